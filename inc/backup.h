@@ -64,6 +64,18 @@ struct _backup_record
   backup_record_ptr         next;                 ///< ONLY IN-MEMORY: next backup record or NULL (tail)
 };
 
+/**********************************************************************************************//**
+ * @typedef void (*backup_progress_cb)(void* ctx, uint64_t bytes);
+ *
+ * @brief Progress callback invoked after each disk transfer of a backup / verification; it may
+ *        also block the caller (e.g. to enforce a bandwidth budget).
+ *
+ * @param ctx   the caller-supplied context pointer
+ * @param bytes number of bytes just transferred from/to the disk
+ **************************************************************************************************/
+
+typedef void (*backup_progress_cb)(void* ctx, uint64_t bytes);
+
 /**********************************************************************************************//**
  * @fn  backup_header_ptr bootstrap_backup(uint64_t device_sectors);
  *
@@ -128,6 +140,28 @@ void free_backup_structure(backup_header_ptr bhp);
 
 bool create_backup_file(disk_ptr dp, backup_header_ptr bhp, DISK_HANDLE h, const char* backup_file, const char *message);
 
+/**********************************************************************************************//**
+ * @fn  bool create_backup_file_ex(disk_ptr dp, backup_header_ptr bhp, DISK_HANDLE h, const char* backup_file, const char* message, backup_progress_cb progress, void* progress_ctx);
+ *
+ * @brief Creates a backup file (see create_backup_file) reporting every disk transfer to a
+ *        progress callback.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param dp          pointer to the disk.
+ * @param bhp         pointer to the backup header.
+ * @param h           disk handle opened for at least 'reading'.
+ * @param backup_file pointer to the fully-qualified, zero-terminated backup file name.
+ * @param message     NULL or a message string (progress is shown)
+ * @param progress    NULL or the progress callback
+ * @param progress_ctx context pointer passed to the progress callback
+ *
+ * @returns true if the backup could be created, false otherwise (error).
+ **************************************************************************************************/
+
+bool create_backup_file_ex(disk_ptr dp, backup_header_ptr bhp, DISK_HANDLE h, const char* backup_file, const char* message, backup_progress_cb progress, void* progress_ctx);
+
 /**********************************************************************************************//**
  * @fn  bool check_backup_file(disk_ptr dp, DISK_HANDLE h, const char* backup_file, const char* message);
  *
@@ -147,6 +181,27 @@ bool create_backup_file(disk_ptr dp, backup_header_ptr bhp, DISK_HANDLE h, const
 
 bool check_backup_file(disk_ptr dp, DISK_HANDLE h, const char* backup_file, const char* message);
 
+/**********************************************************************************************//**
+ * @fn  bool check_backup_file_ex(disk_ptr dp, DISK_HANDLE h, const char* backup_file, const char* message, backup_progress_cb progress, void* progress_ctx);
+ *
+ * @brief Performs a read-back of a backup file (see check_backup_file) reporting every disk
+ *        transfer to a progress callback.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param dp          pointer to the disk.
+ * @param h           disk handle opened for a least 'reading' or INVALID_DISK_HANDLE.
+ * @param backup_file pointer to the fully-qualified, zero-terminated backup file name.
+ * @param message     NULL or a message string (progress is shown)
+ * @param progress    NULL or the progress callback
+ * @param progress_ctx context pointer passed to the progress callback
+ *
+ * @returns true if the backup file matches the included LBAs of the physical disk, false on error.
+ **************************************************************************************************/
+
+bool check_backup_file_ex(disk_ptr dp, DISK_HANDLE h, const char* backup_file, const char* message, backup_progress_cb progress, void* progress_ctx);
+
 /**********************************************************************************************//**
  * @fn  bool restore_backup_file(disk_ptr dp, DISK_HANDLE h, const char* backup_file);
  *
@@ -165,6 +220,60 @@ bool check_backup_file(disk_ptr dp, DISK_HANDLE h, const char* backup_file, cons
 
 bool restore_backup_file(disk_ptr dp, DISK_HANDLE h, const char* backup_file, const char *message);
 
+/**********************************************************************************************//**
+ * @fn  bool restore_backup_plan(disk_ptr dp, const char* backup_file, write_plan_ptr wpp, const char* message);
+ *
+ * @brief Reads and verifies a complete backup file (of at most WRITE_PLAN_MAX_BYTES) and adds
+ *        all records to a write plan, i.e. nothing is written unless the hash of the backup file
+ *        is correct. Records starting within the head region (MBR, primary GPT) are appended
+ *        after a barrier, so that they are written after all other records are durable.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param dp          pointer to the disk (number of device sectors MUST match)
+ * @param backup_file pointer to the fully-qualified, zero-terminated backup file name
+ * @param wpp         the write plan
+ * @param message     NULL or a message string (progress is shown)
+ *
+ * @returns true if the backup was verified and added to the plan, false on error.
+ **************************************************************************************************/
+
+bool restore_backup_plan(disk_ptr dp, const char* backup_file, write_plan_ptr wpp, const char* message);
+
+/**********************************************************************************************//**
+ * @fn  bool backup_add_partition_tables(disk_ptr dp, backup_header_ptr bhp);
+ *
+ * @brief Adds all partition table sectors of a (scanned) disk to a backup: the MBR and all
+ *        extended partition sectors, the primary GPT (LBAs 1..33) and the backup GPT (last 33
+ *        LBAs of the disk, plus the area the primary GPT header points to if it differs).
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param dp  pointer to the disk (disk_scan_partitions must have been called)
+ * @param bhp pointer to the backup header
+ *
+ * @returns true on success, false otherwise.
+ **************************************************************************************************/
+
+bool backup_add_partition_tables(disk_ptr dp, backup_header_ptr bhp);
+
+/**********************************************************************************************//**
+ * @fn  uint64_t backup_get_data_size(backup_header_ptr bhp);
+ *
+ * @brief Computes the number of disk bytes covered by all records of a backup
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param bhp pointer to the backup header
+ *
+ * @returns the number of bytes (sum of all records).
+ **************************************************************************************************/
+
+uint64_t backup_get_data_size(backup_header_ptr bhp);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,73 @@
+/**
+ * @file   clone.h
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @brief  declaration of the clone command, which copies a disk or image file
+ *         to another disk or image file (pipelined, optionally offloaded to
+ *         the file system, verified).
+ *
+ * [MIT license]
+ *
+ * Copyright (c) 2021 Ingo A. Kubbilun
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INC_CLONE_H_
+#define _INC_CLONE_H_
+
+#include <part-y.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CLONE_DEFAULT_CHUNK_SIZE        (4 << 20)                   ///< transfer size if no device profile exists
+#define CLONE_DEFAULT_WORKERS           4                           ///< concurrent reads (and writes) if no device profile exists
+#define CLONE_SEGMENT_CHUNKS            16                          ///< chunks per pipeline segment
+#define CLONE_PROGRESS_INTERVAL_MS      500                         ///< progress update interval
+
+/**********************************************************************************************//**
+ * @fn  int clone_disk(cmdline_args_ptr cap);
+ *
+ * @brief Clones the working disk onto the target --target (device or image file; a missing image
+ *        file is created, an existing one is re-created sparse). The data is copied by a pipeline
+ *        of readers and writers over a ring of two segment buffers; between image files, the copy
+ *        is offloaded to the file system if possible (copy_file_range). Holes of a sparse source
+ *        are not read, and zero chunks are not written to an image file target. Afterwards, the
+ *        clone is verified by parallel readers (unless --no-verify is specified). If the target
+ *        is larger than the source, the backup GPT is relocated to the end of the target.
+ *        With --used-only, the allocation maps of the EXT2/3/4, NTFS and FAT file systems are read
+ *        (all partitions in parallel) and only their used blocks and metadata are copied; the
+ *        unused blocks of a target device are discarded (or zeroed) if the device supports it.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param cap command line arguments
+ *
+ * @returns 0 on success, 1 on error (process exit code).
+ **************************************************************************************************/
+
+int clone_disk(cmdline_args_ptr cap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _INC_CLONE_H_
@@ -0,0 +1,165 @@
+/**
+ * @file   convert.h
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @brief  declaration of the generic table conversions: the convert command
+ *         (MBR to GPT in place) and the writepmbr command (protective MBR).
+ *
+ * [MIT license]
+ *
+ * Copyright (c) 2021 Ingo A. Kubbilun
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INC_CONVERT_H_
+#define _INC_CONVERT_H_
+
+#include <part-y.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CONVERT_BACKUP_SUFFIX           ".mbr.bak"                  ///< default backup file of an image file (appended to the image file name)
+
+typedef struct _convert_plan            convert_plan, * convert_plan_ptr;
+
+struct _convert_plan
+{
+  uint32_t                              num_parts;                  ///< number of converted partitions
+  write_plan_ptr                        wpp;                        ///< the sectors to be written (NULL = nothing to do)
+};
+
+/**********************************************************************************************//**
+ * @fn  bool convert_mbr_to_gpt_plan(disk_ptr dp, convert_plan_ptr cpp, bool verbose, char* error, size_t error_size);
+ *
+ * @brief Builds a GPT from the MBR (and all logical partitions) of a scanned disk. The GPT type
+ *        of each partition is derived from its MBR type (see gpt_get_guid_for_mbr_type), the
+ *        partitions keep their location. The protective MBR (keeping the boot code), the
+ *        primary and the backup GPT are only added to a write plan (backup GPT first), nothing
+ *        is written.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param           dp          the (scanned) disk
+ * @param [in,out]  cpp         receives the plan (release it with convert_free)
+ * @param           verbose     true: print the mapping of each partition
+ * @param [in,out]  error       receives the error message on error
+ * @param           error_size  size of the error buffer in bytes
+ *
+ * @returns true on success, false if the disk cannot be converted (error contains the reason).
+ **************************************************************************************************/
+
+bool convert_mbr_to_gpt_plan(disk_ptr dp, convert_plan_ptr cpp, bool verbose, char* error, size_t error_size);
+
+/**********************************************************************************************//**
+ * @fn  bool convert_write_pmbr_plan(disk_ptr dp, convert_plan_ptr cpp, char* error, size_t error_size);
+ *
+ * @brief Builds a protective MBR for a disk with a healthy GPT, replacing a hybrid (or missing)
+ *        MBR or a protective MBR that does not cover the disk. The boot code is kept.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param           dp          the (scanned) disk
+ * @param [in,out]  cpp         receives the plan (cpp->wpp is NULL if nothing is to be done)
+ * @param [in,out]  error       receives the error message on error
+ * @param           error_size  size of the error buffer in bytes
+ *
+ * @returns true on success, false on error.
+ **************************************************************************************************/
+
+bool convert_write_pmbr_plan(disk_ptr dp, convert_plan_ptr cpp, char* error, size_t error_size);
+
+/**********************************************************************************************//**
+ * @fn  bool convert_commit(disk_ptr dp, convert_plan_ptr cpp, const char* backup_file, backup_progress_cb progress, void* progress_ctx, char* error, size_t error_size);
+ *
+ * @brief Commits a plan: all partition table sectors of the disk (see
+ *        backup_add_partition_tables) are saved to a new backup file, which is verified, then
+ *        the write plan is executed (see write_plan_execute).
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param           dp            the disk
+ * @param           cpp           the plan
+ * @param           backup_file   zero-terminated name of the backup file (must not exist)
+ * @param           progress      NULL or the progress callback (backup transfers)
+ * @param           progress_ctx  context pointer passed to the progress callback
+ * @param [in,out]  error         receives the error message on error
+ * @param           error_size    size of the error buffer in bytes
+ *
+ * @returns true on success, false on error.
+ **************************************************************************************************/
+
+bool convert_commit(disk_ptr dp, convert_plan_ptr cpp, const char* backup_file, backup_progress_cb progress, void* progress_ctx, char* error, size_t error_size);
+
+/**********************************************************************************************//**
+ * @fn  void convert_free(convert_plan_ptr cpp);
+ *
+ * @brief Releases the write plan of a conversion plan
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param cpp the plan
+ **************************************************************************************************/
+
+void convert_free(convert_plan_ptr cpp);
+
+/**********************************************************************************************//**
+ * @fn  int convert_mbr_to_gpt(cmdline_args_ptr cap);
+ *
+ * @brief Converts the MBR of the working disk to a GPT in place (see convert_mbr_to_gpt_plan and
+ *        convert_commit). The backup file is --backup-file or, for image files, the image file
+ *        name plus CONVERT_BACKUP_SUFFIX. If a fleet list file is specified (--fleet), all disks
+ *        of the list are converted in parallel instead (see fleet_convert).
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param cap command line arguments
+ *
+ * @returns 0 on success, 1 on error (process exit code).
+ **************************************************************************************************/
+
+int convert_mbr_to_gpt(cmdline_args_ptr cap);
+
+/**********************************************************************************************//**
+ * @fn  int convert_write_pmbr(cmdline_args_ptr cap);
+ *
+ * @brief Writes a protective MBR to the working disk (see convert_write_pmbr_plan and
+ *        convert_commit).
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param cap command line arguments
+ *
+ * @returns 0 on success, 1 on error (process exit code).
+ **************************************************************************************************/
+
+int convert_write_pmbr(cmdline_args_ptr cap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _INC_CONVERT_H_
@@ -0,0 +1,66 @@
+/**
+ * @file   create.h
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @brief  declaration of the create command, which lays out a new MBR or GPT
+ *         on a device or image file and commits all table sectors in one batch.
+ *
+ * [MIT license]
+ *
+ * Copyright (c) 2021 Ingo A. Kubbilun
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INC_CREATE_H_
+#define _INC_CREATE_H_
+
+#include <part-y.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CREATE_MBR_MAX_PARTITIONS       4                           ///< only primary partitions are created in an MBR
+#define CREATE_MBR_MAX_LBA              0xFFFFFFFF                  ///< MBR entries store 32bit LBAs
+
+/**********************************************************************************************//**
+ * @fn  int create_partition_table(cmdline_args_ptr cap);
+ *
+ * @brief Creates a new partition table (--part-type=MBR|GPT) containing the partitions specified
+ *        by --partition (in this order) on the working disk. The partitions are placed first-fit
+ *        at aligned boundaries (see disk_partition_alignment). All table sectors (protective MBR,
+ *        primary header and entries, backup entries and header or the MBR) are built in memory
+ *        and written by one write plan (see writeplan.h): the backup GPT first, then, after a
+ *        flush, the head region. Stale GPT copies are cleared if an MBR replaces a GPT.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param cap command line arguments
+ *
+ * @returns 0 on success, 1 on error (process exit code).
+ **************************************************************************************************/
+
+int create_partition_table(cmdline_args_ptr cap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _INC_CREATE_H_
@@ -50,6 +50,32 @@ extern "C" {
 #define DISK_FLAG_HAS_MBR               0x00000008                  ///< MBR partition table could be successfully read and parsed
 #define DISK_FLAG_MBR_IS_PROTECTIVE     0x00000010                  ///< only set if both MBR and GPT present AND MBR only contains one 0xEE entry
 #define DISK_FLAG_HAS_GPT               0x00000020                  ///< GPT partition table could be successfully read and parsed
+#define DISK_FLAG_SPARSE_FILE           0x00000040                  ///< image file is sparse (not all blocks allocated, holes read back as zeros)
+#define DISK_FLAG_PROBED                0x00000080                  ///< size and sector sizes are known (sysfs metadata or device opened)
+#define DISK_FLAG_SCANNED               0x00000100                  ///< partition tables have been scanned (see disk_ensure_scanned)
+#define DISK_FLAG_ROTATIONAL            0x00000200                  ///< device has a seek penalty (spinning disk)
+#define DISK_FLAG_DISCARD               0x00000400                  ///< device supports discard (TRIM, UNMAP)
+
+#define DISK_ZERO_NONE                  0x00000000                  ///< no fast zeroing available, data has to be written
+#define DISK_ZERO_WRITE_ZEROES          0x00000001                  ///< device zeroes the blocks itself (WRITE ZEROES / WRITE SAME)
+#define DISK_ZERO_PUNCH_HOLE            0x00000002                  ///< image file: blocks deallocated (file becomes sparse)
+#define DISK_ZERO_ZERO_RANGE            0x00000003                  ///< image file: blocks zeroed by the file system (allocation kept)
+
+#define DISK_ZERO_CHUNK_SIZE            (1 << 30)                   ///< max. range of one zeroing request (progress granularity)
+
+#define DISK_EXPLORE_MAX_WORKERS        16                          ///< max. number of devices probed and scanned in parallel
+#define DISK_PROBE_DEFAULT_TIMEOUT_MS   10000                       ///< default deadline for opening (and scanning) one device
+#define DISK_PROBE_POLL_MS              20                          ///< interval in which the deadlines of the probed devices are checked
+#define DISK_BATCH_READ_WORKERS         8                           ///< max. number of concurrent reads of disk_read_batch
+#define DISK_GPT_HEAD_SECTORS           34                          ///< MBR + GPT header + 32 sectors of GPT entries (128 entries)
+#define DISK_POOL_MAX_HANDLES           64                          ///< max. number of device handles kept open for reuse
+#define DISK_MAX_IO_VECTORS             64                          ///< max. number of segments passed to one vectored write system call
+#define DISK_PARTITION_ALIGNMENT        (1 << 20)                   ///< default partition boundary (1 MiB, a multiple of all physical sector sizes)
+#define DISK_MAX_PARTITION_ALIGNMENT    (16 << 20)                  ///< max. boundary derived from the optimal I/O size (16 MiB)
+
+#define DISK_PLACE_FIRST_FIT            0x00000000                  ///< allocate the first (lowest) free extent that is large enough
+#define DISK_PLACE_BEST_FIT             0x00000001                  ///< allocate the smallest free extent that is large enough
+#define DISK_PLACE_EXPLICIT             0x00000002                  ///< allocate at the start LBA specified by the caller
 
 typedef struct _mbr_part_sector        *mbr_part_sector_ptr;        ///< forward definition
 
@@ -57,6 +83,24 @@ typedef struct _disk                    disk, * disk_ptr;
 typedef struct _sector                  sector, * sector_ptr;
 typedef struct _disk_map                disk_map, * disk_map_ptr;
 typedef struct _gpt                    *gpt_ptr;                    ///< forward
+typedef struct _scan_cache             *scan_cache_ptr;             ///< forward (see scancache.h)
+typedef struct _scan_cache_entry       *scan_cache_entry_ptr;       ///< forward (see scancache.h)
+typedef struct _disk_pool_stats         disk_pool_stats, * disk_pool_stats_ptr;
+typedef struct _disk_io_vector          disk_io_vector, * disk_io_vector_ptr;
+
+struct _disk_pool_stats
+{
+  uint64_t                              opens;                      ///< device handles opened
+  uint64_t                              opens_avoided;              ///< disk_open_device calls served by an idle pooled handle
+  uint64_t                              syncs;                      ///< handles flushed because they were written to
+  uint64_t                              syncs_avoided;              ///< handles released without flushing (nothing written)
+};
+
+struct _disk_io_vector
+{
+  const uint8_t                        *buffer;                     ///< segment data (aligned like all buffers used for device I/O)
+  uint32_t                              size;                       ///< segment size in bytes (multiple of 512)
+};
 
 struct _disk
 {
@@ -79,6 +123,16 @@ struct _disk
   uint32_t                              flags;                      ///< some disk flags, see above
   uint32_t                              logical_sector_size;        ///< if this is != 512 = SECTOR_SIZE, then this tool refuses to use the disk
   uint32_t                              physical_sector_size;       ///< usually 512, can be 4096 (4K drive with 512 emulation aka '512e', though.
+  uint64_t                              allocated_size;             ///< image files: number of bytes allocated on the file system (<= device_size)
+  uint32_t                              min_io_size;                ///< smallest I/O without read-modify-write (e.g. RAID chunk; 0 = unknown)
+  uint32_t                              opt_io_size;                ///< optimal I/O size reported by the device (e.g. RAID stripe width; 0 = none)
+  uint32_t                              max_transfer_size;          ///< largest transfer of one request to the device (0 = unknown)
+  uint32_t                              alignment_offset;           ///< byte offset of the first naturally aligned physical sector
+
+  uint32_t                              io_read_size;               ///< preferred read transfer size from the device profile (0 = built-in default)
+  uint32_t                              io_read_depth;              ///< preferred number of concurrent reads from the device profile (0 = built-in default)
+  uint32_t                              io_write_size;              ///< preferred write transfer size from the device profile (0 = built-in default)
+  uint32_t                              io_write_depth;             ///< preferred number of concurrent writes from the device profile (0 = built-in default)
 
   mbr_part_sector_ptr                   mbr;                        ///< if != NULL, then MBR (plus optional extended partition tables) successfully scanned
   disk_map_ptr                          mbr_dmp;                    ///< the disk map according to MBR plus any extended partitions (logical drives)
@@ -96,6 +150,12 @@ struct _disk
   bool                                  backup_gpt_corrupt;         ///< true if secondary=backup GPT could be successfully parsed
   disk_map_ptr                          gpt_dmp;                    ///< the disk map according to GPT
   bool                                  gpts_mismatch;              ///< true if both GPTs mismatch (which is bad -> corrupt GPT(s))
+
+  scan_cache_ptr                        scan_cache;                 ///< scan result cache (NULL = disabled)
+  scan_cache_entry_ptr                  scan_replay;                ///< cached scan served by disk_read_sectors (during disk_scan_partitions only)
+  scan_cache_entry_ptr                  scan_record;                ///< sectors read by the last scan (stored in the cache by scan_cache_save)
+  bool                                  scan_recording;             ///< disk_read_sectors appends to scan_record (during disk_scan_partitions only)
+  bool                                  scan_cache_invalid;         ///< the cached scan is void (disk written or scan deviates from the cache)
 };
 
 struct _sector
@@ -125,12 +185,18 @@ struct _disk_map
   char                          description[64];
 
   bool                          is_free;
+
+  uint32_t                      num_items;        ///< first item of a sorted map only: number of items of the contiguous array (0 = plain list)
+  uint32_t                      largest_free;     ///< first item of a sorted map only: index of the largest free item (num_items if none)
 };
 
 /**********************************************************************************************//**
  * @fn  uint32_t disk_explore_all(disk_ptr* head, disk_ptr* tail);
  *
- * @brief Explore all disks in the system (Windows or Linux)
+ * @brief Explore all disks in the system (Windows or Linux). This is just the cheap enumeration
+ *        (Linux: including size and sector sizes from sysfs); the devices are not opened and their
+ *        partition tables are not scanned, see disk_probe_all and disk_ensure_scanned. The list is
+ *        always in device order.
  *
  * @author Ingo A. Kubbilun (www.devcorn.de)
  * @date   01.09.2021
@@ -143,6 +209,59 @@ struct _disk_map
 
 uint32_t disk_explore_all(disk_ptr* head, disk_ptr* tail);
 
+/**********************************************************************************************//**
+ * @fn  void disk_probe_all(disk_ptr head, bool scan, uint32_t timeout_ms);
+ *
+ * @brief Opens all (not yet probed) disks of a list retrieving their sizes and, optionally, scans
+ *        their partition tables. The disks are processed in parallel (at most
+ *        DISK_EXPLORE_MAX_WORKERS at a time), so slow devices do not block the others. Each disk
+ *        has to be completed within timeout_ms after its probing has started; a disk which misses
+ *        its deadline is marked with DISK_FLAG_READ_ACCESS_ERROR and left behind (the blocked
+ *        worker finishes in the background), so this function returns after the deadlines even
+ *        if a device hangs.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param head        head of the disk list
+ * @param scan        true: also scan the partition tables
+ * @param timeout_ms  deadline per disk in milliseconds (0 = no deadline)
+ **************************************************************************************************/
+
+void disk_probe_all(disk_ptr head, bool scan, uint32_t timeout_ms);
+
+/**********************************************************************************************//**
+ * @fn  bool disk_probe(disk_ptr dp, bool scan, uint32_t timeout_ms);
+ *
+ * @brief Same as disk_probe_all, but for one disk (which may be part of a list).
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param dp          pointer to the disk
+ * @param scan        true: also scan the partition tables
+ * @param timeout_ms  deadline in milliseconds (0 = no deadline)
+ *
+ * @returns true on success, false if the disk cannot be accessed (or missed its deadline).
+ **************************************************************************************************/
+
+bool disk_probe(disk_ptr dp, bool scan, uint32_t timeout_ms);
+
+/**********************************************************************************************//**
+ * @fn  bool disk_ensure_scanned(disk_ptr dp);
+ *
+ * @brief Scans the partition tables of a disk if this has not been done yet
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param dp  pointer to the disk
+ *
+ * @returns true on success (or if already scanned), false on error.
+ **************************************************************************************************/
+
+bool disk_ensure_scanned(disk_ptr dp);
+
 /**********************************************************************************************//**
  * @fn  void disk_free_list(disk_ptr head);
  *
@@ -159,7 +278,10 @@ void disk_free_list(disk_ptr head);
 /**********************************************************************************************//**
  * @fn  DISK_HANDLE disk_open_device(const char* device_file, bool writeAccess);
  *
- * @brief opens a device file in read-only or read-write mode
+ * @brief opens a device file in read-only or read-write mode. Handles are pooled per process:
+ *        an idle handle of the same device file and mode (released by disk_close_device) is
+ *        reused instead of opening the device again. A handle is never shared by two users at
+ *        the same time.
  *
  * @author Ingo A. Kubbilun (www.devcorn.de)
  * @date   01.09.2021
@@ -175,7 +297,9 @@ DISK_HANDLE disk_open_device(const char* device_file, bool writeAccess);
 /**********************************************************************************************//**
  * @fn  void disk_close_device(DISK_HANDLE h);
  *
- * @brief closes a device file
+ * @brief releases a device file handle to the pool. If data has been written using the handle,
+ *        it is flushed (fdatasync plus BLKFLSBUF for block devices on Linux, FlushFileBuffers on
+ *        Windows); read-only handles are released without any flush.
  *
  * @author Ingo A. Kubbilun (www.devcorn.de)
  * @date   01.09.2021
@@ -185,6 +309,67 @@ DISK_HANDLE disk_open_device(const char* device_file, bool writeAccess);
 
 void disk_close_device(DISK_HANDLE h);
 
+/**********************************************************************************************//**
+ * @fn  void disk_pool_release(const char* device_file);
+ *
+ * @brief closes all idle pooled handles of a device file (or of all device files), e.g. before
+ *        an image file is resized or before an external program needs exclusive access.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param device_file device file or NULL for all device files
+ **************************************************************************************************/
+
+void disk_pool_release(const char* device_file);
+
+/**********************************************************************************************//**
+ * @fn  DISK_HANDLE disk_open_device_batched(const char* device_file);
+ *
+ * @brief opens a device file for a batch of writes, which are made durable by explicit flushes
+ *        (disk_flush_device) instead of by every single write (no O_SYNC on Linux, no
+ *        FILE_FLAG_WRITE_THROUGH on Windows). The handle is not pooled; disk_close_device
+ *        flushes and closes it.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param device_file fully-qualified device file name
+ *
+ * @returns INVALID_DISK_HANDLE on error or a usable DISK_HANDLE (success)
+ **************************************************************************************************/
+
+DISK_HANDLE disk_open_device_batched(const char* device_file);
+
+/**********************************************************************************************//**
+ * @fn  bool disk_flush_device(DISK_HANDLE h);
+ *
+ * @brief makes all data written using the handle so far durable (fdatasync on Linux,
+ *        FlushFileBuffers on Windows). This is the write barrier of batched writes.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param h handle to the opened device file
+ *
+ * @returns true on success, false on error.
+ **************************************************************************************************/
+
+bool disk_flush_device(DISK_HANDLE h);
+
+/**********************************************************************************************//**
+ * @fn  void disk_pool_get_stats(disk_pool_stats_ptr stats);
+ *
+ * @brief retrieves the counters of the handle pool.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param [in,out]  stats receives the counters
+ **************************************************************************************************/
+
+void disk_pool_get_stats(disk_pool_stats_ptr stats);
+
 /**********************************************************************************************//**
  * @fn  uint64_t disk_get_size(const char* device_file, DISK_HANDLE h, uint32_t* logical_sector_size, uint32_t* physical_sector_size);
  *
@@ -204,6 +389,83 @@ void disk_close_device(DISK_HANDLE h);
 
 uint64_t disk_get_size(const char* device_file, DISK_HANDLE h, uint32_t* logical_sector_size, uint32_t* physical_sector_size);
 
+/**********************************************************************************************//**
+ * @fn  bool disk_get_geometry(disk_ptr dp, DISK_HANDLE h);
+ *
+ * @brief retrieves the size, the sector sizes and the I/O limits of an opened device (or image
+ *        file) and stores them in the disk structure. On Linux, the block device ioctls are used
+ *        (BLKGETSIZE64, BLKSSZGET, BLKPBSZGET, BLKIOMIN, BLKIOOPT, BLKALIGNOFF); the queue
+ *        attributes are looked up in sysfs by the device number, so this also works for
+ *        partitions and symbolic links to device files.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param [in,out]  dp  pointer to the disk receiving the geometry
+ * @param           h   handle to the already opened device file.
+ *
+ * @returns true on success, false if the size cannot be retrieved.
+ **************************************************************************************************/
+
+bool disk_get_geometry(disk_ptr dp, DISK_HANDLE h);
+
+/**********************************************************************************************//**
+ * @fn  uint32_t disk_io_size(disk_ptr dp, uint32_t preferred, uint32_t default_size);
+ *
+ * @brief chooses the transfer size of an I/O engine. A preferred size (from the device profile)
+ *        is used as is; otherwise, the default size is rounded down to a multiple of the optimal
+ *        I/O size of the device (or of the minimum I/O size and the physical sector size), so
+ *        that no transfer causes a read-modify-write cycle in the device.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param dp            pointer to the disk
+ * @param preferred     preferred transfer size (0 = none)
+ * @param default_size  built-in default transfer size of the engine
+ *
+ * @returns the transfer size in bytes (a multiple of SECTOR_SIZE).
+ **************************************************************************************************/
+
+uint32_t disk_io_size(disk_ptr dp, uint32_t preferred, uint32_t default_size);
+
+/**********************************************************************************************//**
+ * @fn  void disk_partition_alignment(disk_ptr dp, uint64_t* align_lbas, uint64_t* align_offset);
+ *
+ * @brief computes the boundary new partitions are aligned to: DISK_PARTITION_ALIGNMENT (1 MiB)
+ *        or, if the device reports an optimal I/O size (e.g. RAID stripe width), the least common
+ *        multiple of both. An optimal I/O size that is not a multiple of the physical sector size
+ *        or that yields a boundary above DISK_MAX_PARTITION_ALIGNMENT (16 MiB) is implausible and
+ *        ignored. The alignment offset of the device shifts all boundaries.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param           dp            pointer to the disk
+ * @param [in,out]  align_lbas    receives the alignment in LBAs
+ * @param [in,out]  align_offset  receives the LBA of the first aligned boundary (< align_lbas)
+ **************************************************************************************************/
+
+void disk_partition_alignment(disk_ptr dp, uint64_t* align_lbas, uint64_t* align_offset);
+
+/**********************************************************************************************//**
+ * @fn  uint64_t disk_align_lba(uint64_t lba, uint64_t align_lbas, uint64_t align_offset, bool round_up);
+ *
+ * @brief rounds an LBA to a boundary align_offset + n * align_lbas.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param lba           the LBA
+ * @param align_lbas    alignment in LBAs (0 or 1: no alignment)
+ * @param align_offset  LBA of the first aligned boundary (less than align_lbas)
+ * @param round_up      true to round up, false to round down
+ *
+ * @returns the aligned LBA (LBAs below align_offset are not rounded down).
+ **************************************************************************************************/
+
+uint64_t disk_align_lba(uint64_t lba, uint64_t align_lbas, uint64_t align_offset, bool round_up);
+
 /**********************************************************************************************//**
  * @fn  bool disk_read(disk_ptr dp, DISK_HANDLE h, uint64_t fp, uint8_t* buffer, uint32_t size);
  *
@@ -242,6 +504,124 @@ bool disk_read(disk_ptr dp, DISK_HANDLE h, uint64_t fp, uint8_t* buffer, uint32_
 
 bool disk_write(disk_ptr dp, DISK_HANDLE h, uint64_t fp, const uint8_t * buffer, uint32_t size);
 
+/**********************************************************************************************//**
+ * @fn  bool disk_read_at(DISK_HANDLE h, uint64_t fp, uint8_t* buffer, uint32_t size);
+ *
+ * @brief Positional disk read, which does not modify the file pointer of the handle. Thus, this
+ *        function can be called concurrently by several threads sharing one handle.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param h       disk handle
+ * @param fp      file pointer (zero-based, must be divisible by 512)
+ * @param buffer  buffer receiving the data (aligned to SECTOR_MEM_ALIGN for unbuffered handles)
+ * @param size    size of the data to be read, must be divisible by 512
+ *
+ * @returns True if it succeeds, false if it fails.
+ **************************************************************************************************/
+
+bool disk_read_at(DISK_HANDLE h, uint64_t fp, uint8_t* buffer, uint32_t size);
+
+/**********************************************************************************************//**
+ * @fn  bool disk_write_at(DISK_HANDLE h, uint64_t fp, const uint8_t* buffer, uint32_t size);
+ *
+ * @brief Positional disk write (see disk_read_at)
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param h       disk handle
+ * @param fp      file pointer (zero-based, must be divisible by 512)
+ * @param buffer  buffer containing the data (aligned to SECTOR_MEM_ALIGN for unbuffered handles)
+ * @param size    size of the data to be written, must be divisible by 512
+ *
+ * @returns True if it succeeds, false if it fails.
+ **************************************************************************************************/
+
+bool disk_write_at(DISK_HANDLE h, uint64_t fp, const uint8_t* buffer, uint32_t size);
+
+/**********************************************************************************************//**
+ * @fn  bool disk_write_vector_at(DISK_HANDLE h, uint64_t fp, const disk_io_vector* iov, uint32_t num_iov);
+ *
+ * @brief Positional gather write: the segments are written back to back starting at fp using as
+ *        few system calls as possible (pwritev on Linux, at most DISK_MAX_IO_VECTORS segments per
+ *        call; short writes are completed).
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param h       disk handle
+ * @param fp      file pointer (zero-based, must be divisible by 512)
+ * @param iov     array of segments (each aligned to SECTOR_MEM_ALIGN, size divisible by 512)
+ * @param num_iov number of segments
+ *
+ * @returns True if it succeeds, false if it fails.
+ **************************************************************************************************/
+
+bool disk_write_vector_at(DISK_HANDLE h, uint64_t fp, const disk_io_vector* iov, uint32_t num_iov);
+
+/**********************************************************************************************//**
+ * @fn  bool disk_copy_range(DISK_HANDLE src, uint64_t src_fp, DISK_HANDLE dst, uint64_t dst_fp, uint64_t size);
+ *
+ * @brief Copies a range between two image files without transferring the data through user space
+ *        (copy_file_range on Linux, which lets the file system share the blocks, e.g. reflinks on
+ *        XFS and btrfs, or copy them on the server side, e.g. NFS). Not available on Windows.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param src     source handle
+ * @param src_fp  start of the source range (zero-based)
+ * @param dst     destination handle opened for writing
+ * @param dst_fp  start of the destination range (zero-based)
+ * @param size    size of the range in bytes
+ *
+ * @returns true on success, false if the offload is not supported or failed; the caller has to
+ *          copy the range by reading and writing it then.
+ **************************************************************************************************/
+
+bool disk_copy_range(DISK_HANDLE src, uint64_t src_fp, DISK_HANDLE dst, uint64_t dst_fp, uint64_t size);
+
+/**********************************************************************************************//**
+ * @fn  bool disk_zero_range(disk_ptr dp, DISK_HANDLE h, uint64_t fp, uint64_t size, const char* message, uint32_t* method);
+ *
+ * @brief Zeroes a range of a device or image file without transferring zero buffers, i.e. the
+ *        zeroing is offloaded to the device (Linux: BLKZEROOUT if the queue limits report
+ *        WRITE ZEROES / WRITE SAME support) or to the file system (image files: hole punching or
+ *        zero ranges). Discards are not used: they do not guarantee that blocks read back as zeros.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param           dp      pointer to the disk
+ * @param           h       disk handle opened for writing
+ * @param           fp      start of the range (zero-based, must be divisible by 512)
+ * @param           size    size of the range (must be divisible by 512)
+ * @param           message NULL or a message string (progress is shown)
+ * @param [in,out]  method  receives the zeroing method (DISK_ZERO_xxx)
+ *
+ * @returns true if the range has been zeroed, false if no fast zeroing method is available or if
+ *          it failed; the caller has to write zeros then.
+ **************************************************************************************************/
+
+bool disk_zero_range(disk_ptr dp, DISK_HANDLE h, uint64_t fp, uint64_t size, const char* message, uint32_t* method);
+
+/**********************************************************************************************//**
+ * @fn  const char* disk_zero_method_name(uint32_t method);
+ *
+ * @brief Retrieves a human-readable name of a zeroing method
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param method  zeroing method (DISK_ZERO_xxx)
+ *
+ * @returns zero-terminated name of the method.
+ **************************************************************************************************/
+
+const char* disk_zero_method_name(uint32_t method);
+
 /**********************************************************************************************//**
  * @fn  uint64_t disk_getFileSize(DISK_HANDLE h);
  *
@@ -257,6 +637,74 @@ bool disk_write(disk_ptr dp, DISK_HANDLE h, uint64_t fp, const uint8_t * buffer,
 
 uint64_t disk_getFileSize(DISK_HANDLE h);
 
+/**********************************************************************************************//**
+ * @fn  bool disk_resize_image(const char* image_file, uint64_t size, bool preallocate);
+ *
+ * @brief Creates (if it does not exist) and truncates or extends an image file without writing any
+ *        data. The image file is sparse unless preallocate is true, i.e. only the blocks actually
+ *        written later on occupy disk space.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param image_file  zero-terminated name of the image file
+ * @param size        new size of the image file in bytes
+ * @param preallocate true: allocate all blocks of the image file (fallocate); false: sparse file
+ *
+ * @returns true on success, false on error.
+ **************************************************************************************************/
+
+bool disk_resize_image(const char* image_file, uint64_t size, bool preallocate);
+
+/**********************************************************************************************//**
+ * @fn  uint64_t disk_get_allocated_size(DISK_HANDLE h);
+ *
+ * @brief Retrieves the number of bytes actually allocated by an (image) file on its file system,
+ *        which is less than the file size if the file is sparse.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param h the already open file (handle)
+ *
+ * @returns the allocated size in bytes or (uint64_t)-1 on error.
+ **************************************************************************************************/
+
+uint64_t disk_get_allocated_size(DISK_HANDLE h);
+
+/**********************************************************************************************//**
+ * @fn  bool disk_range_has_data(DISK_HANDLE h, uint64_t fp, uint64_t size);
+ *
+ * @brief Checks if a range of an (image) file contains any allocated data. Ranges which are holes
+ *        read back as zeros, so there is nothing to be parsed (or zeroed) there.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param h     the already open file (handle)
+ * @param fp    start of the range (zero-based)
+ * @param size  size of the range in bytes
+ *
+ * @returns false if the range is a hole, true if it contains data (or if this cannot be determined).
+ **************************************************************************************************/
+
+bool disk_range_has_data(DISK_HANDLE h, uint64_t fp, uint64_t size);
+
+/**********************************************************************************************//**
+ * @fn  bool disk_file_exists(const char* file_name);
+ *
+ * @brief Checks if a file (or device) exists
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param file_name zero-terminated name of the file
+ *
+ * @returns true if the file exists, false otherwise.
+ **************************************************************************************************/
+
+bool disk_file_exists(const char* file_name);
+
 /**********************************************************************************************//**
  * @fn  sector_ptr disk_read_sectors(disk_ptr dp, DISK_HANDLE h, sector_ptr* head, sector_ptr* tail, uint64_t lba, uint32_t num_sectors);
  *
@@ -280,6 +728,32 @@ uint64_t disk_getFileSize(DISK_HANDLE h);
 
 sector_ptr disk_read_sectors(disk_ptr dp, DISK_HANDLE h, sector_ptr* head, sector_ptr* tail, uint64_t lba, uint32_t num_sectors);
 
+/**********************************************************************************************//**
+ * @fn  bool disk_read_batch(disk_ptr dp, DISK_HANDLE h, const uint64_t* lbas, uint32_t num_reads, uint32_t num_sectors, uint8_t* buffer, bool* ok);
+ *
+ * @brief Reads a batch of small windows (of equal size) into one buffer. The windows are read
+ *        concurrently with positional reads (at most DISK_BATCH_READ_WORKERS at a time), so the
+ *        device latency is paid once per batch and not once per window. While
+ *        disk_scan_partitions runs, the windows are served from or recorded in the scan cache
+ *        just like disk_read_sectors does.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param           dp          pointer to the disk
+ * @param           h           open DISK_HANDLE (shared by all reads)
+ * @param           lbas        array of num_reads start LBAs
+ * @param           num_reads   number of windows
+ * @param           num_sectors number of sectors of each window
+ * @param [in,out]  buffer      receives the windows one after another (num_reads * num_sectors
+ *                              sectors)
+ * @param [in,out]  ok          array of num_reads flags, receives the result of each window
+ *
+ * @returns true if all windows could be read, false if at least one failed (see ok).
+ **************************************************************************************************/
+
+bool disk_read_batch(disk_ptr dp, DISK_HANDLE h, const uint64_t* lbas, uint32_t num_reads, uint32_t num_sectors, uint8_t* buffer, bool* ok);
+
 /**********************************************************************************************//**
  * @fn  void disk_free_sector(sector_ptr sp);
  *
@@ -349,6 +823,104 @@ void disk_dump_info(disk_ptr dp);
 
 void disk_dump_map(disk_map_ptr dmp);
 
+/**********************************************************************************************//**
+ * @fn  disk_map_ptr sort_and_complete_disk_map(disk_map_ptr dmp, uint64_t deviceSectorSize);
+ *
+ * @brief Sorts a disk map (O(n log n)) and fills partition gaps with free (unallocated) entries.
+ *        The result is a contiguous array of items, which are still linked via prev/next, so that
+ *        the queries below can use binary searches. The input list is always consumed.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param dmp               plain (unsorted) disk map list
+ * @param deviceSectorSize  number of sectors of the device
+ *
+ * @returns The sorted and complete disk map or NULL on error (overlapping entries or double
+ *          partition GUIDs).
+ **************************************************************************************************/
+
+disk_map_ptr sort_and_complete_disk_map(disk_map_ptr dmp, uint64_t deviceSectorSize);
+
+/**********************************************************************************************//**
+ * @fn  disk_map_ptr disk_map_find(disk_map_ptr dmp, uint64_t lba);
+ *
+ * @brief Looks up the disk map item containing an LBA (binary search in a sorted map).
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param dmp disk map
+ * @param lba the LBA
+ *
+ * @returns the item or NULL if the LBA is not covered by the map.
+ **************************************************************************************************/
+
+disk_map_ptr disk_map_find(disk_map_ptr dmp, uint64_t lba);
+
+/**********************************************************************************************//**
+ * @fn  disk_map_ptr disk_map_largest_free(disk_map_ptr dmp);
+ *
+ * @brief Returns the largest free (unallocated) extent of a disk map. For sorted maps, it is
+ *        determined once by sort_and_complete_disk_map.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param dmp disk map
+ *
+ * @returns the free item or NULL if there is no free space at all.
+ **************************************************************************************************/
+
+disk_map_ptr disk_map_largest_free(disk_map_ptr dmp);
+
+/**********************************************************************************************//**
+ * @fn  bool disk_map_next_free(disk_map_ptr dmp, uint64_t from_lba, uint64_t num_lbas, uint64_t align_lbas, uint64_t align_offset, uint64_t* lba_start);
+ *
+ * @brief Finds the first free range of num_lbas LBAs starting at or after from_lba, whose start
+ *        is aligned (see disk_align_lba).
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param           dmp           sorted disk map
+ * @param           from_lba      first LBA to be considered
+ * @param           num_lbas      number of LBAs requested
+ * @param           align_lbas    alignment in LBAs (0 or 1: no alignment)
+ * @param           align_offset  LBA of the first aligned boundary (less than align_lbas)
+ * @param [in,out]  lba_start     receives the start LBA of the free range
+ *
+ * @returns true if found, false if there is no such range.
+ **************************************************************************************************/
+
+bool disk_map_next_free(disk_map_ptr dmp, uint64_t from_lba, uint64_t num_lbas, uint64_t align_lbas, uint64_t align_offset, uint64_t* lba_start);
+
+/**********************************************************************************************//**
+ * @fn  bool disk_map_allocate(disk_map_ptr dmp, uint32_t placement, uint64_t num_lbas, uint64_t align_lbas, uint64_t align_offset, uint64_t* lba_start, uint64_t* lba_count);
+ *
+ * @brief Allocates an extent for a new partition in the free space of a sorted disk map. The
+ *        start LBA is always rounded up to the next aligned boundary (see disk_align_lba), the
+ *        free extents are chosen first-fit or best-fit (DISK_PLACE_xxx). For DISK_PLACE_EXPLICIT,
+ *        the extent starts at the (aligned) LBA passed in lba_start. The disk map is not modified.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param           dmp           sorted disk map
+ * @param           placement     DISK_PLACE_xxx
+ * @param           num_lbas      number of LBAs requested; 0 = the whole free extent (for best-fit:
+ *                                the largest one)
+ * @param           align_lbas    alignment in LBAs (0 or 1: no alignment)
+ * @param           align_offset  LBA of the first aligned boundary (less than align_lbas)
+ * @param [in,out]  lba_start     DISK_PLACE_EXPLICIT: requested start LBA; receives the start LBA
+ *                                of the extent
+ * @param [in,out]  lba_count     receives the number of LBAs of the extent
+ *
+ * @returns true on success, false if there is no suitable free extent.
+ **************************************************************************************************/
+
+bool disk_map_allocate(disk_map_ptr dmp, uint32_t placement, uint64_t num_lbas, uint64_t align_lbas, uint64_t align_offset, uint64_t* lba_start, uint64_t* lba_count);
+
 typedef struct _cmdline_args *cmdline_args_ptr;
 
 /**********************************************************************************************//**
@@ -493,22 +1065,6 @@ void disk_free_diskpart_volume_list(diskpart_volume_ptr item);
 
 win_volume_ptr findWindowsVolumeByPartitionStartLBA(win_volume_ptr head, uint32_t disk_number, uint64_t start_lba);
 
-/**********************************************************************************************//**
- * @fn  disk_map_ptr sort_and_complete_disk_map(disk_map_ptr dmp, uint64_t deviceSectorSize);
- *
- * @brief (Windows only) Sorts a disk map and fill partition gaps with free (unallocated) entries
- *
- * @author Ingo A. Kubbilun (www.devcorn.de)
- * @date   01.09.2021
- *
- * @param dmp               The dmp.
- * @param deviceSectorSize  Size of the device sector.
- *
- * @returns The sorted and complete disk map.
- **************************************************************************************************/
-
-disk_map_ptr sort_and_complete_disk_map(disk_map_ptr dmp, uint64_t deviceSectorSize);
-
 #ifdef _WINDOWS
 
 /**********************************************************************************************//**
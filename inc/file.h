@@ -143,6 +143,26 @@ bool file_setpointer(FILE_HANDLE f, uint64_t pos);
 
 uint64_t file_get_size(FILE_HANDLE f);
 
+/**********************************************************************************************//**
+ * @fn  bool file_replace(const char* file_name, const void* data, uint32_t size);
+ *
+ * @brief Atomically and durably replaces the contents of a (small) file, e.g. a checkpoint: the
+ *        data is written to <file_name>.tmp and synced, then the temporary file is renamed over
+ *        the file (Linux: the directory is synced, too). After a crash, the file either has its
+ *        old or its new contents.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param file_name zero-terminated name of the file
+ * @param data      new contents of the file
+ * @param size      size of the new contents in bytes
+ *
+ * @returns true on success, false otherwise
+ **************************************************************************************************/
+
+bool file_replace(const char* file_name, const void* data, uint32_t size);
+
 /**********************************************************************************************//**
  * @fn  bool file_copy(const char* src_name, const char* dst_name);
  *
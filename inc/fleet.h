@@ -0,0 +1,193 @@
+/**
+ * @file   fleet.h
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @brief  declaration of structures and functions that perform operations
+ *         (e.g. partition table backups) on a whole fleet of disks in one
+ *         process using a shared worker pool and a global resource budget.
+ *
+ * [MIT license]
+ *
+ * Copyright (c) 2021 Ingo A. Kubbilun
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INC_FLEET_H_
+#define _INC_FLEET_H_
+
+#include <part-y.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FLEET_JOB_PENDING               0x00000000                  ///< job not yet started
+#define FLEET_JOB_RUNNING               0x00000001                  ///< job is being executed by a worker
+#define FLEET_JOB_OK                    0x00000002                  ///< job successfully completed
+#define FLEET_JOB_FAILED                0x00000003                  ///< job failed (see error message)
+
+#define FLEET_PROGRESS_INTERVAL_MS      500                         ///< update interval of the aggregated progress line
+
+typedef struct _fleet_job               fleet_job, * fleet_job_ptr;
+typedef struct _fleet                   fleet, * fleet_ptr;
+
+/**********************************************************************************************//**
+ * @typedef bool (*fleet_job_op)(fleet_job_ptr job, disk_ptr dp);
+ *
+ * @brief Operation of a fleet command (plan and commit), invoked by a worker for each disk once
+ *        the disk is set up, scanned and known to be readable with 512 byte sectors. It sets
+ *        job->bytes_total (and job->bytes_done in dry-run mode), and job->written before it
+ *        writes to the disk.
+ *
+ * @param job the fleet job (job->error receives the error message on error)
+ * @param dp  the disk of the job
+ *
+ * @returns true on success, false on error.
+ **************************************************************************************************/
+
+typedef bool (*fleet_job_op)(fleet_job_ptr job, disk_ptr dp);
+
+struct _fleet_job
+{
+  fleet_job_ptr                         next;                       ///< next job in list (NULL if this is tail)
+
+  char                                  device_file[256];           ///< device or image file to operate on
+  char                                  target_file[256];           ///< e.g. the backup file to be created
+  uint64_t                              device_key;                 ///< identity of the underlying device (per-device concurrency)
+
+  fleet_ptr                             fp;                         ///< back pointer to the fleet
+
+  volatile uint32_t                     status;                     ///< FLEET_JOB_xxx
+  volatile uint64_t                     bytes_total;                ///< total number of disk bytes to be transferred (0 if not yet known)
+  volatile uint64_t                     bytes_done;                 ///< number of disk bytes transferred so far
+  uint64_t                              start_usec;                 ///< start time stamp (see get_time_usec)
+  uint64_t                              end_usec;                   ///< end time stamp (see get_time_usec)
+
+  bool                                  written;                    ///< the job has (possibly) written to the disk (scan cache entry is dropped)
+
+  char                                  result[32];                 ///< short description of what has been done (e.g. the repair action)
+  char                                  error[128];                 ///< error message if status is FLEET_JOB_FAILED
+};
+
+struct _fleet
+{
+  cmdline_args_ptr                      cap;                        ///< command line arguments (global options)
+
+  fleet_job_ptr                         head;                       ///< head of all jobs (in list file order)
+  fleet_job_ptr                         tail;                       ///< tail of all jobs
+  uint32_t                              num_jobs;
+
+  const char                           *io_verb;                    ///< "read", "written" or "transferred" (progress and summary)
+  fleet_job_op                          job_op;                     ///< operation performed by each job
+  io_budget_ptr                         budget;                     ///< NULL or the global bandwidth budget
+  volatile uint64_t                     bytes_done;                 ///< aggregated number of transferred disk bytes
+  volatile uint64_t                     jobs_finished;              ///< number of jobs completed (successfully or not)
+};
+
+/**********************************************************************************************//**
+ * @fn  fleet_ptr fleet_load(cmdline_args_ptr cap, const char* list_file, bool with_target);
+ *
+ * @brief Loads a fleet list file. Each line contains a device (or image file), optionally
+ *        followed by whitespace and the target file of this device (e.g. the backup file). Empty
+ *        lines and lines starting with '#' are ignored.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param cap         command line arguments
+ * @param list_file   zero-terminated name of the list file
+ * @param with_target true if each line has to specify a target file, false if it must not
+ *
+ * @returns NULL on error or the newly allocated fleet.
+ **************************************************************************************************/
+
+fleet_ptr fleet_load(cmdline_args_ptr cap, const char* list_file, bool with_target);
+
+/**********************************************************************************************//**
+ * @fn  void fleet_free(fleet_ptr fp);
+ *
+ * @brief Frees a fleet including all of its jobs
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param fp  pointer to the fleet (NULL is a no-op)
+ **************************************************************************************************/
+
+void fleet_free(fleet_ptr fp);
+
+/**********************************************************************************************//**
+ * @fn  int fleet_backup(cmdline_args_ptr cap);
+ *
+ * @brief Creates (and verifies) partition table backups of all disks in the fleet list file
+ *        (cap->fleet_file). The per-disk pipelines are scheduled on a shared worker pool
+ *        (cap->num_threads workers, at most cap->per_device_limit jobs per physical device),
+ *        all disk reads share the bandwidth budget cap->max_bandwidth. Progress and results are
+ *        reported in aggregated form.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param cap command line arguments
+ *
+ * @returns 0 if all backups succeeded, 1 otherwise (process exit code).
+ **************************************************************************************************/
+
+int fleet_backup(cmdline_args_ptr cap);
+
+/**********************************************************************************************//**
+ * @fn  int fleet_repair_gpt(cmdline_args_ptr cap);
+ *
+ * @brief Repairs the GPTs of all disks in the fleet list file (cap->fleet_file, one disk per
+ *        line) in parallel (see repair_gpt_plan). Scheduling is the same as for fleet_backup;
+ *        the action taken for each disk is reported in aggregated form.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param cap command line arguments
+ *
+ * @returns 0 if all disks are healthy or repaired, 1 otherwise (process exit code).
+ **************************************************************************************************/
+
+int fleet_repair_gpt(cmdline_args_ptr cap);
+
+/**********************************************************************************************//**
+ * @fn  int fleet_convert(cmdline_args_ptr cap);
+ *
+ * @brief Converts the MBRs of all disks (or image files) in the fleet list file
+ *        (cap->fleet_file, one '<disk> <backup file>' per line) to GPTs in parallel (see
+ *        convert_mbr_to_gpt_plan and convert_commit). Scheduling is the same as for
+ *        fleet_backup.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param cap command line arguments
+ *
+ * @returns 0 if all disks are converted, 1 otherwise (process exit code).
+ **************************************************************************************************/
+
+int fleet_convert(cmdline_args_ptr cap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _INC_FLEET_H_
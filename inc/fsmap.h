@@ -0,0 +1,121 @@
+/**
+ * @file   fsmap.h
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @brief  declaration of the file system allocation maps (used blocks of
+ *         EXT2/3/4, NTFS and FAT file systems as a list of extents).
+ *
+ * [MIT license]
+ *
+ * Copyright (c) 2021 Ingo A. Kubbilun
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INC_FSMAP_H_
+#define _INC_FSMAP_H_
+
+#include <part-y.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FS_MAP_EDGE_SIZE                (64 << 10)                  ///< always used at the start and at the end of a partition (boot sectors, superblocks, backups)
+#define FS_MAP_MERGE_GAP                (1 << 20)                   ///< unused gaps smaller than this are treated as used (fewer, larger transfers)
+#define FS_MAP_MAX_BITMAP               (256 << 20)                 ///< largest allocation bitmap held in memory (bytes)
+#define FS_MAP_READ_SIZE                (1 << 20)                   ///< largest read of allocation tables and bitmaps
+
+typedef struct _fs_extent               fs_extent, * fs_extent_ptr;
+typedef struct _fs_extent_list          fs_extent_list, * fs_extent_list_ptr;
+
+struct _fs_extent
+{
+  uint64_t                              fp;                         ///< byte offset on the disk
+  uint64_t                              size;                       ///< size in bytes (a multiple of 512)
+};
+
+struct _fs_extent_list
+{
+  fs_extent_ptr                         items;                      ///< extents sorted by their byte offsets (disjoint)
+  uint64_t                              num_items;                  ///< number of extents
+  uint64_t                              max_items;                  ///< number of allocated extents
+  uint64_t                              merge_gap;                  ///< extents closer than this are merged
+};
+
+/**********************************************************************************************//**
+ * @fn  bool fs_extent_add(fs_extent_list_ptr el, uint64_t fp, uint64_t size);
+ *
+ * @brief Appends an extent to a list. The extent is merged with the preceding ones if they
+ *        overlap or if the gap between them is not larger than the merge gap of the list. The
+ *        extents have to be added in ascending order of their ends.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param [in,out]  el    the extent list
+ * @param           fp    byte offset of the extent
+ * @param           size  size of the extent in bytes (0 = nothing is added)
+ *
+ * @returns false if there is insufficient memory available.
+ **************************************************************************************************/
+
+bool fs_extent_add(fs_extent_list_ptr el, uint64_t fp, uint64_t size);
+
+/**********************************************************************************************//**
+ * @fn  void fs_extent_free(fs_extent_list_ptr el);
+ *
+ * @brief Frees the extents of a list (the list can be reused afterwards).
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param [in,out]  el  the extent list
+ **************************************************************************************************/
+
+void fs_extent_free(fs_extent_list_ptr el);
+
+/**********************************************************************************************//**
+ * @fn  bool fs_map_used(DISK_HANDLE h, uint32_t fs_type, uint64_t part_fp, uint64_t part_size, fs_extent_list_ptr el);
+ *
+ * @brief Reads the allocation map of the file system of a partition (EXT2/3/4: block bitmaps,
+ *        NTFS: $Bitmap, FAT12/16/32: the first FAT) and appends the used extents of the
+ *        partition to a list. The metadata (boot sectors, superblocks and their backups, group
+ *        descriptors, bitmaps, inode tables, FATs, the FAT12/16 root directory) and the first
+ *        and last FS_MAP_EDGE_SIZE bytes of the partition are always used.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param           h         disk handle with read access (positional reads only)
+ * @param           fs_type   one of the FSYS_xxx constants (peeked file system)
+ * @param           part_fp   byte offset of the partition
+ * @param           part_size size of the partition in bytes
+ * @param [in,out]  el        receives the used extents (absolute byte offsets)
+ *
+ * @returns false if the file system is not supported, if it is inconsistent or if it cannot be
+ *          read; the whole partition has to be regarded as used then (the list is undefined).
+ **************************************************************************************************/
+
+bool fs_map_used(DISK_HANDLE h, uint32_t fs_type, uint64_t part_fp, uint64_t part_size, fs_extent_list_ptr el);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _INC_FSMAP_H_
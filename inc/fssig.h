@@ -0,0 +1,164 @@
+/**
+ * @file   fssig.h
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @brief  declaration of the file system signature engine, which identifies
+ *         the file system of a partition (type, UUID, label and size) from
+ *         one read of the union of all signature windows.
+ *
+ * [MIT license]
+ *
+ * Copyright (c) 2021 Ingo A. Kubbilun
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INC_FSSIG_H_
+#define _INC_FSSIG_H_
+
+#include <part-y.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FS_SIG_LABEL_SIZE               64                          ///< max. size of a file system label (UTF-8, zero-terminated)
+#define FS_SIG_NEAR_WINDOW_SIZE         4096                        ///< probes inside the first 4 KiB are matched first (one small read)
+#define FS_SIG_MAX_FAR_WINDOWS          4                           ///< max. number of windows beyond FS_SIG_NEAR_WINDOW_SIZE
+
+typedef struct _fs_sig_result           fs_sig_result, * fs_sig_result_ptr;
+typedef struct _fs_sig_probe            fs_sig_probe, * fs_sig_probe_ptr;
+
+struct _fs_sig_result
+{
+  uint32_t                              fs_type;                    ///< one of the FSYS_xxx constants
+  uint8_t                               uuid[16];                   ///< file system UUID in big endian (all zeros if none)
+  char                                  label[FS_SIG_LABEL_SIZE];   ///< file system label (empty if none)
+  uint64_t                              fs_size;                    ///< size of the file system in bytes (0 = unknown)
+};
+
+/**********************************************************************************************//**
+ * @typedef bool (*fs_sig_match)(const uint8_t* window, fs_sig_result_ptr res)
+ *
+ * @brief Matcher of one file system: inspects its window and fills the result on a match.
+ **************************************************************************************************/
+
+typedef bool (*fs_sig_match)(const uint8_t* window, fs_sig_result_ptr res);
+
+struct _fs_sig_probe
+{
+  uint32_t                              fs_type;                    ///< FSYS_xxx identified by this probe
+  uint32_t                              offset;                     ///< byte offset of the window (relative to the partition start)
+  uint32_t                              size;                       ///< size of the window in bytes
+  fs_sig_match                          match;                      ///< matcher (called with a pointer to the window)
+};
+
+/**********************************************************************************************//**
+ * @fn  uint32_t fs_sig_window_size(uint64_t part_size);
+ *
+ * @brief Computes the union of the near windows (inside FS_SIG_NEAR_WINDOW_SIZE) of all probes
+ *        fitting into a partition, i.e. the number of bytes which have to be read from the start
+ *        of the partition so that all of them can be matched. The far windows (see
+ *        fs_sig_far_windows) are only read if none of the near probes matches.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param part_size size of the partition in bytes
+ *
+ * @returns the number of bytes to be read (a multiple of SECTOR_SIZE; 0 if no probe fits).
+ **************************************************************************************************/
+
+uint32_t fs_sig_window_size(uint64_t part_size);
+
+/**********************************************************************************************//**
+ * @fn  uint32_t fs_sig_far_windows(uint64_t part_size, uint32_t* offsets, uint32_t* sizes, uint32_t max_windows);
+ *
+ * @brief Gets the windows of the probes beyond FS_SIG_NEAR_WINDOW_SIZE fitting into a partition
+ *        (e.g. BTRFS at 64 KiB, ZFS at 128 KiB), in the order of their priority.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param           part_size   size of the partition in bytes
+ * @param [in,out]  offsets     receives the byte offsets of the windows (multiples of SECTOR_SIZE)
+ * @param [in,out]  sizes       receives the sizes of the windows (multiples of SECTOR_SIZE)
+ * @param           max_windows number of array elements (FS_SIG_MAX_FAR_WINDOWS)
+ *
+ * @returns the number of windows stored.
+ **************************************************************************************************/
+
+uint32_t fs_sig_far_windows(uint64_t part_size, uint32_t* offsets, uint32_t* sizes, uint32_t max_windows);
+
+/**********************************************************************************************//**
+ * @fn  uint32_t fs_sig_identify(const uint8_t* data, uint32_t data_size, fs_sig_result_ptr res);
+ *
+ * @brief Runs all probes (in the order of their priority) over the data read from the start of
+ *        a partition. Probes whose window is not completely contained in the data are skipped.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param           data      data read from the start of the partition
+ * @param           data_size number of bytes available (see fs_sig_window_size)
+ * @param [in,out]  res       receives the result (cleared first)
+ *
+ * @returns one of the FSYS_xxx constants (FSYS_UNKNOWN if no probe matched).
+ **************************************************************************************************/
+
+uint32_t fs_sig_identify(const uint8_t* data, uint32_t data_size, fs_sig_result_ptr res);
+
+/**********************************************************************************************//**
+ * @fn  uint32_t fs_sig_identify_at(const uint8_t* data, uint32_t data_offset, uint32_t data_size, fs_sig_result_ptr res);
+ *
+ * @brief Like fs_sig_identify, but the data has been read from data_offset (relative to the
+ *        start of the partition); only the probes whose window is completely contained are run.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param           data        data read from the partition
+ * @param           data_offset byte offset of the data (relative to the partition start)
+ * @param           data_size   number of bytes available
+ * @param [in,out]  res         receives the result (cleared first)
+ *
+ * @returns one of the FSYS_xxx constants (FSYS_UNKNOWN if no probe matched).
+ **************************************************************************************************/
+
+uint32_t fs_sig_identify_at(const uint8_t* data, uint32_t data_offset, uint32_t data_size, fs_sig_result_ptr res);
+
+/**********************************************************************************************//**
+ * @fn  const char* fs_sig_name(uint32_t fs_type);
+ *
+ * @brief Returns the descriptive name of a file system type.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param fs_type one of the FSYS_xxx constants
+ *
+ * @returns the name (never NULL).
+ **************************************************************************************************/
+
+const char* fs_sig_name(uint32_t fs_type);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _INC_FSSIG_H_
@@ -0,0 +1,99 @@
+/**
+ * @file   move.h
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @brief  declaration of the data move engine (memmove of LBA ranges at disk
+ *         scale) and of the move command, which moves and/or grows a partition.
+ *
+ * [MIT license]
+ *
+ * Copyright (c) 2021 Ingo A. Kubbilun
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INC_MOVE_H_
+#define _INC_MOVE_H_
+
+#include <part-y.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MOVE_DEFAULT_CHUNK_SIZE         (4 << 20)                   ///< transfer size if no device profile exists
+#define MOVE_DEFAULT_WORKERS            4                           ///< concurrent reads (and writes) if no device profile exists
+#define MOVE_SEGMENT_CHUNKS             16                          ///< chunks per pipeline segment (unit of the checkpoints)
+#define MOVE_PROGRESS_INTERVAL_MS       500                         ///< progress update interval
+#define MOVE_MIN_CHECKPOINT_SEGMENT     (1 << 20)                   ///< overlapping moves by less than this are not checkpointed
+
+/**********************************************************************************************//**
+ * @fn  bool move_lba_range(disk_ptr dp, uint64_t src_lba, uint64_t dst_lba, uint64_t num_lbas, uint32_t num_workers, const char* checkpoint_file, const char* message);
+ *
+ * @brief Copies num_lbas sectors from src_lba to dst_lba like memmove, i.e. the ranges may
+ *        overlap: the copy runs upwards if the destination lies below the source and downwards
+ *        otherwise. The range is split into segments; the chunks of the next segment are read
+ *        (striped across the worker threads) while the chunks of the current segment are
+ *        written. If a checkpoint file is specified, the segments are not larger than the
+ *        distance of source and destination, and every segment is flushed and recorded before the
+ *        next one is written, so the source of all outstanding segments is still intact if the
+ *        move is interrupted; calling this function again with the same arguments resumes it.
+ *        An overlapping move by less than MOVE_MIN_CHECKPOINT_SEGMENT (1 MiB) is not
+ *        checkpointed because of the tiny segments (one flush per segment).
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param dp              the disk
+ * @param src_lba         first LBA of the source
+ * @param dst_lba         first LBA of the destination
+ * @param num_lbas        number of LBAs to be moved
+ * @param num_workers     number of concurrent reads (and writes); 0 = device profile or default
+ * @param checkpoint_file file storing the progress (NULL or empty = no checkpoints)
+ * @param message         progress title (WORKING line)
+ *
+ * @returns true on success, false on error (the error has been reported).
+ **************************************************************************************************/
+
+bool move_lba_range(disk_ptr dp, uint64_t src_lba, uint64_t dst_lba, uint64_t num_lbas, uint32_t num_workers, const char* checkpoint_file, const char* message);
+
+/**********************************************************************************************//**
+ * @fn  int move_partition(cmdline_args_ptr cap);
+ *
+ * @brief Moves the partition --part-no to the start LBA --to-lba and/or grows it to --part-size.
+ *        The new location has to be inside the usable area and must not overlap another
+ *        partition (it may overlap the old location). The data is moved by move_lba_range, then
+ *        the partition table is updated (GPT: backup GPT before primary GPT; MBR: LBA 0).
+ *        The hidden sectors of a FAT or NTFS boot sector (and its backup) are set to the new
+ *        start if they referred to the old one.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param cap command line arguments
+ *
+ * @returns 0 on success, 1 on error (process exit code).
+ **************************************************************************************************/
+
+int move_partition(cmdline_args_ptr cap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _INC_MOVE_H_
@@ -59,6 +59,7 @@ extern "C" {
 #include <Windows.h>
 #include <winioctl.h>
 #include <io.h>
+#include <time.h>
 #include <fcntl.h>
 #include <winreg.h>
 #include <objbase.h>
@@ -92,6 +93,11 @@ extern "C" {
 #include <sys/types.h>
 #include <dirent.h>
 #include <sys/mount.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <sys/sysmacros.h>
+#include <pthread.h>
+#include <time.h>
 #define stricmp strcasecmp
 #define FMT64 "l"
 #define likely(expr)    (__builtin_expect(!!(expr), 1))
@@ -109,15 +115,30 @@ extern "C" {
 
 #include <file.h>
 #include <disk.h>
+#include <writeplan.h>
+#include <fssig.h>
+#include <fsmap.h>
 #include <partition.h>
 #include <backup.h>
 #include <sha3.h>
 #include <bcd.h>
+#include <workpool.h>
+
+typedef struct _cmdline_args    cmdline_args, *cmdline_args_ptr;
+
+#include <fleet.h>
+#include <probe.h>
+#include <wipe.h>
+#include <scancache.h>
+#include <create.h>
+#include <repair.h>
+#include <convert.h>
+#include <move.h>
+#include <clone.h>
 
 #define WINDOWS_BOOT_EFI_DIR    "\\Windows\\Boot\\EFI"
 
 typedef struct _part_def        part_def, *part_def_ptr;
-typedef struct _cmdline_args    cmdline_args, *cmdline_args_ptr;
 
 struct _part_def
 {
@@ -160,6 +181,10 @@ struct _part_def
 #define COMMAND_FILL            0x0000000C
 #define COMMAND_HEXDUMP         0x0000000D
 #define COMMAND_ENUMDISKS       0x0000000E
+#define COMMAND_PROBE           0x0000000F
+#define COMMAND_WIPE            0x00000010
+#define COMMAND_MOVE            0x00000011
+#define COMMAND_CLONE           0x00000012
 
 #define PARTITION_TYPE_FAT12    0x00000001
 #define PARTITION_TYPE_FAT16    0x00000002
@@ -205,6 +230,8 @@ struct _cmdline_args
   bool                          verbose;
   bool                          no_format;
   bool                          part_type_mbr;
+  bool                          preallocate;                    ///< allocate all blocks of created or extended image files (no sparse files)
+  bool                          new_image_file;                 ///< the image file has been created by this invocation (removed if the command fails)
 
   uint32_t                      num_physical_disks;             ///< number of enumerated physical disks
   disk_ptr                      pd_head;                        ///< head of physical disk list
@@ -212,6 +239,30 @@ struct _cmdline_args
 
   disk_ptr                      work_disk;                      ///< selected disk, either physical or image file
 
+  char                          fleet_file[256];                ///< list file with '<device> <backup file>' lines (multi-disk backup)
+  uint32_t                      num_threads;                    ///< number of worker threads (0 = number of CPUs)
+  uint32_t                      per_device_limit;               ///< max. number of concurrent jobs per physical device
+  uint64_t                      max_bandwidth;                  ///< global I/O bandwidth limit in bytes per second (0 = unlimited)
+  uint32_t                      probe_timeout_ms;               ///< deadline for opening (and scanning) one device (0 = none)
+
+  uint64_t                      scratch_range_start;            ///< first LBA which may be overwritten by the probe command
+  uint64_t                      scratch_range_end;              ///< last LBA which may be overwritten by the probe command (0 = no scratch range)
+  char                          profile_file[256];              ///< file containing the device profiles (see probe command)
+
+  char                          wipe_passes[128];               ///< comma-separated list of wipe passes (empty = WIPE_DEFAULT_PASSES)
+  char                          checkpoint_file[256];           ///< wipe and move checkpoint file (empty = no checkpoints)
+  bool                          no_verify;                      ///< do not read back and verify the wipe passes
+
+  uint32_t                      part_no;                        ///< move command: partition to be moved (1-based; 0 = none specified)
+  uint64_t                      to_lba;                         ///< move command: new start LBA of the partition (0 = unchanged)
+  uint64_t                      part_size;                      ///< move command: new size in bytes (0 = unchanged, (uint64_t)-1 = REMAINING)
+
+  char                          target_name[256];               ///< clone command: target device or image file
+  bool                          used_only;                      ///< clone command: copy the used blocks of the file systems only
+
+  char                          scan_cache_file[256];           ///< scan result cache file (empty = no cache)
+  scan_cache_ptr                scan_cache;                     ///< loaded scan result cache (NULL = no cache)
+
 #ifdef _WINDOWS
   win_volume_ptr                wvp;                            ///< all Windows volumes (with drive letter where applicable)
   diskpart_volume_ptr           dvp;                            ///< all volumes as enumerated by the external diskpart.exe tool
@@ -284,6 +335,8 @@ void convert_guid_from_to_mixed ( uint8_t *guid );
 
 bool is_zero_guid(const uint8_t* guid);
 
+bool generate_guid(uint8_t* guid); // random GUID in mixed endian
+
 typedef struct _disk_map *disk_map_ptr;
 
 void free_disk_map ( disk_map_ptr dmp );
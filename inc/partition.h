@@ -48,9 +48,30 @@ extern "C" {
 #define FSYS_LINUX_EXT2                 0x00000006
 #define FSYS_LINUX_EXT3                 0x00000007
 #define FSYS_LINUX_EXT4                 0x00000008
+#define FSYS_XFS                        0x00000009
+#define FSYS_BTRFS                      0x0000000A
+#define FSYS_LUKS                       0x0000000B
+#define FSYS_LVM_PV                     0x0000000C
+#define FSYS_LINUX_SWAP                 0x0000000D
+#define FSYS_BITLOCKER                  0x0000000E
+#define FSYS_WIN_REFS                   0x0000000F
+#define FSYS_ZFS                        0x00000010
+
+#define FS_PEEK_BATCH                   32                            ///< max. number of partitions peeked with one batch read
 
 typedef struct _mbr_part_sector         mbr_part_sector, * mbr_part_sector_ptr;
 typedef struct _mbr_entry               mbr_entry, * mbr_entry_ptr;
+typedef struct _fs_peek                 fs_peek, * fs_peek_ptr;
+
+struct _fs_peek
+{
+  uint64_t                  lba;                          ///< start LBA of the file system partition
+  uint64_t                  num_sectors;                  ///< size of the partition (limits the signature windows)
+  uint32_t                 *fs_type;                      ///< receives one of the FSYS_xxx constants
+  uint8_t                  *uuid;                         ///< (optional) receives the file system UUID
+  char                     *label;                        ///< (optional) receives the label (FS_SIG_LABEL_SIZE bytes)
+  uint64_t                 *fs_size;                      ///< (optional) receives the file system size in bytes
+};
 
 struct _mbr_entry
 {
@@ -66,10 +87,13 @@ struct _mbr_entry
   uint32_t                  num_sectors;
 
   uint32_t                  fs_type;                      ///< one of the FSYS_xxx flags
+  uint64_t                  fs_peek_lba;                  ///< absolute start LBA of a file system to be peeked (0 = none)
 
-  uint8_t                   uuid[16];                     ///< UUID of Linux EXT2/3/4
+  uint8_t                   uuid[16];                     ///< file system UUID (e.g. Linux EXT2/3/4) in big endian
+  char                      fs_label[FS_SIG_LABEL_SIZE];  ///< file system label (empty if none)
+  uint64_t                  fs_size;                      ///< file system size in bytes (0 = unknown)
 
-  char                      type_desc[64];                ///< can be empty string (unknown) or partition type description
+  const char               *type_desc;                    ///< partition type description (points into the static type table)
 
   uint8_t                   boot_flag;                    ///< 0x00 not active, 0x80 if active
   uint8_t                   part_type;
@@ -101,21 +125,54 @@ struct _mbr_part_sector
 #define GPT_ATTR_HIDDEN                 ((uint64_t)0x4000000000000000)
 #define GPT_ATTR_DO_NOT_MOUNT           ((uint64_t)0x8000000000000000)
 
+#define GPT_DEFAULT_ENTRIES             128                           ///< number of entry slots in a newly created GPT
+#define GPT_ENTRY_SIZE                  0x80                          ///< size of the standard part of one partition entry
+#define GPT_MAX_ENTRY_SIZE              0x1000                        ///< largest size of one partition entry accepted
+#define GPT_MAX_ENTRY_ARRAY_SIZE        (16 << 20)                    ///< largest partition entry array accepted (bytes)
+#define GPT_ENTRY_READ_CHUNK_SECTORS    64                            ///< the entry array is read (and the CRC computed) in chunks of this size
+
+/// number of 512-byte sectors occupied by the partition entry array of a GPT header
+#define GPT_ENTRY_ARRAY_SECTORS(_hdr)   ((uint32_t)((((uint64_t)(_hdr).number_of_part_entries) * (_hdr).size_of_part_entry + SECTOR_SIZE_MASK) >> SECTOR_SHIFT))
+
+#define GPT_TYPE_PEEK_FS                0x01                          ///< the file system of partitions of this type is peeked
+
+/// builds the on-disk (mixed endian) byte representation of a GUID written as
+/// 0xAAAAAAAA, 0xBBBB, 0xCCCC, 0xDDDD, 0xEEEEEEEEEEEE, i.e. in the canonical string order
+#define GPT_TYPE_GUID(_a,_b,_c,_d,_e) \
+  { (uint8_t)(_a), (uint8_t)((_a) >> 8), (uint8_t)((_a) >> 16), (uint8_t)((_a) >> 24), \
+    (uint8_t)(_b), (uint8_t)((_b) >> 8), (uint8_t)(_c), (uint8_t)((_c) >> 8), \
+    (uint8_t)((_d) >> 8), (uint8_t)(_d), \
+    (uint8_t)((uint64_t)(_e) >> 40), (uint8_t)((uint64_t)(_e) >> 32), (uint8_t)((uint64_t)(_e) >> 24), \
+    (uint8_t)((uint64_t)(_e) >> 16), (uint8_t)((uint64_t)(_e) >> 8), (uint8_t)(_e) }
+
+typedef struct _gpt_type_info           gpt_type_info, * gpt_type_info_ptr;
+
+struct _gpt_type_info
+{
+  uint8_t                   guid[16];                     ///< type GUID in mixed endian (on-disk byte order)
+  uint8_t                   mbr_type;                     ///< corresponding MBR partition type (0x00 if there is none)
+  uint8_t                   flags;                        ///< GPT_TYPE_xxx
+  char                      mbr_description[64];          ///< description of the MBR side
+  char                      gpt_description[64];          ///< description of the GPT partition type
+};
+
 typedef struct _gpt_header              gpt_header, * gpt_header_ptr;
 typedef struct _gpt_entry               gpt_entry, * gpt_entry_ptr;
 typedef struct _gpt                     gpt, * gpt_ptr;
 
 struct _gpt_entry
 {
+  uint32_t                  slot;                         ///< index of the entry in the GPT partition entry array (0-based)
   uint8_t                   type_guid[16];                ///< type GUID in mixed endian
   uint8_t                   partition_guid[16];           ///< partition GUID in mixed endian
-  uint8_t                   fs_uuid[16];                  ///< file system UUID (Linux EXT2, EXT3, EXT4) in big endian (raw memory)
+  uint8_t                   fs_uuid[16];                  ///< file system UUID (e.g. Linux EXT2, EXT3, EXT4) in big endian (raw memory)
   uint64_t                  part_start_lba;
   uint64_t                  part_end_lba;
   uint64_t                  attributes;
   uint32_t                  fs_type;                      ///< one of the FSYS_xxx flags (see peek file system function)
-  uint16_t                  part_name[38];                ///< UTF-16 Little Endian -> Windows wchar_t (36 chars, 38 here because of terminating zero, plus one spare char)
-  char                      part_name_utf8_oem[128];
+  char                      fs_label[FS_SIG_LABEL_SIZE];  ///< file system label (empty if none)
+  uint64_t                  fs_size;                      ///< file system size in bytes (0 = unknown)
+  uint16_t                  part_name[38];                ///< UTF-16 Little Endian -> Windows wchar_t (36 chars, 38 here because of terminating zero, plus one spare char); see gpt_entry_name
 };
 
 struct _gpt_header
@@ -136,8 +193,8 @@ struct _gpt_header
 
   uint64_t                  starting_lba_part_entries;    ///< always 2 in primary copy
 
-  uint32_t                  number_of_part_entries;
-  uint32_t                  size_of_part_entry;           ///< only 0x80 = 128 supported
+  uint32_t                  number_of_part_entries;       ///< number of slots in the partition entry array
+  uint32_t                  size_of_part_entry;           ///< 128 * 2^n bytes (up to GPT_MAX_ENTRY_SIZE)
   uint32_t                  part_entries_crc32;
 
   bool                      header_corrupt;               ///< true if CRC32 of header mismatches
@@ -148,8 +205,10 @@ struct _gpt
 {
   gpt_header                header;
 
-  sector_ptr                sp;                           ///< 32 sectors containing the entries
-  gpt_entry                 entries[128];
+  uint32_t                  num_entries;                  ///< number of used entries (not the number of slots)
+  uint32_t                  max_entries;                  ///< number of allocated entries
+  gpt_entry_ptr             entries;                      ///< used entries only, sorted by their slot
+  uint8_t                  *ext_data;                     ///< bytes beyond GPT_ENTRY_SIZE of all slots (written back unchanged); NULL for 128 byte entries
 };
 
 typedef struct _disk       *disk_ptr;                     ///< forward definition
@@ -230,6 +289,70 @@ bool partition_compare_gpts(gpt_ptr g1, gpt_ptr g2);
 
 void partition_free_gpt(gpt_ptr gptp);
 
+/**********************************************************************************************//**
+ * @fn  gpt_ptr partition_new_gpt(uint32_t max_entries);
+ *
+ * @brief Allocates an empty GPT in memory (zeroed header, no entries)
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param max_entries number of entries to be allocated in advance (the array grows on demand)
+ *
+ * @returns pointer to the GPT or NULL on error (insufficient memory).
+ **************************************************************************************************/
+
+gpt_ptr partition_new_gpt(uint32_t max_entries);
+
+/**********************************************************************************************//**
+ * @fn  gpt_ptr partition_clone_gpt(gpt_ptr gptp);
+ *
+ * @brief Creates a deep copy of a GPT in memory. The header sector is not copied.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param gptp  pointer to GPT
+ *
+ * @returns pointer to the copy or NULL on error (insufficient memory).
+ **************************************************************************************************/
+
+gpt_ptr partition_clone_gpt(gpt_ptr gptp);
+
+/**********************************************************************************************//**
+ * @fn  gpt_entry_ptr gpt_find_entry(gpt_ptr g, uint32_t slot);
+ *
+ * @brief Looks up the entry of a slot of the GPT partition entry array (binary search over the
+ *        used entries).
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param g     pointer to GPT
+ * @param slot  slot (0-based index in the partition entry array)
+ *
+ * @returns pointer to the entry or NULL if the slot is unused.
+ **************************************************************************************************/
+
+gpt_entry_ptr gpt_find_entry(gpt_ptr g, uint32_t slot);
+
+/**********************************************************************************************//**
+ * @fn  gpt_entry_ptr gpt_add_entry(gpt_ptr g, uint32_t slot);
+ *
+ * @brief Adds a new (zeroed) entry for a slot of the GPT partition entry array. The entries stay
+ *        sorted by their slot; appending (ascending slots) is the fast path.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param g     pointer to GPT
+ * @param slot  slot (0-based index in the partition entry array)
+ *
+ * @returns pointer to the new entry or NULL if the slot is already used or on insufficient memory.
+ **************************************************************************************************/
+
+gpt_entry_ptr gpt_add_entry(gpt_ptr g, uint32_t slot);
+
 /**********************************************************************************************//**
  * @fn  disk_map_ptr partition_create_disk_map_mbr(disk_ptr dp);
  *
@@ -294,7 +417,8 @@ bool partition_dump_gpt(disk_ptr dp);
 /**********************************************************************************************//**
  * @fn  bool partition_peek_fs_for_gpt(disk_ptr dp, DISK_HANDLE h);
  *
- * @brief Walks down all partitions of a GPT calling partition_peek_filesystem for all supported partition types
+ * @brief Walks down all partitions of a GPT peeking the file systems of all supported partition types
+ *        in one batch (see partition_peek_fs_batch)
  *
  * @author Ingo A. Kubbilun (www.devcorn.de)
  * @date   01.09.2021
@@ -307,6 +431,45 @@ bool partition_dump_gpt(disk_ptr dp);
 
 bool partition_peek_fs_for_gpt(disk_ptr dp, DISK_HANDLE h);
 
+/**********************************************************************************************//**
+ * @fn  bool partition_peek_fs_for_mbr(disk_ptr dp, DISK_HANDLE h);
+ *
+ * @brief Peeks the file systems of all MBR partitions (including logical drives) marked for
+ *        peeking while the MBR was scanned, all of them in one batch (see partition_peek_fs_batch)
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param dp  pointer to disk
+ * @param h   an opened disk handle to the disk (for reading/peeking file systems).
+ *
+ * @returns true on success, false on error.
+ **************************************************************************************************/
+
+bool partition_peek_fs_for_mbr(disk_ptr dp, DISK_HANDLE h);
+
+/**********************************************************************************************//**
+ * @fn  bool partition_peek_fs_batch(disk_ptr dp, DISK_HANDLE h, fs_peek_ptr peeks, uint32_t num_peeks);
+ *
+ * @brief Peeks a batch of file systems: the near signature windows (first 4 KiB) of all
+ *        partitions are read concurrently into one buffer (disk_read_batch), then inspected one
+ *        after another; the far windows are only read for partitions left unidentified. While
+ *        the disk is scanned, the results (not the windows) are replayed from or recorded in
+ *        the scan cache.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param dp          pointer to disk
+ * @param h           an opened disk handle to the disk
+ * @param peeks       array of file systems to be peeked (results are stored via the pointers)
+ * @param num_peeks   number of array entries
+ *
+ * @returns true on success, false on error (out of memory).
+ **************************************************************************************************/
+
+bool partition_peek_fs_batch(disk_ptr dp, DISK_HANDLE h, fs_peek_ptr peeks, uint32_t num_peeks);
+
 /**********************************************************************************************//**
  * @fn  uint32_t partition_peek_filesystem(disk_ptr dp, DISK_HANDLE h, uint64_t lba_start, uint8_t* uuid);
  *
@@ -330,7 +493,7 @@ bool partition_peek_fs_for_gpt(disk_ptr dp, DISK_HANDLE h);
 uint32_t partition_peek_filesystem(disk_ptr dp, DISK_HANDLE h, uint64_t lba_start, uint8_t* uuid);
 
 /**********************************************************************************************//**
- * @fn  void setGPTPartitionName(uint16_t* p, char *p2, const char* name);
+ * @fn  void setGPTPartitionName(uint16_t* p, const char* name);
  *
  * @brief Copies up to 38 Little Endian UTF-16 letters to the GPT entry (name of partition)
  *
@@ -338,13 +501,31 @@ uint32_t partition_peek_filesystem(disk_ptr dp, DISK_HANDLE h, uint64_t lba_star
  * @date   01.09.2021
  *
  * @param [in,out]  p     pointer to buffer with 36 uint16_t's.
- * @param [in,out]  p2    target pointer receiving the ASCII string.
  * @param           name  pointer to the zero-terminated name; up to 35 characters are copied. THIS
  *                        MUST BE ZERO-TERMINATED according to UEFI spec. so only 35 characters plus
  *                        zero are allowed.
  **************************************************************************************************/
 
-void setGPTPartitionName(uint16_t* p, char *p2, const char* name);
+void setGPTPartitionName(uint16_t* p, const char* name);
+
+/**********************************************************************************************//**
+ * @fn  const char* gpt_entry_name(const gpt_entry* gep, char* buffer, uint32_t buffer_size);
+ *
+ * @brief Decodes the UTF-16 name of a GPT partition entry. The names are not converted while the
+ *        GPT is parsed but only if they are really displayed.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param           gep         pointer to the GPT entry
+ * @param [in,out]  buffer      buffer receiving the (zero-terminated) UTF-8 name (Windows: OEM
+ *                              code page for the console)
+ * @param           buffer_size size of the buffer in bytes
+ *
+ * @returns buffer (contains an empty string if the name cannot be decoded).
+ **************************************************************************************************/
+
+const char* gpt_entry_name(const gpt_entry* gep, char* buffer, uint32_t buffer_size);
 
 /**********************************************************************************************//**
  * @fn  bool gpt_get_guid_for_mbr_type(uint8_t part_type, uint8_t* guid, uint64_t* attributes);
@@ -363,6 +544,23 @@ void setGPTPartitionName(uint16_t* p, char *p2, const char* name);
 
 bool gpt_get_guid_for_mbr_type(uint8_t part_type, uint8_t* guid, uint64_t* attributes);
 
+/**********************************************************************************************//**
+ * @fn  const gpt_type_info* gpt_lookup_type(const uint8_t* type_guid);
+ *
+ * @brief Looks up a GPT partition type GUID (binary, mixed endian as stored in the GPT entry) in
+ *        the table of known partition types. The table is sorted by the on-disk bytes, so the
+ *        lookup is a binary search without any string formatting.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param type_guid pointer to the 16 bytes of the type GUID
+ *
+ * @returns pointer to the (constant) type information or NULL if the type is unknown.
+ **************************************************************************************************/
+
+const gpt_type_info* gpt_lookup_type(const uint8_t* type_guid);
+
 /**********************************************************************************************//**
  * @fn  bool partition_dump_temporary_gpt(gpt_ptr g);
  *
@@ -392,15 +590,34 @@ bool partition_dump_temporary_gpt(gpt_ptr g);
 
 void create_protective_mbr(uint64_t device_sectors, uint8_t* target);
 
+/**********************************************************************************************//**
+ * @fn  void mbr_create_entry(uint8_t* entry, uint8_t boot_flag, uint8_t part_type, uint64_t start_lba, uint64_t num_sectors);
+ *
+ * @brief Creates one 16-byte entry of an MBR partition table (CHS values are computed from the LBAs).
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param [in,out]  entry         pointer to the 16-byte entry, e.g. sector + 0x1BE
+ * @param           boot_flag     0x80 (active) or 0x00
+ * @param           part_type     MBR partition type
+ * @param           start_lba     first LBA of the partition (below 2^32)
+ * @param           num_sectors   number of sectors of the partition (below 2^32)
+ **************************************************************************************************/
+
+void mbr_create_entry(uint8_t* entry, uint8_t boot_flag, uint8_t part_type, uint64_t start_lba, uint64_t num_sectors);
+
 /**********************************************************************************************//**
  * @fn  void gpt_create_table(uint8_t* sector, gpt_ptr g, bool is_primary);
  *
- * @brief Creates a GPT consisting of 33 (1 for header, 32 for the entries) 512-byte sectors.
+ * @brief Creates a GPT consisting of the header sector plus GPT_ENTRY_ARRAY_SECTORS 512-byte
+ *        sectors for the entries (33 sectors for the default 128 entries). The bytes beyond
+ *        GPT_ENTRY_SIZE of larger entries are taken from g->ext_data.
  *
  * @author Ingo A. Kubbilun (www.devcorn.de)
  * @date   01.09.2021
  *
- * @param [in,out]  sector      pointer to the target area (at least 33 * 512 bytes space)
+ * @param [in,out]  sector      pointer to the target area (1 + GPT_ENTRY_ARRAY_SECTORS sectors)
  * @param           g           pointer to GPT that will be stored in the sector area
  * @param           is_primary  true if it is the primary GPT, false if it is the backup GPT
  **************************************************************************************************/
@@ -410,18 +627,19 @@ void gpt_create_table(uint8_t* sector, gpt_ptr g, bool is_primary);
 /**********************************************************************************************//**
  * @fn  uint64_t gpt_repair_table(uint8_t* sector, gpt_ptr g, bool is_primary);
  *
- * @brief Creates a GPT consisting of 33 (1 for header, 32 for the entries) 512-byte sectors using
- *        the other GPT (backup for primary or primary for backup, respectively).
+ * @brief Creates a GPT consisting of the header sector plus GPT_ENTRY_ARRAY_SECTORS 512-byte
+ *        sectors for the entries using the other GPT (backup for primary or primary for backup,
+ *        respectively). The bytes beyond GPT_ENTRY_SIZE of larger entries are taken from
+ *        g->ext_data.
  *
  * @author Ingo A. Kubbilun (www.devcorn.de)
  * @date   01.09.2021
  *
- * @param [in,out]  sector      pointer to the target area (at least 33 * 512 bytes space)
+ * @param [in,out]  sector      pointer to the target area (1 + GPT_ENTRY_ARRAY_SECTORS sectors)
  * @param           g           pointer to GPT that will be used as the template (repair source)
  * @param           is_primary  true if GPT is the primary GPT, false if it is the backup GPT.
  *
- * @returns the 64bit file pointer offset where the 33 512 byte sectors have to be written to the
- *          disk.
+ * @returns the 64bit file pointer offset where the sectors have to be written to the disk.
  **************************************************************************************************/
 
 uint64_t gpt_repair_table(uint8_t* sector, gpt_ptr g, bool is_primary);
@@ -0,0 +1,161 @@
+/**
+ * @file   probe.h
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @brief  declaration of the device throughput probe (block size / queue depth
+ *         sweeps) and of the per-device profiles, which are used to size the
+ *         transfers of backup, restore and fill.
+ *
+ * [MIT license]
+ *
+ * Copyright (c) 2021 Ingo A. Kubbilun
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INC_PROBE_H_
+#define _INC_PROBE_H_
+
+#include <part-y.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PROBE_MIN_BLOCK_SIZE            (64 << 10)                  ///< smallest block size of the sequential sweeps
+#define PROBE_MAX_BLOCK_SIZE            (16 << 20)                  ///< largest block size of the sequential sweeps
+#define PROBE_MAX_QUEUE_DEPTH           16                          ///< largest queue depth of the sweeps
+#define PROBE_RANDOM_BLOCK_SIZE         4096                        ///< block size of the random I/O tests
+#define PROBE_POINT_DURATION_MS         250                         ///< duration of one test point (block size / queue depth)
+#define PROBE_POINT_MAX_BYTES           (512 << 20)                 ///< max. bytes transferred in one sequential test point
+#define PROBE_MIN_SCRATCH_SIZE          (16 << 20)                  ///< min. size of the scratch area for the write tests
+#define PROBE_GOOD_ENOUGH_PERCENT       90                          ///< pick the cheapest setting reaching this percentage of the best one
+
+#define PROFILE_FILE_NAME               ".part-y-profiles"          ///< default profile file (in the home directory)
+
+typedef struct _device_profile          device_profile, * device_profile_ptr;
+
+struct _device_profile
+{
+  char                                  device_file[256];           ///< device or image file this profile belongs to
+  uint64_t                              device_size;                ///< device size in bytes (profile is void if the size changes)
+
+  uint32_t                              read_block_size;            ///< preferred transfer size for (sequential) reads
+  uint32_t                              read_queue_depth;           ///< preferred number of concurrent reads
+  uint32_t                              write_block_size;           ///< preferred transfer size for (sequential) writes (0 = not measured)
+  uint32_t                              write_queue_depth;          ///< preferred number of concurrent writes (0 = not measured)
+
+  uint64_t                              read_bps;                   ///< sequential read throughput (bytes per second) with the preferred settings
+  uint64_t                              write_bps;                  ///< sequential write throughput (bytes per second) with the preferred settings
+
+  uint32_t                              random_read_iops;           ///< 4K random reads per second (queue depth 1)
+  uint32_t                              random_read_latency_usec;   ///< average 4K random read latency (queue depth 1)
+  uint32_t                              random_write_iops;          ///< 4K random writes per second (queue depth 1, 0 = not measured)
+  uint32_t                              random_write_latency_usec;  ///< average 4K random write latency (queue depth 1)
+};
+
+/**********************************************************************************************//**
+ * @fn  void probe_default_profile_file(char* buf, size_t buf_size);
+ *
+ * @brief Retrieves the fully-qualified name of the default profile file, which is located in the
+ *        home directory of the user (Linux: $HOME, Windows: %APPDATA%).
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param [in,out]  buf       buffer receiving the zero-terminated file name
+ * @param           buf_size  size of the buffer in bytes
+ **************************************************************************************************/
+
+void probe_default_profile_file(char* buf, size_t buf_size);
+
+/**********************************************************************************************//**
+ * @fn  bool probe_load_profile(const char* profile_file, const char* device_file, uint64_t device_size, device_profile_ptr prof);
+ *
+ * @brief Loads the profile of a device from the profile file. Lines with transfer sizes that are
+ *        not multiples of 512 or above PROBE_MAX_BLOCK_SIZE, or with queue depths above
+ *        PROBE_MAX_QUEUE_DEPTH, are ignored.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param           profile_file  zero-terminated name of the profile file
+ * @param           device_file   zero-terminated name of the device (or image file)
+ * @param           device_size   current size of the device in bytes
+ * @param [in,out]  prof          receives the profile
+ *
+ * @returns true if a matching profile was found, false otherwise.
+ **************************************************************************************************/
+
+bool probe_load_profile(const char* profile_file, const char* device_file, uint64_t device_size, device_profile_ptr prof);
+
+/**********************************************************************************************//**
+ * @fn  bool probe_save_profile(const char* profile_file, const device_profile* prof);
+ *
+ * @brief Stores the profile of a device in the profile file replacing an already existing profile
+ *        of the same device.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param profile_file  zero-terminated name of the profile file
+ * @param prof          pointer to the profile
+ *
+ * @returns true on success, false on error.
+ **************************************************************************************************/
+
+bool probe_save_profile(const char* profile_file, const device_profile* prof);
+
+/**********************************************************************************************//**
+ * @fn  void probe_apply_profile(cmdline_args_ptr cap, disk_ptr dp);
+ *
+ * @brief Looks up the profile of a disk (if any) and stores the preferred transfer size and
+ *        concurrency in the disk structure (io_block_size, io_queue_depth).
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param cap command line arguments (profile file)
+ * @param dp  pointer to the disk
+ **************************************************************************************************/
+
+void probe_apply_profile(cmdline_args_ptr cap, disk_ptr dp);
+
+/**********************************************************************************************//**
+ * @fn  int probe_device(cmdline_args_ptr cap);
+ *
+ * @brief Measures the sequential and random throughput and latency of the working disk sweeping
+ *        block sizes and queue depths. Write tests are only performed in the explicitly allowed
+ *        scratch range (--scratch-range) or, for image files, in a temporary file next to the
+ *        image. The resulting profile is stored in the profile file.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param cap command line arguments
+ *
+ * @returns 0 on success, 1 on error (process exit code).
+ **************************************************************************************************/
+
+int probe_device(cmdline_args_ptr cap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _INC_PROBE_H_
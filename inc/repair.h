@@ -0,0 +1,143 @@
+/**
+ * @file   repair.h
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @brief  declaration of the repairgpt command, which rebuilds a broken GPT
+ *         copy from the intact one with a minimal number of sector writes.
+ *
+ * [MIT license]
+ *
+ * Copyright (c) 2021 Ingo A. Kubbilun
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INC_REPAIR_H_
+#define _INC_REPAIR_H_
+
+#include <part-y.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define REPAIR_GPT_NONE                 0x00000000                  ///< both GPT copies are valid, identical and in place
+#define REPAIR_GPT_BACKUP               0x00000001                  ///< the backup GPT is rebuilt from the primary GPT
+#define REPAIR_GPT_PRIMARY              0x00000002                  ///< the primary GPT is rebuilt from the backup GPT
+#define REPAIR_GPT_RELOCATE             0x00000003                  ///< the backup GPT is moved to the last LBA of a resized disk
+
+typedef struct _repair_plan             repair_plan, * repair_plan_ptr;
+
+struct _repair_plan
+{
+  uint32_t                              action;                     ///< REPAIR_GPT_xxx
+  write_plan_ptr                        wpp;                        ///< the regions to be written (a relocation writes the backup GPT first)
+};
+
+/**********************************************************************************************//**
+ * @fn  bool repair_gpt_plan(disk_ptr dp, repair_plan_ptr rpp, char* error, size_t error_size);
+ *
+ * @brief Decides which GPT copy of a scanned disk is broken (see disk_scan_partitions) and
+ *        regenerates exactly the region of this copy (header plus partition entries) from the
+ *        intact one. If the backup GPT does not reside at the last LBA (resized disk), the
+ *        backup GPT is rebuilt there and the primary GPT (and a protective MBR) is updated
+ *        accordingly. The regions are only added to a write plan, nothing is written.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param           dp          the (scanned) disk
+ * @param [in,out]  rpp         receives the plan (release it with repair_gpt_free)
+ * @param [in,out]  error       receives the error message on error
+ * @param           error_size  size of the error buffer in bytes
+ *
+ * @returns true on success (rpp->action may be REPAIR_GPT_NONE), false if the disk cannot be
+ *          repaired (error contains the reason).
+ **************************************************************************************************/
+
+bool repair_gpt_plan(disk_ptr dp, repair_plan_ptr rpp, char* error, size_t error_size);
+
+/**********************************************************************************************//**
+ * @fn  bool repair_gpt_commit(disk_ptr dp, repair_plan_ptr rpp, char* error, size_t error_size);
+ *
+ * @brief Executes the write plan of a repair plan (see write_plan_execute)
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param           dp          the disk
+ * @param           rpp         the plan (see repair_gpt_plan)
+ * @param [in,out]  error       receives the error message on error
+ * @param           error_size  size of the error buffer in bytes
+ *
+ * @returns true on success, false on error.
+ **************************************************************************************************/
+
+bool repair_gpt_commit(disk_ptr dp, repair_plan_ptr rpp, char* error, size_t error_size);
+
+/**********************************************************************************************//**
+ * @fn  void repair_gpt_free(repair_plan_ptr rpp);
+ *
+ * @brief Releases the write plan of a repair plan
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param rpp the plan
+ **************************************************************************************************/
+
+void repair_gpt_free(repair_plan_ptr rpp);
+
+/**********************************************************************************************//**
+ * @fn  const char* repair_gpt_action_name(uint32_t action);
+ *
+ * @brief Returns a short description of a repair action
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param action  REPAIR_GPT_xxx
+ *
+ * @returns the zero-terminated description.
+ **************************************************************************************************/
+
+const char* repair_gpt_action_name(uint32_t action);
+
+/**********************************************************************************************//**
+ * @fn  int repair_gpt(cmdline_args_ptr cap);
+ *
+ * @brief Repairs the GPT of the working disk (see repair_gpt_plan). The write plan is
+ *        printed; in dry-run mode, nothing else is done. If a fleet list file is specified
+ *        (--fleet), all disks of the list are repaired in parallel instead (see
+ *        fleet_repair_gpt).
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param cap command line arguments
+ *
+ * @returns 0 on success, 1 on error (process exit code).
+ **************************************************************************************************/
+
+int repair_gpt(cmdline_args_ptr cap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _INC_REPAIR_H_
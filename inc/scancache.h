@@ -0,0 +1,318 @@
+/**
+ * @file   scancache.h
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @brief  declaration of the scan cache, which stores the sectors read while
+ *         scanning the partition tables of a device, so that repeated
+ *         invocations only have to read (and validate) LBAs 0 and 1.
+ *
+ * [MIT license]
+ *
+ * Copyright (c) 2021 Ingo A. Kubbilun
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INC_SCANCACHE_H_
+#define _INC_SCANCACHE_H_
+
+#include <part-y.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SCAN_CACHE_FILE_NAME            ".part-y-scancache"         ///< default cache file (in the home directory)
+#define SCAN_CACHE_MAGIC                "PARTYSC2"                  ///< first eight bytes of the cache file
+#define SCAN_CACHE_MAX_AGE_SEC          3600                        ///< entries older than this are rescanned (changes by other tools)
+#define SCAN_CACHE_MAX_ENTRIES          256                         ///< max. number of devices in the cache file
+#define SCAN_CACHE_MAX_RUNS             4096                        ///< max. number of sector runs of one entry
+#define SCAN_CACHE_MAX_RUN_SECTORS      1024                        ///< max. number of sectors of one run
+#define SCAN_CACHE_MAX_PEEKS            4096                        ///< max. number of file system peeks of one entry
+#define SCAN_CACHE_HASH_SIZE            32                          ///< SHA3-256 of LBAs 0 and 1 (MBR and primary GPT header)
+
+typedef struct _scan_cache_run          scan_cache_run, * scan_cache_run_ptr;
+typedef struct _scan_cache_peek         scan_cache_peek, * scan_cache_peek_ptr;
+typedef struct _scan_cache_entry        scan_cache_entry;
+typedef struct _scan_cache              scan_cache;
+
+struct _scan_cache_run
+{
+  uint64_t                              lba;                        ///< first LBA of the run
+  uint32_t                              num_sectors;                ///< number of sectors of the run
+  uint8_t                              *data;                       ///< sector data (num_sectors * SECTOR_SIZE bytes)
+};
+
+struct _scan_cache_peek
+{
+  uint64_t                              lba;                        ///< start LBA of the peeked partition
+  uint64_t                              num_sectors;                ///< size of the partition (limits the signature windows)
+  fs_sig_result                         result;                     ///< the identified file system (FSYS_UNKNOWN if none)
+};
+
+struct _scan_cache_entry
+{
+  scan_cache_entry_ptr                  next;                       ///< next entry (NULL if this is tail)
+
+  char                                  device_file[256];           ///< device or image file this entry belongs to
+  uint64_t                              device_id;                  ///< device number (block device) or file system of the image file
+  uint64_t                              file_id;                    ///< image files: file number (inode); 0 for devices
+  uint64_t                              mtime_usec;                 ///< image files: modification time; 0 for devices
+  uint64_t                              device_size;                ///< device size in bytes
+  uint32_t                              logical_sector_size;        ///< logical sector size of the device
+  uint32_t                              physical_sector_size;       ///< physical sector size of the device
+  char                                  serial[64];                 ///< WWN or serial number of the device (empty if unknown)
+  uint8_t                               validator[SCAN_CACHE_HASH_SIZE]; ///< hash of LBAs 0 and 1 (includes the CRCs of the primary GPT)
+  uint64_t                              timestamp;                  ///< point in time (seconds since the epoch) of the scan
+
+  uint32_t                              num_runs;                   ///< number of sector runs
+  uint32_t                              max_runs;                   ///< allocated number of sector runs
+  scan_cache_run_ptr                    runs;                       ///< all sectors read by the scan (in the order of the reads)
+
+  uint32_t                              num_peeks;                  ///< number of file system peeks
+  uint32_t                              max_peeks;                  ///< allocated number of file system peeks
+  scan_cache_peek_ptr                   peeks;                      ///< results of the file system peeks (not the windows read)
+};
+
+struct _scan_cache
+{
+  char                                  cache_file[256];            ///< file the cache is loaded from and stored to
+  scan_cache_entry_ptr                  head;                       ///< all cached entries (read-only while scanning)
+  volatile uint64_t                     hits;                       ///< number of scans served from the cache
+  volatile uint64_t                     misses;                     ///< number of scans read from the devices
+  bool                                  invalidate_only;            ///< writing command: scans are neither replayed nor recorded
+  bool                                  dropped;                    ///< entries dropped by scan_cache_invalidate_file (file has to be rewritten)
+};
+
+/**********************************************************************************************//**
+ * @fn  void scan_cache_default_file(char* buf, size_t buf_size);
+ *
+ * @brief Gets the name of the default scan cache file, i.e. SCAN_CACHE_FILE_NAME in the home
+ *        directory (Linux) or in %APPDATA% (Windows).
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param [in,out]  buf       buffer receiving the file name
+ * @param           buf_size  size of the buffer
+ **************************************************************************************************/
+
+void scan_cache_default_file(char* buf, size_t buf_size);
+
+/**********************************************************************************************//**
+ * @fn  scan_cache_ptr scan_cache_load(const char* cache_file);
+ *
+ * @brief Loads the scan cache from a file. A missing, foreign or damaged file yields an empty
+ *        cache, which is (re)written by scan_cache_save.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param cache_file  name of the cache file
+ *
+ * @returns NULL on memory allocation error, otherwise the cache (free it with scan_cache_free).
+ **************************************************************************************************/
+
+scan_cache_ptr scan_cache_load(const char* cache_file);
+
+/**********************************************************************************************//**
+ * @fn  void scan_cache_free(scan_cache_ptr sc);
+ *
+ * @brief Frees the scan cache and all of its entries.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param sc  the scan cache (may be NULL)
+ **************************************************************************************************/
+
+void scan_cache_free(scan_cache_ptr sc);
+
+/**********************************************************************************************//**
+ * @fn  void scan_cache_free_entry(scan_cache_entry_ptr ep);
+ *
+ * @brief Frees one cache entry including all of its sector runs.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param ep  the entry (may be NULL)
+ **************************************************************************************************/
+
+void scan_cache_free_entry(scan_cache_entry_ptr ep);
+
+/**********************************************************************************************//**
+ * @fn  bool scan_cache_begin(disk_ptr dp, DISK_HANDLE h);
+ *
+ * @brief Called by disk_scan_partitions before the partition tables are read. Reads LBAs 0 and
+ *        1, and looks up an entry with the same identity (device number or file, size, sector
+ *        sizes, WWN or serial number) and the same hash of LBAs 0 and 1. On a hit, all further
+ *        reads of disk_read_sectors are served from the entry. On a miss, the sectors read are
+ *        recorded in a new entry, which is stored by scan_cache_save. The cache itself is not
+ *        modified, so that several disks can be scanned in parallel.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param [in,out]  dp  the disk (the cache is dp->scan_cache; nothing is done if it is NULL)
+ * @param           h   handle of the opened device or image file
+ *
+ * @returns true on a cache hit, false otherwise.
+ **************************************************************************************************/
+
+bool scan_cache_begin(disk_ptr dp, DISK_HANDLE h);
+
+/**********************************************************************************************//**
+ * @fn  bool scan_cache_replay(disk_ptr dp, uint64_t lba, uint32_t num_sectors, uint8_t* buffer);
+ *
+ * @brief Serves a read of disk_read_sectors from the cache entry being replayed. If the sectors
+ *        are not part of the entry, the entry is invalidated (it is dropped by scan_cache_save).
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param [in,out]  dp           the disk
+ * @param           lba          first LBA
+ * @param           num_sectors  number of sectors
+ * @param [in,out]  buffer       buffer receiving num_sectors * SECTOR_SIZE bytes
+ *
+ * @returns true if the buffer has been filled, false if the sectors have to be read.
+ **************************************************************************************************/
+
+bool scan_cache_replay(disk_ptr dp, uint64_t lba, uint32_t num_sectors, uint8_t* buffer);
+
+/**********************************************************************************************//**
+ * @fn  void scan_cache_record(disk_ptr dp, uint64_t lba, uint32_t num_sectors, const uint8_t* data);
+ *
+ * @brief Appends sectors read by disk_read_sectors to the entry being recorded.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param [in,out]  dp           the disk
+ * @param           lba          first LBA
+ * @param           num_sectors  number of sectors
+ * @param           data         sector data
+ **************************************************************************************************/
+
+void scan_cache_record(disk_ptr dp, uint64_t lba, uint32_t num_sectors, const uint8_t* data);
+
+/**********************************************************************************************//**
+ * @fn  bool scan_cache_replay_peek(disk_ptr dp, uint64_t lba, uint64_t num_sectors, fs_sig_result_ptr res);
+ *
+ * @brief Serves a file system peek of partition_peek_fs_batch from the cache entry being
+ *        replayed. If the partition is not part of the entry, the entry is invalidated (it is
+ *        dropped by scan_cache_save).
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param [in,out]  dp           the disk
+ * @param           lba          start LBA of the partition
+ * @param           num_sectors  size of the partition
+ * @param [in,out]  res          receives the result
+ *
+ * @returns true if the result has been filled, false if the partition has to be peeked.
+ **************************************************************************************************/
+
+bool scan_cache_replay_peek(disk_ptr dp, uint64_t lba, uint64_t num_sectors, fs_sig_result_ptr res);
+
+/**********************************************************************************************//**
+ * @fn  void scan_cache_record_peek(disk_ptr dp, uint64_t lba, uint64_t num_sectors, const fs_sig_result* res);
+ *
+ * @brief Appends the result of a file system peek to the entry being recorded. The windows read
+ *        by the peek are not recorded (they are much larger than the result).
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param [in,out]  dp           the disk
+ * @param           lba          start LBA of the partition
+ * @param           num_sectors  size of the partition
+ * @param           res          the result
+ **************************************************************************************************/
+
+void scan_cache_record_peek(disk_ptr dp, uint64_t lba, uint64_t num_sectors, const fs_sig_result* res);
+
+/**********************************************************************************************//**
+ * @fn  void scan_cache_end(disk_ptr dp);
+ *
+ * @brief Called by disk_scan_partitions after the scan; stops the replay or recording.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param [in,out]  dp  the disk
+ **************************************************************************************************/
+
+void scan_cache_end(disk_ptr dp);
+
+/**********************************************************************************************//**
+ * @fn  void scan_cache_invalidate(disk_ptr dp);
+ *
+ * @brief Marks the cache entry of a disk invalid, e.g. because part-y has written to the disk.
+ *        The entry (and any new recording) is dropped by scan_cache_save.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param [in,out]  dp  the disk (may be NULL)
+ **************************************************************************************************/
+
+void scan_cache_invalidate(disk_ptr dp);
+
+/**********************************************************************************************//**
+ * @fn  void scan_cache_invalidate_file(scan_cache_ptr sc, const char* device_file);
+ *
+ * @brief Drops the cache entry of a device or image file by its name, e.g. for a disk which has
+ *        been written but whose disk structure is not passed to scan_cache_save (clone target).
+ *        Must not be called while disks are scanned.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param [in,out]  sc          the scan cache (may be NULL)
+ * @param           device_file the device or image file
+ **************************************************************************************************/
+
+void scan_cache_invalidate_file(scan_cache_ptr sc, const char* device_file);
+
+/**********************************************************************************************//**
+ * @fn  bool scan_cache_save(scan_cache_ptr sc, disk_ptr head, disk_ptr work_disk);
+ *
+ * @brief Merges the recordings of all scanned disks into the cache, drops invalidated and
+ *        expired entries and writes the cache file (via a temporary file, which replaces the
+ *        cache file) if anything has changed. Must not be called while disks are scanned.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param [in,out]  sc         the scan cache
+ * @param [in,out]  head       list of disks (may be NULL)
+ * @param [in,out]  work_disk  working disk (may be NULL or part of the list)
+ *
+ * @returns true on success, false if the cache file cannot be written.
+ **************************************************************************************************/
+
+bool scan_cache_save(scan_cache_ptr sc, disk_ptr head, disk_ptr work_disk);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _INC_SCANCACHE_H_
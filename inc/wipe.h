@@ -0,0 +1,104 @@
+/**
+ * @file   wipe.h
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @brief  declaration of the wipe engine, which overwrites a device or image
+ *         file with one or more pattern or pseudo random passes, optionally
+ *         verifying each pass by reading the data back.
+ *
+ * [MIT license]
+ *
+ * Copyright (c) 2021 Ingo A. Kubbilun
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INC_WIPE_H_
+#define _INC_WIPE_H_
+
+#include <part-y.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WIPE_MAX_PASSES                 16                          ///< max. number of passes in one --passes list
+#define WIPE_DEFAULT_PASSES             "random"                    ///< passes performed if --passes is not specified
+
+#define WIPE_PASS_PATTERN               0x00000000                  ///< pass writes a constant byte pattern
+#define WIPE_PASS_RANDOM                0x00000001                  ///< pass writes pseudo random data (reproducible for the verification)
+
+#define WIPE_DEFAULT_CHUNK_SIZE         (4 << 20)                   ///< transfer size if no device profile exists
+#define WIPE_DEFAULT_WORKERS            4                           ///< concurrent writes (and reads) if no device profile exists
+#define WIPE_SEGMENT_CHUNKS             16                          ///< chunks per pipeline segment (unit of verification and checkpoints)
+#define WIPE_PROGRESS_INTERVAL_MS       500                         ///< progress update interval
+#define WIPE_PRNG_LANES                 4                           ///< independent generator lanes (vectorized by the compiler)
+
+typedef struct _wipe_pass               wipe_pass, * wipe_pass_ptr;
+
+struct _wipe_pass
+{
+  uint32_t                              type;                       ///< WIPE_PASS_xxx
+  uint8_t                               pattern;                    ///< byte pattern (WIPE_PASS_PATTERN only)
+  char                                  name[16];                   ///< name of the pass as specified on the command line
+};
+
+/**********************************************************************************************//**
+ * @fn  bool wipe_parse_passes(const char* spec, wipe_pass_ptr passes, uint32_t* num_passes);
+ *
+ * @brief Parses a comma-separated list of wipe passes. Each pass is either 'zero', 'one' (0xFF),
+ *        'random' or a hexadecimal byte pattern (e.g. '0x55').
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param           spec        zero-terminated list of passes
+ * @param [in,out]  passes      array of WIPE_MAX_PASSES entries receiving the passes (may be NULL
+ *                              just to check the syntax)
+ * @param [in,out]  num_passes  receives the number of passes
+ *
+ * @returns true on success, false if the list cannot be parsed.
+ **************************************************************************************************/
+
+bool wipe_parse_passes(const char* spec, wipe_pass_ptr passes, uint32_t* num_passes);
+
+/**********************************************************************************************//**
+ * @fn  int wipe_device(cmdline_args_ptr cap);
+ *
+ * @brief Overwrites the working disk (or the LBA range --lba-range) with all passes of the list
+ *        --passes. The range is split into segments; the chunks of a segment are striped across
+ *        the worker threads while the chunks of the previous segment are read back and verified
+ *        (unless --no-verify is specified). After each segment, the position is stored in the
+ *        checkpoint file (--checkpoint), so that an interrupted wipe can be resumed. The
+ *        throughput of each pass is reported.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param cap command line arguments
+ *
+ * @returns 0 on success, 1 on error (process exit code).
+ **************************************************************************************************/
+
+int wipe_device(cmdline_args_ptr cap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _INC_WIPE_H_
@@ -0,0 +1,234 @@
+/**
+ * @file   workpool.h
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @brief  declaration of a small, portable worker thread pool (with optional
+ *         per-key concurrency limits) and of a global I/O bandwidth budget
+ *         shared by all workers.
+ *
+ * [MIT license]
+ *
+ * Copyright (c) 2021 Ingo A. Kubbilun
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INC_WORKPOOL_H_
+#define _INC_WORKPOOL_H_
+
+#include <part-y.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WORKPOOL_MAX_THREADS            64                          ///< upper limit of worker threads in one pool
+#define WORKPOOL_NO_KEY                 ((uint64_t)0)               ///< tasks submitted with this key are never limited per key
+
+typedef struct _workpool                workpool, * workpool_ptr;   ///< opaque, see workpool.c
+typedef struct _io_budget               io_budget, * io_budget_ptr; ///< opaque, see workpool.c
+
+typedef void (*workpool_func)(void* arg);
+
+/**********************************************************************************************//**
+ * @fn  uint32_t workpool_num_cpus(void);
+ *
+ * @brief Retrieves the number of online CPUs (used as the default number of worker threads)
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @returns number of online CPUs (at least 1).
+ **************************************************************************************************/
+
+uint32_t workpool_num_cpus(void);
+
+/**********************************************************************************************//**
+ * @fn  uint64_t get_time_usec(void);
+ *
+ * @brief Retrieves a monotonic time stamp in microseconds (only differences are meaningful)
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @returns the current monotonic time in microseconds.
+ **************************************************************************************************/
+
+uint64_t get_time_usec(void);
+
+/**********************************************************************************************//**
+ * @fn  uint64_t atomic_add64(volatile uint64_t* p, uint64_t value);
+ *
+ * @brief Atomically adds a value to a 64bit counter shared between threads
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param [in,out]  p     pointer to the counter
+ * @param           value value to be added
+ *
+ * @returns the new value of the counter.
+ **************************************************************************************************/
+
+uint64_t atomic_add64(volatile uint64_t* p, uint64_t value);
+
+/**********************************************************************************************//**
+ * @fn  uint64_t atomic_load64(volatile uint64_t* p);
+ *
+ * @brief Atomically reads a 64bit counter shared between threads
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param p pointer to the counter
+ *
+ * @returns the current value of the counter.
+ **************************************************************************************************/
+
+uint64_t atomic_load64(volatile uint64_t* p);
+
+/**********************************************************************************************//**
+ * @fn  workpool_ptr workpool_create(uint32_t num_threads, uint32_t max_per_key);
+ *
+ * @brief Creates a worker pool and starts all of its worker threads
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param num_threads number of worker threads (1..WORKPOOL_MAX_THREADS); 0 selects the number
+ *                    of online CPUs.
+ * @param max_per_key maximum number of tasks sharing the same key (!= WORKPOOL_NO_KEY) that may
+ *                    run concurrently, e.g. the number of concurrent jobs per physical device;
+ *                    0 means unlimited.
+ *
+ * @returns NULL on error or the newly created worker pool.
+ **************************************************************************************************/
+
+workpool_ptr workpool_create(uint32_t num_threads, uint32_t max_per_key);
+
+/**********************************************************************************************//**
+ * @fn  bool workpool_submit(workpool_ptr wp, uint64_t key, workpool_func func, void* arg);
+ *
+ * @brief Submits a task to the worker pool. Tasks are started in submission order unless a task
+ *        has to wait for its key (see max_per_key), then subsequent runnable tasks are preferred.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param wp    pointer to the worker pool
+ * @param key   concurrency key (e.g. a device identity) or WORKPOOL_NO_KEY
+ * @param func  task function executed by one of the worker threads
+ * @param arg   argument passed to the task function
+ *
+ * @returns true on success, false on error (out of memory).
+ **************************************************************************************************/
+
+bool workpool_submit(workpool_ptr wp, uint64_t key, workpool_func func, void* arg);
+
+/**********************************************************************************************//**
+ * @fn  bool workpool_wait(workpool_ptr wp, uint32_t timeout_ms);
+ *
+ * @brief Waits until all submitted tasks have been completed
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param wp          pointer to the worker pool
+ * @param timeout_ms  maximum wait time in milliseconds; 0 waits without time limit.
+ *
+ * @returns true if the pool is idle (all tasks completed), false if the timeout elapsed.
+ **************************************************************************************************/
+
+bool workpool_wait(workpool_ptr wp, uint32_t timeout_ms);
+
+/**********************************************************************************************//**
+ * @fn  void workpool_destroy(workpool_ptr wp);
+ *
+ * @brief Waits for all pending tasks, stops all worker threads and frees the pool
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param wp  pointer to the worker pool (NULL is a no-op)
+ **************************************************************************************************/
+
+void workpool_destroy(workpool_ptr wp);
+
+/**********************************************************************************************//**
+ * @fn  void workpool_abandon(workpool_ptr wp);
+ *
+ * @brief Gives up a pool without waiting: queued tasks are dropped, tasks which are already
+ *        running (e.g. blocked in a system call) finish in the background and the last worker
+ *        thread frees the pool. The arguments of the running tasks must stay valid until then.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param wp  pointer to the worker pool (NULL is a no-op)
+ **************************************************************************************************/
+
+void workpool_abandon(workpool_ptr wp);
+
+/**********************************************************************************************//**
+ * @fn  io_budget_ptr io_budget_create(uint64_t bytes_per_second);
+ *
+ * @brief Creates a global I/O bandwidth budget, which can be shared by any number of threads
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param bytes_per_second  overall bandwidth limit in bytes per second (0 = unlimited)
+ *
+ * @returns NULL on error or the newly allocated budget.
+ **************************************************************************************************/
+
+io_budget_ptr io_budget_create(uint64_t bytes_per_second);
+
+/**********************************************************************************************//**
+ * @fn  void io_budget_consume(io_budget_ptr bp, uint64_t bytes);
+ *
+ * @brief Consumes bytes from the budget; the calling thread is delayed until the transfer fits
+ *        into the configured bandwidth (all threads share one virtual time line).
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param bp    pointer to the budget (NULL is a no-op)
+ * @param bytes number of bytes transferred (or about to be transferred)
+ **************************************************************************************************/
+
+void io_budget_consume(io_budget_ptr bp, uint64_t bytes);
+
+/**********************************************************************************************//**
+ * @fn  void io_budget_free(io_budget_ptr bp);
+ *
+ * @brief Frees a budget
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param bp  pointer to the budget (NULL is a no-op)
+ **************************************************************************************************/
+
+void io_budget_free(io_budget_ptr bp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _INC_WORKPOOL_H_
@@ -0,0 +1,187 @@
+/**
+ * @file   writeplan.h
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @brief  declaration of write plans: the sector writes of a mutating operation are
+ *         collected first and executed at once (sorted, coalesced, vectored), with flush
+ *         barriers only where the order of the writes matters.
+ *
+ * [MIT license]
+ *
+ * Copyright (c) 2021 Ingo A. Kubbilun
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INC_WRITEPLAN_H_
+#define _INC_WRITEPLAN_H_
+
+#include <part-y.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WRITE_PLAN_MAX_BYTES            (256 << 20)                 ///< max. amount of data held by one plan
+#define WRITE_PLAN_MAX_WRITE            (16 << 20)                  ///< max. size of one coalesced (vectored) write
+
+typedef struct _write_plan_item         write_plan_item, * write_plan_item_ptr;
+typedef struct _write_plan              write_plan, * write_plan_ptr;
+
+struct _write_plan_item
+{
+  uint64_t                              lba;                        ///< first LBA written
+  uint32_t                              num_sectors;                ///< number of sectors written
+  uint32_t                              phase;                      ///< phase (items of a phase are reordered freely; phases are separated by flushes)
+  uint32_t                              seq;                        ///< insertion order (keeps the sort stable)
+  uint8_t                              *data;                       ///< copy of the data (aligned to SECTOR_MEM_ALIGN)
+  void                                 *data_malloc_ptr;            ///< this is the original pointer returned by malloc()
+  char                                  description[48];            ///< what is written (for the plan output)
+};
+
+struct _write_plan
+{
+  write_plan_item_ptr                   items;                      ///< array of items
+  uint32_t                              num_items;                  ///< number of used items
+  uint32_t                              max_items;                  ///< number of allocated items
+  uint32_t                              num_phases;                 ///< number of phases (barriers + 1)
+  uint64_t                              num_bytes;                  ///< total amount of data written
+  bool                                  sorted;                     ///< items sorted by phase and LBA (and checked for overlaps)
+};
+
+/**********************************************************************************************//**
+ * @fn  write_plan_ptr write_plan_create(void);
+ *
+ * @brief Creates an empty write plan.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @returns NULL on error (out of memory) or the new plan.
+ **************************************************************************************************/
+
+write_plan_ptr write_plan_create(void);
+
+/**********************************************************************************************//**
+ * @fn  void write_plan_free(write_plan_ptr wpp);
+ *
+ * @brief Frees a write plan including all data copies.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param wpp the plan (may be NULL)
+ **************************************************************************************************/
+
+void write_plan_free(write_plan_ptr wpp);
+
+/**********************************************************************************************//**
+ * @fn  bool write_plan_add(write_plan_ptr wpp, uint64_t lba, uint32_t num_sectors, const uint8_t* data, const char* description);
+ *
+ * @brief Adds a sector write to the current phase of the plan. The data is copied, so the caller
+ *        may reuse its buffer.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param wpp         the plan
+ * @param lba         first LBA to be written
+ * @param num_sectors number of sectors
+ * @param data        num_sectors * 512 bytes of data or NULL to write zeros
+ * @param description short description of the data (e.g. "backup GPT")
+ *
+ * @returns true on success, false on error (out of memory or WRITE_PLAN_MAX_BYTES exceeded).
+ **************************************************************************************************/
+
+bool write_plan_add(write_plan_ptr wpp, uint64_t lba, uint32_t num_sectors, const uint8_t* data, const char* description);
+
+/**********************************************************************************************//**
+ * @fn  void write_plan_barrier(write_plan_ptr wpp);
+ *
+ * @brief Ends the current phase: all writes added so far are durable (flushed) before any write
+ *        added afterwards is issued, e.g. the backup GPT before the primary GPT. Within a phase,
+ *        the writes are issued in LBA order and adjacent writes are coalesced.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param wpp the plan
+ **************************************************************************************************/
+
+void write_plan_barrier(write_plan_ptr wpp);
+
+/**********************************************************************************************//**
+ * @fn  bool write_plan_append(write_plan_ptr wpp, write_plan_ptr src);
+ *
+ * @brief Appends all writes of another plan after a barrier, i.e. they are issued after all
+ *        writes of wpp are durable (the phases of src are kept). The data copies are moved,
+ *        src is empty afterwards.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param wpp the plan
+ * @param src the plan whose writes are appended
+ *
+ * @returns true on success, false on error (out of memory or WRITE_PLAN_MAX_BYTES exceeded).
+ **************************************************************************************************/
+
+bool write_plan_append(write_plan_ptr wpp, write_plan_ptr src);
+
+/**********************************************************************************************//**
+ * @fn  void write_plan_dump(write_plan_ptr wpp);
+ *
+ * @brief Prints the writes of the plan in the order they are executed (one line per coalesced
+ *        write, including the regions it consists of), the flush barriers and the cost of the
+ *        plan compared to one synchronous write per region. Used for --dry-run.
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param wpp the plan
+ **************************************************************************************************/
+
+void write_plan_dump(write_plan_ptr wpp);
+
+/**********************************************************************************************//**
+ * @fn  bool write_plan_execute(write_plan_ptr wpp, const char* device_file, char* error, size_t error_size);
+ *
+ * @brief Executes a plan: the device is opened once without synchronous writes
+ *        (disk_open_device_batched); the writes of each phase are issued in LBA order, adjacent
+ *        writes as one vectored write; between two phases, the device is flushed, and the final
+ *        flush is done when the device is closed. Overlapping writes within a phase are refused
+ *        (before anything is written).
+ *
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @date   01.09.2021
+ *
+ * @param           wpp         the plan
+ * @param           device_file device or image file
+ * @param [in,out]  error       receives an error message
+ * @param           error_size  size of the error buffer
+ *
+ * @returns true on success, false on error.
+ **************************************************************************************************/
+
+bool write_plan_execute(write_plan_ptr wpp, const char* device_file, char* error, size_t error_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _INC_WRITEPLAN_H_
@@ -31,7 +31,9 @@
 
 static const char backup_signature[16] = { 'P','A','R','T','-','Y','-','B','A','C','K','-','F','I','L','E' };
 
-#define BACKUP_BUFFER_SIZE        (16<<20)    ///< 16 Megs
+#define BACKUP_BUFFER_SIZE        (16<<20)    ///< 16 Megs (default if there is no device profile)
+#define BACKUP_BUFFER_SIZE_MIN    (64<<10)    ///< lower limit of a transfer size taken from a device profile
+#define BACKUP_BUFFER_SIZE_MAX    (64<<20)    ///< upper limit of a transfer size taken from a device profile
 
 backup_header_ptr bootstrap_backup(uint64_t device_sectors)
 {
@@ -126,19 +128,35 @@ void free_backup_structure(backup_header_ptr bhp)
   free(bhp);
 }
 
+static uint32_t backup_buffer_size(uint32_t preferred)
+{
+  if ((preferred < BACKUP_BUFFER_SIZE_MIN) || (preferred > BACKUP_BUFFER_SIZE_MAX))
+    return BACKUP_BUFFER_SIZE;
+
+  return preferred & (~SECTOR_SIZE_MASK);
+}
+
 bool create_backup_file(disk_ptr dp, backup_header_ptr bhp, DISK_HANDLE h, const char* backup_file, const char *message)
+{
+  return create_backup_file_ex(dp, bhp, h, backup_file, message, NULL, NULL);
+}
+
+bool create_backup_file_ex(disk_ptr dp, backup_header_ptr bhp, DISK_HANDLE h, const char* backup_file, const char* message, backup_progress_cb progress, void* progress_ctx)
 {
   uint8_t             header[SECTOR_SIZE], sector[SECTOR_SIZE];
   FILE_HANDLE         f;
   backup_record_ptr   brp;
   uint8_t            *buffer = NULL, *aligned_buffer;
   uint64_t            to_be_transferred, lba, this_size, overall_size, overall_counter = 0;
+  uint32_t            buffer_size;
   sha3_context        ctx;
   const uint8_t      *hash;
 
   if (NULL == dp || NULL == bhp || INVALID_DISK_HANDLE == h || NULL == backup_file)
     return false;
 
+  buffer_size = backup_buffer_size(disk_io_size(dp, dp->io_read_size, BACKUP_BUFFER_SIZE));
+
   memset(&ctx, 0, sizeof(ctx));
   sha3_Init(&ctx, 512);
 
@@ -186,7 +204,7 @@ ErrorExit:
 
   // write records
   
-  buffer = (uint8_t*)malloc(BACKUP_BUFFER_SIZE + SECTOR_SIZE);
+  buffer = (uint8_t*)malloc(buffer_size + SECTOR_SIZE);
   if (unlikely(NULL == buffer))
     goto ErrorExit;
 
@@ -213,11 +231,14 @@ ErrorExit:
 
     while (0 != to_be_transferred)
     {
-      this_size = to_be_transferred > BACKUP_BUFFER_SIZE ? BACKUP_BUFFER_SIZE : to_be_transferred;
+      this_size = to_be_transferred > buffer_size ? buffer_size : to_be_transferred;
 
       if (!disk_read(dp, h, lba << SECTOR_SHIFT, aligned_buffer, (uint32_t)this_size))
         goto ErrorExit;
 
+      if (NULL != progress)
+        progress(progress_ctx, this_size);
+
       overall_counter += this_size;
 
       if (NULL != message)
@@ -274,6 +295,11 @@ static bool check_filler(const uint8_t* buffer, uint32_t size, uint8_t value)
 }
 
 bool check_backup_file(disk_ptr dp, DISK_HANDLE h, const char* backup_file, const char *message)
+{
+  return check_backup_file_ex(dp, h, backup_file, message, NULL, NULL);
+}
+
+bool check_backup_file_ex(disk_ptr dp, DISK_HANDLE h, const char* backup_file, const char* message, backup_progress_cb progress, void* progress_ctx)
 {
   uint8_t             sector[SECTOR_SIZE];
   FILE_HANDLE         f;
@@ -282,6 +308,7 @@ bool check_backup_file(disk_ptr dp, DISK_HANDLE h, const char* backup_file, cons
   uint8_t            *buffer = NULL, *aligned_buffer, *aligned_buffer2;
   uint8_t            *buffer2 = NULL;
   uint64_t            i, to_be_transferred, lba, this_size, overall_size, overall_counter = 0;
+  uint32_t            buffer_size;
   sha3_context        ctx;
   const uint8_t      *hash;
   uint8_t             orig_hash[32];
@@ -289,6 +316,8 @@ bool check_backup_file(disk_ptr dp, DISK_HANDLE h, const char* backup_file, cons
   if (NULL == dp || INVALID_DISK_HANDLE == h || NULL == backup_file)
     return false;
 
+  buffer_size = backup_buffer_size(disk_io_size(dp, dp->io_read_size, BACKUP_BUFFER_SIZE));
+
   memset(&ctx, 0, sizeof(ctx));
   sha3_Init(&ctx, 512);
 
@@ -339,11 +368,11 @@ ErrorExit:
 
   // read and check records
 
-  buffer = (uint8_t*)malloc(BACKUP_BUFFER_SIZE + SECTOR_SIZE);
+  buffer = (uint8_t*)malloc(buffer_size + SECTOR_SIZE);
   if (unlikely(NULL == buffer))
     goto ErrorExit;
 
-  buffer2 = (uint8_t*)malloc(BACKUP_BUFFER_SIZE + SECTOR_SIZE);
+  buffer2 = (uint8_t*)malloc(buffer_size + SECTOR_SIZE);
   if (unlikely(NULL == buffer2))
     goto ErrorExit;
 
@@ -375,12 +404,15 @@ ErrorExit:
 
     while (0 != to_be_transferred)
     {
-      this_size = to_be_transferred > BACKUP_BUFFER_SIZE ? BACKUP_BUFFER_SIZE : to_be_transferred;
+      this_size = to_be_transferred > buffer_size ? buffer_size : to_be_transferred;
 
       if (INVALID_DISK_HANDLE != h)
       {
         if (!disk_read(dp, h, lba << SECTOR_SHIFT, aligned_buffer, (uint32_t)this_size))
           goto ErrorExit;
+
+        if (NULL != progress)
+          progress(progress_ctx, this_size);
       }
 
       overall_counter += this_size;
@@ -424,6 +456,39 @@ ErrorExit:
   return (!memcmp(hash, orig_hash, 32)) ? true : false;
 }
 
+static bool restoreReadHeader(disk_ptr dp, FILE_HANDLE f, sha3_context* ctx, backup_header_ptr bhp, uint64_t* overall_size, uint8_t* orig_hash)
+{
+  uint8_t             sector[SECTOR_SIZE];
+
+  if (!file_read(f, sector, SECTOR_SIZE))
+    return false;
+
+  if (memcmp(&sector[0x0000], backup_signature, 16))
+    return false;
+
+  memcpy(orig_hash, &sector[0x0030], 32);
+  memset(&sector[0x0030], 0x55, 32);
+
+  if (!check_filler(&sector[0x0030], SECTOR_SIZE - 0x0030, 0x55))
+    return false;
+
+  sha3_Update(ctx, sector, SECTOR_SIZE);
+
+  bhp->version = READ_BIG_ENDIAN32(sector, 0x0010);
+  bhp->first_record_ofs = READ_BIG_ENDIAN32(sector, 0x0014);
+
+  if (BACKUP_VERSION != bhp->version)
+    return false;
+  if (SECTOR_SIZE != bhp->first_record_ofs)
+    return false;
+
+  bhp->device_sectors = READ_BIG_ENDIAN64(sector, 0x0018);
+  bhp->num_records = READ_BIG_ENDIAN64(sector, 0x0020);
+  *overall_size = READ_BIG_ENDIAN64(sector, 0x0028);
+
+  return (dp->device_sectors == bhp->device_sectors) ? true : false;
+}
+
 bool restore_backup_file(disk_ptr dp, DISK_HANDLE h, const char* backup_file, const char *message)
 {
   uint8_t             sector[SECTOR_SIZE];
@@ -432,6 +497,7 @@ bool restore_backup_file(disk_ptr dp, DISK_HANDLE h, const char* backup_file, co
   backup_record       br;
   uint8_t            *buffer = NULL, *aligned_buffer;
   uint64_t            i, to_be_transferred, lba, this_size, overall_size, overall_counter = 0;
+  uint32_t            buffer_size;
   sha3_context        ctx;
   const uint8_t* hash;
   uint8_t             orig_hash[32];
@@ -439,6 +505,8 @@ bool restore_backup_file(disk_ptr dp, DISK_HANDLE h, const char* backup_file, co
   if (NULL == dp || INVALID_DISK_HANDLE == h || NULL == backup_file)
     return false;
 
+  buffer_size = backup_buffer_size(disk_io_size(dp, dp->io_write_size, BACKUP_BUFFER_SIZE));
+
   memset(&ctx, 0, sizeof(ctx));
   sha3_Init(&ctx, 512);
 
@@ -448,7 +516,7 @@ bool restore_backup_file(disk_ptr dp, DISK_HANDLE h, const char* backup_file, co
 
   // read header
 
-  if (!file_read(f, sector, SECTOR_SIZE))
+  if (!restoreReadHeader(dp, f, &ctx, &bh, &overall_size, orig_hash))
   {
 ErrorExit:
     file_close(f, false);
@@ -459,35 +527,9 @@ ErrorExit:
 
   overall_counter += SECTOR_SIZE;
 
-  if (memcmp(&sector[0x0000], backup_signature, 16))
-    goto ErrorExit;
-
-  memcpy(orig_hash, &sector[0x0030], 32);
-  memset(&sector[0x0030], 0x55, 32);
-
-  if (!check_filler(&sector[0x0030], SECTOR_SIZE - 0x0030, 0x55))
-    goto ErrorExit;
-
-  sha3_Update(&ctx, sector, SECTOR_SIZE);
-
-  bh.version = READ_BIG_ENDIAN32(sector, 0x0010);
-  bh.first_record_ofs = READ_BIG_ENDIAN32(sector, 0x0014);
-
-  if (BACKUP_VERSION != bh.version)
-    goto ErrorExit;
-  if (SECTOR_SIZE != bh.first_record_ofs)
-    goto ErrorExit;
-
-  bh.device_sectors = READ_BIG_ENDIAN64(sector, 0x0018);
-  bh.num_records = READ_BIG_ENDIAN64(sector, 0x0020);
-  overall_size = READ_BIG_ENDIAN64(sector, 0x0028);
-
-  if (dp->device_sectors != bh.device_sectors)
-    goto ErrorExit;
-
   // read and check records
 
-  buffer = (uint8_t*)malloc(BACKUP_BUFFER_SIZE + SECTOR_SIZE);
+  buffer = (uint8_t*)malloc(buffer_size + SECTOR_SIZE);
   if (unlikely(NULL == buffer))
     goto ErrorExit;
 
@@ -517,7 +559,7 @@ ErrorExit:
 
     while (0 != to_be_transferred)
     {
-      this_size = to_be_transferred > BACKUP_BUFFER_SIZE ? BACKUP_BUFFER_SIZE : to_be_transferred;
+      this_size = to_be_transferred > buffer_size ? buffer_size : to_be_transferred;
 
       if (!file_read(f, aligned_buffer, (uint32_t)this_size))
         goto ErrorExit;
@@ -555,3 +597,199 @@ ErrorExit:
 
   return (!memcmp(hash, orig_hash, 32)) ? true : false;
 }
+
+bool restore_backup_plan(disk_ptr dp, const char* backup_file, write_plan_ptr wpp, const char* message)
+{
+  uint8_t             sector[SECTOR_SIZE];
+  FILE_HANDLE         f;
+  backup_header       bh;
+  backup_record       br;
+  write_plan_ptr      head = NULL;
+  uint8_t            *buffer = NULL, *aligned_buffer;
+  uint64_t            i, to_be_transferred, lba, this_size, overall_size, overall_counter = 0;
+  uint32_t            buffer_size;
+  sha3_context        ctx;
+  const uint8_t      *hash;
+  uint8_t             orig_hash[32];
+  char                description[48];
+  bool                res = false;
+
+  if (NULL == dp || NULL == backup_file || NULL == wpp)
+    return false;
+
+  buffer_size = backup_buffer_size(disk_io_size(dp, dp->io_write_size, BACKUP_BUFFER_SIZE));
+
+  memset(&ctx, 0, sizeof(ctx));
+  sha3_Init(&ctx, 512);
+
+  f = file_open(backup_file, true/*read-only*/);
+  if (INVALID_FILE_HANDLE == f)
+    return false;
+
+  if (!restoreReadHeader(dp, f, &ctx, &bh, &overall_size, orig_hash) || overall_size > WRITE_PLAN_MAX_BYTES)
+    goto Exit;
+
+  overall_counter += SECTOR_SIZE;
+
+  // records starting in the head region (MBR, primary GPT) are written last, after all other
+  // records (e.g. the backup GPT) are durable
+
+  head = write_plan_create();
+  buffer = (uint8_t*)malloc(buffer_size + SECTOR_SIZE);
+  if (NULL == head || NULL == buffer)
+    goto Exit;
+
+  aligned_buffer = (uint8_t*)((((uint64_t)buffer) + (SECTOR_SIZE - 1)) & (~(SECTOR_SIZE - 1)));
+
+  for (i = 0; i < bh.num_records; i++)
+  {
+    if (!file_read(f, sector, SECTOR_SIZE))
+      goto Exit;
+
+    overall_counter += SECTOR_SIZE;
+
+    sha3_Update(&ctx, sector, SECTOR_SIZE);
+
+    if (!check_filler(&sector[0x0010], SECTOR_SIZE - 0x0010, 0xAA))
+      goto Exit;
+
+    br.start_lba = READ_BIG_ENDIAN64(sector, 0x0000);
+    br.num_lbas = READ_BIG_ENDIAN64(sector, 0x0008);
+
+    if ((br.start_lba + br.num_lbas) > dp->device_sectors)
+      goto Exit;
+
+    to_be_transferred = br.num_lbas << SECTOR_SHIFT;
+
+    lba = br.start_lba;
+
+    snprintf(description, sizeof(description), "backup record %" FMT64 "u", i + 1);
+
+    while (0 != to_be_transferred)
+    {
+      this_size = to_be_transferred > buffer_size ? buffer_size : to_be_transferred;
+
+      if (!file_read(f, aligned_buffer, (uint32_t)this_size))
+        goto Exit;
+
+      overall_counter += this_size;
+
+      if (NULL != message)
+      {
+        fprintf(stdout, "\r%s" CTRL_GREEN "%3.2f%%" CTRL_RESET, message, (((double)overall_counter) * 100.0) / ((double)overall_size));
+        fflush(stdout);
+      }
+
+      sha3_Update(&ctx, aligned_buffer, (size_t)this_size);
+
+      // chunks of one record are adjacent, so they are coalesced again by the plan
+
+      if (!write_plan_add(br.start_lba < DISK_GPT_HEAD_SECTORS ? head : wpp, lba, (uint32_t)(this_size >> SECTOR_SHIFT), aligned_buffer, description))
+        goto Exit;
+
+      lba += this_size >> SECTOR_SHIFT;
+
+      to_be_transferred -= this_size;
+    }
+  }
+
+  if (NULL != message)
+  {
+    fprintf(stdout, "\r%s       \r%s", message, message);
+    fflush(stdout);
+  }
+
+  hash = (uint8_t*)sha3_Finalize(&ctx);
+
+  res = (!memcmp(hash, orig_hash, 32) && write_plan_append(wpp, head)) ? true : false;
+
+Exit:
+  file_close(f, false/*do not flush*/);
+  if (NULL != buffer)
+    free(buffer);
+  write_plan_free(head);
+
+  return res;
+}
+
+bool backup_add_partition_tables(disk_ptr dp, backup_header_ptr bhp)
+{
+  mbr_part_sector_ptr     mpsp;
+  uint64_t                backup_gpt_lba;
+  uint32_t                entry_sectors;
+
+  if (NULL == dp || NULL == bhp)
+    return false;
+
+  // MBR (always LBA 0, even if there is no valid MBR) plus all extended partition sectors
+
+  if (!add_backup_record(bhp, 0, 1))
+    return false;
+
+  mpsp = dp->mbr;
+  while (NULL != mpsp)
+  {
+    if ((NULL != mpsp->sp) && (0 != mpsp->sp->lba))
+    {
+      if (!add_backup_record(bhp, mpsp->sp->lba, 1))
+        return false;
+    }
+    mpsp = mpsp->next;
+  }
+
+  // size of the entry array: the scanned GPT tells it, default is 128 entries of 128 bytes (32 sectors)
+
+  if (NULL != dp->gpt1)
+    entry_sectors = GPT_ENTRY_ARRAY_SECTORS(dp->gpt1->header);
+  else
+  if (NULL != dp->gpt2)
+    entry_sectors = GPT_ENTRY_ARRAY_SECTORS(dp->gpt2->header);
+  else
+    entry_sectors = 32;
+
+  if (dp->device_sectors < (1 + 2 * (1 + (uint64_t)entry_sectors)))
+    return true; // too small for any GPT
+
+  // primary GPT: header plus the sectors of entries
+
+  if (!add_backup_record(bhp, 1, 1 + entry_sectors))
+    return false;
+
+  // backup GPT: the sectors of entries plus the header in the last LBA
+
+  if (!add_backup_record(bhp, dp->device_sectors - 1 - entry_sectors, 1 + entry_sectors))
+    return false;
+
+  // if the disk was enlarged, then the backup GPT is still located where the primary header says
+
+  if (NULL != dp->gpt1)
+  {
+    backup_gpt_lba = dp->gpt1->header.backup_lba;
+
+    if ((backup_gpt_lba >= (2 + 2 * (uint64_t)entry_sectors)) && (backup_gpt_lba < (dp->device_sectors - 1 - entry_sectors)))
+    {
+      if (!add_backup_record(bhp, backup_gpt_lba - entry_sectors, 1 + entry_sectors))
+        return false;
+    }
+  }
+
+  return true;
+}
+
+uint64_t backup_get_data_size(backup_header_ptr bhp)
+{
+  backup_record_ptr       brp;
+  uint64_t                size = 0;
+
+  if (NULL == bhp)
+    return 0;
+
+  brp = bhp->head;
+  while (NULL != brp)
+  {
+    size += brp->num_lbas << SECTOR_SHIFT;
+    brp = brp->next;
+  }
+
+  return size;
+}
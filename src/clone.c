@@ -0,0 +1,912 @@
+/**
+ * @file   clone.c
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @brief  implementation of the clone command (pipelined reader/writer,
+ *         copy offload, sparse handling, parallel verification).
+ *
+ * [MIT license]
+ *
+ * Copyright (c) 2021 Ingo A. Kubbilun
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <part-y.h>
+
+#define CLONE_STREAM_READ         0x00000000  ///< read the chunks of a segment from the source
+#define CLONE_STREAM_WRITE        0x00000001  ///< write the chunks of a segment to the target
+#define CLONE_STREAM_OFFLOAD      0x00000002  ///< let the file system copy the chunks (no buffers)
+#define CLONE_STREAM_VERIFY       0x00000003  ///< read the chunks from both sides and compare them
+
+#define CLONE_MSG_OFFLOAD         CTRL_CYAN "WORKING" CTRL_RESET " : Cloning (copy offload) ...................................: "
+#define CLONE_MSG_COPY            CTRL_CYAN "WORKING" CTRL_RESET " : Cloning the disk .........................................: "
+#define CLONE_MSG_VERIFY          CTRL_CYAN "CHECKING" CTRL_RESET ": Verifying the clone .....................................: "
+#define CLONE_MSG_MAP             CTRL_CYAN "WORKING" CTRL_RESET " : Mapping the used blocks of the file systems ..............: "
+#define CLONE_MSG_DISCARD         CTRL_CYAN "WORKING" CTRL_RESET " : Discarding the unused blocks of the target ...............: "
+
+typedef struct _clone_chunk             clone_chunk, * clone_chunk_ptr;
+typedef struct _clone_run               clone_run, * clone_run_ptr;
+typedef struct _clone_stream            clone_stream, * clone_stream_ptr;
+typedef struct _clone_worker            clone_worker, * clone_worker_ptr;
+typedef struct _clone_part              clone_part, * clone_part_ptr;
+
+struct _clone_chunk
+{
+  uint64_t                              fp;                         ///< byte offset (identical on source and target)
+  uint32_t                              size;                       ///< size of the chunk in bytes
+};
+
+struct _clone_run
+{
+  DISK_HANDLE                           src;                        ///< source handle (positional reads only)
+  DISK_HANDLE                           dst;                        ///< target handle (positional writes only)
+  clone_chunk_ptr                       chunks;                     ///< all chunks to be copied
+  uint64_t                              num_chunks;                 ///< number of chunks
+  uint32_t                              chunk_size;                 ///< largest chunk, i.e. distance of two chunks in a segment buffer
+  bool                                  src_sparse;                 ///< the source is a sparse image file: holes are not read
+  bool                                  skip_zeros;                 ///< the target reads back zeros where nothing is written
+  volatile uint64_t                     errors;                     ///< number of failed operations (I/O errors, mismatches, offload failures)
+  volatile uint64_t                     skipped;                    ///< bytes not written (holes and zero chunks)
+  volatile uint64_t                     offloaded;                  ///< bytes copied by the file system
+};
+
+struct _clone_stream
+{
+  clone_run_ptr                         run;                        ///< back pointer to the run
+  uint32_t                              mode;                       ///< CLONE_STREAM_xxx
+  uint8_t                              *buffer;                     ///< segment buffer (read and write only)
+  uint64_t                              first;                      ///< first chunk of the segment
+  uint64_t                              end;                        ///< first chunk after the segment
+  volatile uint64_t                     next_chunk;                 ///< next chunk (relative to first) to be processed
+  volatile uint64_t                     bytes;                      ///< number of bytes processed so far
+};
+
+struct _clone_worker
+{
+  clone_stream_ptr                      stream;                     ///< segment the worker currently processes
+  void                                 *mem;                        ///< allocated memory of buffer
+  void                                 *mem2;                       ///< allocated memory of expected
+  uint8_t                              *buffer;                     ///< target data (verification only)
+  uint8_t                              *expected;                   ///< source data (verification only)
+  uint64_t                              mismatch_fp;                ///< first mismatching byte position ((uint64_t)-1 if none)
+  bool                                  io_error;                   ///< true if a read or write failed
+  bool                                  offload_failed;             ///< true if the file system refused to copy a chunk
+};
+
+struct _clone_part
+{
+  DISK_HANDLE                           src;                        ///< source handle (positional reads only)
+  uint64_t                              fp;                         ///< byte offset of the partition
+  uint64_t                              size;                       ///< size of the partition in bytes
+  uint32_t                              fs_type;                    ///< peeked file system (FSYS_xxx)
+  bool                                  mapped;                     ///< true if the used blocks of the file system are in extents
+  fs_extent_list                        extents;                    ///< used extents of the file system
+};
+
+static bool clone_is_zero(const uint8_t* data, uint32_t size)
+{
+  const uint64_t     *p = (const uint64_t*)data;
+  uint32_t            i, n = size >> 3;
+
+  for (i = 0; i < n; i++)
+  {
+    if (0 != p[i])
+      return false;
+  }
+
+  return true;
+}
+
+static bool clone_read_source(clone_run_ptr run, const clone_chunk* ccp, uint8_t* buffer)
+{
+  if (run->src_sparse && !disk_range_has_data(run->src, ccp->fp, ccp->size))
+  {
+    memset(buffer, 0, ccp->size);
+    return true;
+  }
+
+  return disk_read_at(run->src, ccp->fp, buffer, ccp->size);
+}
+
+static void clone_task(void* arg)
+{
+  clone_worker_ptr    cwp = (clone_worker_ptr)arg;
+  clone_stream_ptr    cs = cwp->stream;
+  clone_run_ptr       run = cs->run;
+  clone_chunk_ptr     ccp;
+  uint64_t            idx;
+  uint8_t            *data;
+  uint32_t            i;
+  bool                ok = true;
+
+  while (0 == atomic_load64(&run->errors))
+  {
+    idx = cs->first + atomic_add64(&cs->next_chunk, 1) - 1;
+    if (idx >= cs->end)
+      break;
+
+    ccp = &run->chunks[idx];
+    data = cs->buffer + (idx - cs->first) * run->chunk_size;
+
+    switch (cs->mode)
+    {
+      case CLONE_STREAM_READ:
+        ok = clone_read_source(run, ccp, data);
+        break;
+
+      case CLONE_STREAM_WRITE:
+        if (run->skip_zeros && clone_is_zero(data, ccp->size))
+          atomic_add64(&run->skipped, ccp->size);
+        else
+          ok = disk_write_at(run->dst, ccp->fp, data, ccp->size);
+        break;
+
+      case CLONE_STREAM_OFFLOAD:
+        if (run->src_sparse && !disk_range_has_data(run->src, ccp->fp, ccp->size))
+          atomic_add64(&run->skipped, ccp->size);
+        else
+        if (disk_copy_range(run->src, ccp->fp, run->dst, ccp->fp, ccp->size))
+          atomic_add64(&run->offloaded, ccp->size);
+        else
+        {
+          cwp->offload_failed = true;
+          atomic_add64(&run->errors, 1);
+          return;
+        }
+        break;
+
+      default: // CLONE_STREAM_VERIFY
+        ok = clone_read_source(run, ccp, cwp->expected) && disk_read_at(run->dst, ccp->fp, cwp->buffer, ccp->size);
+        if (ok && memcmp(cwp->buffer, cwp->expected, ccp->size))
+        {
+          for (i = 0; i < ccp->size; i++)
+          {
+            if (cwp->buffer[i] != cwp->expected[i])
+              break;
+          }
+          if ((ccp->fp + i) < cwp->mismatch_fp)
+            cwp->mismatch_fp = ccp->fp + i;
+          atomic_add64(&run->errors, 1);
+          return;
+        }
+        break;
+    }
+
+    if (!ok)
+    {
+      cwp->io_error = true;
+      atomic_add64(&run->errors, 1);
+      break;
+    }
+
+    atomic_add64(&cs->bytes, ccp->size);
+  }
+}
+
+static uint8_t* clone_alloc(uint64_t size, void** mem)
+{
+  *mem = malloc((size_t)size + SECTOR_MEM_ALIGN);
+  if (unlikely(NULL == *mem))
+    return NULL;
+
+  return (uint8_t*)((((uint64_t)*mem) + (SECTOR_MEM_ALIGN - 1)) & (~((uint64_t)(SECTOR_MEM_ALIGN - 1))));
+}
+
+static void clone_submit(workpool_ptr wp, clone_worker_ptr workers, uint32_t num_workers, clone_stream_ptr cs)
+{
+  uint32_t            i;
+
+  for (i = 0; i < num_workers; i++)
+  {
+    workers[i].stream = cs;
+    (void)workpool_submit(wp, WORKPOOL_NO_KEY, clone_task, &workers[i]);
+  }
+}
+
+static void clone_wait(workpool_ptr wp, const char* message, uint64_t done, clone_stream_ptr cs, uint64_t total)
+{
+  while (!workpool_wait(wp, CLONE_PROGRESS_INTERVAL_MS))
+  {
+    fprintf(stdout, "\r%s" CTRL_GREEN "%3.2f%%" CTRL_RESET, message,
+      (((double)(done + (NULL != cs ? atomic_load64(&cs->bytes) : 0))) * 100.0) / ((double)total));
+    fflush(stdout);
+  }
+}
+
+static bool clone_copy_pipelined(clone_run_ptr run, workpool_ptr wp, clone_worker_ptr readers, clone_worker_ptr writers, uint32_t num_workers,
+                                 uint8_t** buffers, uint64_t total, const char* message)
+{
+  clone_stream        streams[2];
+  uint64_t            next = 0, done = 0;
+  uint32_t            cur = 0;
+  bool                prev_valid = false;
+
+  memset(streams, 0, sizeof(streams));
+
+  // pipeline: the chunks of segment k+1 are read into one buffer while the chunks of segment k
+  // are written from the other one
+
+  while ((next < run->num_chunks) || prev_valid)
+  {
+    if (next < run->num_chunks)
+    {
+      memset(&streams[cur], 0, sizeof(clone_stream));
+      streams[cur].run = run;
+      streams[cur].mode = CLONE_STREAM_READ;
+      streams[cur].buffer = buffers[cur];
+      streams[cur].first = next;
+      streams[cur].end = (run->num_chunks - next) > CLONE_SEGMENT_CHUNKS ? next + CLONE_SEGMENT_CHUNKS : run->num_chunks;
+      clone_submit(wp, readers, num_workers, &streams[cur]);
+    }
+
+    if (prev_valid)
+    {
+      streams[cur ^ 1].mode = CLONE_STREAM_WRITE;
+      streams[cur ^ 1].next_chunk = 0;
+      streams[cur ^ 1].bytes = 0;
+      clone_submit(wp, writers, num_workers, &streams[cur ^ 1]);
+    }
+
+    clone_wait(wp, message, done, prev_valid ? &streams[cur ^ 1] : NULL, total);
+
+    if (0 != atomic_load64(&run->errors))
+      return false;
+
+    if (prev_valid)
+      done += atomic_load64(&streams[cur ^ 1].bytes);
+
+    prev_valid = next < run->num_chunks;
+    if (prev_valid)
+      next = streams[cur].end;
+    cur ^= 1;
+  }
+
+  return true;
+}
+
+static bool clone_run_stream(clone_run_ptr run, workpool_ptr wp, clone_worker_ptr workers, uint32_t num_workers, uint32_t mode,
+                             uint64_t total, const char* message)
+{
+  clone_stream        cs;
+
+  memset(&cs, 0, sizeof(cs));
+  cs.run = run;
+  cs.mode = mode;
+  cs.end = run->num_chunks;
+
+  clone_submit(wp, workers, num_workers, &cs);
+  clone_wait(wp, message, 0, &cs, total);
+
+  return 0 == atomic_load64(&run->errors);
+}
+
+static void clone_report(const char* what, uint64_t size, uint64_t elapsed, const char* suffix)
+{
+  char                size_str[32], rate_str[32];
+
+  format_disk_size(size, size_str, sizeof(size_str));
+  format_disk_size(0 == elapsed ? 0 : (uint64_t)((((double)size) * 1000000.0) / ((double)elapsed)), rate_str, sizeof(rate_str));
+  fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": %s %s in %.2f s = %s/s%s\n", what, size_str, ((double)elapsed) / 1000000.0, rate_str, suffix);
+}
+
+static bool clone_build_chunks(clone_run_ptr run, const fs_extent_list* el, uint32_t chunk_size)
+{
+  uint64_t            i, fp, end, n = 0;
+
+  for (i = 0; i < el->num_items; i++)
+    n += (el->items[i].size + chunk_size - 1) / chunk_size;
+
+  run->chunks = (clone_chunk_ptr)malloc((size_t)((0 == n ? 1 : n) * sizeof(clone_chunk)));
+  if (NULL == run->chunks)
+    return false;
+
+  for (i = 0; i < el->num_items; i++)
+  {
+    for (fp = el->items[i].fp, end = fp + el->items[i].size; fp < end; fp += chunk_size)
+    {
+      run->chunks[run->num_chunks].fp = fp;
+      run->chunks[run->num_chunks].size = (end - fp) > chunk_size ? chunk_size : (uint32_t)(end - fp);
+      run->num_chunks++;
+    }
+  }
+
+  return true;
+}
+
+static void clone_map_task(void* arg)
+{
+  clone_part_ptr      cpp = (clone_part_ptr)arg;
+
+  cpp->mapped = fs_map_used(cpp->src, cpp->fs_type, cpp->fp, cpp->size, &cpp->extents);
+}
+
+static int clone_part_compare(const void* a, const void* b)
+{
+  const clone_part   *pa = (const clone_part*)a, *pb = (const clone_part*)b;
+
+  return pa->fp < pb->fp ? -1 : (pa->fp > pb->fp ? 1 : 0);
+}
+
+static bool clone_map_used(disk_ptr dp, DISK_HANDLE src, workpool_ptr wp, uint64_t total, fs_extent_list_ptr el)
+{
+  gpt_ptr             g = NULL != dp->gpt1 ? dp->gpt1 : dp->gpt2;
+  mbr_part_sector_ptr mpsp;
+  mbr_entry_ptr       mep;
+  clone_part_ptr      parts, cpp;
+  uint64_t            fp = 0, used, j;
+  uint32_t            num_parts = 0, max_parts = 0, i;
+  bool                ok = false;
+  char                size_str[32], size_str2[32];
+
+  // the partitions of the GPT, or the primary and logical partitions of the MBR
+
+  if (NULL != g)
+    max_parts = g->num_entries;
+  else
+  if (NULL != dp->mbr && NULL != dp->mbr->sp && !(DISK_FLAG_MBR_IS_PROTECTIVE & dp->flags))
+  {
+    for (mpsp = dp->mbr; NULL != mpsp; mpsp = mpsp->next)
+      max_parts += 4;
+  }
+
+  parts = (clone_part_ptr)calloc(max_parts + 1, sizeof(clone_part));
+  if (NULL == parts)
+    return false;
+
+  if (NULL != g)
+  {
+    for (i = 0; i < g->num_entries; i++)
+    {
+      parts[num_parts].fp = g->entries[i].part_start_lba << SECTOR_SHIFT;
+      parts[num_parts].size = (g->entries[i].part_end_lba - g->entries[i].part_start_lba + 1) << SECTOR_SHIFT;
+      parts[num_parts].fs_type = g->entries[i].fs_type;
+      num_parts++;
+    }
+  }
+  else
+  if (0 != max_parts)
+  {
+    for (mpsp = dp->mbr; NULL != mpsp; mpsp = mpsp->next)
+    {
+      for (i = 0; i < 4; i++)
+      {
+        mep = &mpsp->part_table[i];
+        if (0 == mep->num_sectors || MBR_IS_EXTENDED_PARTITION(mep->part_type))
+          continue;
+        parts[num_parts].fp = mep->start_sector << SECTOR_SHIFT; // absolute (also for logical partitions)
+        parts[num_parts].size = ((uint64_t)mep->num_sectors) << SECTOR_SHIFT;
+        parts[num_parts].fs_type = mep->fs_type;
+        num_parts++;
+      }
+    }
+  }
+
+  // the allocation maps of all partitions are read in parallel
+
+  fprintf(stdout, CLONE_MSG_MAP);
+  fflush(stdout);
+
+  for (i = 0; i < num_parts; i++)
+  {
+    cpp = &parts[i];
+    cpp->src = src;
+    cpp->extents.merge_gap = FS_MAP_MERGE_GAP;
+    if (cpp->fp >= total)
+      cpp->size = 0;
+    else
+    if (cpp->size > (total - cpp->fp))
+      cpp->size = total - cpp->fp;
+    if (0 != cpp->size)
+      (void)workpool_submit(wp, WORKPOOL_NO_KEY, clone_map_task, cpp);
+  }
+
+  while (!workpool_wait(wp, CLONE_PROGRESS_INTERVAL_MS));
+
+  fprintf(stdout, CTRL_GREEN "OK" CTRL_RESET "\n");
+
+  // everything outside of the partitions (partition tables, boot loaders, gaps) is copied, the
+  // partitions without a supported (or with an inconsistent) file system are copied completely
+
+  qsort(parts, num_parts, sizeof(clone_part), clone_part_compare);
+
+  for (i = 0; i < num_parts; i++)
+  {
+    cpp = &parts[i];
+    if (0 == cpp->size)
+      continue;
+
+    if (cpp->fp > fp && !fs_extent_add(el, fp, cpp->fp - fp))
+      goto Exit;
+
+    if (cpp->mapped && cpp->fp >= fp)
+    {
+      for (j = 0, used = 0; j < cpp->extents.num_items; j++)
+      {
+        used += cpp->extents.items[j].size;
+        if (!fs_extent_add(el, cpp->extents.items[j].fp, cpp->extents.items[j].size))
+          goto Exit;
+      }
+      format_disk_size(used, size_str, sizeof(size_str));
+      format_disk_size(cpp->size, size_str2, sizeof(size_str2));
+      fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": partition at LBA %" FMT64 "u (%s): %s of %s used.\n", cpp->fp >> SECTOR_SHIFT,
+        fs_sig_name(cpp->fs_type), size_str, size_str2);
+    }
+    else
+    {
+      if (!fs_extent_add(el, cpp->fp, cpp->size))
+        goto Exit;
+      fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": partition at LBA %" FMT64 "u (%s): copied completely.\n", cpp->fp >> SECTOR_SHIFT,
+        fs_sig_name(cpp->fs_type));
+    }
+
+    if ((cpp->fp + cpp->size) > fp)
+      fp = cpp->fp + cpp->size;
+  }
+
+  ok = fs_extent_add(el, fp, total - fp);
+
+Exit:
+  for (i = 0; i < num_parts; i++)
+    fs_extent_free(&parts[i].extents);
+  free(parts);
+
+  return ok;
+}
+
+static void clone_discard_unused(disk_ptr tdp, DISK_HANDLE dst, const fs_extent_list* el, uint64_t total)
+{
+  uint64_t            i, fp = 0, end, discarded = 0;
+  uint32_t            method = DISK_ZERO_NONE;
+  char                size_str[32];
+
+  // the unused blocks of the file systems are not read by them; they are discarded or zeroed if
+  // the device can do it without transferring zeros, otherwise they are left as they are
+
+  fprintf(stdout, CLONE_MSG_DISCARD);
+  fflush(stdout);
+
+  for (i = 0; i <= el->num_items; i++)
+  {
+    end = i < el->num_items ? el->items[i].fp : total;
+    if (end > fp)
+    {
+      if (!disk_zero_range(tdp, dst, fp, end - fp, NULL, &method))
+        break;
+      discarded += end - fp;
+    }
+    if (i < el->num_items)
+      fp = el->items[i].fp + el->items[i].size;
+  }
+
+  format_disk_size(discarded, size_str, sizeof(size_str));
+  if (i <= el->num_items)
+  {
+    fprintf(stdout, "\r" CLONE_MSG_DISCARD CTRL_YELLOW "N/A" CTRL_RESET "     \n");
+    fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": the unused blocks of the target are left as they are (%s discarded).\n", size_str);
+  }
+  else
+  {
+    fprintf(stdout, "\r" CLONE_MSG_DISCARD CTRL_GREEN "OK" CTRL_RESET "     \n");
+    fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": %s of unused blocks of the target zeroed (%s).\n", size_str, disk_zero_method_name(method));
+  }
+}
+
+static bool clone_plan_relocation(disk_ptr dp, uint64_t target_size, repair_plan_ptr rpp, char* error, size_t error_size)
+{
+  disk                target;
+  uint64_t            stale_lba;
+
+  // the relocation is planned from the primary GPT; a missing or damaged one is up to repairgpt
+
+  if (NULL == dp->gpt1 || dp->primary_gpt_corrupt)
+  {
+    snprintf(error, error_size, "the primary GPT of the source is missing or damaged");
+    return false;
+  }
+
+  stale_lba = dp->gpt1->header.backup_lba;
+
+  // the GPT repair plans the relocation if it is applied to the source with the size of the target
+
+  memcpy(&target, dp, sizeof(disk));
+  target.device_size = target_size;
+  target.device_sectors = target_size >> SECTOR_SHIFT;
+
+  if (!repair_gpt_plan(&target, rpp, error, error_size))
+    return false;
+
+  if (REPAIR_GPT_RELOCATE != rpp->action)
+  {
+    snprintf(error, error_size, "the GPT of the source cannot be relocated (%s)", repair_gpt_action_name(rpp->action));
+    repair_gpt_free(rpp);
+    return false;
+  }
+
+  // the copied backup GPT header of the source would be found by tools scanning for GPT headers;
+  // it is zeroed after the primary GPT refers to the new backup GPT
+
+  if (stale_lba < (target.device_sectors - 1 - GPT_ENTRY_ARRAY_SECTORS(dp->gpt1->header)) &&
+      !write_plan_add(rpp->wpp, stale_lba, 1, NULL, "stale backup GPT header"))
+  {
+    snprintf(error, error_size, "insufficient memory available");
+    repair_gpt_free(rpp);
+    return false;
+  }
+
+  return true;
+}
+
+int clone_disk(cmdline_args_ptr cap)
+{
+  disk_ptr            dp = cap->work_disk, tdp = NULL, p;
+  clone_worker        readers[WORKPOOL_MAX_THREADS / 2], writers[WORKPOOL_MAX_THREADS / 2];
+  clone_run           run;
+  fs_extent_list      extents;
+  repair_plan         rp;
+  workpool_ptr        wp = NULL;
+  DISK_HANDLE         src = INVALID_DISK_HANDLE, dst = INVALID_DISK_HANDLE;
+  uint32_t            num_workers, chunk_size, i;
+  uint64_t            total, copy_total = 0, target_size, t0, elapsed, mismatch_fp, e;
+  bool                new_image, is_image, offload, relocate, verify = !cap->no_verify, io_error, ok = false;
+  void               *mem[2] = { NULL, NULL };
+  uint8_t            *buffers[2];
+  char                error[256], size_str[32], size_str2[32], suffix[128];
+  const char         *target_file = cap->target_name;
+
+  memset(readers, 0, sizeof(readers));
+  memset(writers, 0, sizeof(writers));
+  memset(&rp, 0, sizeof(rp));
+  memset(&run, 0, sizeof(run));
+  memset(&extents, 0, sizeof(extents));
+
+  if (NULL == dp)
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": No working disk available.\n");
+    return 1;
+  }
+
+  if (SECTOR_SIZE != dp->logical_sector_size)
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": logical sector size %u is not supported.\n", dp->logical_sector_size);
+    return 1;
+  }
+
+  if (0 == cap->target_name[0])
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": please specify the target device or image file (--target).\n");
+    return 1;
+  }
+
+  total = dp->device_sectors << SECTOR_SHIFT;
+  if (0 == total)
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": nothing to be cloned (size is zero).\n");
+    return 1;
+  }
+
+  // the target: a missing image file is created, an existing one keeps its size if it is larger
+
+  new_image = !disk_file_exists(cap->target_name);
+#ifdef _WINDOWS
+  if (cap->target_name[0] >= '0' && cap->target_name[0] <= '9') // physical drive number
+    new_image = false;
+#endif
+  if (new_image)
+  {
+    is_image = true;
+    target_size = total;
+  }
+  else
+  {
+    tdp = disk_setup_device(cap, cap->target_name);
+    if (NULL == tdp)
+    {
+      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": unable to setup the target device/image file %s\n", cap->target_name);
+      return 1;
+    }
+
+    if (tdp == dp || !strcmp(tdp->device_file, dp->device_file))
+    {
+      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": source and target are identical.\n");
+      goto Exit;
+    }
+
+    target_file = tdp->device_file;
+    is_image = (DISK_FLAG_NOT_DEVICE_BUT_FILE & tdp->flags) ? true : false;
+    target_size = tdp->device_sectors << SECTOR_SHIFT;
+
+    if (!is_image && SECTOR_SIZE != tdp->logical_sector_size)
+    {
+      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": logical sector size %u of the target is not supported.\n", tdp->logical_sector_size);
+      goto Exit;
+    }
+
+    if (target_size < total)
+    {
+      if (!is_image)
+      {
+        format_disk_size(target_size, size_str, sizeof(size_str));
+        format_disk_size(total, size_str2, sizeof(size_str2));
+        fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": the target (%s) is smaller than the source (%s).\n", size_str, size_str2);
+        goto Exit;
+      }
+      target_size = total;
+    }
+  }
+
+  // a larger target receives its backup GPT at its end (the source GPT must be intact)
+
+  relocate = (target_size > total) && (dp->primary_gpt_exists || dp->backup_gpt_exists);
+  if (relocate && !clone_plan_relocation(dp, target_size, &rp, error, sizeof(error)))
+  {
+    fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": the backup GPT is not relocated (%s); please run repairgpt on the target.\n", error);
+    relocate = false;
+  }
+
+  // transfer size and concurrency: command line, device profile, built-in defaults
+
+  chunk_size = disk_io_size(dp, dp->io_read_size, CLONE_DEFAULT_CHUNK_SIZE);
+  num_workers = 0 != cap->num_threads ? cap->num_threads : (0 != dp->io_read_depth ? dp->io_read_depth : CLONE_DEFAULT_WORKERS);
+  if (num_workers > (WORKPOOL_MAX_THREADS / 2))
+    num_workers = WORKPOOL_MAX_THREADS / 2;
+
+  offload = is_image && (DISK_FLAG_NOT_DEVICE_BUT_FILE & dp->flags);
+
+  format_disk_size(total, size_str, sizeof(size_str));
+  format_disk_size(target_size, size_str2, sizeof(size_str2));
+  fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": cloning %s (%s) to %s %s (%s).\n", dp->device_file, size_str,
+    new_image ? "the new image file" : (is_image ? "the image file" : "the device"), target_file, size_str2);
+  format_disk_size(chunk_size, size_str, sizeof(size_str));
+  fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": %u worker(s), transfer size %s, copy offload %s, verification %s.\n", num_workers, size_str,
+    offload ? "if supported" : "not applicable", verify ? "enabled" : "disabled");
+
+  if (cap->dryrun)
+  {
+    fprintf(stdout, CTRL_MAGENTA "DRYRUN" CTRL_RESET ": Explaining what would be done.\n");
+    if (is_image)
+      fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": The image file would be %s as a sparse file; zero blocks are not written.\n", new_image ? "created" : "re-created");
+    else
+      fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": Overwriting drive (" CTRL_RED "DANGEROUS" CTRL_RESET ") with the source.\n");
+    if (relocate)
+    {
+      fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": The backup GPT would be relocated to the end of the target:\n");
+      write_plan_dump(rp.wpp);
+    }
+    if (cap->used_only)
+      fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": Only the used blocks of EXT2/3/4, NTFS and FAT file systems would be copied%s.\n",
+        is_image ? "" : "; the unused blocks of the target would be discarded if possible");
+    ok = true;
+    goto Exit;
+  }
+
+  // the target is not part of the disks passed to scan_cache_save
+
+  scan_cache_invalidate_file(cap->scan_cache, target_file);
+
+  if (is_image)
+  {
+    if (!disk_resize_image(target_file, 0, false) || !disk_resize_image(target_file, target_size, cap->preallocate))
+    {
+      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": unable to create the image file %s\n", target_file);
+      goto Exit;
+    }
+  }
+
+  src = disk_open_device(dp->device_file, false);
+  dst = disk_open_device_batched(target_file);
+  if (INVALID_DISK_HANDLE == src || INVALID_DISK_HANDLE == dst)
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": Unable to access the source for reading or the target for writing.\n");
+    goto Exit;
+  }
+
+  wp = workpool_create(num_workers << 1, 0);
+  if (NULL == wp)
+  {
+NoMemory:
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": Insufficient memory available.\n");
+    goto Exit;
+  }
+
+  // the extents to be copied: the whole disk, or everything but the unused blocks of the file systems
+
+  extents.merge_gap = FS_MAP_MERGE_GAP;
+  if (cap->used_only ? !clone_map_used(dp, src, wp, total, &extents) : !fs_extent_add(&extents, 0, total))
+    goto NoMemory;
+
+  for (e = 0; e < extents.num_items; e++)
+    copy_total += extents.items[e].size;
+
+  // the chunks, two segment buffers (read and write), two buffers per verifier
+
+  if (!clone_build_chunks(&run, &extents, chunk_size))
+    goto NoMemory;
+
+  run.src = src;
+  run.dst = dst;
+  run.chunk_size = chunk_size;
+  run.src_sparse = (DISK_FLAG_SPARSE_FILE & dp->flags) ? true : false;
+  run.skip_zeros = is_image; // re-created above, reads back zeros
+
+  buffers[0] = clone_alloc(((uint64_t)chunk_size) * CLONE_SEGMENT_CHUNKS, &mem[0]);
+  buffers[1] = clone_alloc(((uint64_t)chunk_size) * CLONE_SEGMENT_CHUNKS, &mem[1]);
+  if (NULL == buffers[0] || NULL == buffers[1])
+    goto NoMemory;
+
+  if (verify)
+  {
+    for (i = 0; i < num_workers; i++)
+    {
+      readers[i].buffer = clone_alloc(chunk_size, &readers[i].mem);
+      readers[i].expected = clone_alloc(chunk_size, &readers[i].mem2);
+      readers[i].mismatch_fp = (uint64_t)-1;
+      if (NULL == readers[i].buffer || NULL == readers[i].expected)
+        goto NoMemory;
+    }
+  }
+
+  if (cap->used_only && !is_image)
+    clone_discard_unused(tdp, dst, &extents, total);
+
+  t0 = get_time_usec();
+
+  // between image files, the file system may copy (or share) the blocks itself; if it refuses,
+  // everything is copied by the pipeline
+
+  if (offload)
+  {
+    fprintf(stdout, CLONE_MSG_OFFLOAD);
+    fflush(stdout);
+
+    if (clone_run_stream(&run, wp, writers, num_workers, CLONE_STREAM_OFFLOAD, copy_total,
+                         CLONE_MSG_OFFLOAD))
+      fprintf(stdout, "\r" CLONE_MSG_OFFLOAD CTRL_GREEN "OK" CTRL_RESET "     \n");
+    else
+    {
+      fprintf(stdout, "\r" CLONE_MSG_OFFLOAD CTRL_YELLOW "N/A" CTRL_RESET "     \n");
+      fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": the file system does not support the copy offload, copying the data.\n");
+      offload = false;
+      run.errors = 0;
+      run.skipped = 0;
+      run.offloaded = 0;
+    }
+  }
+
+  if (!offload)
+  {
+    fprintf(stdout, CLONE_MSG_COPY);
+    fflush(stdout);
+
+    if (!clone_copy_pipelined(&run, wp, readers, writers, num_workers, buffers, copy_total,
+                              CLONE_MSG_COPY))
+    {
+      fprintf(stdout, "\r" CLONE_MSG_COPY CTRL_RED "ERROR" CTRL_RESET "     \n");
+      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": Unable to perform write or read operation.\n");
+      goto Exit;
+    }
+    fprintf(stdout, "\r" CLONE_MSG_COPY CTRL_GREEN "OK" CTRL_RESET "     \n");
+  }
+
+  if (!disk_flush_device(dst))
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": Unable to flush the target.\n");
+    goto Exit;
+  }
+
+  elapsed = get_time_usec() - t0;
+
+  format_disk_size(atomic_load64(&run.skipped), size_str, sizeof(size_str));
+  format_disk_size(atomic_load64(&run.offloaded), size_str2, sizeof(size_str2));
+  snprintf(suffix, sizeof(suffix), " (%s not written: holes and zero blocks; %s copied by the file system)", size_str, size_str2);
+  clone_report("cloned", copy_total, elapsed, suffix);
+  if (cap->used_only)
+  {
+    format_disk_size(total - copy_total, size_str, sizeof(size_str));
+    fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": %s of unused file system blocks not copied.\n", size_str);
+  }
+
+  // parallel verification: every verifier reads its chunks from both sides
+
+  if (verify)
+  {
+    fprintf(stdout, CLONE_MSG_VERIFY);
+    fflush(stdout);
+
+    t0 = get_time_usec();
+
+    if (!clone_run_stream(&run, wp, readers, num_workers, CLONE_STREAM_VERIFY, copy_total,
+                          CLONE_MSG_VERIFY))
+    {
+      fprintf(stdout, "\r" CLONE_MSG_VERIFY CTRL_RED "ERROR" CTRL_RESET "     \n");
+
+      io_error = false;
+      mismatch_fp = (uint64_t)-1;
+      for (i = 0; i < num_workers; i++)
+      {
+        io_error |= readers[i].io_error;
+        if (readers[i].mismatch_fp < mismatch_fp)
+          mismatch_fp = readers[i].mismatch_fp;
+      }
+
+      if (io_error)
+        fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": Unable to perform read operation.\n");
+      if (((uint64_t)-1) != mismatch_fp)
+        fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": verification failed at byte offset %" FMT64 "u (LBA %" FMT64 "u).\n", mismatch_fp, mismatch_fp >> SECTOR_SHIFT);
+      goto Exit;
+    }
+    fprintf(stdout, "\r" CLONE_MSG_VERIFY CTRL_GREEN "OK" CTRL_RESET "     \n");
+
+    clone_report("verified", copy_total, get_time_usec() - t0, "");
+  }
+
+  disk_close_device(dst);
+  dst = INVALID_DISK_HANDLE;
+
+  if (relocate)
+  {
+    fprintf(stdout, CTRL_CYAN "WORKING" CTRL_RESET " : Relocating the backup GPT of the target ..................: ");
+    if (!write_plan_execute(rp.wpp, target_file, error, sizeof(error)))
+    {
+      fprintf(stdout, CTRL_RED "ERROR" CTRL_RESET "\n          %s.\n", error);
+      goto Exit;
+    }
+    fprintf(stdout, CTRL_GREEN "OK" CTRL_RESET "\n");
+  }
+
+  ok = true;
+
+Exit:
+  if (NULL != wp)
+    workpool_destroy(wp);
+
+  for (i = 0; i < (WORKPOOL_MAX_THREADS / 2); i++)
+  {
+    if (NULL != readers[i].mem)
+      free(readers[i].mem);
+    if (NULL != readers[i].mem2)
+      free(readers[i].mem2);
+  }
+
+  if (NULL != mem[0])
+    free(mem[0]);
+  if (NULL != mem[1])
+    free(mem[1]);
+  if (NULL != run.chunks)
+    free(run.chunks);
+  fs_extent_free(&extents);
+
+  repair_gpt_free(&rp);
+
+  disk_close_device(src);
+  disk_close_device(dst);
+
+  // the target structure is only owned here if it is not part of the (Windows) physical disk list
+
+  if (NULL != tdp)
+  {
+    for (p = cap->pd_head; NULL != p && p != tdp; p = p->next);
+    if (NULL == p)
+    {
+      tdp->next = NULL;
+      disk_free_list(tdp);
+    }
+  }
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,414 @@
+/**
+ * @file   convert.c
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @brief  implementation of the generic table conversions (MBR to GPT in place,
+ *         protective MBR), which work on devices and image files alike.
+ *
+ * [MIT license]
+ *
+ * Copyright (c) 2021 Ingo A. Kubbilun
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <part-y.h>
+
+static uint8_t* convert_alloc(void** buffer_mem, uint32_t num_sectors)
+{
+  uint8_t            *p;
+
+  *buffer_mem = malloc((((size_t)num_sectors) << SECTOR_SHIFT) + SECTOR_MEM_ALIGN);
+  if (NULL == *buffer_mem)
+    return NULL;
+
+  p = (uint8_t*)((((uint64_t)*buffer_mem) + (SECTOR_MEM_ALIGN - 1)) & (~((uint64_t)(SECTOR_MEM_ALIGN - 1))));
+  memset(p, 0, ((size_t)num_sectors) << SECTOR_SHIFT);
+
+  return p;
+}
+
+static void convert_protective_mbr(disk_ptr dp, uint8_t* sector)
+{
+  create_protective_mbr(dp->device_sectors, sector);
+
+  // keep boot code and disk signature of the existing MBR
+
+  if (NULL != dp->mbr && NULL != dp->mbr->sp && 0x55 == dp->mbr->sp->data[SECTOR_SIZE - 2] && 0xAA == dp->mbr->sp->data[SECTOR_SIZE - 1])
+    memcpy(sector, dp->mbr->sp->data, 0x01BE);
+}
+
+bool convert_mbr_to_gpt_plan(disk_ptr dp, convert_plan_ptr cpp, bool verbose, char* error, size_t error_size)
+{
+  mbr_part_sector_ptr mpsp;
+  mbr_entry_ptr       mep;
+  gpt_ptr             g = NULL;
+  gpt_entry_ptr       gep;
+  const gpt_type_info*gtip;
+  uint64_t            attributes, end_lba, tail_lba;
+  uint32_t            i, entry_sectors;
+  uint8_t            *p;
+  void               *buffer_mem = NULL;
+
+  memset(cpp, 0, sizeof(convert_plan));
+
+  if (!(DISK_FLAG_HAS_MBR & dp->flags) || NULL == dp->mbr)
+  {
+    snprintf(error, error_size, "no MBR found");
+    return false;
+  }
+
+  if ((DISK_FLAG_MBR_IS_PROTECTIVE & dp->flags) || (dp->primary_gpt_exists && !dp->primary_gpt_corrupt) ||
+      (dp->backup_gpt_exists && !dp->backup_gpt_corrupt))
+  {
+    snprintf(error, error_size, "the disk already has a GPT");
+    return false;
+  }
+
+  if (dp->device_sectors < (DISK_GPT_HEAD_SECTORS << 2))
+  {
+    snprintf(error, error_size, "the disk is too small for a GPT");
+    return false;
+  }
+
+  g = partition_new_gpt(GPT_DEFAULT_ENTRIES);
+  if (NULL == g)
+    goto NoMemory;
+
+  g->header.revision = 0x00010000;
+  g->header.header_size = 0x5C;
+  g->header.current_lba = 1;
+  g->header.backup_lba = dp->device_sectors - 1;
+  g->header.first_usable_lba = DISK_GPT_HEAD_SECTORS;
+  g->header.last_usable_lba = dp->device_sectors - DISK_GPT_HEAD_SECTORS;
+  g->header.starting_lba_part_entries = 2; // primary GPT
+  g->header.number_of_part_entries = GPT_DEFAULT_ENTRIES;
+  g->header.size_of_part_entry = 128;
+  entry_sectors = GPT_ENTRY_ARRAY_SECTORS(g->header);
+
+  if (!generate_guid(g->header.disk_guid))
+  {
+    snprintf(error, error_size, "unable to generate the disk GUID");
+    goto ErrorExit;
+  }
+
+  // all primary and logical partitions in MBR order (the extended partitions are dropped)
+
+  for (mpsp = dp->mbr; NULL != mpsp; mpsp = mpsp->next)
+  {
+    for (i = 0; i < 4; i++)
+    {
+      mep = &mpsp->part_table[i];
+      if (0x00 == mep->part_type || 0 == mep->num_sectors || MBR_IS_EXTENDED_PARTITION(mep->part_type))
+        continue;
+
+      end_lba = mep->start_sector + mep->num_sectors - 1;
+
+      if (g->num_entries >= GPT_DEFAULT_ENTRIES)
+      {
+        snprintf(error, error_size, "more than %u partitions", GPT_DEFAULT_ENTRIES);
+        goto ErrorExit;
+      }
+
+      if (mep->start_sector < g->header.first_usable_lba || end_lba > g->header.last_usable_lba)
+      {
+        snprintf(error, error_size, "partition at LBAs %" FMT64 "u..%" FMT64 "u overlaps the GPT areas", mep->start_sector, end_lba);
+        goto ErrorExit;
+      }
+
+      gep = gpt_add_entry(g, g->num_entries); // entries are appended slot by slot
+      if (NULL == gep)
+        goto NoMemory;
+
+      if (!gpt_get_guid_for_mbr_type(mep->part_type, gep->type_guid, &attributes))
+      {
+        snprintf(error, error_size, "MBR partition type 0x%02X has no GPT equivalent", mep->part_type);
+        goto ErrorExit;
+      }
+
+      if (!generate_guid(gep->partition_guid))
+      {
+        snprintf(error, error_size, "unable to generate a partition GUID");
+        goto ErrorExit;
+      }
+
+      gep->part_start_lba = mep->start_sector;
+      gep->part_end_lba = end_lba;
+      gep->attributes = attributes | (0x80 == mep->boot_flag ? GPT_ATTR_LEGACY_BIOS_BOOT : 0);
+      gep->fs_type = mep->fs_type;
+
+      gtip = gpt_lookup_type(gep->type_guid);
+      setGPTPartitionName(gep->part_name, 0 != mep->fs_label[0] ? mep->fs_label : (NULL != gtip ? gtip->gpt_description : ""));
+
+      if (verbose)
+        fprintf(stdout, "  %3u  %20" FMT64 "u .. %20" FMT64 "u  0x%02X -> %s\n", g->num_entries, gep->part_start_lba, gep->part_end_lba,
+          mep->part_type, NULL != gtip ? gtip->gpt_description : "(unknown)");
+    }
+  }
+
+  // the backup GPT is durable before the protective MBR and the primary GPT (both computed from
+  // the same GPT) replace the MBR
+
+  cpp->num_parts = g->num_entries;
+  cpp->wpp = write_plan_create();
+  p = convert_alloc(&buffer_mem, 1 + 1 + entry_sectors);
+  if (NULL == cpp->wpp || NULL == p)
+    goto NoMemory;
+
+  tail_lba = gpt_repair_table(p, g, true /*primary is the template of the backup*/) >> SECTOR_SHIFT;
+  if (!write_plan_add(cpp->wpp, tail_lba, 1 + entry_sectors, p, "backup GPT"))
+    goto NoMemory;
+  write_plan_barrier(cpp->wpp);
+
+  memset(p, 0, ((size_t)(1 + 1 + entry_sectors)) << SECTOR_SHIFT);
+  convert_protective_mbr(dp, p);
+  gpt_create_table(p + SECTOR_SIZE, g, true /*primary*/);
+  if (!write_plan_add(cpp->wpp, 0, 1, p, "protective MBR") ||
+      !write_plan_add(cpp->wpp, 1, 1 + entry_sectors, p + SECTOR_SIZE, "primary GPT"))
+    goto NoMemory;
+
+  partition_free_gpt(g);
+  free(buffer_mem);
+
+  return true;
+
+NoMemory:
+  snprintf(error, error_size, "insufficient memory available");
+ErrorExit:
+  if (NULL != g)
+    partition_free_gpt(g);
+  if (NULL != buffer_mem)
+    free(buffer_mem);
+  convert_free(cpp);
+  return false;
+}
+
+bool convert_write_pmbr_plan(disk_ptr dp, convert_plan_ptr cpp, char* error, size_t error_size)
+{
+  uint8_t             pmbr[SECTOR_SIZE];
+
+  memset(cpp, 0, sizeof(convert_plan));
+
+  if (!(DISK_FLAG_HAS_GPT & dp->flags))
+  {
+    snprintf(error, error_size, "no healthy GPT found (see repairgpt)");
+    return false;
+  }
+
+  // an existing protective MBR is kept if its 0xEE entry covers the disk
+
+  create_protective_mbr(dp->device_sectors, pmbr);
+
+  if ((DISK_FLAG_MBR_IS_PROTECTIVE & dp->flags) && NULL != dp->mbr && NULL != dp->mbr->sp &&
+      !memcmp(dp->mbr->sp->data + 0x01BE, pmbr + 0x01BE, SECTOR_SIZE - 0x01BE))
+    return true;
+
+  convert_protective_mbr(dp, pmbr);
+
+  cpp->wpp = write_plan_create();
+  if (NULL == cpp->wpp || !write_plan_add(cpp->wpp, 0, 1, pmbr, "protective MBR"))
+  {
+    snprintf(error, error_size, "insufficient memory available");
+    convert_free(cpp);
+    return false;
+  }
+
+  return true;
+}
+
+bool convert_commit(disk_ptr dp, convert_plan_ptr cpp, const char* backup_file, backup_progress_cb progress, void* progress_ctx, char* error, size_t error_size)
+{
+  backup_header_ptr   bhp;
+  DISK_HANDLE         h = INVALID_DISK_HANDLE;
+  bool                res = false;
+
+  if (NULL == cpp->wpp || 0 == cpp->wpp->num_items)
+    return true;
+
+  if (disk_file_exists(backup_file))
+  {
+    snprintf(error, error_size, "the backup file %s already exists", backup_file);
+    return false;
+  }
+
+  bhp = bootstrap_backup(dp->device_sectors);
+  if ((NULL == bhp) || (!backup_add_partition_tables(dp, bhp)))
+  {
+    snprintf(error, error_size, "unable to prepare the backup records");
+    goto Exit;
+  }
+
+  h = disk_open_device(dp->device_file, false/*read-only*/);
+  if (INVALID_DISK_HANDLE == h)
+  {
+    snprintf(error, error_size, "unable to open the device for reading");
+    goto Exit;
+  }
+
+  // nothing is written unless all affected sectors are saved (and verified)
+
+  if (!create_backup_file_ex(dp, bhp, h, backup_file, NULL, progress, progress_ctx))
+  {
+    snprintf(error, error_size, "unable to create the backup file %s", backup_file);
+    goto Exit;
+  }
+
+  if (!check_backup_file_ex(dp, h, backup_file, NULL, progress, progress_ctx))
+  {
+    snprintf(error, error_size, "unable to verify the backup file %s", backup_file);
+    goto Exit;
+  }
+
+  disk_close_device(h);
+  h = INVALID_DISK_HANDLE;
+
+  res = write_plan_execute(cpp->wpp, dp->device_file, error, error_size);
+
+Exit:
+  disk_close_device(h);
+  free_backup_structure(bhp);
+  return res;
+}
+
+void convert_free(convert_plan_ptr cpp)
+{
+  if (NULL != cpp->wpp)
+    write_plan_free(cpp->wpp);
+  memset(cpp, 0, sizeof(convert_plan));
+}
+
+static int convert_run(cmdline_args_ptr cap, convert_plan_ptr cpp, const char* what)
+{
+  disk_ptr            dp = cap->work_disk;
+  char                backup_file[sizeof(cap->backup_file) + sizeof(CONVERT_BACKUP_SUFFIX)], error[256];
+
+  if (0 != cap->backup_file[0])
+    strcpy(backup_file, cap->backup_file);
+  else
+  if (DISK_FLAG_NOT_DEVICE_BUT_FILE & dp->flags)
+    snprintf(backup_file, sizeof(backup_file), "%s" CONVERT_BACKUP_SUFFIX, dp->device_file);
+  else
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": Please specify a backup file.\n");
+    return 1;
+  }
+
+  if (disk_file_exists(backup_file))
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": the backup file %s already exists.\n", backup_file);
+    return 1;
+  }
+
+  if (cap->dryrun)
+  {
+    fprintf(stdout, CTRL_MAGENTA "DRYRUN" CTRL_RESET ": Explaining what would be done.\n");
+    fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": backing up all partition table sectors to %s\n", backup_file);
+    write_plan_dump(cpp->wpp);
+    return 0;
+  }
+
+  fprintf(stdout, CTRL_CYAN "WORKING" CTRL_RESET " : %s: ", what);
+  fflush(stdout);
+
+  if (!convert_commit(dp, cpp, backup_file, NULL, NULL, error, sizeof(error)))
+  {
+    fprintf(stdout, CTRL_RED "ERROR" CTRL_RESET "\n          %s.\n", error);
+    return 1;
+  }
+
+  fprintf(stdout, CTRL_GREEN "OK" CTRL_RESET "\n");
+  fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": the previous partition table sectors are saved in %s (see restore).\n", backup_file);
+
+  return 0;
+}
+
+static bool convert_check_disk(disk_ptr dp)
+{
+  if (NULL == dp)
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": No working disk available.\n");
+    return false;
+  }
+
+  if (SECTOR_SIZE != dp->logical_sector_size)
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": logical sector size %u is not supported.\n", dp->logical_sector_size);
+    return false;
+  }
+
+  return true;
+}
+
+int convert_mbr_to_gpt(cmdline_args_ptr cap)
+{
+  disk_ptr            dp = cap->work_disk;
+  convert_plan        cp;
+  char                error[256];
+  int                 exitcode;
+
+  if (0 != cap->fleet_file[0])
+    return fleet_convert(cap);
+
+  if (!convert_check_disk(dp))
+    return 1;
+
+  fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": converting the MBR of %s to a GPT:\n\n", dp->device_file);
+
+  if (!convert_mbr_to_gpt_plan(dp, &cp, true/*verbose*/, error, sizeof(error)))
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": %s: %s.\n", dp->device_file, error);
+    return 1;
+  }
+
+  fprintf(stdout, "\n");
+
+  exitcode = convert_run(cap, &cp, "Converting the MBR to a GPT ..............................");
+
+  convert_free(&cp);
+
+  return exitcode;
+}
+
+int convert_write_pmbr(cmdline_args_ptr cap)
+{
+  disk_ptr            dp = cap->work_disk;
+  convert_plan        cp;
+  char                error[256];
+  int                 exitcode;
+
+  if (!convert_check_disk(dp))
+    return 1;
+
+  if (!convert_write_pmbr_plan(dp, &cp, error, sizeof(error)))
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": %s: %s.\n", dp->device_file, error);
+    return 1;
+  }
+
+  if (NULL == cp.wpp)
+  {
+    fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": %s already has a protective MBR, nothing to do.\n", dp->device_file);
+    return 0;
+  }
+
+  exitcode = convert_run(cap, &cp, "Writing the protective MBR ...............................");
+
+  convert_free(&cp);
+
+  return exitcode;
+}
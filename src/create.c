@@ -0,0 +1,419 @@
+/**
+ * @file   create.c
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @brief  implementation of the create command (new MBR or GPT, batched commit
+ *         of all table sectors).
+ *
+ * [MIT license]
+ *
+ * Copyright (c) 2021 Ingo A. Kubbilun
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <part-y.h>
+
+static const uint8_t create_guid_msr[16] = GPT_TYPE_GUID(0xE3C9E316, 0x0B5C, 0x4DB8, 0x817D, 0xF92DF00215AE); ///< Microsoft reserved (no MBR type)
+
+typedef struct _create_type             create_type, * create_type_ptr;
+typedef struct _create_layout           create_layout, * create_layout_ptr;
+
+struct _create_type
+{
+  uint32_t                              type;                       ///< PARTITION_TYPE_xxx
+  uint8_t                               mbr_type;                   ///< MBR partition type (0x00 = GPT-only)
+  const char                           *name;                       ///< name as specified on the command line
+};
+
+struct _create_layout
+{
+  disk_ptr                              dp;                         ///< the working disk
+  bool                                  is_mbr;                     ///< true: MBR, false: GPT
+  bool                                  clear_gpt;                  ///< MBR replaces a GPT: clear both GPT copies
+  uint64_t                              first_usable_lba;           ///< first LBA available for partitions
+  uint64_t                              last_usable_lba;            ///< last LBA available for partitions
+  uint32_t                              num_parts;                  ///< number of partitions placed so far
+  uint64_t                              start_lba[128];             ///< placed partitions (same order as cap->part_defs)
+  uint64_t                              end_lba[128];
+};
+
+static const create_type create_types[] =
+{
+  { PARTITION_TYPE_FAT12, 0x01, "FAT12" },
+  { PARTITION_TYPE_FAT16, 0x0E, "FAT16" },
+  { PARTITION_TYPE_FAT32, 0x0C, "FAT32" },
+  { PARTITION_TYPE_EXFAT, 0x07, "exFAT" },
+  { PARTITION_TYPE_NTFS,  0x07, "NTFS" },
+  { PARTITION_TYPE_WINRE, 0x27, "WinRE" },
+  { PARTITION_TYPE_MSR,   0x00, "MSR" },
+  { PARTITION_TYPE_EXT2,  0x83, "EXT2" },
+  { PARTITION_TYPE_EXT3,  0x83, "EXT3" },
+  { PARTITION_TYPE_EXT4,  0x83, "EXT4" },
+  { PARTITION_TYPE_SWAP,  0x82, "SWAP" },
+  { PARTITION_TYPE_EFI,   0xEF, "EFI" }
+};
+
+static const create_type* create_find_type(uint32_t type)
+{
+  uint32_t            i;
+
+  for (i = 0; i < sizeof(create_types) / sizeof(create_types[0]); i++)
+  {
+    if (type == create_types[i].type)
+      return &create_types[i];
+  }
+
+  return NULL;
+}
+
+static bool create_map_add(disk_map_ptr* head, uint64_t start_lba, uint64_t end_lba, const char* description)
+{
+  disk_map_ptr        dmp = (disk_map_ptr)malloc(sizeof(disk_map));
+
+  if (unlikely(NULL == dmp))
+    return false;
+  memset(dmp, 0, sizeof(disk_map));
+
+  dmp->start_lba = start_lba;
+  dmp->end_lba = end_lba;
+  strncpy(dmp->description, description, sizeof(dmp->description) - 1);
+
+  dmp->next = *head;
+  if (NULL != *head)
+    (*head)->prev = dmp;
+  *head = dmp;
+
+  return true;
+}
+
+// the disk map of the new layout: the table areas plus all partitions placed so far
+
+static disk_map_ptr create_layout_map(create_layout_ptr clp)
+{
+  disk_map_ptr        head = NULL;
+  uint32_t            i;
+
+  if (!create_map_add(&head, 0, clp->first_usable_lba - 1, "partition table(s)"))
+    goto ErrorExit;
+
+  if (clp->last_usable_lba < clp->dp->device_sectors - 1)
+  {
+    if (!create_map_add(&head, clp->last_usable_lba + 1, clp->dp->device_sectors - 1, "backup GPT"))
+      goto ErrorExit;
+  }
+
+  for (i = 0; i < clp->num_parts; i++)
+  {
+    if (!create_map_add(&head, clp->start_lba[i], clp->end_lba[i], "new partition"))
+      goto ErrorExit;
+  }
+
+  return sort_and_complete_disk_map(head, clp->dp->device_sectors);
+
+ErrorExit:
+  free_disk_map(head);
+  return NULL;
+}
+
+static void create_dump_layout(cmdline_args_ptr cap, create_layout_ptr clp)
+{
+  uint32_t            i;
+  char                size_str[16];
+
+  fprintf(stdout, "  #      Start LBA                 End LBA         Size       Type   Label\n");
+  fprintf(stdout, "----------------------------------------------------------------------------------------\n");
+  for (i = 0; i < clp->num_parts; i++)
+  {
+    format_disk_size((clp->end_lba[i] - clp->start_lba[i] + 1) << SECTOR_SHIFT, size_str, sizeof(size_str));
+    fprintf(stdout, "%3u %20" FMT64 "u .. %20" FMT64 "u (%10s) %-6s '%s'\n", i + 1, clp->start_lba[i], clp->end_lba[i], size_str,
+      create_find_type(cap->part_defs[i].type)->name, cap->part_defs[i].label);
+  }
+}
+
+int create_partition_table(cmdline_args_ptr cap)
+{
+  disk_ptr            dp = cap->work_disk;
+  create_layout       cl;
+  const create_type  *ctp;
+  const gpt_type_info*gtip;
+  disk_map_ptr        dmp;
+  gpt_ptr             g = NULL;
+  gpt_entry_ptr       gep;
+  write_plan_ptr      wpp = NULL;
+  uint64_t            align_lbas, align_offset, num_lbas, lba_start, lba_count, attributes, tail_lba = 0;
+  uint32_t            i, head_sectors, tail_sectors = 0, disk_signature;
+  uint8_t            *buffer_mem = NULL, *head, *tail, guid[16];
+  char                size_str[16], error[256];
+  int                 exitcode = 1;
+
+  if (NULL == dp)
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": No working disk available.\n");
+    return 1;
+  }
+
+  if (SECTOR_SIZE != dp->logical_sector_size)
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": logical sector size %u is not supported.\n", dp->logical_sector_size);
+    return 1;
+  }
+
+  if (dp->device_sectors < (DISK_GPT_HEAD_SECTORS << 2))
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": the disk is too small for a partition table.\n");
+    return 1;
+  }
+
+  memset(&cl, 0, sizeof(cl));
+  cl.dp = dp;
+  cl.is_mbr = cap->part_type_mbr;
+  cl.clear_gpt = cl.is_mbr && (dp->primary_gpt_exists || dp->backup_gpt_exists);
+
+  if (cl.is_mbr && cap->num_part_defs > CREATE_MBR_MAX_PARTITIONS)
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": an MBR holds at most %u (primary) partitions.\n", CREATE_MBR_MAX_PARTITIONS);
+    return 1;
+  }
+
+  // the table areas: MBR, primary GPT (LBAs 0..33) and backup GPT (last 33 LBAs); an MBR replacing a GPT keeps the GPT areas free, too
+
+  if (cl.is_mbr && !cl.clear_gpt)
+  {
+    cl.first_usable_lba = 1;
+    cl.last_usable_lba = dp->device_sectors - 1;
+  }
+  else
+  {
+    cl.first_usable_lba = DISK_GPT_HEAD_SECTORS;
+    cl.last_usable_lba = dp->device_sectors - DISK_GPT_HEAD_SECTORS;
+  }
+
+  if (cl.is_mbr && cl.last_usable_lba >= CREATE_MBR_MAX_LBA)
+    cl.last_usable_lba = CREATE_MBR_MAX_LBA - 1;
+
+  // place all partitions (first-fit, aligned)
+
+  disk_partition_alignment(dp, &align_lbas, &align_offset);
+
+  for (i = 0; i < cap->num_part_defs; i++)
+  {
+    ctp = create_find_type(cap->part_defs[i].type);
+    if (NULL == ctp || (cl.is_mbr && 0x00 == ctp->mbr_type))
+    {
+      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": partition #%u: type %s cannot be created in an %s.\n", i + 1,
+        NULL == ctp ? "(unknown)" : ctp->name, cl.is_mbr ? "MBR" : "GPT");
+      return 1;
+    }
+
+    num_lbas = (((uint64_t)-1) == cap->part_defs[i].size) ? 0 : ((cap->part_defs[i].size + SECTOR_SIZE_MASK) >> SECTOR_SHIFT);
+
+    dmp = create_layout_map(&cl);
+    if (NULL == dmp)
+    {
+      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": Insufficient memory available (internal error).\n");
+      return 1;
+    }
+
+    if (!disk_map_allocate(dmp, DISK_PLACE_FIRST_FIT, num_lbas, align_lbas, align_offset, &lba_start, &lba_count))
+    {
+      free_disk_map(dmp);
+      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": partition #%u (%s) does not fit into the free space of the disk.\n", i + 1, ctp->name);
+      return 1;
+    }
+    free_disk_map(dmp);
+
+    cl.start_lba[i] = lba_start;
+    cl.end_lba[i] = lba_start + lba_count - 1;
+    cl.num_parts++;
+  }
+
+  format_disk_size(align_lbas << SECTOR_SHIFT, size_str, sizeof(size_str));
+  fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": new %s with %u partition(s), aligned to %s:\n\n", cl.is_mbr ? "MBR" : "GPT", cl.num_parts, size_str);
+  create_dump_layout(cap, &cl);
+  fprintf(stdout, "\n");
+
+  // build all table sectors in memory: the head region at LBA 0 and the tail region (backup GPT) at the end of the disk
+
+  buffer_mem = (uint8_t*)malloc(((DISK_GPT_HEAD_SECTORS << 1) << SECTOR_SHIFT) + SECTOR_MEM_ALIGN);
+  if (NULL == buffer_mem)
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": Insufficient memory available (internal error).\n");
+    return 1;
+  }
+  head = (uint8_t*)((((uint64_t)buffer_mem) + (SECTOR_MEM_ALIGN - 1)) & (~((uint64_t)(SECTOR_MEM_ALIGN - 1))));
+  tail = head + (DISK_GPT_HEAD_SECTORS << SECTOR_SHIFT);
+  memset(head, 0, (DISK_GPT_HEAD_SECTORS << 1) << SECTOR_SHIFT);
+
+  if (cl.is_mbr)
+  {
+    // keep the boot code of an existing (non-protective) MBR
+
+    if ((DISK_FLAG_HAS_MBR & dp->flags) && !(DISK_FLAG_MBR_IS_PROTECTIVE & dp->flags) && NULL != dp->mbr && NULL != dp->mbr->sp)
+      memcpy(head, dp->mbr->sp->data, 0x01B8);
+
+    if (!generate_guid(guid))
+    {
+      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": unable to generate a disk signature.\n");
+      goto ErrorExit;
+    }
+    disk_signature = READ_LITTLE_ENDIAN32(guid, 0);
+    WRITE_LITTLE_ENDIAN32(head, 0x01B8, disk_signature);
+    head[SECTOR_SIZE - 2] = 0x55;
+    head[SECTOR_SIZE - 1] = 0xAA;
+
+    for (i = 0; i < cl.num_parts; i++)
+      mbr_create_entry(&head[0x01BE + (i << 4)], (cap->part_defs[i].flags & GPT_ATTR_LEGACY_BIOS_BOOT) ? 0x80 : 0x00,
+        create_find_type(cap->part_defs[i].type)->mbr_type, cl.start_lba[i], cl.end_lba[i] - cl.start_lba[i] + 1);
+
+    // an MBR replacing a GPT also clears both GPT copies (zeros)
+
+    head_sectors = cl.clear_gpt ? DISK_GPT_HEAD_SECTORS : 1;
+    if (cl.clear_gpt)
+    {
+      tail_sectors = DISK_GPT_HEAD_SECTORS - 1;
+      tail_lba = dp->device_sectors - tail_sectors;
+    }
+  }
+  else
+  {
+    g = partition_new_gpt(GPT_DEFAULT_ENTRIES);
+    if (NULL == g)
+    {
+      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": Insufficient memory available (internal error).\n");
+      goto ErrorExit;
+    }
+
+    g->header.revision = 0x00010000;
+    g->header.header_size = 0x5C;
+    g->header.current_lba = 1;
+    g->header.backup_lba = dp->device_sectors - 1;
+    g->header.first_usable_lba = cl.first_usable_lba;
+    g->header.last_usable_lba = cl.last_usable_lba;
+    g->header.starting_lba_part_entries = 2; // primary GPT
+    g->header.number_of_part_entries = GPT_DEFAULT_ENTRIES;
+    g->header.size_of_part_entry = 128;
+
+    if (!generate_guid(g->header.disk_guid))
+    {
+      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": unable to generate the disk GUID.\n");
+      goto ErrorExit;
+    }
+
+    for (i = 0; i < cl.num_parts; i++)
+    {
+      ctp = create_find_type(cap->part_defs[i].type);
+
+      gep = gpt_add_entry(g, i);
+      if (NULL == gep)
+      {
+        fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": Insufficient memory available (internal error).\n");
+        goto ErrorExit;
+      }
+
+      attributes = 0;
+      if (PARTITION_TYPE_MSR == ctp->type)
+        memcpy(gep->type_guid, create_guid_msr, 16);
+      else
+        (void)gpt_get_guid_for_mbr_type(ctp->mbr_type, gep->type_guid, &attributes);
+
+      if (!generate_guid(gep->partition_guid))
+      {
+        fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": unable to generate a partition GUID.\n");
+        goto ErrorExit;
+      }
+
+      gep->part_start_lba = cl.start_lba[i];
+      gep->part_end_lba = cl.end_lba[i];
+      gep->attributes = attributes | cap->part_defs[i].flags;
+
+      // the type description is the default name of the partition
+
+      gtip = gpt_lookup_type(gep->type_guid);
+      setGPTPartitionName(gep->part_name, 0 != cap->part_defs[i].label[0] ? cap->part_defs[i].label : (NULL != gtip ? gtip->gpt_description : ""));
+    }
+
+    create_protective_mbr(dp->device_sectors, head);
+    gpt_create_table(head + SECTOR_SIZE, g, true /*primary*/);
+    tail_lba = gpt_repair_table(tail, g, true /*primary is the template of the backup*/) >> SECTOR_SHIFT;
+
+    head_sectors = 1 + 1 + GPT_ENTRY_ARRAY_SECTORS(g->header);
+    tail_sectors = 1 + GPT_ENTRY_ARRAY_SECTORS(g->header);
+  }
+
+  // the backup GPT goes first, the (protective) MBR and the primary GPT only after it is durable
+
+  wpp = write_plan_create();
+  if (NULL == wpp ||
+      (0 != tail_sectors && !write_plan_add(wpp, tail_lba, tail_sectors, tail, cl.is_mbr ? "clearing the backup GPT" : "backup GPT")))
+  {
+    fprintf(stdout, CTRL_RED "ERROR" CTRL_RESET ": insufficient memory available.\n");
+    goto ErrorExit;
+  }
+  write_plan_barrier(wpp);
+  if (!write_plan_add(wpp, 0, head_sectors, head, cl.is_mbr ? (cl.clear_gpt ? "MBR, clearing the primary GPT" : "MBR") : "protective MBR and primary GPT"))
+  {
+    fprintf(stdout, CTRL_RED "ERROR" CTRL_RESET ": insufficient memory available.\n");
+    goto ErrorExit;
+  }
+
+  if (cap->dryrun)
+  {
+    fprintf(stdout, CTRL_MAGENTA "DRYRUN" CTRL_RESET ": Explaining what would be done.\n");
+    write_plan_dump(wpp);
+    exitcode = 0;
+    goto ErrorExit;
+  }
+
+  if ((DISK_FLAG_HAS_MBR | DISK_FLAG_HAS_GPT) & dp->flags)
+    fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": the existing partition table(s) of %s are replaced.\n", dp->device_file);
+
+  fprintf(stdout, CTRL_CYAN "WORKING" CTRL_RESET " : Writing the new partition table ..........................: ");
+  fflush(stdout);
+
+  // a new (empty) image file gets its size (--file-size) first
+
+  if ((DISK_FLAG_NOT_DEVICE_BUT_FILE & dp->flags) && dp->device_size != (dp->device_sectors << SECTOR_SHIFT))
+  {
+    if (!disk_resize_image(dp->device_file, dp->device_sectors << SECTOR_SHIFT, cap->preallocate))
+    {
+      fprintf(stdout, CTRL_RED "ERROR" CTRL_RESET "\n          Unable to resize the image file %s.\n", dp->device_file);
+      goto ErrorExit;
+    }
+    dp->device_size = dp->device_sectors << SECTOR_SHIFT;
+  }
+
+  if (!write_plan_execute(wpp, dp->device_file, error, sizeof(error)))
+  {
+    fprintf(stdout, CTRL_RED "ERROR" CTRL_RESET "\n          %s.\n", error);
+    goto ErrorExit;
+  }
+
+  fprintf(stdout, CTRL_GREEN "OK" CTRL_RESET "\n");
+  exitcode = 0;
+
+ErrorExit:
+  if (NULL != wpp)
+    write_plan_free(wpp);
+  if (NULL != g)
+    partition_free_gpt(g);
+  if (NULL != buffer_mem)
+    free(buffer_mem);
+
+  return exitcode;
+}
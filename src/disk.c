@@ -40,7 +40,6 @@ static void enumAllPhysicaldrives(disk_ptr *head, disk_ptr *tail, uint32_t *tota
   uint32_t                i, numDrives;
   char                    szKey[16], szValue[512], * p, * p2, * p3;
   disk_ptr                item;
-  DISK_HANDLE             h;
 
   if (NULL == total)
     return;
@@ -109,40 +108,6 @@ ErrorExit:
     item->logical_sector_size = SECTOR_SIZE;
     item->physical_sector_size = SECTOR_SIZE;
 
-    h = disk_open_device(item->device_file, false/*read-only*/);
-    if (INVALID_DISK_HANDLE == h)
-    {
-      item->flags |= DISK_FLAG_READ_ACCESS_ERROR;
-    }
-    else
-    {
-      DWORD             length_needed = 32768, check_size;
-      uint8_t          *drive_layout = (uint8_t*)malloc(length_needed);
-      
-      item->device_sectors = disk_get_size(item->device_file, h, &item->logical_sector_size, &item->physical_sector_size);
-      item->device_size = item->device_sectors << SECTOR_SHIFT;
-
-      if (NULL != drive_layout)
-      {
-        if (DeviceIoControl(h, IOCTL_DISK_GET_DRIVE_LAYOUT_EX, NULL, 0, drive_layout, length_needed, &length_needed, (LPOVERLAPPED)NULL))
-        {
-          PDRIVE_LAYOUT_INFORMATION_EX dlix = (PDRIVE_LAYOUT_INFORMATION_EX)drive_layout;
-
-          check_size = sizeof(DRIVE_LAYOUT_INFORMATION_EX) + (dlix->PartitionCount - 1) * sizeof(PARTITION_INFORMATION_EX);
-
-          if (check_size == length_needed)
-          {
-            item->win_drive_layout = (PDRIVE_LAYOUT_INFORMATION_EX)malloc(length_needed);
-            if (NULL != item->win_drive_layout)
-              memcpy(item->win_drive_layout, drive_layout, length_needed);
-          }
-        }
-        free(drive_layout);
-      }
-
-      disk_close_device(h);
-    }
-
     item->prev = *tail;
     if (NULL == *tail)
       *head = item;
@@ -157,17 +122,87 @@ ErrorExit:
   RegCloseKey(hKey);
 }
 
+static void probePhysicalDrive(disk_ptr item)
+{
+  DISK_HANDLE             h;
+
+  item->flags |= DISK_FLAG_PROBED;
+
+  h = disk_open_device(item->device_file, false/*read-only*/);
+  if (INVALID_DISK_HANDLE == h)
+  {
+    item->flags |= DISK_FLAG_READ_ACCESS_ERROR;
+  }
+  else
+  {
+    DWORD             length_needed = 32768, check_size;
+    uint8_t          *drive_layout = (uint8_t*)malloc(length_needed);
+      
+    if (!disk_get_geometry(item, h))
+      item->flags |= DISK_FLAG_READ_ACCESS_ERROR;
+
+    if (NULL != drive_layout)
+    {
+      if (DeviceIoControl(h, IOCTL_DISK_GET_DRIVE_LAYOUT_EX, NULL, 0, drive_layout, length_needed, &length_needed, (LPOVERLAPPED)NULL))
+      {
+        PDRIVE_LAYOUT_INFORMATION_EX dlix = (PDRIVE_LAYOUT_INFORMATION_EX)drive_layout;
+
+        check_size = sizeof(DRIVE_LAYOUT_INFORMATION_EX) + (dlix->PartitionCount - 1) * sizeof(PARTITION_INFORMATION_EX);
+
+        if (check_size == length_needed)
+        {
+          item->win_drive_layout = (PDRIVE_LAYOUT_INFORMATION_EX)malloc(length_needed);
+          if (NULL != item->win_drive_layout)
+            memcpy(item->win_drive_layout, drive_layout, length_needed);
+        }
+      }
+      free(drive_layout);
+    }
+
+    disk_close_device(h);
+  }
+}
+
 #else // LINUX
 
 static const char linux_disk_prefixes[][8] = { "hd", "sd", "nvm" };
 
+static uint64_t readSysfsValue(const char* name, const char* attribute)
+{
+  char                      sys_file[256];
+  FILE                     *f;
+  uint64_t                  value;
+
+  snprintf(sys_file, sizeof(sys_file), "/sys/block/%s/%s", name, attribute);
+  f = fopen(sys_file, "rt");
+  if (NULL == f)
+    return 0;
+
+  memset(sys_file, 0, sizeof(sys_file));
+  (void)fread(sys_file, 1, sizeof(sys_file) - 1, f);
+  fclose(f);
+
+  value = (uint64_t)strtoull(sys_file, NULL, 10);
+
+  return value;
+}
+
+static int compareDeviceNames(const char* a, const char* b)
+{
+  size_t                    la = strlen(a), lb = strlen(b);
+
+  if (la != lb)
+    return la < lb ? -1 : 1;
+
+  return strcmp(a, b);
+}
+
 static void enumAllPhysicaldrives(disk_ptr* head, disk_ptr* tail, uint32_t* total)
 {
   DIR                      *dir;
   struct dirent            *ent;
   size_t                    i, l, el;
-  disk_ptr                  item;
-  DISK_HANDLE               h;
+  disk_ptr                  item, pos;
 
   if (NULL == total)
     return;
@@ -203,27 +238,42 @@ static void enumAllPhysicaldrives(disk_ptr* head, disk_ptr* tail, uint32_t* tota
 
           snprintf(item->device_file, sizeof(item->device_file), "/dev/%s", ent->d_name);
 
-          item->logical_sector_size = SECTOR_SIZE;
-          item->physical_sector_size = SECTOR_SIZE;
-
-          h = disk_open_device(item->device_file, false/*read-only*/);
-          if (INVALID_DISK_HANDLE == h)
-          {
-            item->flags |= DISK_FLAG_READ_ACCESS_ERROR;
-          }
-          else
-          {
-            item->device_sectors = disk_get_size(item->device_file, h, &item->logical_sector_size, &item->physical_sector_size);
-            item->device_size = item->device_sectors << SECTOR_SHIFT;
-            disk_close_device(h);
-          }
-
-          item->prev = *tail;
-          if (NULL == *tail)
+          // the sysfs metadata is sufficient, the device is not opened (see probePhysicalDrive)
+
+          item->device_sectors = readSysfsValue(ent->d_name, "size"); // always in units of 512 bytes
+          item->device_size = item->device_sectors << SECTOR_SHIFT;
+          item->logical_sector_size = (uint32_t)readSysfsValue(ent->d_name, "queue/logical_block_size");
+          item->physical_sector_size = (uint32_t)readSysfsValue(ent->d_name, "queue/physical_block_size");
+          if (0 == item->logical_sector_size)
+            item->logical_sector_size = SECTOR_SIZE;
+          if (0 == item->physical_sector_size)
+            item->physical_sector_size = SECTOR_SIZE;
+          item->min_io_size = (uint32_t)readSysfsValue(ent->d_name, "queue/minimum_io_size");
+          item->opt_io_size = (uint32_t)readSysfsValue(ent->d_name, "queue/optimal_io_size");
+          item->max_transfer_size = (uint32_t)(readSysfsValue(ent->d_name, "queue/max_sectors_kb") << 10);
+          item->alignment_offset = (uint32_t)readSysfsValue(ent->d_name, "alignment_offset");
+          if (0 != readSysfsValue(ent->d_name, "queue/rotational"))
+            item->flags |= DISK_FLAG_ROTATIONAL;
+          if (0 != readSysfsValue(ent->d_name, "queue/discard_max_bytes"))
+            item->flags |= DISK_FLAG_DISCARD;
+          item->flags |= DISK_FLAG_PROBED;
+
+          // readdir() order is arbitrary: keep the list sorted (sda, sdb, ..., sdz, sdaa, ...)
+
+          pos = *head;
+          while (NULL != pos && compareDeviceNames(pos->device_file, item->device_file) < 0)
+            pos = pos->next;
+
+          item->next = pos;
+          item->prev = NULL == pos ? *tail : pos->prev;
+          if (NULL == item->prev)
             *head = item;
           else
-            (*tail)->next = item;
-          *tail = item;
+            item->prev->next = item;
+          if (NULL == pos)
+            *tail = item;
+          else
+            pos->prev = item;
 
           (*total)++;
 
@@ -235,8 +285,205 @@ static void enumAllPhysicaldrives(disk_ptr* head, disk_ptr* tail, uint32_t* tota
   closedir(dir);
 }
 
+static void probePhysicalDrive(disk_ptr item)
+{
+  DISK_HANDLE               h;
+
+  item->flags |= DISK_FLAG_PROBED;
+
+  h = disk_open_device(item->device_file, false/*read-only*/);
+  if (INVALID_DISK_HANDLE == h)
+  {
+    item->flags |= DISK_FLAG_READ_ACCESS_ERROR;
+  }
+  else
+  {
+    if (!disk_get_geometry(item, h))
+      item->flags |= DISK_FLAG_READ_ACCESS_ERROR;
+    disk_close_device(h);
+  }
+}
+
 #endif // !_WINDOWS
 
+static void probeImageFile(disk_ptr item)
+{
+  DISK_HANDLE               h;
+
+  item->flags |= DISK_FLAG_PROBED;
+
+  h = disk_open_device(item->device_file, false/*read-only*/);
+  if (INVALID_DISK_HANDLE == h)
+  {
+    item->flags |= DISK_FLAG_READ_ACCESS_ERROR;
+    return;
+  }
+
+  (void)disk_get_geometry(item, h);
+  item->allocated_size = disk_get_allocated_size(h);
+  if (item->allocated_size < item->device_size)
+    item->flags |= DISK_FLAG_SPARSE_FILE;
+
+  disk_close_device(h);
+}
+
+typedef struct _probe_slot              probe_slot, * probe_slot_ptr;
+
+struct _probe_slot
+{
+  disk                                  dp;                         ///< private copy of the disk (a blocked worker never touches the list)
+  bool                                  scan;                       ///< also scan the partition tables
+  volatile uint64_t                     start_usec;                 ///< set by the worker when the probing starts (0 = still queued)
+  volatile uint64_t                     done;                       ///< set by the worker when the probing is complete
+  volatile uint64_t                     timed_out;                  ///< set by the caller if the deadline has been missed
+};
+
+static void probeTask(void* arg)
+{
+  probe_slot_ptr            ps = (probe_slot_ptr)arg;
+
+  (void)atomic_add64(&ps->start_usec, get_time_usec() | 1);
+
+  // each task only touches its own copy of the disk structure, so no locking is required
+
+  if (!(DISK_FLAG_PROBED & ps->dp.flags))
+  {
+    if (DISK_FLAG_NOT_DEVICE_BUT_FILE & ps->dp.flags)
+      probeImageFile(&ps->dp);
+    else
+      probePhysicalDrive(&ps->dp);
+  }
+
+  if (ps->scan && !(DISK_FLAG_READ_ACCESS_ERROR & ps->dp.flags) && 0 == atomic_load64(&ps->timed_out))
+    (void)disk_ensure_scanned(&ps->dp);
+
+  (void)atomic_add64(&ps->done, 1);
+}
+
+static void probeTakeResult(disk_ptr dp, probe_slot_ptr ps)
+{
+  disk_ptr                  next = dp->next, prev = dp->prev;
+  mbr_part_sector_ptr       mps;
+  sector_ptr                sp;
+
+  memcpy(dp, &ps->dp, sizeof(disk));
+  dp->next = next;
+  dp->prev = prev;
+
+  // the sectors read by the scan point back to the copy
+
+  for (mps = dp->mbr; NULL != mps; mps = mps->next)
+    for (sp = mps->sp; NULL != sp; sp = sp->next)
+      sp->dp = dp;
+
+  if (NULL != dp->gpt1)
+  {
+    if (NULL != dp->gpt1->header.sp)
+      dp->gpt1->header.sp->dp = dp;
+  }
+
+  if (NULL != dp->gpt2)
+  {
+    if (NULL != dp->gpt2->header.sp)
+      dp->gpt2->header.sp->dp = dp;
+  }
+}
+
+static bool probeDisks(disk_ptr* disks, uint32_t num_disks, bool scan, uint32_t timeout_ms)
+{
+  probe_slot_ptr            slots;
+  workpool_ptr              wp;
+  uint32_t                  i, num_workers, remaining;
+  uint64_t                  start_usec, now_usec, started_usec, timeout_usec = ((uint64_t)timeout_ms) * 1000, bound_usec;
+  bool                      *finished, abandon = false, ok = true;
+
+  slots = (probe_slot_ptr)malloc(num_disks * (sizeof(probe_slot) + sizeof(bool)));
+  if (unlikely(NULL == slots))
+    return false;
+
+  memset(slots, 0, num_disks * (sizeof(probe_slot) + sizeof(bool)));
+  finished = (bool*)(slots + num_disks);
+
+  for (i = 0; i < num_disks; i++)
+  {
+    memcpy(&slots[i].dp, disks[i], sizeof(disk));
+    slots[i].scan = scan;
+  }
+
+  // slow or half-dead devices do not block the others
+
+  num_workers = num_disks < DISK_EXPLORE_MAX_WORKERS ? num_disks : DISK_EXPLORE_MAX_WORKERS;
+  wp = workpool_create(num_workers, 0);
+
+  for (i = 0; i < num_disks; i++)
+  {
+    if (NULL == wp || !workpool_submit(wp, WORKPOOL_NO_KEY, probeTask, &slots[i]))
+      probeTask(&slots[i]); // no deadline
+  }
+
+  // a disk has to be completed within the timeout after its probing has started; queued disks
+  // wait for a free worker, so they are given up after as many timeouts as there are rounds
+
+  start_usec = get_time_usec();
+  bound_usec = timeout_usec * ((num_disks + num_workers - 1) / num_workers);
+
+  do
+  {
+    (void)workpool_wait(wp, DISK_PROBE_POLL_MS);
+
+    now_usec = get_time_usec();
+    remaining = 0;
+
+    for (i = 0; i < num_disks; i++)
+    {
+      if (finished[i])
+        continue;
+
+      if (0 != atomic_load64(&slots[i].done))
+      {
+        probeTakeResult(disks[i], &slots[i]);
+        finished[i] = true;
+        continue;
+      }
+
+      started_usec = atomic_load64(&slots[i].start_usec);
+
+      if (0 != timeout_ms && ((0 != started_usec && (now_usec - started_usec) >= timeout_usec) ||
+                              (0 == started_usec && (now_usec - start_usec) >= bound_usec)))
+      {
+        (void)atomic_add64(&slots[i].timed_out, 1);
+        disks[i]->flags |= DISK_FLAG_PROBED | DISK_FLAG_READ_ACCESS_ERROR;
+        finished[i] = true;
+        abandon = true;
+        continue;
+      }
+
+      remaining++;
+    }
+  }
+  while (0 != remaining);
+
+  for (i = 0; i < num_disks; i++)
+  {
+    if (DISK_FLAG_READ_ACCESS_ERROR & disks[i]->flags)
+      ok = false;
+  }
+
+  if (abandon)
+  {
+    // blocked workers still use their slots, so the slots are left to them (never freed)
+
+    workpool_abandon(wp);
+  }
+  else
+  {
+    workpool_destroy(wp);
+    free(slots);
+  }
+
+  return ok;
+}
+
 void disk_dump_info(disk_ptr dp)
 {
   char                size_str[32], size_str2[32];
@@ -251,7 +498,20 @@ void disk_dump_info(disk_ptr dp)
   format_disk_size(dp->device_size, size_str, sizeof(size_str));
   format_64bit(dp->device_sectors, size_str2, sizeof(size_str2));
   fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": device size is %s (%s sectors)\n", size_str, size_str2);
+  if (dp->flags & DISK_FLAG_SPARSE_FILE)
+  {
+    format_disk_size(dp->allocated_size, size_str, sizeof(size_str));
+    fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": image file is sparse, %s allocated\n", size_str);
+  }
   fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": physical sector size is %u, logical sector size is %u\n", dp->physical_sector_size, dp->logical_sector_size);
+  if (!(dp->flags & DISK_FLAG_NOT_DEVICE_BUT_FILE))
+  {
+    format_disk_size(dp->max_transfer_size, size_str, sizeof(size_str));
+    fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": minimum I/O size is %u, optimal I/O size is %u, max. transfer size is %s, alignment offset is %u\n",
+      dp->min_io_size, dp->opt_io_size, size_str, dp->alignment_offset);
+    fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": rotational: %s; discard: %s\n",
+      dp->flags & DISK_FLAG_ROTATIONAL ? "yes" : "no", dp->flags & DISK_FLAG_DISCARD ? "yes" : "no");
+  }
   fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": MBR partition table: %s; GUID partition table: %s\n", 
     dp->flags & DISK_FLAG_HAS_MBR ? CTRL_GREEN "yes" CTRL_RESET : CTRL_RED "no" CTRL_RESET, 
     dp->flags & DISK_FLAG_HAS_GPT ? CTRL_GREEN "yes" CTRL_RESET : CTRL_RED "no" CTRL_RESET);
@@ -295,7 +555,6 @@ void disk_dump_info(disk_ptr dp)
 uint32_t disk_explore_all(disk_ptr* head, disk_ptr* tail)
 {
   uint32_t                  total_disks;
-  disk_ptr                  item;
 
   if (unlikely(NULL == head || NULL == tail))
     return 0;
@@ -303,19 +562,118 @@ uint32_t disk_explore_all(disk_ptr* head, disk_ptr* tail)
   *head = NULL;
   *tail = NULL;
 
+  // the enumeration is cheap and fixes the order of the list; opening the devices and scanning
+  // their partition tables is deferred (see disk_probe_all, disk_ensure_scanned)
+
   enumAllPhysicaldrives(head, tail, &total_disks);
 
-  if (0 == total_disks)
-    return 0;
+  return total_disks;
+}
 
-  item = *head;
-  while (NULL != item)
+void disk_probe_all(disk_ptr head, bool scan, uint32_t timeout_ms)
+{
+  uint32_t                  num_disks = 0, i;
+  disk_ptr                  item;
+  disk_ptr                 *disks;
+
+  for (item = head; NULL != item; item = item->next)
+    num_disks++;
+
+  if (0 == num_disks)
+    return;
+
+  disks = (disk_ptr*)malloc(num_disks * sizeof(disk_ptr));
+  if (unlikely(NULL == disks))
+    return;
+
+  for (item = head, i = 0; NULL != item; item = item->next)
+    disks[i++] = item;
+
+  (void)probeDisks(disks, num_disks, scan, timeout_ms);
+
+  free(disks);
+}
+
+bool disk_probe(disk_ptr dp, bool scan, uint32_t timeout_ms)
+{
+  return probeDisks(&dp, 1, scan, timeout_ms);
+}
+
+uint32_t disk_io_size(disk_ptr dp, uint32_t preferred, uint32_t default_size)
+{
+  uint32_t                  granularity, size;
+
+  if (0 != preferred)
+    return preferred;
+
+  // the optimal I/O size (e.g. full RAID stripes) is a multiple of the minimum I/O size
+
+  granularity = dp->opt_io_size;
+  if (0 == granularity || 0 != (granularity & SECTOR_SIZE_MASK))
   {
-    disk_scan_partitions(item);
-    item = item->next;
+    granularity = dp->min_io_size > dp->physical_sector_size ? dp->min_io_size : dp->physical_sector_size;
+    if (granularity < SECTOR_SIZE || 0 != (granularity & SECTOR_SIZE_MASK))
+      granularity = SECTOR_SIZE;
   }
 
-  return total_disks;
+  if (default_size <= granularity)
+    return granularity;
+
+  size = default_size - (default_size % granularity);
+
+  return size;
+}
+
+void disk_partition_alignment(disk_ptr dp, uint64_t* align_lbas, uint64_t* align_offset)
+{
+  uint64_t                  align = DISK_PARTITION_ALIGNMENT, a, b, t;
+  uint32_t                  pss = dp->physical_sector_size >= SECTOR_SIZE ? dp->physical_sector_size : SECTOR_SIZE;
+
+  // the boundary has to be a multiple of the optimal I/O size (e.g. a RAID stripe), too;
+  // devices report odd values here (e.g. the max. transfer size), these are ignored
+
+  if (0 != dp->opt_io_size && 0 == (dp->opt_io_size % pss) && dp->opt_io_size <= DISK_MAX_PARTITION_ALIGNMENT)
+  {
+    a = align;
+    b = dp->opt_io_size;
+    while (0 != b)
+    {
+      t = a % b;
+      a = b;
+      b = t;
+    }
+    align = (align / a) * dp->opt_io_size;
+    if (align > DISK_MAX_PARTITION_ALIGNMENT)
+      align = DISK_PARTITION_ALIGNMENT;
+  }
+
+  *align_lbas = align >> SECTOR_SHIFT;
+  *align_offset = (0 == (dp->alignment_offset & SECTOR_SIZE_MASK)) ? (dp->alignment_offset >> SECTOR_SHIFT) % *align_lbas : 0;
+}
+
+uint64_t disk_align_lba(uint64_t lba, uint64_t align_lbas, uint64_t align_offset, bool round_up)
+{
+  uint64_t                  rem;
+
+  if (align_lbas <= 1)
+    return lba;
+
+  if (lba < align_offset)
+    return round_up ? align_offset : lba;
+
+  rem = (lba - align_offset) % align_lbas;
+  if (0 == rem)
+    return lba;
+
+  return round_up ? lba + (align_lbas - rem) : lba - rem;
+}
+
+bool disk_ensure_scanned(disk_ptr dp)
+{
+  if (DISK_FLAG_SCANNED & dp->flags)
+    return true;
+
+  return disk_scan_partitions(dp);
 }
 
 void disk_free_list(disk_ptr head)
@@ -335,6 +693,8 @@ void disk_free_list(disk_ptr head)
       free_disk_map(head->mbr_dmp);
     if (NULL != head->gpt_dmp)
       free_disk_map(head->gpt_dmp);
+    if (NULL != head->scan_record)
+      scan_cache_free_entry(head->scan_record);
 #ifdef _WINDOWS
     if (NULL != head->win_drive_layout)
       free(head->win_drive_layout);
@@ -346,6 +706,50 @@ void disk_free_list(disk_ptr head)
   }
 }
 
+// per-process device handle pool: idle handles are reused by disk_open_device, written handles
+// are flushed when they are released
+
+typedef struct _pooled_handle           pooled_handle, * pooled_handle_ptr;
+
+struct _pooled_handle
+{
+  char                                  device_file[256];           ///< device or image file
+  DISK_HANDLE                           h;                          ///< the opened handle
+  bool                                  write_access;               ///< opened read-write
+  bool                                  in_use;                     ///< handed out by disk_open_device (not idle)
+  bool                                  written;                    ///< data has been written since the handle was handed out
+};
+
+static pooled_handle                    disk_pool[DISK_POOL_MAX_HANDLES];
+static uint32_t                         disk_pool_num = 0;
+static disk_pool_stats                  disk_pool_counters;
+
+#ifdef _WINDOWS
+static SRWLOCK                          disk_pool_lock = SRWLOCK_INIT;
+#define disk_pool_lock_acquire()        AcquireSRWLockExclusive(&disk_pool_lock)
+#define disk_pool_lock_release()        ReleaseSRWLockExclusive(&disk_pool_lock)
+#else
+static pthread_mutex_t                  disk_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+#define disk_pool_lock_acquire()        pthread_mutex_lock(&disk_pool_lock)
+#define disk_pool_lock_release()        pthread_mutex_unlock(&disk_pool_lock)
+#endif
+
+static void diskPoolMarkWritten(DISK_HANDLE h)
+{
+  uint32_t            i;
+
+  disk_pool_lock_acquire();
+  for (i = 0; i < disk_pool_num; i++)
+  {
+    if (disk_pool[i].in_use && disk_pool[i].h == h)
+    {
+      disk_pool[i].written = true;
+      break;
+    }
+  }
+  disk_pool_lock_release();
+}
+
 #ifdef _WINDOWS
 
 #define O_RDONLY     _O_RDONLY
@@ -363,16 +767,25 @@ void disk_free_list(disk_ptr head)
 #define O_SEQUENTIAL _O_SEQUENTIAL
 #define O_RANDOM     _O_RANDOM
 
-DISK_HANDLE disk_open_device(const char* device_file, bool writeAccess )
+static DISK_HANDLE diskOpenHandle(const char* device_file, bool writeAccess )
 {
   return writeAccess ? CreateFileA(device_file, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_WRITE_THROUGH | FILE_FLAG_NO_BUFFERING, NULL) :
                        CreateFileA(device_file, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING, NULL);
 }
 
-void disk_close_device(DISK_HANDLE h)
+static DISK_HANDLE diskOpenBatchedHandle(const char* device_file)
 {
-  if (INVALID_DISK_HANDLE != h)
-    CloseHandle(h);
+  return CreateFileA(device_file, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING, NULL);
+}
+
+static void diskFlushHandle(DISK_HANDLE h)
+{
+  (void)FlushFileBuffers(h);
+}
+
+static void diskCloseHandle(DISK_HANDLE h)
+{
+  CloseHandle(h);
 }
 
 uint64_t disk_get_size(const char* device_file, DISK_HANDLE h, uint32_t* logical_sector_size, uint32_t* physical_sector_size)
@@ -413,15 +826,73 @@ uint64_t disk_get_size(const char* device_file, DISK_HANDLE h, uint32_t* logical
   return (0 != (res & SECTOR_SIZE_MASK)) ? 0 : (res >> SECTOR_SHIFT);
 }
 
-bool disk_read(disk_ptr dp, DISK_HANDLE h, uint64_t fp, uint8_t* buffer, uint32_t size)
+bool disk_get_geometry(disk_ptr dp, DISK_HANDLE h)
 {
-  DWORD               read = 0;
-  LARGE_INTEGER       distToMove, newFp;
-
-  if (DISK_FLAG_READ_ACCESS_ERROR & dp->flags)
-    return false;
+  STORAGE_PROPERTY_QUERY              storageQuery;
+  STORAGE_ACCESS_ALIGNMENT_DESCRIPTOR diskAlignment;
+  STORAGE_ADAPTER_DESCRIPTOR          adapter;
+  DEVICE_SEEK_PENALTY_DESCRIPTOR      seekPenalty;
+  DEVICE_TRIM_DESCRIPTOR              trim;
+  DWORD                               outsize;
 
-  if ((0 != (size & 511)) || (0 != (fp & 511)) || (INVALID_DISK_HANDLE == h) || (NULL == buffer) || (0 == size))
+  if (DISK_FLAG_NOT_DEVICE_BUT_FILE & dp->flags) // image file; simulation of sectors sizes (logical, physical) is (512,512)
+  {
+    dp->device_size = disk_getFileSize(h);
+    dp->device_sectors = dp->device_size >> SECTOR_SHIFT;
+    dp->logical_sector_size = dp->physical_sector_size = SECTOR_SIZE;
+    dp->min_io_size = SECTOR_SIZE;
+    dp->opt_io_size = 0;
+    dp->max_transfer_size = 0;
+    dp->alignment_offset = 0;
+    return true;
+  }
+
+  dp->device_sectors = disk_get_size(dp->device_file, h, &dp->logical_sector_size, &dp->physical_sector_size);
+  if (0 == dp->device_sectors)
+    return false;
+  dp->device_size = dp->device_sectors << SECTOR_SHIFT;
+
+  dp->min_io_size = dp->physical_sector_size;
+  dp->opt_io_size = 0; // not reported by Windows
+  dp->max_transfer_size = 0;
+  dp->alignment_offset = 0;
+  dp->flags &= ~(DISK_FLAG_ROTATIONAL | DISK_FLAG_DISCARD);
+
+  memset(&storageQuery, 0, sizeof(STORAGE_PROPERTY_QUERY));
+  storageQuery.QueryType = PropertyStandardQuery;
+
+  storageQuery.PropertyId = StorageAccessAlignmentProperty;
+  memset(&diskAlignment, 0, sizeof(diskAlignment));
+  if (DeviceIoControl(h, IOCTL_STORAGE_QUERY_PROPERTY, &storageQuery, sizeof(STORAGE_PROPERTY_QUERY), &diskAlignment, sizeof(diskAlignment), &outsize, NULL))
+    dp->alignment_offset = (uint32_t)diskAlignment.BytesOffsetForSectorAlignment;
+
+  storageQuery.PropertyId = StorageAdapterProperty;
+  memset(&adapter, 0, sizeof(adapter));
+  if (DeviceIoControl(h, IOCTL_STORAGE_QUERY_PROPERTY, &storageQuery, sizeof(STORAGE_PROPERTY_QUERY), &adapter, sizeof(adapter), &outsize, NULL))
+    dp->max_transfer_size = (uint32_t)adapter.MaximumTransferLength;
+
+  storageQuery.PropertyId = StorageDeviceSeekPenaltyProperty;
+  memset(&seekPenalty, 0, sizeof(seekPenalty));
+  if (DeviceIoControl(h, IOCTL_STORAGE_QUERY_PROPERTY, &storageQuery, sizeof(STORAGE_PROPERTY_QUERY), &seekPenalty, sizeof(seekPenalty), &outsize, NULL) && seekPenalty.IncursSeekPenalty)
+    dp->flags |= DISK_FLAG_ROTATIONAL;
+
+  storageQuery.PropertyId = StorageDeviceTrimProperty;
+  memset(&trim, 0, sizeof(trim));
+  if (DeviceIoControl(h, IOCTL_STORAGE_QUERY_PROPERTY, &storageQuery, sizeof(STORAGE_PROPERTY_QUERY), &trim, sizeof(trim), &outsize, NULL) && trim.TrimEnabled)
+    dp->flags |= DISK_FLAG_DISCARD;
+
+  return true;
+}
+
+bool disk_read(disk_ptr dp, DISK_HANDLE h, uint64_t fp, uint8_t* buffer, uint32_t size)
+{
+  DWORD               read = 0;
+  LARGE_INTEGER       distToMove, newFp;
+
+  if (DISK_FLAG_READ_ACCESS_ERROR & dp->flags)
+    return false;
+
+  if ((0 != (size & 511)) || (0 != (fp & 511)) || (INVALID_DISK_HANDLE == h) || (NULL == buffer) || (0 == size))
     return false;
 
   distToMove.QuadPart = fp;
@@ -456,6 +927,8 @@ bool disk_write(disk_ptr dp, DISK_HANDLE h, uint64_t fp, const uint8_t * buffer,
   if ((0 != (size & 511)) || (0 != (fp & 511)) || (INVALID_DISK_HANDLE == h) || (NULL == buffer) || (0 == size))
     return false;
 
+  diskPoolMarkWritten(h); // flushed by disk_close_device
+
   distToMove.QuadPart = fp;
   if (!SetFilePointerEx(h, distToMove, &newFp, FILE_BEGIN))
   {
@@ -477,6 +950,107 @@ bool disk_write(disk_ptr dp, DISK_HANDLE h, uint64_t fp, const uint8_t * buffer,
   return true;
 }
 
+bool disk_read_at(DISK_HANDLE h, uint64_t fp, uint8_t* buffer, uint32_t size)
+{
+  DWORD               read = 0;
+  OVERLAPPED          ov;
+
+  if ((0 != (size & 511)) || (0 != (fp & 511)) || (INVALID_DISK_HANDLE == h) || (NULL == buffer) || (0 == size))
+    return false;
+
+  memset(&ov, 0, sizeof(ov));
+  ov.Offset = (DWORD)fp;
+  ov.OffsetHigh = (DWORD)(fp >> 32);
+
+  return (ReadFile(h, (LPVOID)buffer, size, &read, &ov) && (size == read)) ? true : false;
+}
+
+bool disk_write_at(DISK_HANDLE h, uint64_t fp, const uint8_t* buffer, uint32_t size)
+{
+  DWORD               written = 0;
+  OVERLAPPED          ov;
+
+  if ((0 != (size & 511)) || (0 != (fp & 511)) || (INVALID_DISK_HANDLE == h) || (NULL == buffer) || (0 == size))
+    return false;
+
+  diskPoolMarkWritten(h); // flushed by disk_close_device
+
+  memset(&ov, 0, sizeof(ov));
+  ov.Offset = (DWORD)fp;
+  ov.OffsetHigh = (DWORD)(fp >> 32);
+
+  return (WriteFile(h, (LPCVOID)buffer, size, &written, &ov) && (size == written)) ? true : false;
+}
+
+bool disk_write_vector_at(DISK_HANDLE h, uint64_t fp, const disk_io_vector* iov, uint32_t num_iov)
+{
+  uint32_t            i;
+
+  // there is no positional gather write for arbitrary buffers (WriteFileGather requires whole
+  // system pages), so the segments are written one after the other without any flush in between
+
+  if ((0 != (fp & 511)) || (INVALID_DISK_HANDLE == h) || (NULL == iov) || (0 == num_iov))
+    return false;
+
+  for (i = 0; i < num_iov; i++)
+  {
+    if (!disk_write_at(h, fp, iov[i].buffer, iov[i].size))
+      return false;
+    fp += iov[i].size;
+  }
+
+  return true;
+}
+
+bool disk_flush_device(DISK_HANDLE h)
+{
+  if (INVALID_DISK_HANDLE == h)
+    return false;
+
+  return FlushFileBuffers(h) ? true : false;
+}
+
+bool disk_copy_range(DISK_HANDLE src, uint64_t src_fp, DISK_HANDLE dst, uint64_t dst_fp, uint64_t size)
+{
+  (void)src;
+  (void)src_fp;
+  (void)dst;
+  (void)dst_fp;
+  (void)size;
+
+  return false; // block cloning (FSCTL_DUPLICATE_EXTENTS_TO_FILE) is ReFS-only and cluster-aligned, so it is not used
+}
+
+bool disk_zero_range(disk_ptr dp, DISK_HANDLE h, uint64_t fp, uint64_t size, const char* message, uint32_t* method)
+{
+  FILE_ZERO_DATA_INFORMATION  fzdi;
+  DWORD                       dummy;
+
+  (void)message;
+
+  *method = DISK_ZERO_NONE;
+
+  if ((0 != (size & 511)) || (0 != (fp & 511)) || (INVALID_DISK_HANDLE == h) || (0 == size))
+    return false;
+
+  diskPoolMarkWritten(h); // flushed by disk_close_device
+
+  // there is no generic zeroing offload for physical drives, the caller writes zeros
+
+  if (!(DISK_FLAG_NOT_DEVICE_BUT_FILE & dp->flags))
+    return false;
+
+  fzdi.FileOffset.QuadPart = (LONGLONG)fp;
+  fzdi.BeyondFinalZero.QuadPart = (LONGLONG)(fp + size);
+
+  if (!DeviceIoControl(h, FSCTL_SET_ZERO_DATA, &fzdi, sizeof(fzdi), NULL, 0, &dummy, NULL))
+    return false;
+
+  *method = DISK_ZERO_ZERO_RANGE; // sparse files are deallocated
+
+  return true;
+}
+
 int truncate(const char* file_name, uint64_t filesize)
 {
   HANDLE h = CreateFile(file_name, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
@@ -504,148 +1078,779 @@ int truncate(const char* file_name, uint64_t filesize)
   return 0;
 }
 
+bool disk_resize_image(const char* image_file, uint64_t size, bool preallocate)
+{
+  HANDLE h;
+  LARGE_INTEGER newSize, currentFp;
+  FILE_ALLOCATION_INFO fai;
+  DWORD dummy;
+  bool ok;
+
+  disk_pool_release(image_file); // the file is opened exclusively
+
+  h = CreateFile(image_file, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (INVALID_HANDLE_VALUE == h)
+    return false;
+
+  // sparse image files only allocate the blocks which are actually written
+
+  if (!preallocate)
+    (void)DeviceIoControl(h, FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &dummy, NULL);
+
+  newSize.QuadPart = (LONGLONG)size;
+
+  ok = SetFilePointerEx(h, newSize, &currentFp, FILE_BEGIN) && SetEndOfFile(h);
+
+  if (ok && preallocate && 0 != size)
+  {
+    fai.AllocationSize.QuadPart = (LONGLONG)size;
+    ok = SetFileInformationByHandle(h, FileAllocationInfo, &fai, sizeof(fai)) ? true : false;
+  }
+
+  CloseHandle(h);
+
+  return ok;
+}
+
+uint64_t disk_get_allocated_size(DISK_HANDLE h)
+{
+  FILE_STANDARD_INFO fsi;
+
+  if (!GetFileInformationByHandleEx(h, FileStandardInfo, &fsi, sizeof(fsi)))
+    return (uint64_t)-1;
+
+  return (uint64_t)fsi.AllocationSize.QuadPart;
+}
+
+bool disk_range_has_data(DISK_HANDLE h, uint64_t fp, uint64_t size)
+{
+  FILE_ALLOCATED_RANGE_BUFFER query, range;
+  DWORD dwBytesReturned = 0;
+
+  query.FileOffset.QuadPart = (LONGLONG)fp;
+  query.Length.QuadPart = (LONGLONG)size;
+
+  if (!DeviceIoControl(h, FSCTL_QUERY_ALLOCATED_RANGES, &query, sizeof(query), &range, sizeof(range), &dwBytesReturned, NULL))
+    return true; // ERROR_MORE_DATA (there are several allocated ranges) or not supported: assume data
+
+  return 0 != dwBytesReturned;
+}
+
+bool disk_file_exists(const char* file_name)
+{
+  return INVALID_FILE_ATTRIBUTES != GetFileAttributesA(file_name);
+}
+
 #else // _LINUX
 
-DISK_HANDLE disk_open_device (const char* device_file, bool writeAccess)
+#ifndef BLKFLSBUF
+#define BLKFLSBUF                       _IO(0x12,97)
+#endif
+
+static DISK_HANDLE diskOpenHandle(const char* device_file, bool writeAccess)
 {
   return writeAccess ? open(device_file, O_RDWR | O_SYNC | O_DIRECT) :
                        open(device_file, O_RDONLY | O_SYNC);
 }
 
-void disk_close_device(DISK_HANDLE h)
+static DISK_HANDLE diskOpenBatchedHandle(const char* device_file)
 {
-  if (INVALID_DISK_HANDLE != h)
+  return open(device_file, O_RDWR | O_DIRECT);
+}
+
+static void diskFlushHandle(DISK_HANDLE h)
+{
+  struct stat         st;
+
+  // only the data of this handle (no file system wide syncfs); block devices also drop their
+  // buffer cache, so that buffered readers see the written data
+
+  (void)fdatasync(h);
+  if (0 == fstat(h, &st) && S_ISBLK(st.st_mode))
+    (void)ioctl(h, BLKFLSBUF, 0);
+}
+
+static void diskCloseHandle(DISK_HANDLE h)
+{
+  close(h);
+}
+
+#ifndef BLKZEROOUT
+#define BLKZEROOUT                      _IO(0x12,127)
+#endif
+#ifndef BLKIOMIN
+#define BLKIOMIN                        _IO(0x12,120)
+#endif
+#ifndef BLKIOOPT
+#define BLKIOOPT                        _IO(0x12,121)
+#endif
+#ifndef BLKALIGNOFF
+#define BLKALIGNOFF                     _IO(0x12,122)
+#endif
+#ifndef BLKPBSZGET
+#define BLKPBSZGET                      _IO(0x12,123)
+#endif
+
+static uint64_t disk_get_queue_limit(DISK_HANDLE h, const char* limit)
+{
+  struct stat         st;
+  char                sys_file[128], value[64];
+  FILE               *f;
+
+  if ((0 != fstat(h, &st)) || (!S_ISBLK(st.st_mode)))
+    return 0;
+
+  snprintf(sys_file, sizeof(sys_file), "/sys/dev/block/%u:%u/queue/%s", major(st.st_rdev), minor(st.st_rdev), limit);
+  f = fopen(sys_file, "rt");
+  if (NULL == f) // partitions do not have a queue, use the one of the whole disk
   {
-    syncfs(h);
-    close(h);
+    snprintf(sys_file, sizeof(sys_file), "/sys/dev/block/%u:%u/../queue/%s", major(st.st_rdev), minor(st.st_rdev), limit);
+    f = fopen(sys_file, "rt");
+    if (NULL == f)
+      return 0;
   }
+
+  memset(value, 0, sizeof(value));
+  (void)fread(value, 1, sizeof(value) - 1, f);
+  fclose(f);
+
+  return (uint64_t)strtoull(value, NULL, 10);
+}
+
+bool disk_get_geometry(disk_ptr dp, DISK_HANDLE h)
+{
+  struct stat         st;
+  uint64_t            size = 0;
+  int                 value;
+  unsigned int        uvalue;
+
+  if (0 != fstat(h, &st))
+    return false;
+
+  if (!S_ISBLK(st.st_mode)) // image file; simulation of sectors sizes (logical, physical) is (512,512)
+  {
+    dp->device_size = (uint64_t)st.st_size;
+    dp->device_sectors = dp->device_size >> SECTOR_SHIFT;
+    dp->logical_sector_size = dp->physical_sector_size = SECTOR_SIZE;
+    dp->min_io_size = SECTOR_SIZE;
+    dp->opt_io_size = 0;
+    dp->max_transfer_size = 0;
+    dp->alignment_offset = 0;
+    return true;
+  }
+
+  if (0 != ioctl(h, BLKGETSIZE64, &size))
+    return false;
+
+  dp->device_size = size;
+  dp->device_sectors = (0 != (size & SECTOR_SIZE_MASK)) ? 0 : (size >> SECTOR_SHIFT);
+
+  value = 0;
+  dp->logical_sector_size = (0 == ioctl(h, BLKSSZGET, &value) && value > 0) ? (uint32_t)value : SECTOR_SIZE;
+  uvalue = 0;
+  dp->physical_sector_size = (0 == ioctl(h, BLKPBSZGET, &uvalue) && 0 != uvalue) ? (uint32_t)uvalue : dp->logical_sector_size;
+  uvalue = 0;
+  dp->min_io_size = (0 == ioctl(h, BLKIOMIN, &uvalue)) ? (uint32_t)uvalue : 0;
+  uvalue = 0;
+  dp->opt_io_size = (0 == ioctl(h, BLKIOOPT, &uvalue)) ? (uint32_t)uvalue : 0;
+  value = 0;
+  dp->alignment_offset = (0 == ioctl(h, BLKALIGNOFF, &value) && value > 0) ? (uint32_t)value : 0; // -1 = misaligned
+
+  // the queue limits are not available as ioctls
+
+  dp->max_transfer_size = (uint32_t)(disk_get_queue_limit(h, "max_sectors_kb") << 10);
+
+  dp->flags &= ~(DISK_FLAG_ROTATIONAL | DISK_FLAG_DISCARD);
+  if (0 != disk_get_queue_limit(h, "rotational"))
+    dp->flags |= DISK_FLAG_ROTATIONAL;
+  if (0 != disk_get_queue_limit(h, "discard_max_bytes"))
+    dp->flags |= DISK_FLAG_DISCARD;
+
+  return true;
 }
 
 uint64_t disk_get_size(const char *device_file, DISK_HANDLE h, uint32_t* logical_sector_size, uint32_t* physical_sector_size)
 {
-  uint64_t            res;
+  disk                d;
 
-  res = (uint64_t)lseek(h, 0, SEEK_END);
+  (void)device_file;
 
-  (void)lseek(h, 0, SEEK_SET);
+  memset(&d, 0, sizeof(d));
 
-  if (NULL != logical_sector_size || NULL != physical_sector_size)
+  if (!disk_get_geometry(&d, h))
+    return 0;
+
+  if (NULL != logical_sector_size)
+    *logical_sector_size = d.logical_sector_size;
+  if (NULL != physical_sector_size)
+    *physical_sector_size = d.physical_sector_size;
+
+  return d.device_sectors;
+}
+
+bool disk_read(disk_ptr dp, DISK_HANDLE h, uint64_t fp, uint8_t* buffer, uint32_t size)
+{
+  if (DISK_FLAG_READ_ACCESS_ERROR & dp->flags)
+    return false;
+
+  if ((0 != (size & 511)) || (0 != (fp & 511)) || (INVALID_DISK_HANDLE == h) || (NULL == buffer) || (0 == size))
+    return false;
+
+  if (fp != ((uint64_t)lseek(h, fp, SEEK_SET)))
+  {
+    dp->flags |= DISK_FLAG_READ_ACCESS_ERROR;
+    return false;
+  }
+
+  if (size != read(h, buffer, size))
+  {
+    dp->flags |= DISK_FLAG_READ_ACCESS_ERROR;
+    return false;
+  }
+
+  return true;
+}
+
+bool disk_write(disk_ptr dp, DISK_HANDLE h, uint64_t fp, const uint8_t * buffer, uint32_t size)
+{
+  ssize_t written;
+
+  if (NULL != dp)
+  {
+    if (DISK_FLAG_READ_ACCESS_ERROR & dp->flags)
+      return false;
+  }
+
+  if ((0 != (size & 511)) || (0 != (fp & 511)) || (INVALID_DISK_HANDLE == h) || (NULL == buffer) || (0 == size))
+    return false;
+
+  diskPoolMarkWritten(h); // flushed by disk_close_device
+
+  if (fp != ((uint64_t)lseek(h, fp, SEEK_SET)))
   {
-    const char* p = strstr(device_file, "/dev/");
-    char sys_file[256];
-    FILE* f;
+    dp->flags |= DISK_FLAG_READ_ACCESS_ERROR;
+    return false;
+  }
 
-    if (NULL == p) // e.g. this is an image file; simulation of sectors sizes (logical, physical) is (512,512)
+  if (size != (written=write(h, buffer, size)))
+  {
+    if (NULL != dp)
+      dp->flags |= DISK_FLAG_WRITE_ACCESS_ERROR;
+    return false;
+  }
+
+  return true;
+}
+
+bool disk_read_at(DISK_HANDLE h, uint64_t fp, uint8_t* buffer, uint32_t size)
+{
+  if ((0 != (size & 511)) || (0 != (fp & 511)) || (INVALID_DISK_HANDLE == h) || (NULL == buffer) || (0 == size))
+    return false;
+
+  return (((ssize_t)size) == pread(h, buffer, size, (off_t)fp)) ? true : false;
+}
+
+bool disk_write_at(DISK_HANDLE h, uint64_t fp, const uint8_t* buffer, uint32_t size)
+{
+  if ((0 != (size & 511)) || (0 != (fp & 511)) || (INVALID_DISK_HANDLE == h) || (NULL == buffer) || (0 == size))
+    return false;
+
+  diskPoolMarkWritten(h); // flushed by disk_close_device
+
+  return (((ssize_t)size) == pwrite(h, buffer, size, (off_t)fp)) ? true : false;
+}
+
+bool disk_write_vector_at(DISK_HANDLE h, uint64_t fp, const disk_io_vector* iov, uint32_t num_iov)
+{
+  struct iovec        vec[DISK_MAX_IO_VECTORS];
+  uint32_t            i, n;
+  uint64_t            size, skip;
+  ssize_t             written;
+
+  if ((0 != (fp & 511)) || (INVALID_DISK_HANDLE == h) || (NULL == iov) || (0 == num_iov))
+    return false;
+
+  diskPoolMarkWritten(h); // flushed by disk_close_device
+
+  while (0 != num_iov)
+  {
+    n = (num_iov > DISK_MAX_IO_VECTORS) ? DISK_MAX_IO_VECTORS : num_iov;
+
+    for (i = 0, size = 0; i < n; i++)
     {
-      if (NULL != logical_sector_size)
-        *logical_sector_size = 512;
-      if (NULL != physical_sector_size)
-        *physical_sector_size = 512;
+      if ((0 != (iov[i].size & 511)) || (NULL == iov[i].buffer) || (0 == iov[i].size))
+        return false;
+      vec[i].iov_base = (void*)iov[i].buffer;
+      vec[i].iov_len = iov[i].size;
+      size += iov[i].size;
     }
-    else
-    {
-      p += sizeof("/dev/") - 1;
 
-      if (NULL != logical_sector_size)
+    written = pwritev(h, vec, (int)n, (off_t)fp);
+    if (written < 0)
+      return false;
+
+    if (((uint64_t)written) != size) // short write: the remainder is written segment by segment
+    {
+      for (i = 0, skip = (uint64_t)written; i < n; fp += iov[i].size, i++)
       {
-        snprintf(sys_file, sizeof(sys_file), "/sys/block/%s/queue/hw_sector_size", p);
-        f = fopen(sys_file, "rt");
-        if (NULL == f)
+        if (skip >= iov[i].size)
         {
-          *logical_sector_size = 512;
-        }
-        else
-        {
-          memset(sys_file, 0, sizeof(sys_file));
-          (void)fread(sys_file, 1, sizeof(sys_file), f);
-          fclose(f);
-          *logical_sector_size = (uint32_t)strtoul(sys_file, NULL, 10);
-          if (0 == *logical_sector_size)
-            *logical_sector_size = 512;
+          skip -= iov[i].size;
+          continue;
         }
+        if ((0 != (skip & 511)) || !disk_write_at(h, fp + skip, iov[i].buffer + skip, iov[i].size - (uint32_t)skip))
+          return false;
+        skip = 0;
       }
+    }
+    else
+      fp += size;
+
+    iov += n;
+    num_iov -= n;
+  }
+
+  return true;
+}
+
+bool disk_flush_device(DISK_HANDLE h)
+{
+  if (INVALID_DISK_HANDLE == h)
+    return false;
+
+  return (0 == fdatasync(h)) ? true : false;
+}
+
+bool disk_copy_range(DISK_HANDLE src, uint64_t src_fp, DISK_HANDLE dst, uint64_t dst_fp, uint64_t size)
+{
+  loff_t              off_in = (loff_t)src_fp, off_out = (loff_t)dst_fp;
+  ssize_t             copied;
+
+  if ((INVALID_DISK_HANDLE == src) || (INVALID_DISK_HANDLE == dst))
+    return false;
+
+  diskPoolMarkWritten(dst); // flushed by disk_close_device
+
+  while (0 != size)
+  {
+    copied = copy_file_range(src, &off_in, dst, &off_out, (size_t)size, 0);
+    if (copied <= 0)
+      return false; // EXDEV, EINVAL, EOPNOTSUPP, ENOSYS: not supported; 0: unexpected end of the source
+
+    size -= (uint64_t)copied;
+  }
+
+  return true;
+}
+
+bool disk_zero_range(disk_ptr dp, DISK_HANDLE h, uint64_t fp, uint64_t size, const char* message, uint32_t* method)
+{
+  uint64_t            range[2], done = 0, this_size;
+
+  *method = DISK_ZERO_NONE;
+
+  if ((0 != (size & 511)) || (0 != (fp & 511)) || (INVALID_DISK_HANDLE == h) || (0 == size))
+    return false;
+
+  diskPoolMarkWritten(h); // flushed by disk_close_device
+
+  if (DISK_FLAG_NOT_DEVICE_BUT_FILE & dp->flags)
+  {
+    if (0 == fallocate(h, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t)fp, (off_t)size))
+      *method = DISK_ZERO_PUNCH_HOLE;
+    else
+    if (0 == fallocate(h, FALLOC_FL_ZERO_RANGE | FALLOC_FL_KEEP_SIZE, (off_t)fp, (off_t)size))
+      *method = DISK_ZERO_ZERO_RANGE;
+
+    return (DISK_ZERO_NONE != *method) ? true : false;
+  }
+
+  // only use BLKZEROOUT if the device really supports WRITE ZEROES / WRITE SAME, otherwise the
+  // kernel falls back to writing zero pages; discarded blocks are never guaranteed to read back as
+  // zeros (queue/discard_zeroes_data always reads 0 since Linux 4.12), so BLKDISCARD is not used
+
+  if (0 == disk_get_queue_limit(h, "write_zeroes_max_bytes"))
+    return false;
+
+  *method = DISK_ZERO_WRITE_ZEROES;
+
+  while (done != size)
+  {
+    this_size = size - done;
+    if (this_size > DISK_ZERO_CHUNK_SIZE)
+      this_size = DISK_ZERO_CHUNK_SIZE;
+
+    range[0] = fp + done;
+    range[1] = this_size;
+
+    if (0 != ioctl(h, BLKZEROOUT, range))
+    {
+      *method = DISK_ZERO_NONE;
+      return false;
+    }
+
+    done += this_size;
+
+    if (NULL != message)
+    {
+      fprintf(stdout, "\r%s" CTRL_GREEN "%3.2f%%" CTRL_RESET, message, (((double)done) * 100.0) / ((double)size));
+      fflush(stdout);
+    }
+  }
+
+  return true;
+}
+
+
+bool disk_resize_image(const char* image_file, uint64_t size, bool preallocate)
+{
+  int h = open(image_file, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  bool ok;
+
+  if (-1 == h)
+    return false;
+
+  // ftruncate() never writes data, extending the file just creates a hole at its end
+
+  ok = (0 == ftruncate(h, (off_t)size));
+
+  if (ok && preallocate && 0 != size)
+  {
+    if (0 != fallocate(h, 0, 0, (off_t)size))
+      ok = (0 == posix_fallocate(h, 0, (off_t)size)); // emulated by the C library if the file system cannot do it
+  }
+
+  close(h);
+
+  return ok;
+}
+
+uint64_t disk_get_allocated_size(DISK_HANDLE h)
+{
+  struct stat st;
+
+  if (0 != fstat(h, &st))
+    return (uint64_t)-1;
+
+  return ((uint64_t)st.st_blocks) << SECTOR_SHIFT; // st_blocks is always measured in 512 byte units
+}
+
+bool disk_range_has_data(DISK_HANDLE h, uint64_t fp, uint64_t size)
+{
+  off_t data = lseek(h, (off_t)fp, SEEK_DATA);
+
+  if (((off_t)-1) == data)
+    return (ENXIO == errno) ? false : true; // ENXIO: only a hole up to the end of the file; other errors: SEEK_DATA not supported, assume data
+
+  return ((uint64_t)data) < fp + size;
+}
+
+bool disk_file_exists(const char* file_name)
+{
+  struct stat st;
+
+  return 0 == stat(file_name, &st);
+}
+
+#endif // !_WINDOWS
+
+static void diskPoolRemove(uint32_t idx)
+{
+  disk_pool_num--;
+  if (idx != disk_pool_num)
+    memcpy(&disk_pool[idx], &disk_pool[disk_pool_num], sizeof(pooled_handle));
+}
+
+DISK_HANDLE disk_open_device(const char* device_file, bool writeAccess)
+{
+  DISK_HANDLE         h, evicted = INVALID_DISK_HANDLE;
+  uint32_t            i;
+
+  disk_pool_lock_acquire();
+
+  for (i = 0; i < disk_pool_num; i++)
+  {
+    if (!disk_pool[i].in_use && disk_pool[i].write_access == writeAccess && !strcmp(disk_pool[i].device_file, device_file))
+    {
+      disk_pool[i].in_use = true;
+      disk_pool[i].written = false;
+      disk_pool_counters.opens_avoided++;
+      h = disk_pool[i].h;
+      disk_pool_lock_release();
+      return h;
+    }
+  }
+
+  disk_pool_lock_release();
+
+#ifdef _WINDOWS
+  // an idle read-only handle (FILE_SHARE_READ) prevents any other handle with write access
+
+  disk_pool_release(device_file);
+#endif
+
+  h = diskOpenHandle(device_file, writeAccess);
+  if (INVALID_DISK_HANDLE == h)
+    return h;
+
+  disk_pool_lock_acquire();
+
+  disk_pool_counters.opens++;
+
+  if (DISK_POOL_MAX_HANDLES == disk_pool_num) // pool is full: make room by closing an idle handle
+  {
+    for (i = 0; i < disk_pool_num; i++)
+    {
+      if (!disk_pool[i].in_use)
+      {
+        evicted = disk_pool[i].h;
+        diskPoolRemove(i);
+        break;
+      }
+    }
+  }
+
+  if (disk_pool_num < DISK_POOL_MAX_HANDLES)
+  {
+    memset(&disk_pool[disk_pool_num], 0, sizeof(pooled_handle));
+    strncpy(disk_pool[disk_pool_num].device_file, device_file, sizeof(disk_pool[disk_pool_num].device_file) - 1);
+    disk_pool[disk_pool_num].h = h;
+    disk_pool[disk_pool_num].write_access = writeAccess;
+    disk_pool[disk_pool_num].in_use = true;
+    disk_pool_num++;
+  }
+
+  disk_pool_lock_release();
+
+  if (INVALID_DISK_HANDLE != evicted)
+    diskCloseHandle(evicted);
+
+  return h;
+}
+
+void disk_close_device(DISK_HANDLE h)
+{
+  uint32_t            i;
+  bool                pooled = false, written = false;
+
+  if (INVALID_DISK_HANDLE == h)
+    return;
+
+  disk_pool_lock_acquire();
+
+  for (i = 0; i < disk_pool_num; i++)
+  {
+    if (disk_pool[i].in_use && disk_pool[i].h == h)
+    {
+      pooled = true;
+      written = disk_pool[i].written;
+      break;
+    }
+  }
+
+  if (written || !pooled) // the pool was full when an unpooled handle was opened: written state unknown
+    disk_pool_counters.syncs++;
+  else
+    disk_pool_counters.syncs_avoided++;
+
+  disk_pool_lock_release();
+
+  // the flush is done outside of the lock (and before the handle can be handed out again)
+
+  if (written || !pooled)
+    diskFlushHandle(h);
+
+  if (!pooled)
+  {
+    diskCloseHandle(h);
+    return;
+  }
+
+  disk_pool_lock_acquire();
+  for (i = 0; i < disk_pool_num; i++)
+  {
+    if (disk_pool[i].in_use && disk_pool[i].h == h)
+    {
+      disk_pool[i].in_use = false;
+      disk_pool[i].written = false;
+      break;
+    }
+  }
+  disk_pool_lock_release();
+}
+
+DISK_HANDLE disk_open_device_batched(const char* device_file)
+{
+  DISK_HANDLE         h;
+
+  // never pooled: disk_close_device flushes and closes it
+
+  disk_pool_release(device_file);
+
+  h = diskOpenBatchedHandle(device_file);
+  if (INVALID_DISK_HANDLE == h)
+    return h;
+
+  disk_pool_lock_acquire();
+  disk_pool_counters.opens++;
+  disk_pool_lock_release();
+
+  return h;
+}
+
+void disk_pool_release(const char* device_file)
+{
+  DISK_HANDLE         handles[DISK_POOL_MAX_HANDLES];
+  uint32_t            i = 0, num = 0;
+
+  disk_pool_lock_acquire();
+  while (i < disk_pool_num)
+  {
+    if (!disk_pool[i].in_use && (NULL == device_file || !strcmp(disk_pool[i].device_file, device_file)))
+    {
+      handles[num++] = disk_pool[i].h;
+      diskPoolRemove(i);
+    }
+    else
+      i++;
+  }
+  disk_pool_lock_release();
+
+  for (i = 0; i < num; i++)
+    diskCloseHandle(handles[i]);
+}
+
+void disk_pool_get_stats(disk_pool_stats_ptr stats)
+{
+  disk_pool_lock_acquire();
+  memcpy(stats, &disk_pool_counters, sizeof(disk_pool_stats));
+  disk_pool_lock_release();
+}
+
+uint64_t disk_getFileSize(DISK_HANDLE h)
+{
+  return file_get_size(h);
+}
 
-      if (NULL != physical_sector_size)
-      {
-        snprintf(sys_file, sizeof(sys_file), "/sys/block/%s/queue/physical_block_size", p);
-        f = fopen(sys_file, "rt");
-        if (NULL == f)
-        {
-          *physical_sector_size = 512;
-        }
-        else
-        {
-          memset(sys_file, 0, sizeof(sys_file));
-          (void)fread(sys_file, 1, sizeof(sys_file), f);
-          fclose(f);
-          *physical_sector_size = (uint32_t)strtoul(sys_file, NULL, 10);
-          if (0 == *physical_sector_size)
-            *physical_sector_size = 512;
-        }
-      }
-    }
+const char* disk_zero_method_name(uint32_t method)
+{
+  switch (method)
+  {
+    case DISK_ZERO_WRITE_ZEROES:
+      return "WRITE ZEROES (offloaded to the device)";
+    case DISK_ZERO_PUNCH_HOLE:
+      return "hole punching (sparse image file)";
+    case DISK_ZERO_ZERO_RANGE:
+      return "zero range (file system)";
+    default:
+      break;
   }
 
-  return (0 != (res & SECTOR_SIZE_MASK)) ? 0 : (res >> SECTOR_SHIFT);
+  return "zero buffer writes";
 }
 
-bool disk_read(disk_ptr dp, DISK_HANDLE h, uint64_t fp, uint8_t* buffer, uint32_t size)
+typedef struct _batch_read              batch_read, * batch_read_ptr;
+
+struct _batch_read
 {
+  DISK_HANDLE                           h;                          ///< handle shared by all reads (positional reads only)
+  uint64_t                              fp;                         ///< file pointer of this read
+  uint8_t                              *buffer;                     ///< destination
+  uint32_t                              size;                       ///< size of this read in bytes
+  bool                                 *ok;                         ///< receives the result
+};
+
+static void batchReadTask(void* arg)
+{
+  batch_read_ptr            br = (batch_read_ptr)arg;
+
+  *br->ok = disk_read_at(br->h, br->fp, br->buffer, br->size);
+}
+
+bool disk_read_batch(disk_ptr dp, DISK_HANDLE h, const uint64_t* lbas, uint32_t num_reads, uint32_t num_sectors, uint8_t* buffer, bool* ok)
+{
+  batch_read_ptr            reads;
+  workpool_ptr              wp = NULL;
+  uint32_t                  i, num_pending = 0, num_workers;
+  size_t                    read_size = ((size_t)num_sectors) << SECTOR_SHIFT;
+  bool                      all_ok = true;
+
+  if (unlikely(NULL == dp || INVALID_DISK_HANDLE == h || NULL == lbas || NULL == buffer || NULL == ok || 0 == num_sectors))
+    return false;
+
+  if (0 == num_reads)
+    return true;
+
+  memset(ok, 0, num_reads * sizeof(bool));
+
   if (DISK_FLAG_READ_ACCESS_ERROR & dp->flags)
     return false;
 
-  if ((0 != (size & 511)) || (0 != (fp & 511)) || (INVALID_DISK_HANDLE == h) || (NULL == buffer) || (0 == size))
+  reads = (batch_read_ptr)malloc(num_reads * sizeof(batch_read));
+  if (unlikely(NULL == reads))
     return false;
 
-  if (fp != ((uint64_t)lseek(h, fp, SEEK_SET)))
+  // the scan cache is served first (and serially), only the remaining windows go to the device
+
+  for (i = 0; i < num_reads; i++)
   {
-    dp->flags |= DISK_FLAG_READ_ACCESS_ERROR;
-    return false;
+    if ((lbas[i] + num_sectors) > dp->device_sectors)
+      continue;
+
+    if (NULL != dp->scan_replay && scan_cache_replay(dp, lbas[i], num_sectors, buffer + i * read_size))
+    {
+      ok[i] = true;
+      continue;
+    }
+
+    reads[num_pending].h = h;
+    reads[num_pending].fp = lbas[i] << SECTOR_SHIFT;
+    reads[num_pending].buffer = buffer + i * read_size;
+    reads[num_pending].size = (uint32_t)read_size;
+    reads[num_pending].ok = &ok[i];
+    num_pending++;
   }
 
-  if (size != read(h, buffer, size))
+  // the reads are issued concurrently, so the device latency is not paid once per window
+
+  if (num_pending > 1)
   {
-    dp->flags |= DISK_FLAG_READ_ACCESS_ERROR;
-    return false;
+    num_workers = num_pending < DISK_BATCH_READ_WORKERS ? num_pending : DISK_BATCH_READ_WORKERS;
+    wp = workpool_create(num_workers, 0);
   }
 
-  return true;
-}
-
-bool disk_write(disk_ptr dp, DISK_HANDLE h, uint64_t fp, const uint8_t * buffer, uint32_t size)
-{
-  ssize_t written;
+  for (i = 0; i < num_pending; i++)
+  {
+    if (NULL == wp || !workpool_submit(wp, WORKPOOL_NO_KEY, batchReadTask, &reads[i]))
+      batchReadTask(&reads[i]);
+  }
 
-  if (NULL != dp)
+  if (NULL != wp)
   {
-    if (DISK_FLAG_READ_ACCESS_ERROR & dp->flags)
-      return false;
+    (void)workpool_wait(wp, 0);
+    workpool_destroy(wp);
   }
 
-  if ((0 != (size & 511)) || (0 != (fp & 511)) || (INVALID_DISK_HANDLE == h) || (NULL == buffer) || (0 == size))
-    return false;
+  // recording is not thread-safe, so it is done afterwards in the order of the windows
 
-  if (fp != ((uint64_t)lseek(h, fp, SEEK_SET)))
+  for (i = 0; i < num_reads; i++)
   {
-    dp->flags |= DISK_FLAG_READ_ACCESS_ERROR;
-    return false;
+    if (!ok[i])
+      all_ok = false;
   }
 
-  if (size != (written=write(h, buffer, size)))
+  if (dp->scan_recording)
   {
-    if (NULL != dp)
-      dp->flags |= DISK_FLAG_WRITE_ACCESS_ERROR;
-    return false;
+    for (i = 0; i < num_pending; i++)
+    {
+      if (*reads[i].ok)
+        scan_cache_record(dp, reads[i].fp >> SECTOR_SHIFT, num_sectors, reads[i].buffer);
+    }
   }
 
-  return true;
-}
-
-#endif // !_WINDOWS
+  free(reads);
 
-uint64_t disk_getFileSize(DISK_HANDLE h)
-{
-  return file_get_size(h);
+  return all_ok;
 }
 
 void disk_free_sector(sector_ptr sp)
@@ -702,11 +1907,19 @@ sector_ptr disk_read_sectors(disk_ptr dp, DISK_HANDLE h, sector_ptr* head, secto
 
   item->data = (uint8_t*) ((((uint64_t)item->data_malloc_ptr) + (SECTOR_MEM_ALIGN - 1)) & (~(SECTOR_MEM_ALIGN - 1)));
 
-  if (!disk_read(dp, h, lba << SECTOR_SHIFT, item->data, item->num_sectors << SECTOR_SHIFT))
+  // while disk_scan_partitions runs, the sectors are either served from or recorded in the scan cache
+
+  if (NULL == dp->scan_replay || !scan_cache_replay(dp, lba, num_sectors, item->data))
   {
-    free(item->data_malloc_ptr);
-    free(item);
-    return NULL;
+    if (!disk_read(dp, h, lba << SECTOR_SHIFT, item->data, item->num_sectors << SECTOR_SHIFT))
+    {
+      free(item->data_malloc_ptr);
+      free(item);
+      return NULL;
+    }
+
+    if (dp->scan_recording)
+      scan_cache_record(dp, lba, num_sectors, item->data);
   }
 
   if (NULL == head)
@@ -745,213 +1958,145 @@ sector_ptr disk_read_sectors(disk_ptr dp, DISK_HANDLE h, sector_ptr* head, secto
 
     if (NULL == run) // insert at tail
     {
-      run->prev = *tail;
+      item->prev = *tail;
       if (NULL == *tail)
-        *head = run;
+        *head = item;
       else
-        (*tail)->next = run;
-      *tail = run;
+        (*tail)->next = item;
+      *tail = item;
     }
   }
 
   return item;
 }
 
-static void exchange_disk_map_ptr(disk_map_ptr a, disk_map_ptr b, disk_map_ptr* head, disk_map_ptr* tail)
+static int disk_map_compare_start(const void* a, const void* b)
 {
-  disk_map_ptr    c;
-  disk_map_ptr    a_prev;
-  disk_map_ptr    a_next;
-  disk_map_ptr    b_prev;
-  disk_map_ptr    b_next;
-
-  if (b->next == a) // exchange a and b
-  {
-    c = a;
-    a = b;
-    b = c;
-  }
+  const disk_map* x = *(const disk_map* const*)a;
+  const disk_map* y = *(const disk_map* const*)b;
 
-  a_prev = a->prev;
-  a_next = a->next;
-  b_prev = b->prev;
-  b_next = b->next;
-
-  if (a->next == b) // a and b are neighbours, i.e. a->next = b && b->prev = a
-  {
-    a->prev = b;
-    a->prev->next = a;
-
-    a->next = b_next;
-    if (NULL == a->next)
-      *tail = a;
-    else
-      a->next->prev = a;
-
-    b->prev = a_prev;
-    if (NULL == b->prev)
-      *head = b;
-    else
-      b->prev->next = b;
-
-    b->next = a;
-    b->next->prev = b;
-  }
-  else
-  {
-    a->prev = b_prev;
-    if (NULL == a->prev)
-      *head = a;
-    else
-      a->prev->next = a;
-
-    a->next = b_next;
-    if (NULL == a->next)
-      *tail = a;
-    else
-      a->next->prev = a;
+  if (x->start_lba < y->start_lba)
+    return -1;
+  return (x->start_lba > y->start_lba) ? 1 : 0;
+}
 
-    b->prev = a_prev;
-    if (NULL == b->prev)
-      *head = b;
-    else
-      b->prev->next = b;
+static int disk_map_compare_guid(const void* a, const void* b)
+{
+  return memcmp((*(const disk_map* const*)a)->guid, (*(const disk_map* const*)b)->guid, 16);
+}
 
-    b->next = a_next;
-    if (NULL == b->next)
-      *tail = b;
-    else
-      b->next->prev = b;
-  }
+static void disk_map_set_free(disk_map_ptr dmp, uint64_t start_lba, uint64_t end_lba)
+{
+  dmp->start_lba = start_lba;
+  dmp->end_lba = end_lba;
+  dmp->is_free = true;
+  strcpy(dmp->description, "unallocated (free) space");
 }
 
 disk_map_ptr sort_and_complete_disk_map(disk_map_ptr dmp, uint64_t deviceSectorSize)
 {
-  disk_map_ptr            head = dmp;
-  disk_map_ptr            tail, run = dmp, run2, min;
-  uint64_t                lba = 0;
+  disk_map_ptr           *items = NULL;
+  disk_map_ptr            map = NULL, run;
+  uint32_t                num_items = 0, total, i, j, num_guids;
+  uint64_t                lba = 0, largest = 0;
 
   if (NULL == dmp)
     return NULL;
 
-  tail = dmp;
-  while (NULL != tail->next)
-    tail = tail->next;
+  for (run = dmp; NULL != run; run = run->next)
+    num_items++;
 
-  // sort all entries in ascending order
+  items = (disk_map_ptr*)malloc(num_items * sizeof(disk_map_ptr));
+  if (unlikely(NULL == items))
+    goto ErrorExit;
 
-  while (NULL != run)
-  {
-    run2 = run->next;
+  for (i = 0, run = dmp; NULL != run; run = run->next)
+    items[i++] = run;
 
-    if (NULL == run2)
-      break;
+  // sort all entries in ascending order
 
-    min = run;
+  qsort(items, num_items, sizeof(disk_map_ptr), disk_map_compare_start);
 
-    while (NULL != run2)
-    {
-      if (run2->start_lba < min->start_lba)
-        min = run2;
-      run2 = run2->next;
-    }
+  // sweep: detect overlapping entries and count the gaps, which become free entries
 
-    if (min != run) // we have to exchange an entry
-    {
-      exchange_disk_map_ptr(min, run, &head, &tail);
-      run = min->next; // => idempotent!!!
-    }
-    else
-      run = run->next;
+  total = num_items;
+  for (i = 0; i < num_items; i++)
+  {
+    if (unlikely(items[i]->start_lba < lba))
+      goto ErrorExit;
+    if (items[i]->start_lba > lba)
+      total++;
+    lba = items[i]->end_lba + 1;
   }
+  if (lba != deviceSectorSize)
+    total++;
 
-  // after sorting: fill all gaps with empty areas
+  // build the contiguous map, fill all gaps with empty areas
 
-  run = head;
+  map = (disk_map_ptr)malloc(total * sizeof(disk_map));
+  if (unlikely(NULL == map))
+    goto ErrorExit;
+  memset(map, 0, total * sizeof(disk_map));
 
-  while (NULL != run)
+  for (i = 0, j = 0, lba = 0; i < num_items; i++)
   {
-    if (unlikely(run->start_lba < lba))
-    {
-    ErrorExit:
-      free_disk_map(dmp);
-      return NULL;
-    }
-
-    if (run->start_lba > lba) // OK, there is a gap we have to fill now
-    {
-      dmp = (disk_map_ptr)malloc(sizeof(disk_map));
-      if (unlikely(NULL == dmp))
-        goto ErrorExit;
-      memset(dmp, 0, sizeof(disk_map));
-
-      dmp->start_lba = lba;
-      dmp->end_lba = run->start_lba - 1;
-      dmp->is_free = true;
-      strcpy(dmp->description, "unallocated (free) space");
-
-      dmp->next = run;
-      if (NULL == run->prev)
-        head = dmp;
-      else
-        dmp->prev = run->prev;
-      run->prev = dmp;
-
-      if (NULL != dmp->prev)
-        dmp->prev->next = dmp;
-    }
-
-    lba = run->end_lba + 1;
-    run = run->next;
+    if (items[i]->start_lba > lba)
+      disk_map_set_free(&map[j++], lba, items[i]->start_lba - 1);
+    memcpy(&map[j++], items[i], sizeof(disk_map));
+    lba = items[i]->end_lba + 1;
   }
+  if (lba != deviceSectorSize)
+    disk_map_set_free(&map[j++], lba, deviceSectorSize - 1);
 
-  if (tail->end_lba != (deviceSectorSize - 1))
+  map->largest_free = total;
+  for (j = 0; j < total; j++)
   {
-    dmp = (disk_map_ptr)malloc(sizeof(disk_map));
-    if (unlikely(NULL == dmp))
-      goto ErrorExit;
-    memset(dmp, 0, sizeof(disk_map));
-
-    dmp->start_lba = tail->end_lba + 1;
-    dmp->end_lba = deviceSectorSize - 1;
-    dmp->is_free = true;
-    strcpy(dmp->description, "unallocated (free) space");
-
-    tail->next = dmp;
-    dmp->prev = tail;
+    map[j].prev = (0 != j) ? &map[j - 1] : NULL;
+    map[j].next = (j + 1 < total) ? &map[j + 1] : NULL;
+    if (0 != j)
+      map[j].num_items = map[j].largest_free = 0;
 
-    tail = dmp;
+    if (map[j].is_free && (map[j].end_lba - map[j].start_lba + 1) > largest)
+    {
+      largest = map[j].end_lba - map[j].start_lba + 1;
+      map->largest_free = j;
+    }
   }
+  map->num_items = total;
 
   // if partition GUIDs are present, then ensure that there are no double ones
 
-  run = head;
+  for (i = 0, num_guids = 0; i < num_items; i++)
+  {
+    if (!is_zero_guid(items[i]->guid))
+      items[num_guids++] = items[i];
+  }
+
+  qsort(items, num_guids, sizeof(disk_map_ptr), disk_map_compare_guid);
 
-  while (NULL != run)
+  for (i = 1; i < num_guids; i++)
   {
-    if (!is_zero_guid(run->guid))
-    {
-      run2 = head;
-      while (NULL != run2)
-      {
-        if ((run != run2) && (!is_zero_guid(run2->guid)))
-        {
-          if (!memcmp(run->guid, run2->guid, 16))
-            goto ErrorExit;
-        }
-        run2 = run2->next;
-      }
-    }
-    run = run->next;
+    if (!memcmp(items[i - 1]->guid, items[i]->guid, 16))
+      goto ErrorExit;
   }
 
-  return head;
+  free(items);
+  free_disk_map(dmp);
+
+  return map;
+
+ErrorExit:
+  if (NULL != items)
+    free(items);
+  if (NULL != map)
+    free(map);
+  free_disk_map(dmp);
+  return NULL;
 }
 
 disk_ptr disk_create_new(cmdline_args_ptr cap, const char* device_file, bool is_image_file)
 {
   disk_ptr        dp;
-  DISK_HANDLE     h;
 
   if (NULL!=cap->pd_head)
   {
@@ -966,38 +2111,28 @@ disk_ptr disk_create_new(cmdline_args_ptr cap, const char* device_file, bool is_
 
   // not in list, create new one
 
-  h = disk_open_device(device_file, false/*read-only*/);
-  if (INVALID_DISK_HANDLE == h)
-    return NULL;
-
   dp = (disk_ptr)malloc(sizeof(disk));
 
   if (unlikely(NULL == dp))
-  {
-    disk_close_device(h);
     return NULL;
-  }
 
   memset(dp, 0, sizeof(disk));
 
   strncpy(dp->device_file, device_file, sizeof(dp->device_file) - 1);
+  dp->scan_cache = cap->scan_cache;
 
   if (is_image_file)
-  {
-    dp->logical_sector_size = dp->physical_sector_size = 512;
-    dp->device_size = disk_getFileSize(h);
-    dp->device_sectors = dp->device_size >> SECTOR_SHIFT;
     dp->flags |= DISK_FLAG_NOT_DEVICE_BUT_FILE;
-  }
-  else
+
+  // an unresponsive device must not block the program forever
+
+  if (!disk_probe(dp, false/*no scan*/, cap->probe_timeout_ms))
   {
-    dp->device_sectors = disk_get_size(dp->device_file, h, &dp->logical_sector_size, &dp->physical_sector_size);
-    dp->device_size = dp->device_sectors << SECTOR_SHIFT;
+    free(dp); // a timed-out worker only owns its private copy
+    return NULL;
   }
 
-  disk_close_device(h);
-
-  disk_scan_partitions(dp);
+  // the partition tables are scanned on demand (disk_ensure_scanned)
 
   return dp;
 }
@@ -1033,6 +2168,9 @@ disk_ptr disk_setup_device(cmdline_args_ptr cap, const char* device_file)
       dp = dp->next;
       device_no--;
     }
+
+    if (!(DISK_FLAG_PROBED & dp->flags))
+      (void)disk_probe(dp, false/*no scan*/, cap->probe_timeout_ms);
   }
   else
   {
@@ -1100,6 +2238,8 @@ bool disk_scan_partitions(disk_ptr dp)
 {
   DISK_HANDLE                   h = disk_open_device(dp->device_file, false/*read-only*/);
   uint64_t                      backup_gpt_lba = dp->device_sectors - 1;
+  bool                          sparse = (DISK_FLAG_SPARSE_FILE & dp->flags) ? true : false;
+  bool                          head_has_data;
 #ifdef _WINDOWS
   PDRIVE_LAYOUT_INFORMATION_EX  pdliex = NULL;
 #endif
@@ -1107,12 +2247,31 @@ bool disk_scan_partitions(disk_ptr dp)
   if (INVALID_DISK_HANDLE == h)
     return false;
 
-  dp->mbr = partition_scan_mbr(dp, h);
+  dp->flags |= DISK_FLAG_SCANNED;
+
+  // an image file without any data (e.g. just created) cannot contain partition tables
+
+  if (sparse && 0 == dp->allocated_size)
+  {
+    disk_close_device(h);
+    return true;
+  }
+
+  // sparse image files: holes read back as zeros, so do not read (and parse) them at all
+
+  head_has_data = !sparse || disk_range_has_data(h, 0, DISK_GPT_HEAD_SECTORS << SECTOR_SHIFT);
+
+  // a cache hit (LBAs 0 and 1 unchanged) serves all reads below from the scan cache
+
+  (void)scan_cache_begin(dp, h);
+
+  dp->mbr = head_has_data ? partition_scan_mbr(dp, h) : NULL;
   if (NULL == dp->mbr)
     dp->flags &= ~(DISK_FLAG_HAS_MBR | DISK_FLAG_MBR_IS_PROTECTIVE);
   else
   {
     dp->flags |= DISK_FLAG_HAS_MBR;
+    (void)partition_peek_fs_for_mbr(dp, h);
     dp->mbr_dmp = partition_create_disk_map_mbr(dp);
     if (NULL != dp->mbr_dmp)
       dp->mbr_dmp = sort_and_complete_disk_map(dp->mbr_dmp, dp->device_sectors);
@@ -1122,7 +2281,11 @@ bool disk_scan_partitions(disk_ptr dp)
     dp->mbr_partition_info = (uint8_t*)malloc(MBR_PARTITION_INFO_MAX_SIZE);
 
     if (NULL == dp->mbr_partition_info)
+    {
+      scan_cache_end(dp);
+      disk_close_device(h);
       return false;
+    }
 
     memset(dp->mbr_partition_info, 0, MBR_PARTITION_INFO_MAX_SIZE);
     dp->mbr_part_info_size = 0;
@@ -1157,7 +2320,7 @@ bool disk_scan_partitions(disk_ptr dp)
 #endif
   }
 
-  dp->gpt1 = partition_scan_gpt(dp, h, 1 /* LBA of the primary GPT*/);
+  dp->gpt1 = head_has_data ? partition_scan_gpt(dp, h, 1 /* LBA of the primary GPT*/) : NULL;
 
   if (NULL != dp->gpt1)
   {
@@ -1169,7 +2332,9 @@ bool disk_scan_partitions(disk_ptr dp)
       backup_gpt_lba = dp->gpt1->header.backup_lba;
   }
 
-  dp->gpt2 = partition_scan_gpt(dp, h, backup_gpt_lba);
+  if (!sparse || (backup_gpt_lba >= (DISK_GPT_HEAD_SECTORS - 2) &&
+      disk_range_has_data(h, (backup_gpt_lba - (DISK_GPT_HEAD_SECTORS - 2)) << SECTOR_SHIFT, (DISK_GPT_HEAD_SECTORS - 1) << SECTOR_SHIFT)))
+    dp->gpt2 = partition_scan_gpt(dp, h, backup_gpt_lba);
   if (NULL != dp->gpt2)
   {
     dp->backup_gpt_exists = true;
@@ -1192,6 +2357,8 @@ bool disk_scan_partitions(disk_ptr dp)
   if ((dp->primary_gpt_exists && !dp->primary_gpt_corrupt) || (dp->backup_gpt_exists && !dp->backup_gpt_corrupt))
     (void)partition_peek_fs_for_gpt(dp, h);
 
+  scan_cache_end(dp);
+
   disk_close_device(h);
 
   return true;
@@ -1201,6 +2368,12 @@ void free_disk_map(disk_map_ptr dmp)
 {
   disk_map_ptr next;
 
+  if (NULL != dmp && 0 != dmp->num_items) // sorted map: one contiguous array
+  {
+    free(dmp);
+    return;
+  }
+
   while (NULL != dmp)
   {
     next = dmp->next;
@@ -1224,6 +2397,139 @@ void disk_dump_map(disk_map_ptr dmp)
   }
 }
 
+disk_map_ptr disk_map_find(disk_map_ptr dmp, uint64_t lba)
+{
+  uint32_t          lo, hi, mid;
+
+  if (NULL == dmp)
+    return NULL;
+
+  if (0 == dmp->num_items) // plain list
+  {
+    while (NULL != dmp && (lba < dmp->start_lba || lba > dmp->end_lba))
+      dmp = dmp->next;
+    return dmp;
+  }
+
+  // binary search for the last item starting at or before lba
+
+  lo = 0;
+  hi = dmp->num_items;
+  while (hi - lo > 1)
+  {
+    mid = lo + ((hi - lo) >> 1);
+    if (dmp[mid].start_lba <= lba)
+      lo = mid;
+    else
+      hi = mid;
+  }
+
+  return (lba >= dmp[lo].start_lba && lba <= dmp[lo].end_lba) ? &dmp[lo] : NULL;
+}
+
+disk_map_ptr disk_map_largest_free(disk_map_ptr dmp)
+{
+  disk_map_ptr      largest = NULL;
+
+  if (NULL == dmp)
+    return NULL;
+
+  if (0 != dmp->num_items)
+    return (dmp->largest_free < dmp->num_items) ? &dmp[dmp->largest_free] : NULL;
+
+  for (; NULL != dmp; dmp = dmp->next)
+  {
+    if (dmp->is_free && (NULL == largest || (dmp->end_lba - dmp->start_lba) > (largest->end_lba - largest->start_lba)))
+      largest = dmp;
+  }
+
+  return largest;
+}
+
+bool disk_map_next_free(disk_map_ptr dmp, uint64_t from_lba, uint64_t num_lbas, uint64_t align_lbas, uint64_t align_offset, uint64_t* lba_start)
+{
+  uint64_t          start;
+
+  if (0 == num_lbas)
+    return false;
+
+  for (dmp = disk_map_find(dmp, from_lba); NULL != dmp; dmp = dmp->next)
+  {
+    if (!dmp->is_free)
+      continue;
+
+    start = disk_align_lba((dmp->start_lba > from_lba) ? dmp->start_lba : from_lba, align_lbas, align_offset, true);
+
+    if (start <= dmp->end_lba && num_lbas - 1 <= dmp->end_lba - start)
+    {
+      *lba_start = start;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool disk_map_allocate(disk_map_ptr dmp, uint32_t placement, uint64_t num_lbas, uint64_t align_lbas, uint64_t align_offset, uint64_t* lba_start, uint64_t* lba_count)
+{
+  disk_map_ptr      run;
+  uint64_t          start, avail, best_start = 0, best_avail = 0;
+  bool              found = false;
+
+  if (NULL == dmp)
+    return false;
+
+  if (DISK_PLACE_EXPLICIT == placement)
+  {
+    start = disk_align_lba(*lba_start, align_lbas, align_offset, true);
+    run = disk_map_find(dmp, start);
+    if (NULL == run || !run->is_free)
+      return false;
+
+    avail = run->end_lba - start + 1;
+    if (0 != num_lbas && avail < num_lbas)
+      return false;
+
+    *lba_start = start;
+    *lba_count = (0 != num_lbas) ? num_lbas : avail;
+    return true;
+  }
+
+  for (run = dmp; NULL != run; run = run->next)
+  {
+    if (!run->is_free)
+      continue;
+
+    start = disk_align_lba(run->start_lba, align_lbas, align_offset, true);
+    if (start > run->end_lba)
+      continue;
+
+    avail = run->end_lba - start + 1;
+    if (0 != num_lbas && avail < num_lbas)
+      continue;
+
+    // best fit: smallest extent that is large enough (the largest one if the whole extent is requested)
+
+    if (!found || (0 != num_lbas ? avail < best_avail : avail > best_avail))
+    {
+      best_start = start;
+      best_avail = avail;
+      found = true;
+    }
+
+    if (DISK_PLACE_FIRST_FIT == placement)
+      break;
+  }
+
+  if (!found)
+    return false;
+
+  *lba_start = best_start;
+  *lba_count = (0 != num_lbas) ? num_lbas : best_avail;
+
+  return true;
+}
+
 #ifdef _WINDOWS
 
 static void findDriveLetterForVolume(const char* szVolumeName, win_volume_ptr wvp)
@@ -1558,7 +2864,7 @@ diskpart_volume_ptr disk_enumerate_diskpart_volumes(cmdline_args_ptr cap)
     {
       gpt_ptr g = dp->gpt1;
 
-      for (j = 0; j < g->header.number_of_part_entries; j++)
+      for (j = 0; j < g->num_entries; j++)
       {
         if ((!memcmp(guid_microsoft_basic_data, g->entries[j].type_guid, 16)) || // MSDN just states this one
             (!memcmp(guid_efi_system_partition, g->entries[j].type_guid, 16))) // but THAT'S WRONG, also ESPs are taken into account (because they are FAT-formatted)
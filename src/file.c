@@ -91,11 +91,38 @@ uint64_t file_get_size(FILE_HANDLE f)
   return (uint64_t)fs.QuadPart;
 }
 
+bool file_replace(const char* file_name, const void* data, uint32_t size)
+{
+  char                tmp_file[512];
+  HANDLE              h;
+  DWORD               dwWritten = 0;
+  bool                ok;
+
+  if (snprintf(tmp_file, sizeof(tmp_file), "%s.tmp", file_name) >= (int)sizeof(tmp_file))
+    return false;
+
+  h = CreateFileA(tmp_file, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (INVALID_HANDLE_VALUE == h)
+    return false;
+
+  ok = (WriteFile(h, data, size, &dwWritten, NULL) && (dwWritten == size) && FlushFileBuffers(h)) ? true : false;
+
+  CloseHandle(h);
+
+  if (ok)
+    ok = MoveFileExA(tmp_file, file_name, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) ? true : false;
+
+  if (!ok)
+    (void)DeleteFileA(tmp_file);
+
+  return ok;
+}
+
 #else // LINUX
 
 FILE_HANDLE file_open(const char* filename, bool read_only)
 {
-  return read_only ? open(filename, O_RDONLY) : open(filename, O_CREAT | O_RDWR);
+  return read_only ? open(filename, O_RDONLY) : open(filename, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
 }
 
 void file_close(FILE_HANDLE f, bool do_flush)
@@ -139,6 +166,57 @@ uint64_t file_get_size(FILE_HANDLE f)
   return size;
 }
 
+bool file_replace(const char* file_name, const void* data, uint32_t size)
+{
+  char                tmp_file[512], dir_name[512], *p;
+  int                 h;
+  bool                ok;
+
+  if (snprintf(tmp_file, sizeof(tmp_file), "%s.tmp", file_name) >= (int)sizeof(tmp_file))
+    return false;
+
+  h = open(tmp_file, O_CREAT | O_TRUNC | O_WRONLY, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  if (-1 == h)
+    return false;
+
+  ok = file_write(h, data, size) && (0 == fsync(h));
+
+  if (0 != close(h))
+    ok = false;
+
+  if (ok)
+    ok = (0 == rename(tmp_file, file_name));
+
+  if (!ok)
+  {
+    (void)unlink(tmp_file);
+    return false;
+  }
+
+  // the rename itself is only durable once the directory is synced
+
+  strncpy(dir_name, tmp_file, sizeof(dir_name) - 1);
+  dir_name[sizeof(dir_name) - 1] = 0;
+  p = strrchr(dir_name, '/');
+  if (NULL == p)
+    strcpy(dir_name, ".");
+  else
+  if (p == dir_name)
+    p[1] = 0; // root directory
+  else
+    *p = 0;
+
+  h = open(dir_name, O_RDONLY | O_DIRECTORY);
+  if (-1 == h)
+    return false;
+
+  ok = (0 == fsync(h));
+
+  close(h);
+
+  return ok;
+}
+
 #endif // !_WINDOWS
 
 static uint8_t copy_buffer[1 << 20];
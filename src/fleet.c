@@ -0,0 +1,621 @@
+/**
+ * @file   fleet.c
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @brief  implementation of functions that perform operations
+ *         (e.g. partition table backups) on a whole fleet of disks in one
+ *         process using a shared worker pool and a global resource budget.
+ *
+ * [MIT license]
+ *
+ * Copyright (c) 2021 Ingo A. Kubbilun
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <part-y.h>
+
+typedef struct _fleet_command           fleet_command, * fleet_command_ptr;
+
+struct _fleet_command
+{
+  const char                           *operation;                  ///< name of the operation (start message)
+  const char                           *noun;                       ///< name of the jobs (summary)
+  const char                           *column;                     ///< title of the second report column
+  const char                           *io_verb;                    ///< "read", "written" or "transferred" (progress and summary)
+  bool                                  with_target;                ///< true: list file specifies target files (report column), false: job->result is reported
+  fleet_job_op                          job_op;                     ///< the per-disk operation (plan and commit)
+  const char                           *message;                    ///< progress line prefix
+};
+
+static uint64_t fleet_device_key(const char* device_file)
+{
+  uint64_t            key = 0xCBF29CE484222325; // FNV-1a offset basis
+#ifndef _WINDOWS
+  struct stat         st;
+
+  // several paths (symlinks, /dev/disk/by-id/...) may refer to the same device, so use the device identity
+
+  if (0 == stat(device_file, &st))
+  {
+    if (S_ISBLK(st.st_mode))
+      key = (uint64_t)st.st_rdev;
+    else
+      key = (((uint64_t)st.st_dev) << 32) ^ ((uint64_t)st.st_ino);
+
+    return key + 1; // never WORKPOOL_NO_KEY
+  }
+#endif
+
+  while (0 != *device_file)
+  {
+    key ^= (uint64_t)(uint8_t)toupper(*(device_file++));
+    key *= 0x00000100000001B3; // FNV-1a prime
+  }
+
+  return WORKPOOL_NO_KEY == key ? 1 : key;
+}
+
+static char* fleet_next_token(char** pp)
+{
+  char               *p = *pp, *start;
+
+  while (' ' == *p || '\t' == *p)
+    p++;
+
+  if (0 == *p)
+    return NULL;
+
+  start = p;
+
+  if ('"' == *p) // quoted token (path names with blanks)
+  {
+    start = ++p;
+    while (0 != *p && '"' != *p)
+      p++;
+    if ('"' != *p)
+      return NULL;
+  }
+  else
+  {
+    while (0 != *p && ' ' != *p && '\t' != *p)
+      p++;
+  }
+
+  if (0 != *p)
+    *(p++) = 0;
+
+  *pp = p;
+
+  return start;
+}
+
+fleet_ptr fleet_load(cmdline_args_ptr cap, const char* list_file, bool with_target)
+{
+  FILE               *f;
+  fleet_ptr           fp;
+  fleet_job_ptr       job;
+  char                line[1024], *p, *dev, *target;
+  uint32_t            line_no = 0;
+  size_t              l;
+
+  if (NULL == cap || NULL == list_file)
+    return NULL;
+
+  f = fopen(list_file, "rt");
+  if (NULL == f)
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": unable to open the fleet list file %s\n", list_file);
+    return NULL;
+  }
+
+  fp = (fleet_ptr)malloc(sizeof(fleet));
+  if (unlikely(NULL == fp))
+  {
+    fclose(f);
+    return NULL;
+  }
+
+  memset(fp, 0, sizeof(fleet));
+  fp->cap = cap;
+  fp->io_verb = "read";
+
+  while (NULL != fgets(line, sizeof(line), f))
+  {
+    line_no++;
+
+    l = strlen(line);
+    while (0 != l && ('\n' == line[l - 1] || '\r' == line[l - 1]))
+      line[--l] = 0;
+
+    p = line;
+    while (' ' == *p || '\t' == *p)
+      p++;
+
+    if (0 == *p || '#' == *p)
+      continue;
+
+    dev = fleet_next_token(&p);
+    target = (NULL != dev && with_target) ? fleet_next_token(&p) : NULL;
+
+    if ((NULL == dev) || (with_target && NULL == target) || (NULL != fleet_next_token(&p)) ||
+        (strlen(dev) >= sizeof(job->device_file)) || (NULL != target && strlen(target) >= sizeof(job->target_file)))
+    {
+      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": %s, line %u: expecting '%s'\n", list_file, line_no, with_target ? "<device> <target file>" : "<device>");
+ErrorExit:
+      fclose(f);
+      fleet_free(fp);
+      return NULL;
+    }
+
+    job = (fleet_job_ptr)malloc(sizeof(fleet_job));
+    if (unlikely(NULL == job))
+      goto ErrorExit;
+
+    memset(job, 0, sizeof(fleet_job));
+
+    strncpy(job->device_file, dev, sizeof(job->device_file) - 1);
+    if (NULL != target)
+      strncpy(job->target_file, target, sizeof(job->target_file) - 1);
+    job->device_key = fleet_device_key(job->device_file);
+    job->fp = fp;
+    job->status = FLEET_JOB_PENDING;
+
+    if (NULL == fp->tail)
+      fp->head = job;
+    else
+      fp->tail->next = job;
+    fp->tail = job;
+
+    fp->num_jobs++;
+  }
+
+  fclose(f);
+
+  if (0 == fp->num_jobs)
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": the fleet list file %s does not contain any disk.\n", list_file);
+    fleet_free(fp);
+    return NULL;
+  }
+
+  return fp;
+}
+
+void fleet_free(fleet_ptr fp)
+{
+  fleet_job_ptr       next;
+
+  if (NULL == fp)
+    return;
+
+  while (NULL != fp->head)
+  {
+    next = fp->head->next;
+    free(fp->head);
+    fp->head = next;
+  }
+
+  io_budget_free(fp->budget);
+
+  free(fp);
+}
+
+static bool fleet_disk_is_enumerated(cmdline_args_ptr cap, disk_ptr dp)
+{
+  disk_ptr            run = cap->pd_head;
+
+  while (NULL != run)
+  {
+    if (run == dp)
+      return true;
+    run = run->next;
+  }
+
+  return false;
+}
+
+static void fleet_progress(void* ctx, uint64_t bytes)
+{
+  fleet_job_ptr       job = (fleet_job_ptr)ctx;
+
+  io_budget_consume(job->fp->budget, bytes);
+
+  atomic_add64(&job->bytes_done, bytes);
+  atomic_add64(&job->fp->bytes_done, bytes);
+}
+
+static void fleet_run_job(void* arg)
+{
+  fleet_job_ptr       job = (fleet_job_ptr)arg;
+  cmdline_args_ptr    cap = job->fp->cap;
+  disk_ptr            dp;
+  bool                dp_owned;
+
+  job->start_usec = get_time_usec();
+  job->status = FLEET_JOB_RUNNING;
+
+  // enumerated physical disks are taken from the list, all others are set up here; the partition
+  // tables are scanned by the job (i.e. in parallel)
+
+  dp = disk_setup_device(cap, job->device_file);
+  if (NULL == dp)
+  {
+    snprintf(job->error, sizeof(job->error), "unable to setup the device/image file");
+    goto Finish;
+  }
+
+  (void)disk_ensure_scanned(dp);
+
+  dp_owned = !fleet_disk_is_enumerated(cap, dp);
+
+  if ((0 == dp->device_sectors) || (DISK_FLAG_READ_ACCESS_ERROR & dp->flags))
+  {
+    snprintf(job->error, sizeof(job->error), "device/image file is not readable");
+    goto Finish2;
+  }
+
+  if (SECTOR_SIZE != dp->logical_sector_size)
+  {
+    snprintf(job->error, sizeof(job->error), "logical sector size %u is not supported", dp->logical_sector_size);
+    goto Finish2;
+  }
+
+  if (job->fp->job_op(job, dp))
+    job->status = FLEET_JOB_OK;
+
+Finish2:
+  if (dp_owned)
+    disk_free_list(dp);
+
+Finish:
+  if (FLEET_JOB_OK != job->status)
+    job->status = FLEET_JOB_FAILED;
+
+  job->end_usec = get_time_usec();
+
+  atomic_add64(&job->fp->jobs_finished, 1);
+}
+
+static bool fleet_backup_op(fleet_job_ptr job, disk_ptr dp)
+{
+  cmdline_args_ptr    cap = job->fp->cap;
+  backup_header_ptr   bhp;
+  DISK_HANDLE         h = INVALID_DISK_HANDLE;
+  bool                res = false;
+
+  probe_apply_profile(cap, dp);
+
+  bhp = bootstrap_backup(dp->device_sectors);
+  if ((NULL == bhp) || (!backup_add_partition_tables(dp, bhp)))
+  {
+    snprintf(job->error, sizeof(job->error), "unable to prepare the backup records");
+    goto Exit;
+  }
+
+  if (0 != cap->lba_range_end)
+  {
+    if (!add_backup_record(bhp, cap->lba_range_start, cap->lba_range_end - cap->lba_range_start + 1))
+    {
+      snprintf(job->error, sizeof(job->error), "LBA range %"FMT64"u..%"FMT64"u exceeds the device", cap->lba_range_start, cap->lba_range_end);
+      goto Exit;
+    }
+  }
+
+  job->bytes_total = backup_get_data_size(bhp) << 1; // read for backup plus read-back for verification
+
+  if (cap->dryrun)
+  {
+    job->bytes_done = job->bytes_total >> 1; // report the size of the backup (nothing is read)
+    res = true;
+    goto Exit;
+  }
+
+  h = disk_open_device(dp->device_file, false/*read-only*/);
+  if (INVALID_DISK_HANDLE == h)
+  {
+    snprintf(job->error, sizeof(job->error), "unable to open the device/image file for reading");
+    goto Exit;
+  }
+
+  if (!create_backup_file_ex(dp, bhp, h, job->target_file, NULL, fleet_progress, job))
+  {
+    snprintf(job->error, sizeof(job->error), "unable to create the backup file");
+    goto Exit;
+  }
+
+  if (!check_backup_file_ex(dp, h, job->target_file, NULL, fleet_progress, job))
+  {
+    snprintf(job->error, sizeof(job->error), "unable to verify the backup file");
+    goto Exit;
+  }
+
+  res = true;
+
+Exit:
+  disk_close_device(h);
+  free_backup_structure(bhp);
+  return res;
+}
+
+static bool fleet_repair_gpt_op(fleet_job_ptr job, disk_ptr dp)
+{
+  repair_plan         rp;
+  bool                res = false;
+
+  memset(&rp, 0, sizeof(rp));
+
+  if (!repair_gpt_plan(dp, &rp, job->error, sizeof(job->error)))
+    goto Exit;
+
+  strncpy(job->result, repair_gpt_action_name(rp.action), sizeof(job->result) - 1);
+
+  job->bytes_total = rp.wpp->num_bytes;
+
+  if (job->fp->cap->dryrun || REPAIR_GPT_NONE == rp.action)
+  {
+    job->bytes_done = job->bytes_total; // report the size of the planned writes
+    res = true;
+    goto Exit;
+  }
+
+  job->written = true; // also if the commit fails halfway
+
+  if (!repair_gpt_commit(dp, &rp, job->error, sizeof(job->error)))
+    goto Exit;
+
+  fleet_progress(job, job->bytes_total);
+
+  res = true;
+
+Exit:
+  repair_gpt_free(&rp);
+  return res;
+}
+
+static bool fleet_convert_op(fleet_job_ptr job, disk_ptr dp)
+{
+  convert_plan        cp;
+  bool                res = false;
+
+  memset(&cp, 0, sizeof(cp));
+
+  if (!convert_mbr_to_gpt_plan(dp, &cp, false/*quiet*/, job->error, sizeof(job->error)))
+    goto Exit;
+
+  job->bytes_total = cp.wpp->num_bytes;
+
+  if (job->fp->cap->dryrun)
+  {
+    job->bytes_done = job->bytes_total; // report the size of the planned writes
+    res = true;
+    goto Exit;
+  }
+
+  // the backup transfers are not part of bytes_total (same size as --dry-run): only the plan is accounted
+
+  job->written = true; // also if the commit fails halfway
+
+  if (!convert_commit(dp, &cp, job->target_file, NULL, NULL, job->error, sizeof(job->error)))
+    goto Exit;
+
+  fleet_progress(job, job->bytes_total);
+
+  res = true;
+
+Exit:
+  convert_free(&cp);
+  return res;
+}
+
+static const fleet_command fleet_backup_command =
+{
+  "backup", "backup(s)", "backup file", "read", true, fleet_backup_op,
+  CTRL_CYAN "WORKING" CTRL_RESET " : Creating and verifying backups ........................: "
+};
+
+static const fleet_command fleet_repair_gpt_command =
+{
+  "GPT repair", "GPT repair(s)", "action", "written", false, fleet_repair_gpt_op,
+  CTRL_CYAN "WORKING" CTRL_RESET " : Repairing the GPTs .......................................: "
+};
+
+static const fleet_command fleet_convert_command =
+{
+  "MBR to GPT conversion", "conversion(s)", "backup file", "transferred", true, fleet_convert_op,
+  CTRL_CYAN "WORKING" CTRL_RESET " : Converting the MBRs to GPTs ..............................: "
+};
+
+static void fleet_show_progress(fleet_ptr fp, uint64_t start_usec, const char* message)
+{
+  uint64_t            bytes = atomic_load64(&fp->bytes_done);
+  uint64_t            elapsed = get_time_usec() - start_usec;
+  char                size_str[32], rate_str[32];
+
+  format_disk_size(bytes, size_str, sizeof(size_str));
+  format_disk_size(0 == elapsed ? 0 : (uint64_t)((((double)bytes) * 1000000.0) / ((double)elapsed)), rate_str, sizeof(rate_str));
+
+  fprintf(stdout, "\r%s" CTRL_GREEN "%u/%u" CTRL_RESET " disk(s), %s %s, %s/s        ", message,
+    (uint32_t)atomic_load64(&fp->jobs_finished), fp->num_jobs, size_str, fp->io_verb, rate_str);
+  fflush(stdout);
+}
+
+static bool fleet_run(fleet_ptr fp, const char* operation, const char* message, uint64_t* elapsed)
+{
+  cmdline_args_ptr    cap = fp->cap;
+  fleet_job_ptr       job;
+  workpool_ptr        wp;
+  uint32_t            num_threads;
+  uint64_t            start_usec;
+  char                rate_str[32];
+
+  num_threads = 0 == cap->num_threads ? workpool_num_cpus() : cap->num_threads;
+  if (num_threads > fp->num_jobs)
+    num_threads = fp->num_jobs;
+
+  if (0 != cap->max_bandwidth)
+  {
+    fp->budget = io_budget_create(cap->max_bandwidth);
+    if (NULL == fp->budget)
+    {
+      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": Insufficient memory available.\n");
+      return false;
+    }
+  }
+
+  format_disk_size(cap->max_bandwidth, rate_str, sizeof(rate_str));
+  fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": fleet %s of %u disk(s) using %u worker thread(s), %u job(s) per device, bandwidth limit: %s%s\n",
+    operation, fp->num_jobs, num_threads, cap->per_device_limit, 0 == cap->max_bandwidth ? "none" : rate_str, 0 == cap->max_bandwidth ? "" : "/s");
+
+  if (cap->dryrun)
+    fprintf(stdout, CTRL_MAGENTA "DRYRUN" CTRL_RESET ": Explaining what would be done.\n");
+
+  wp = workpool_create(num_threads, cap->per_device_limit);
+  if (NULL == wp)
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": unable to create the worker pool.\n");
+    return false;
+  }
+
+  start_usec = get_time_usec();
+
+  job = fp->head;
+  while (NULL != job)
+  {
+    if (!workpool_submit(wp, job->device_key, fleet_run_job, job))
+    {
+      job->status = FLEET_JOB_FAILED;
+      snprintf(job->error, sizeof(job->error), "unable to schedule the job");
+    }
+    job = job->next;
+  }
+
+  while (!workpool_wait(wp, FLEET_PROGRESS_INTERVAL_MS))
+  {
+    if (!cap->dryrun)
+      fleet_show_progress(fp, start_usec, message);
+  }
+
+  if (!cap->dryrun)
+  {
+    fleet_show_progress(fp, start_usec, message);
+    fprintf(stdout, "\n");
+  }
+
+  workpool_destroy(wp);
+
+  *elapsed = get_time_usec() - start_usec;
+
+  return true;
+}
+
+static int fleet_report(fleet_ptr fp, const fleet_command* fc, uint64_t elapsed)
+{
+  cmdline_args_ptr    cap = fp->cap;
+  fleet_job_ptr       job;
+  uint32_t            num_ok = 0, num_failed = 0;
+  uint64_t            bytes_total = 0;
+  const char         *column;
+  char                size_str[32], rate_str[32];
+
+  // aggregated report (in list file order)
+
+  fprintf(stdout, "\ndevice file         %-30s  status         size      time\n", fc->column);
+  fprintf(stdout, "--------------------------------------------------------------------------------\n");
+
+  job = fp->head;
+  while (NULL != job)
+  {
+    format_disk_size(job->bytes_done, size_str, sizeof(size_str));
+    column = fc->with_target ? job->target_file : job->result;
+
+    if (FLEET_JOB_OK == job->status)
+    {
+      num_ok++;
+      fprintf(stdout, CTRL_MAGENTA "%-18s  " CTRL_RESET "%-30s  " CTRL_GREEN "%-8s" CTRL_RESET "  %10s  %6.2fs\n", job->device_file, column,
+        cap->dryrun ? "PLANNED" : "OK", size_str, ((double)(job->end_usec - job->start_usec)) / 1000000.0);
+    }
+    else
+    {
+      num_failed++;
+      fprintf(stdout, CTRL_MAGENTA "%-18s  " CTRL_RESET "%-30s  " CTRL_RED "%-8s" CTRL_RESET "  %s\n", job->device_file, column, "FAILED", job->error);
+    }
+
+    bytes_total += job->bytes_done;
+    job = job->next;
+  }
+
+  format_disk_size(bytes_total, size_str, sizeof(size_str));
+  format_disk_size(0 == elapsed ? 0 : (uint64_t)((((double)bytes_total) * 1000000.0) / ((double)elapsed)), rate_str, sizeof(rate_str));
+
+  fprintf(stdout, "\n" CTRL_YELLOW "INFO" CTRL_RESET ": %u of %u %s %s, %u failed; %s %s in %.2fs (%s/s).\n",
+    num_ok, fp->num_jobs, fc->noun, cap->dryrun ? "planned" : "succeeded", num_failed, size_str, fc->io_verb, ((double)elapsed) / 1000000.0, rate_str);
+
+  return 0 == num_failed ? 0 : 1;
+}
+
+static int fleet_execute(cmdline_args_ptr cap, const fleet_command* fc)
+{
+  fleet_ptr           fp;
+  fleet_job_ptr       job;
+  uint64_t            elapsed;
+  int                 res;
+
+  fp = fleet_load(cap, cap->fleet_file, fc->with_target);
+  if (NULL == fp)
+    return 1;
+
+  fp->io_verb = fc->io_verb;
+  fp->job_op = fc->job_op;
+
+  if (!fleet_run(fp, fc->operation, fc->message, &elapsed))
+  {
+    fleet_free(fp);
+    return 1;
+  }
+
+  // the disks are freed by the jobs, i.e. they are not passed to scan_cache_save: drop the cache
+  // entries of all written disks by name (the validator does not cover e.g. the backup GPT)
+
+  for (job = fp->head; NULL != job; job = job->next)
+  {
+    if (job->written)
+      scan_cache_invalidate_file(cap->scan_cache, job->device_file);
+  }
+
+  res = fleet_report(fp, fc, elapsed);
+
+  fleet_free(fp);
+
+  return res;
+}
+
+int fleet_backup(cmdline_args_ptr cap)
+{
+  return fleet_execute(cap, &fleet_backup_command);
+}
+
+int fleet_repair_gpt(cmdline_args_ptr cap)
+{
+  return fleet_execute(cap, &fleet_repair_gpt_command);
+}
+
+int fleet_convert(cmdline_args_ptr cap)
+{
+  return fleet_execute(cap, &fleet_convert_command);
+}
@@ -0,0 +1,630 @@
+/**
+ * @file   fsmap.c
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @brief  implementation of the file system allocation maps (EXT2/3/4 block
+ *         bitmaps, NTFS $Bitmap, FAT12/16/32 allocation tables).
+ *
+ * [MIT license]
+ *
+ * Copyright (c) 2021 Ingo A. Kubbilun
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <part-y.h>
+
+#define READ_LITTLE_ENDIAN16(_buf,_ofs) ((((uint32_t)(_buf)[(_ofs)])<<0)|(((uint32_t)(_buf)[(_ofs)+1])<<8))
+
+#define EXT_COMPAT_SPARSE_SUPER2        0x00000200                  ///< only two backup superblocks (listed in the superblock)
+#define EXT_INCOMPAT_META_BG            0x00000010                  ///< group descriptors spread over the meta block groups (not supported)
+#define EXT_INCOMPAT_64BIT              0x00000080                  ///< 64bit block numbers, descriptor size in the superblock
+#define EXT_RO_COMPAT_SPARSE_SUPER      0x00000001                  ///< backup superblocks in groups 0, 1 and powers of 3, 5, 7 only
+#define EXT_RO_COMPAT_GDT_CSUM          0x00000010                  ///< group descriptor flags are valid (uninit_bg)
+#define EXT_RO_COMPAT_BIGALLOC          0x00000200                  ///< bitmaps address clusters, not blocks (not supported)
+#define EXT_RO_COMPAT_METADATA_CSUM     0x00000400                  ///< group descriptor flags are valid (metadata checksums)
+#define EXT_BG_BLOCK_UNINIT             0x00000002                  ///< block bitmap of the group not initialized (only metadata used)
+
+#define NTFS_MFT_RECORD_BITMAP          6                           ///< MFT record of the $Bitmap file
+#define NTFS_ATTR_DATA                  0x00000080                  ///< $DATA attribute
+#define NTFS_ATTR_END                   0xFFFFFFFF                  ///< end of the attributes of an MFT record
+#define NTFS_FIXUP_STRIDE               512                         ///< the update sequence protects the last two bytes of every 512 bytes
+
+#define FS_MAP_TEST(_bm,_i)             (0 != ((_bm)[(_i) >> 3] & (1 << ((_i) & 7))))
+
+typedef struct _fs_map                  fs_map, * fs_map_ptr;
+
+struct _fs_map
+{
+  DISK_HANDLE                           h;                          ///< disk handle (positional reads only)
+  uint64_t                              part_fp;                    ///< byte offset of the partition
+  uint64_t                              part_size;                  ///< size of the partition in bytes
+  uint8_t                              *io;                         ///< aligned read buffer (FS_MAP_READ_SIZE)
+  void                                 *io_mem;                     ///< allocated memory of io
+  uint64_t                              head;                       ///< bytes used at the start of the partition (at least FS_MAP_EDGE_SIZE)
+  uint64_t                              units_fp;                   ///< byte offset of the first allocation unit (relative to the partition)
+  uint32_t                              unit;                       ///< size of an allocation unit (block, cluster) in bytes
+  uint64_t                              num_units;                  ///< number of allocation units
+  uint8_t                              *bitmap;                     ///< one bit per allocation unit (LSB first), set = used
+  void                                 *bitmap_mem;                 ///< allocated memory of bitmap
+};
+
+bool fs_extent_add(fs_extent_list_ptr el, uint64_t fp, uint64_t size)
+{
+  fs_extent_ptr       fep;
+  uint64_t            end = fp + size;
+
+  if (0 == size)
+    return true;
+
+  // merge with the preceding extents if they overlap or if the gap is small enough
+
+  while (0 != el->num_items)
+  {
+    fep = &el->items[el->num_items - 1];
+    if ((fep->fp + fep->size + el->merge_gap) < fp)
+      break;
+    if (fep->fp < fp)
+      fp = fep->fp;
+    if ((fep->fp + fep->size) > end)
+      end = fep->fp + fep->size;
+    el->num_items--;
+  }
+
+  if (el->num_items == el->max_items)
+  {
+    fep = (fs_extent_ptr)realloc(el->items, (size_t)((0 == el->max_items ? 256 : el->max_items << 1) * sizeof(fs_extent)));
+    if (NULL == fep)
+      return false;
+    el->items = fep;
+    el->max_items = 0 == el->max_items ? 256 : el->max_items << 1;
+  }
+
+  el->items[el->num_items].fp = fp;
+  el->items[el->num_items].size = end - fp;
+  el->num_items++;
+
+  return true;
+}
+
+void fs_extent_free(fs_extent_list_ptr el)
+{
+  if (NULL != el->items)
+    free(el->items);
+  el->items = NULL;
+  el->num_items = 0;
+  el->max_items = 0;
+}
+
+static uint8_t* fsMapAlloc(uint64_t size, void** mem)
+{
+  *mem = malloc((size_t)size + SECTOR_MEM_ALIGN);
+  if (unlikely(NULL == *mem))
+    return NULL;
+
+  return (uint8_t*)((((uint64_t)*mem) + (SECTOR_MEM_ALIGN - 1)) & (~((uint64_t)(SECTOR_MEM_ALIGN - 1))));
+}
+
+static bool fsMapRead(fs_map_ptr map, uint64_t fp, uint8_t* buffer, uint64_t size)
+{
+  uint32_t            n, r;
+
+  // reads relative to the partition; the aligned buffer permits unbuffered handles
+
+  if (0 != (fp & SECTOR_SIZE_MASK) || (fp + ((size + SECTOR_SIZE_MASK) & (~((uint64_t)SECTOR_SIZE_MASK)))) > map->part_size)
+    return false;
+
+  while (0 != size)
+  {
+    n = size > FS_MAP_READ_SIZE ? FS_MAP_READ_SIZE : (uint32_t)size;
+    r = (n + SECTOR_SIZE_MASK) & (~SECTOR_SIZE_MASK);
+    if (!disk_read_at(map->h, map->part_fp + fp, map->io, r))
+      return false;
+    memcpy(buffer, map->io, n);
+    buffer += n;
+    fp += r;
+    size -= n;
+  }
+
+  return true;
+}
+
+static bool fsMapCreateBitmap(fs_map_ptr map)
+{
+  uint64_t            size = ((map->num_units + 63) >> 6) << 3;
+
+  if (0 == map->num_units || size > FS_MAP_MAX_BITMAP)
+    return false;
+
+  map->bitmap = fsMapAlloc(size, &map->bitmap_mem);
+  if (NULL == map->bitmap)
+    return false;
+
+  memset(map->bitmap, 0, (size_t)size);
+
+  return true;
+}
+
+static void fsMapSetUnits(fs_map_ptr map, uint64_t first, uint64_t count)
+{
+  uint64_t            i;
+
+  if (first >= map->num_units)
+    return;
+  if (count > (map->num_units - first))
+    count = map->num_units - first;
+
+  for (i = first; i < (first + count); i++)
+    map->bitmap[i >> 3] |= (uint8_t)(1 << (i & 7));
+}
+
+static bool fsMapEmit(fs_map_ptr map, fs_extent_list_ptr el)
+{
+  const uint64_t     *words = (const uint64_t*)map->bitmap;
+  uint64_t            i = 0, start, fp, end;
+
+  if (!fs_extent_add(el, map->part_fp, map->head < map->part_size ? map->head : map->part_size))
+    return false;
+
+  // runs of used units; completely free and completely used 64bit words are skipped at once
+
+  while (i < map->num_units)
+  {
+    if (0 == (i & 63) && 0 == words[i >> 6])
+    {
+      i += 64;
+      continue;
+    }
+    if (!FS_MAP_TEST(map->bitmap, i))
+    {
+      i++;
+      continue;
+    }
+
+    start = i;
+    while (i < map->num_units)
+    {
+      if (0 == (i & 63) && ~((uint64_t)0) == words[i >> 6])
+        i += 64;
+      else
+      if (FS_MAP_TEST(map->bitmap, i))
+        i++;
+      else
+        break;
+    }
+    if (i > map->num_units)
+      i = map->num_units;
+
+    fp = map->units_fp + start * map->unit;
+    end = map->units_fp + i * map->unit;
+    if (end > map->part_size)
+      end = map->part_size;
+    if (fp < end && !fs_extent_add(el, map->part_fp + fp, end - fp))
+      return false;
+  }
+
+  fp = map->part_size > FS_MAP_EDGE_SIZE ? map->part_size - FS_MAP_EDGE_SIZE : 0;
+
+  return fs_extent_add(el, map->part_fp + fp, map->part_size - fp);
+}
+
+static bool fsMapExtHasSuper(const uint8_t* sb, uint64_t group)
+{
+  uint64_t            n;
+  uint32_t            base;
+
+  if (0 == group)
+    return true;
+
+  if (EXT_COMPAT_SPARSE_SUPER2 & READ_LITTLE_ENDIAN32(sb, 0x5C))
+    return group == READ_LITTLE_ENDIAN32(sb, 0x24C) || group == READ_LITTLE_ENDIAN32(sb, 0x250);
+
+  if (1 == group || 0 == (EXT_RO_COMPAT_SPARSE_SUPER & READ_LITTLE_ENDIAN32(sb, 0x64)))
+    return true;
+
+  for (base = 3; base <= 7; base += 2)
+  {
+    for (n = base; n < group; n *= base);
+    if (n == group)
+      return true;
+  }
+
+  return false;
+}
+
+static uint64_t fsMapExtDescBlock(const uint8_t* desc, uint32_t ofs, uint32_t desc_size)
+{
+  uint64_t            block = READ_LITTLE_ENDIAN32(desc, ofs);
+
+  if (desc_size >= 64)
+    block |= ((uint64_t)READ_LITTLE_ENDIAN32(desc, ofs + 0x20)) << 32;
+
+  return block;
+}
+
+static void fsMapExtSetBlocks(fs_map_ptr map, uint64_t first_data_block, uint64_t block, uint64_t count)
+{
+  // the units start at the first data block (block 0 of 1K file systems is in the head)
+
+  if ((block + count) <= first_data_block)
+    return;
+  if (block < first_data_block)
+  {
+    count -= first_data_block - block;
+    block = first_data_block;
+  }
+
+  fsMapSetUnits(map, block - first_data_block, count);
+}
+
+static bool fsMapExt(fs_map_ptr map)
+{
+  uint8_t             sbuf[2048], *sb = &sbuf[1024], *gdt = NULL, *bmp = NULL, *desc;
+  uint64_t            blocks, fdb, groups, gdt_blocks, itb, g, g2, k, bb, count;
+  uint32_t            bs, bpg, ipg, isz, dsz, rsv, incompat, ro_compat;
+  bool                uninit_valid, ok = false;
+
+  if (!fsMapRead(map, 0, sbuf, sizeof(sbuf)) || 0x53 != sb[0x38] || 0xEF != sb[0x39])
+    return false;
+
+  incompat = READ_LITTLE_ENDIAN32(sb, 0x60);
+  ro_compat = READ_LITTLE_ENDIAN32(sb, 0x64);
+  if ((EXT_INCOMPAT_META_BG & incompat) || (EXT_RO_COMPAT_BIGALLOC & ro_compat) || READ_LITTLE_ENDIAN32(sb, 0x18) > 6)
+    return false;
+
+  bs = 1024 << READ_LITTLE_ENDIAN32(sb, 0x18);
+  blocks = READ_LITTLE_ENDIAN32(sb, 0x04);
+  dsz = 32;
+  if (EXT_INCOMPAT_64BIT & incompat)
+  {
+    blocks |= ((uint64_t)READ_LITTLE_ENDIAN32(sb, 0x150)) << 32;
+    dsz = READ_LITTLE_ENDIAN16(sb, 0xFE);
+  }
+  fdb = READ_LITTLE_ENDIAN32(sb, 0x14);
+  bpg = READ_LITTLE_ENDIAN32(sb, 0x20);
+  ipg = READ_LITTLE_ENDIAN32(sb, 0x28);
+  isz = 0 == READ_LITTLE_ENDIAN32(sb, 0x4C) ? 128 : READ_LITTLE_ENDIAN16(sb, 0x58);
+  rsv = READ_LITTLE_ENDIAN16(sb, 0xCE);
+  uninit_valid = 0 != ((EXT_RO_COMPAT_GDT_CSUM | EXT_RO_COMPAT_METADATA_CSUM) & ro_compat);
+
+  if (0 == bpg || 0 != (bpg & 7) || bpg > (bs << 3) || blocks <= fdb || (blocks * bs) > map->part_size || dsz < 32 || dsz > 1024 || 0 == isz)
+    return false;
+
+  groups = (blocks - fdb + bpg - 1) / bpg;
+  gdt_blocks = (groups * dsz + bs - 1) / bs;
+  itb = (((uint64_t)ipg) * isz + bs - 1) / bs;
+
+  map->unit = bs;
+  map->units_fp = fdb * bs;
+  map->num_units = blocks - fdb;
+  map->head = FS_MAP_EDGE_SIZE;
+
+  if (!fsMapCreateBitmap(map))
+    return false;
+
+  gdt = (uint8_t*)malloc((size_t)(gdt_blocks * bs));
+  bmp = (uint8_t*)malloc(FS_MAP_READ_SIZE);
+  if (NULL == gdt || NULL == bmp || !fsMapRead(map, (fdb + 1) * bs, gdt, gdt_blocks * bs))
+    goto Exit;
+
+  // the block bitmaps; with flex_bg, the bitmaps of consecutive groups are adjacent and read at once
+
+  for (g = 0; g < groups; g = g2)
+  {
+    g2 = g + 1;
+    desc = gdt + g * dsz;
+    if (uninit_valid && (EXT_BG_BLOCK_UNINIT & READ_LITTLE_ENDIAN16(desc, 0x12)))
+      continue;
+
+    bb = fsMapExtDescBlock(desc, 0x00, dsz);
+    for (; g2 < groups && (g2 - g) < (FS_MAP_READ_SIZE / bs); g2++)
+    {
+      desc = gdt + g2 * dsz;
+      if ((uninit_valid && (EXT_BG_BLOCK_UNINIT & READ_LITTLE_ENDIAN16(desc, 0x12))) || fsMapExtDescBlock(desc, 0x00, dsz) != (bb + (g2 - g)))
+        break;
+    }
+
+    if ((bb + (g2 - g)) > blocks || !fsMapRead(map, bb * bs, bmp, (g2 - g) * bs))
+      goto Exit;
+
+    for (k = g; k < g2; k++)
+    {
+      count = map->num_units - k * bpg;
+      if (count > bpg)
+        count = bpg;
+      memcpy(map->bitmap + ((k * bpg) >> 3), bmp + (k - g) * bs, (size_t)((count + 7) >> 3));
+    }
+  }
+
+  // the metadata is used even if the block bitmap of its group is not initialized
+
+  for (g = 0; g < groups; g++)
+  {
+    desc = gdt + g * dsz;
+    fsMapExtSetBlocks(map, fdb, fsMapExtDescBlock(desc, 0x00, dsz), 1);
+    fsMapExtSetBlocks(map, fdb, fsMapExtDescBlock(desc, 0x04, dsz), 1);
+    fsMapExtSetBlocks(map, fdb, fsMapExtDescBlock(desc, 0x08, dsz), itb);
+    if (fsMapExtHasSuper(sb, g))
+      fsMapExtSetBlocks(map, fdb, fdb + g * bpg, 1 + gdt_blocks + rsv);
+  }
+
+  ok = true;
+
+Exit:
+  if (NULL != gdt)
+    free(gdt);
+  if (NULL != bmp)
+    free(bmp);
+
+  return ok;
+}
+
+static bool fsMapNtfs(fs_map_ptr map)
+{
+  uint8_t             boot[SECTOR_SIZE], *rec = NULL, *attr;
+  uint64_t            sectors, cluster, mft_lcn, vcn = 0, length, n, bitmap_size;
+  int64_t             lcn = 0, delta;
+  uint32_t            bps, spc, rec_size, ofs, len, usa_ofs, usa_cnt, i, nl, no;
+  int32_t             c;
+  bool                ok = false;
+
+  if (!fsMapRead(map, 0, boot, sizeof(boot)) || memcmp(&boot[0x03], "NTFS    ", 8))
+    return false;
+
+  bps = READ_LITTLE_ENDIAN16(boot, 0x0B);
+  spc = boot[0x0D];
+  if (spc > 0x80)
+    spc = (256 - spc) < 12 ? (1u << (256 - spc)) : 0;
+  if (bps < SECTOR_SIZE || bps > 4096 || 0 != (bps & (bps - 1)) || 0 == spc)
+    return false;
+
+  cluster = ((uint64_t)bps) * spc;
+  sectors = READ_LITTLE_ENDIAN64(boot, 0x28);
+  mft_lcn = READ_LITTLE_ENDIAN64(boot, 0x30);
+  c = (int8_t)boot[0x40];
+  if (c > 0)
+    rec_size = (uint32_t)(c * cluster);
+  else
+    rec_size = (c < 0 && c > -17) ? (1u << (-c)) : 0;
+
+  if (rec_size < SECTOR_SIZE || rec_size > (64 << 10) || 0 != (rec_size & SECTOR_SIZE_MASK) || (sectors * bps) > map->part_size)
+    return false;
+
+  map->unit = (uint32_t)cluster;
+  map->units_fp = 0;
+  map->num_units = sectors / spc;
+  map->head = FS_MAP_EDGE_SIZE;
+
+  if (!fsMapCreateBitmap(map))
+    return false;
+  bitmap_size = ((map->num_units + 63) >> 6) << 3;
+
+  // the MFT record of $Bitmap: the first records of the MFT are always contiguous
+
+  rec = (uint8_t*)malloc(rec_size);
+  if (NULL == rec || !fsMapRead(map, mft_lcn * cluster + NTFS_MFT_RECORD_BITMAP * rec_size, rec, rec_size) || memcmp(rec, "FILE", 4))
+    goto Exit;
+
+  usa_ofs = READ_LITTLE_ENDIAN16(rec, 0x04);
+  usa_cnt = READ_LITTLE_ENDIAN16(rec, 0x06);
+  if (0 == usa_cnt || (usa_ofs + (usa_cnt << 1)) > rec_size || ((usa_cnt - 1) * NTFS_FIXUP_STRIDE) > rec_size)
+    goto Exit;
+
+  for (i = 1; i < usa_cnt; i++)
+  {
+    ofs = i * NTFS_FIXUP_STRIDE - 2;
+    if (rec[ofs] != rec[usa_ofs] || rec[ofs + 1] != rec[usa_ofs + 1])
+      goto Exit;
+    rec[ofs] = rec[usa_ofs + (i << 1)];
+    rec[ofs + 1] = rec[usa_ofs + (i << 1) + 1];
+  }
+
+  // the unnamed $DATA attribute
+
+  for (ofs = READ_LITTLE_ENDIAN16(rec, 0x14); ; ofs += len)
+  {
+    if ((ofs + 0x18) > rec_size || NTFS_ATTR_END == READ_LITTLE_ENDIAN32(rec, ofs))
+      goto Exit;
+    len = READ_LITTLE_ENDIAN32(rec, ofs + 4);
+    if (len < 0x18 || len > (rec_size - ofs))
+      goto Exit;
+    if (NTFS_ATTR_DATA == READ_LITTLE_ENDIAN32(rec, ofs) && 0 == rec[ofs + 9])
+      break;
+  }
+  attr = rec + ofs;
+
+  if (0 == attr[0x08]) // resident (tiny volumes)
+  {
+    n = READ_LITTLE_ENDIAN32(attr, 0x10);
+    ofs = READ_LITTLE_ENDIAN16(attr, 0x14);
+    if ((ofs + n) > len || n < ((map->num_units + 7) >> 3))
+      goto Exit;
+    memcpy(map->bitmap, attr + ofs, (size_t)(n > bitmap_size ? bitmap_size : n));
+  }
+  else
+  {
+    // the data runs (a $Bitmap fragmented into an attribute list is not supported)
+
+    if (len < 0x40 || 0 != READ_LITTLE_ENDIAN64(attr, 0x10))
+      goto Exit;
+
+    for (ofs = READ_LITTLE_ENDIAN16(attr, 0x20); ofs < len && 0 != attr[ofs]; ofs += 1 + nl + no)
+    {
+      nl = attr[ofs] & 0x0F;
+      no = attr[ofs] >> 4;
+      if (0 == nl || nl > 8 || 0 == no || no > 8 || (ofs + 1 + nl + no) > len)
+        goto Exit;
+
+      for (length = 0, i = 0; i < nl; i++)
+        length |= ((uint64_t)attr[ofs + 1 + i]) << (i << 3);
+      for (delta = 0, i = 0; i < no; i++)
+        delta |= ((int64_t)attr[ofs + 1 + nl + i]) << (i << 3);
+      if (no < 8 && (0x80 & attr[ofs + nl + no]))
+        delta -= ((int64_t)1) << (no << 3);
+      lcn += delta;
+
+      if ((vcn * cluster) < bitmap_size)
+      {
+        n = length * cluster;
+        if (n > (bitmap_size - vcn * cluster))
+          n = bitmap_size - vcn * cluster;
+        if (lcn < 0 || !fsMapRead(map, ((uint64_t)lcn) * cluster, map->bitmap + vcn * cluster, n))
+          goto Exit;
+      }
+      vcn += length;
+    }
+
+    if ((vcn * cluster) < ((map->num_units + 7) >> 3))
+      goto Exit;
+  }
+
+  ok = true;
+
+Exit:
+  if (NULL != rec)
+    free(rec);
+
+  return ok;
+}
+
+static bool fsMapFat(fs_map_ptr map)
+{
+  uint8_t             boot[SECTOR_SIZE], *fat;
+  uint64_t            total, fat_size, data, clusters, need, off, n, c, v;
+  uint32_t            bps, spc, rsv, nfats, rds, bits;
+  bool                ok = false;
+
+  if (!fsMapRead(map, 0, boot, sizeof(boot)) || 0x55 != boot[0x1FE] || 0xAA != boot[0x1FF])
+    return false;
+
+  bps = READ_LITTLE_ENDIAN16(boot, 0x0B);
+  spc = boot[0x0D];
+  rsv = READ_LITTLE_ENDIAN16(boot, 0x0E);
+  nfats = boot[0x10];
+  rds = (READ_LITTLE_ENDIAN16(boot, 0x11) * 32 + bps - 1) / (0 == bps ? 1 : bps);
+  total = READ_LITTLE_ENDIAN16(boot, 0x13);
+  if (0 == total)
+    total = READ_LITTLE_ENDIAN32(boot, 0x20);
+  fat_size = READ_LITTLE_ENDIAN16(boot, 0x16);
+  if (0 == fat_size)
+    fat_size = READ_LITTLE_ENDIAN32(boot, 0x24);
+
+  if (bps < SECTOR_SIZE || bps > 4096 || 0 != (bps & (bps - 1)) || 0 == spc || 0 != (spc & (spc - 1)) ||
+      0 == rsv || 0 == nfats || 0 == fat_size || (total * bps) > map->part_size)
+    return false;
+
+  data = rsv + nfats * fat_size + rds;
+  if (total <= data)
+    return false;
+
+  // the FAT type is determined by the number of clusters only
+
+  clusters = (total - data) / spc;
+  bits = clusters < 4085 ? 12 : (clusters < 65525 ? 16 : 32);
+  need = ((clusters + 2) * bits + 7) >> 3;
+  if (need > (fat_size * bps) || (12 == bits && need > FS_MAP_READ_SIZE))
+    return false;
+
+  map->unit = bps * spc;
+  map->units_fp = data * bps;
+  map->num_units = clusters;
+  map->head = map->units_fp > FS_MAP_EDGE_SIZE ? map->units_fp : FS_MAP_EDGE_SIZE; // reserved sectors, FATs, root directory
+
+  if (!fsMapCreateBitmap(map))
+    return false;
+
+  fat = (uint8_t*)malloc(FS_MAP_READ_SIZE);
+  if (NULL == fat)
+    return false;
+
+  // the first FAT in pieces (a piece always holds complete FAT16/32 entries); non-zero entries are used
+
+  for (off = 0; off < need; off += n)
+  {
+    n = (need - off) > FS_MAP_READ_SIZE ? FS_MAP_READ_SIZE : need - off;
+    if (!fsMapRead(map, ((uint64_t)rsv) * bps + off, fat, n))
+      goto Exit;
+
+    for (c = (off << 3) / bits; c < (((off + n) << 3) / bits) && c < (clusters + 2); c++)
+    {
+      if (12 == bits)
+        v = (c & 1) ? (READ_LITTLE_ENDIAN16(fat, (c * 3) >> 1) >> 4) : (READ_LITTLE_ENDIAN16(fat, (c * 3) >> 1) & 0x0FFF);
+      else
+      if (16 == bits)
+        v = READ_LITTLE_ENDIAN16(fat, (c << 1) - off);
+      else
+        v = READ_LITTLE_ENDIAN32(fat, (c << 2) - off) & 0x0FFFFFFF;
+
+      if (c >= 2 && 0 != v)
+        fsMapSetUnits(map, c - 2, 1);
+    }
+  }
+
+  ok = true;
+
+Exit:
+  free(fat);
+
+  return ok;
+}
+
+bool fs_map_used(DISK_HANDLE h, uint32_t fs_type, uint64_t part_fp, uint64_t part_size, fs_extent_list_ptr el)
+{
+  fs_map              map;
+  bool                ok = false;
+
+  memset(&map, 0, sizeof(map));
+  map.h = h;
+  map.part_fp = part_fp;
+  map.part_size = part_size;
+
+  map.io = fsMapAlloc(FS_MAP_READ_SIZE, &map.io_mem);
+  if (NULL == map.io)
+    return false;
+
+  switch (fs_type)
+  {
+    case FSYS_LINUX_EXT2:
+    case FSYS_LINUX_EXT3:
+    case FSYS_LINUX_EXT4:
+      ok = fsMapExt(&map);
+      break;
+
+    case FSYS_WIN_NTFS:
+      ok = fsMapNtfs(&map);
+      break;
+
+    case FSYS_WIN_FAT12:
+    case FSYS_WIN_FAT16:
+    case FSYS_WIN_FAT32:
+      ok = fsMapFat(&map);
+      break;
+
+    default:
+      break;
+  }
+
+  if (ok)
+    ok = fsMapEmit(&map, el);
+
+  if (NULL != map.bitmap_mem)
+    free(map.bitmap_mem);
+  free(map.io_mem);
+
+  return ok;
+}
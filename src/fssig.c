@@ -0,0 +1,400 @@
+/**
+ * @file   fssig.c
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @brief  implementation of the file system signature engine. Each probe
+ *         declares the window it inspects; the near windows (first 4 KiB)
+ *         are read with one I/O, the far ones only if no near probe matches.
+ *
+ * [MIT license]
+ *
+ * Copyright (c) 2021 Ingo A. Kubbilun
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <part-y.h>
+
+#define READ_LITTLE_ENDIAN16(_buf,_ofs) ((((uint32_t)(_buf)[(_ofs)])<<0)|(((uint32_t)(_buf)[(_ofs)+1])<<8))
+#define READ_BIG_ENDIAN16(_buf,_ofs)    ((((uint32_t)(_buf)[(_ofs)])<<8)|(((uint32_t)(_buf)[(_ofs)+1])<<0))
+
+static const char fsNames[][32] =
+{
+  "*UNKNOWN*",
+  "Windows FAT12",
+  "Windows FAT16",
+  "Windows FAT32",
+  "Windows exFAT",
+  "Windows NTFS",
+  "Linux EXT2",
+  "Linux EXT3",
+  "Linux EXT4",
+  "Linux XFS",
+  "Linux Btrfs",
+  "LUKS encrypted volume",
+  "LVM2 physical volume",
+  "Linux swap",
+  "BitLocker encrypted volume",
+  "Windows ReFS",
+  "ZFS pool member"
+};
+
+static void copyLabel(char* label, const uint8_t* src, uint32_t size)
+{
+  uint32_t                  i;
+
+  if (size > FS_SIG_LABEL_SIZE - 1)
+    size = FS_SIG_LABEL_SIZE - 1;
+
+  for (i = 0; i < size && 0 != src[i]; i++)
+    label[i] = (char)src[i];
+  label[i] = 0;
+
+  // FAT labels are padded with blanks
+
+  while (i > 0 && ' ' == label[i - 1])
+    label[--i] = 0;
+}
+
+static bool parseUuidString(uint8_t* uuid, const uint8_t* str, uint32_t size)
+{
+  uint32_t                  i, n = 0;
+  uint8_t                   c, v;
+
+  for (i = 0; i < size && 0 != str[i] && n < 32; i++)
+  {
+    c = str[i];
+    if ('-' == c)
+      continue;
+    if (c >= '0' && c <= '9')
+      v = c - '0';
+    else
+    if (c >= 'a' && c <= 'f')
+      v = c - 'a' + 10;
+    else
+    if (c >= 'A' && c <= 'F')
+      v = c - 'A' + 10;
+    else
+      return false;
+
+    if (0 == (n & 1))
+      uuid[n >> 1] = (uint8_t)(v << 4);
+    else
+      uuid[n >> 1] |= v;
+    n++;
+  }
+
+  return 32 == n;
+}
+
+// all matchers get a pointer to their window (see the probe table below)
+
+static bool matchLuks(const uint8_t* w, fs_sig_result_ptr res)
+{
+  if (memcmp(w, "LUKS\xBA\xBE", 6))
+    return false;
+
+  if (!parseUuidString(res->uuid, &w[0xA8], 40))
+    memset(res->uuid, 0, sizeof(res->uuid));
+
+  if (2 == READ_BIG_ENDIAN16(w, 6)) // LUKS2 has a label
+    copyLabel(res->label, &w[0x18], 48);
+
+  return true;
+}
+
+static bool matchBitLocker(const uint8_t* w, fs_sig_result_ptr res)
+{
+  (void)res;
+
+  return 0 == memcmp(&w[0x03], "-FVE-FS-", 8);
+}
+
+static bool matchReFS(const uint8_t* w, fs_sig_result_ptr res)
+{
+  if (memcmp(&w[0x03], "ReFS\0\0\0\0", 8))
+    return false;
+
+  res->fs_size = READ_LITTLE_ENDIAN64(w, 0x18) * READ_LITTLE_ENDIAN32(w, 0x20);
+
+  return true;
+}
+
+static bool matchExFAT(const uint8_t* w, fs_sig_result_ptr res)
+{
+  if (memcmp(&w[0x03], "EXFAT   ", 8))
+    return false;
+
+  if (w[0x6C] < 32)
+    res->fs_size = READ_LITTLE_ENDIAN64(w, 0x48) << w[0x6C];
+
+  return true;
+}
+
+static bool matchNTFS(const uint8_t* w, fs_sig_result_ptr res)
+{
+  if (memcmp(&w[0x03], "NTFS    ", 8))
+    return false;
+
+  res->fs_size = READ_LITTLE_ENDIAN64(w, 0x28) * READ_LITTLE_ENDIAN16(w, 0x0B);
+
+  return true;
+}
+
+static void fatSize(const uint8_t* w, fs_sig_result_ptr res)
+{
+  uint64_t                  sectors = READ_LITTLE_ENDIAN16(w, 0x13);
+
+  if (0 == sectors)
+    sectors = READ_LITTLE_ENDIAN32(w, 0x20);
+
+  res->fs_size = sectors * READ_LITTLE_ENDIAN16(w, 0x0B);
+}
+
+static bool matchFAT32(const uint8_t* w, fs_sig_result_ptr res)
+{
+  if (!memcmp(&w[0x52], "FAT32   ", 8))
+    copyLabel(res->label, &w[0x47], 11);
+  else
+  if (memcmp(&w[0x36], "FAT32   ", 8))
+    return false;
+
+  fatSize(w, res);
+
+  return true;
+}
+
+static bool matchFAT16(const uint8_t* w, fs_sig_result_ptr res)
+{
+  if (!memcmp(&w[0x36], "FAT16   ", 8))
+    copyLabel(res->label, &w[0x2B], 11);
+  else
+  if (memcmp(&w[0x52], "FAT16   ", 8))
+    return false;
+
+  fatSize(w, res);
+
+  return true;
+}
+
+static bool matchFAT12(const uint8_t* w, fs_sig_result_ptr res)
+{
+  if (memcmp(&w[0x36], "FAT12   ", 8))
+    return false;
+
+  copyLabel(res->label, &w[0x2B], 11);
+  fatSize(w, res);
+
+  return true;
+}
+
+static bool matchXFS(const uint8_t* w, fs_sig_result_ptr res)
+{
+  if (memcmp(w, "XFSB", 4))
+    return false;
+
+  res->fs_size = READ_BIG_ENDIAN64(w, 0x08) * READ_BIG_ENDIAN32(w, 0x04);
+  memcpy(res->uuid, &w[0x20], 16);
+  copyLabel(res->label, &w[0x6C], 12);
+
+  return true;
+}
+
+static bool matchExt(const uint8_t* w, fs_sig_result_ptr res)
+{
+  uint64_t                  blocks;
+
+  // w points to the superblock (LBA 2 within the partition)
+
+  if (0x53 != w[0x38] || 0xEF != w[0x39])
+    return false;
+
+  memcpy(res->uuid, &w[0x68], 16); // this is full BIG ENDIAN UUID (not mixed endian as in GPT)
+  copyLabel(res->label, &w[0x78], 16);
+
+  blocks = READ_LITTLE_ENDIAN32(w, 0x04);
+  if (0x80 & w[0x60]) // INCOMPAT_64BIT
+    blocks |= ((uint64_t)READ_LITTLE_ENDIAN32(w, 0x150)) << 32;
+  if (READ_LITTLE_ENDIAN32(w, 0x18) < 16)
+    res->fs_size = blocks << (10 + READ_LITTLE_ENDIAN32(w, 0x18));
+
+  // 32bit Little Endian at 0x5C means: just check that byte!
+
+  if (0 == (0x04 & w[0x5C])) // no journal
+    res->fs_type = FSYS_LINUX_EXT2;
+  else
+  if (READ_LITTLE_ENDIAN32(w, 0x64) < 0x00000008) // EXT3 or EXT4
+    res->fs_type = FSYS_LINUX_EXT3;
+  else
+    res->fs_type = FSYS_LINUX_EXT4;
+
+  return true;
+}
+
+static bool matchBtrfs(const uint8_t* w, fs_sig_result_ptr res)
+{
+  if (memcmp(&w[0x40], "_BHRfS_M", 8))
+    return false;
+
+  memcpy(res->uuid, &w[0x20], 16);
+  res->fs_size = READ_LITTLE_ENDIAN64(w, 0x70);
+  copyLabel(res->label, &w[0x12B], 256);
+
+  return true;
+}
+
+static bool matchSwap(const uint8_t* w, fs_sig_result_ptr res)
+{
+  if (memcmp(&w[4096 - 10], "SWAPSPACE2", 10) && memcmp(&w[4096 - 10], "SWAP-SPACE", 10))
+    return false;
+
+  if (!memcmp(&w[4096 - 10], "SWAPSPACE2", 10))
+  {
+    res->fs_size = (((uint64_t)READ_LITTLE_ENDIAN32(w, 1024 + 0x04)) + 1) << 12;
+    memcpy(res->uuid, &w[1024 + 0x0C], 16);
+    copyLabel(res->label, &w[1024 + 0x1C], 16);
+  }
+
+  return true;
+}
+
+static bool matchLvm(const uint8_t* w, fs_sig_result_ptr res)
+{
+  uint32_t                  i, ofs;
+
+  // the label is in one of the first four sectors (usually the second one)
+
+  for (i = 0; i < 4; i++, w += SECTOR_SIZE)
+  {
+    if (memcmp(w, "LABELONE", 8) || memcmp(&w[0x18], "LVM2 001", 8))
+      continue;
+
+    ofs = READ_LITTLE_ENDIAN32(w, 0x14); // PV header: 32 characters of PV UUID, device size
+    if (ofs <= SECTOR_SIZE - 40)
+    {
+      copyLabel(res->label, &w[ofs], 32); // the PV UUID is not a hexadecimal UUID
+      res->fs_size = READ_LITTLE_ENDIAN64(w, ofs + 32);
+    }
+
+    return true;
+  }
+
+  return false;
+}
+
+static bool matchZfs(const uint8_t* w, fs_sig_result_ptr res)
+{
+  (void)res;
+
+  // first uberblock of the first label (either byte order)
+
+  return 0x00BAB10C == READ_LITTLE_ENDIAN64(w, 0) || 0x00BAB10C == READ_BIG_ENDIAN64(w, 0);
+}
+
+// the probes in the order of their priority: encryption and specific signatures at the start of
+// the partition first (a BitLocker volume still looks like FAT/NTFS), then the others; the far
+// probes (beyond FS_SIG_NEAR_WINDOW_SIZE) come last because they are only read on demand
+
+static const fs_sig_probe fsProbes[] =
+{
+  { FSYS_LUKS,        0x00000, 512,  matchLuks },
+  { FSYS_BITLOCKER,   0x00000, 512,  matchBitLocker },
+  { FSYS_WIN_REFS,    0x00000, 512,  matchReFS },
+  { FSYS_WIN_EXFAT,   0x00000, 512,  matchExFAT },
+  { FSYS_WIN_NTFS,    0x00000, 512,  matchNTFS },
+  { FSYS_WIN_FAT32,   0x00000, 512,  matchFAT32 },
+  { FSYS_WIN_FAT16,   0x00000, 512,  matchFAT16 },
+  { FSYS_WIN_FAT12,   0x00000, 512,  matchFAT12 },
+  { FSYS_XFS,         0x00000, 512,  matchXFS },
+  { FSYS_LINUX_EXT4,  0x00400, 1024, matchExt },            // EXT2/3/4, decided by the matcher
+  { FSYS_LINUX_SWAP,  0x00000, 4096, matchSwap },
+  { FSYS_LVM_PV,      0x00000, 2048, matchLvm },
+  { FSYS_BTRFS,       0x10000, 1024, matchBtrfs },
+  { FSYS_ZFS,         0x20000, 1024, matchZfs }
+};
+
+uint32_t fs_sig_window_size(uint64_t part_size)
+{
+  uint32_t                  i, end, size = 0;
+
+  for (i = 0; i < sizeof(fsProbes) / sizeof(fsProbes[0]); i++)
+  {
+    end = fsProbes[i].offset + fsProbes[i].size;
+    if (end <= FS_SIG_NEAR_WINDOW_SIZE && ((uint64_t)end) <= part_size && end > size)
+      size = end;
+  }
+
+  return (size + SECTOR_SIZE - 1) & (~SECTOR_SIZE_MASK);
+}
+
+uint32_t fs_sig_far_windows(uint64_t part_size, uint32_t* offsets, uint32_t* sizes, uint32_t max_windows)
+{
+  uint32_t                  i, end, num_windows = 0;
+
+  for (i = 0; i < sizeof(fsProbes) / sizeof(fsProbes[0]) && num_windows < max_windows; i++)
+  {
+    end = fsProbes[i].offset + fsProbes[i].size;
+    if (end <= FS_SIG_NEAR_WINDOW_SIZE || ((uint64_t)end) > part_size)
+      continue;
+
+    offsets[num_windows] = fsProbes[i].offset & (~SECTOR_SIZE_MASK);
+    sizes[num_windows] = ((end + SECTOR_SIZE - 1) & (~SECTOR_SIZE_MASK)) - offsets[num_windows];
+    num_windows++;
+  }
+
+  return num_windows;
+}
+
+uint32_t fs_sig_identify(const uint8_t* data, uint32_t data_size, fs_sig_result_ptr res)
+{
+  return fs_sig_identify_at(data, 0, data_size, res);
+}
+
+uint32_t fs_sig_identify_at(const uint8_t* data, uint32_t data_offset, uint32_t data_size, fs_sig_result_ptr res)
+{
+  uint32_t                  i;
+
+  memset(res, 0, sizeof(fs_sig_result));
+
+  if (NULL == data)
+    return FSYS_UNKNOWN;
+
+  for (i = 0; i < sizeof(fsProbes) / sizeof(fsProbes[0]); i++)
+  {
+    if (fsProbes[i].offset < data_offset ||
+        ((uint64_t)fsProbes[i].offset) + fsProbes[i].size > ((uint64_t)data_offset) + data_size)
+      continue;
+
+    res->fs_type = fsProbes[i].fs_type;
+
+    if (fsProbes[i].match(data + (fsProbes[i].offset - data_offset), res))
+      return res->fs_type;
+
+    memset(res, 0, sizeof(fs_sig_result));
+  }
+
+  return FSYS_UNKNOWN;
+}
+
+const char* fs_sig_name(uint32_t fs_type)
+{
+  if (fs_type >= sizeof(fsNames) / sizeof(fsNames[0]))
+    return fsNames[FSYS_UNKNOWN];
+
+  return fsNames[fs_type];
+}
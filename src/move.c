@@ -0,0 +1,746 @@
+/**
+ * @file   move.c
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @brief  implementation of the data move engine (overlap-safe, pipelined,
+ *         checkpoints) and of the move command.
+ *
+ * [MIT license]
+ *
+ * Copyright (c) 2021 Ingo A. Kubbilun
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <part-y.h>
+
+typedef struct _move_run                move_run, * move_run_ptr;
+typedef struct _move_stream             move_stream, * move_stream_ptr;
+typedef struct _move_worker             move_worker, * move_worker_ptr;
+
+struct _move_run
+{
+  DISK_HANDLE                           h;                          ///< shared handle (positional I/O only)
+  uint64_t                              src;                        ///< byte offset of the source
+  uint64_t                              dst;                        ///< byte offset of the destination
+  uint32_t                              chunk_size;                 ///< transfer size of one operation
+  volatile uint64_t                     errors;                     ///< number of failed operations
+};
+
+struct _move_stream
+{
+  move_run_ptr                          run;                        ///< back pointer to the run
+  bool                                  write;                      ///< true: write the segment to the destination, false: read it from the source
+  uint8_t                              *buffer;                     ///< the segment buffer (one of the ring)
+  uint64_t                              start;                      ///< first byte of the segment (relative to the range)
+  uint64_t                              end;                        ///< first byte after the segment (relative to the range)
+  volatile uint64_t                     next_chunk;                 ///< next chunk of the segment to be processed
+  volatile uint64_t                     bytes;                      ///< number of bytes read (written) so far
+};
+
+struct _move_worker
+{
+  move_stream_ptr                       stream;                     ///< segment the worker currently processes
+  bool                                  io_error;                   ///< true if a read or write failed
+};
+
+static void move_task(void* arg)
+{
+  move_worker_ptr     mwp = (move_worker_ptr)arg;
+  move_stream_ptr     ms = mwp->stream;
+  move_run_ptr        run = ms->run;
+  uint64_t            ofs, size = ms->end - ms->start;
+  uint32_t            this_size;
+  bool                ok;
+
+  while (0 == atomic_load64(&run->errors))
+  {
+    ofs = (atomic_add64(&ms->next_chunk, 1) - 1) * run->chunk_size;
+    if (ofs >= size)
+      break;
+
+    this_size = (size - ofs) > run->chunk_size ? run->chunk_size : (uint32_t)(size - ofs);
+
+    if (ms->write)
+      ok = disk_write_at(run->h, run->dst + ms->start + ofs, ms->buffer + ofs, this_size);
+    else
+      ok = disk_read_at(run->h, run->src + ms->start + ofs, ms->buffer + ofs, this_size);
+
+    if (!ok)
+    {
+      mwp->io_error = true;
+      atomic_add64(&run->errors, 1);
+      break;
+    }
+
+    atomic_add64(&ms->bytes, this_size);
+  }
+}
+
+static uint8_t* move_alloc(uint64_t size, void** mem)
+{
+  *mem = malloc((size_t)size + SECTOR_MEM_ALIGN);
+  if (unlikely(NULL == *mem))
+    return NULL;
+
+  return (uint8_t*)((((uint64_t)*mem) + (SECTOR_MEM_ALIGN - 1)) & (~((uint64_t)(SECTOR_MEM_ALIGN - 1))));
+}
+
+static void move_segment(uint64_t total, uint64_t segment_size, bool downwards, uint64_t k, uint64_t* start, uint64_t* end)
+{
+  // upwards, segment 0 is the first one of the range; downwards, it is the last one
+
+  if (!downwards)
+  {
+    *start = k * segment_size;
+    *end = (total - *start) > segment_size ? *start + segment_size : total;
+  }
+  else
+  {
+    *end = total - k * segment_size;
+    *start = *end > segment_size ? *end - segment_size : 0;
+  }
+}
+
+static bool move_load_checkpoint(const char* checkpoint_file, disk_ptr dp, uint64_t src_lba, uint64_t dst_lba, uint64_t num_lbas,
+                                 uint64_t* segment_size, uint64_t* segments_done)
+{
+  FILE               *f = fopen(checkpoint_file, "rt");
+  char                line[1024];
+  uint64_t            device_size, src, dst, num;
+  int                 n = 0;
+  size_t              l;
+  bool                found = false;
+
+  if (NULL == f)
+    return false;
+
+  while (NULL != fgets(line, sizeof(line), f))
+  {
+    if ('#' == line[0])
+      continue;
+
+    if (6 != sscanf(line, "%" FMT64 "u %" FMT64 "u %" FMT64 "u %" FMT64 "u %" FMT64 "u %" FMT64 "u %n",
+                    &device_size, &src, &dst, &num, segment_size, segments_done, &n) || 0 == n)
+      continue;
+
+    l = strlen(line + n);
+    while ((0 != l) && ('\r' == line[n + l - 1] || '\n' == line[n + l - 1]))
+      line[n + --l] = 0;
+
+    if (strcmp(line + n, dp->device_file) || (device_size != dp->device_size) || (src != src_lba) || (dst != dst_lba) || (num != num_lbas))
+      continue;
+
+    found = true;
+    break;
+  }
+
+  fclose(f);
+
+  return found;
+}
+
+static bool move_save_checkpoint(const char* checkpoint_file, disk_ptr dp, uint64_t src_lba, uint64_t dst_lba, uint64_t num_lbas,
+                                 uint64_t segment_size, uint64_t segments_done)
+{
+  char                text[1024];
+  int                 n;
+
+  n = snprintf(text, sizeof(text),
+               "# part-y move checkpoint (written by the move command, do not edit)\n"
+               "# size src_lba dst_lba num_lbas segment_size segments_done device\n"
+               "%" FMT64 "u %" FMT64 "u %" FMT64 "u %" FMT64 "u %" FMT64 "u %" FMT64 "u %s\n",
+               dp->device_size, src_lba, dst_lba, num_lbas, segment_size, segments_done, dp->device_file);
+  if (n < 0 || n >= (int)sizeof(text))
+    return false;
+
+  // a resumed overlapping move must never restart at an older segment: replace the file atomically
+
+  return file_replace(checkpoint_file, text, (uint32_t)n);
+}
+
+bool move_lba_range(disk_ptr dp, uint64_t src_lba, uint64_t dst_lba, uint64_t num_lbas, uint32_t num_workers, const char* checkpoint_file, const char* message)
+{
+  move_worker         readers[WORKPOOL_MAX_THREADS / 2], writers[WORKPOOL_MAX_THREADS / 2];
+  move_stream         streams[2];
+  move_run            run;
+  workpool_ptr        wp = NULL;
+  DISK_HANDLE         h = INVALID_DISK_HANDLE;
+  uint32_t            chunk_size, i, cur = 0;
+  uint64_t            total = num_lbas << SECTOR_SHIFT, distance, segment_size, num_segments, next_segment = 0, segments_done = 0;
+  uint64_t            cp_segment_size, cp_segments_done, done = 0, remaining, t0, elapsed;
+  bool                downwards = dst_lba > src_lba, checkpoints = NULL != checkpoint_file && 0 != checkpoint_file[0];
+  bool                prev_valid = false, io_error, ok = false;
+  void               *mem[2] = { NULL, NULL };
+  uint8_t            *buffers[2];
+  char                size_str[32], rate_str[32];
+
+  if ((0 == num_lbas) || (src_lba == dst_lba))
+    return true;
+
+  memset(readers, 0, sizeof(readers));
+  memset(writers, 0, sizeof(writers));
+
+  distance = (downwards ? dst_lba - src_lba : src_lba - dst_lba) << SECTOR_SHIFT;
+
+  // transfer size and concurrency: caller (command line), device profile, built-in defaults
+
+  chunk_size = disk_io_size(dp, dp->io_write_size, MOVE_DEFAULT_CHUNK_SIZE);
+  if (0 == num_workers)
+    num_workers = 0 != dp->io_write_depth ? dp->io_write_depth : MOVE_DEFAULT_WORKERS;
+  if (num_workers > (WORKPOOL_MAX_THREADS / 2))
+    num_workers = WORKPOOL_MAX_THREADS / 2;
+  segment_size = ((uint64_t)chunk_size) * MOVE_SEGMENT_CHUNKS;
+
+  // a segment written partially (interrupted move) must not overlap its own source, which is
+  // read again when the move is resumed; a small distance would result in tiny segments, each
+  // of them flushed and recorded, i.e. the move would take ages
+
+  if (checkpoints && distance < total && distance < MOVE_MIN_CHECKPOINT_SEGMENT)
+  {
+    format_disk_size(distance, size_str, sizeof(size_str));
+    fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": the move distance (%s) is too small for checkpoints, an interrupted move cannot be resumed.\n", size_str);
+    checkpoints = false;
+  }
+
+  if (checkpoints && segment_size > distance)
+    segment_size = distance;
+
+  if (checkpoints && move_load_checkpoint(checkpoint_file, dp, src_lba, dst_lba, num_lbas, &cp_segment_size, &cp_segments_done) &&
+      0 != cp_segment_size && 0 == (cp_segment_size & SECTOR_SIZE_MASK) && cp_segment_size <= distance &&
+      cp_segments_done <= ((total + cp_segment_size - 1) / cp_segment_size))
+  {
+    segment_size = cp_segment_size;
+    segments_done = cp_segments_done;
+    format_64bit(segments_done * segment_size > total ? total : segments_done * segment_size, size_str, sizeof(size_str));
+    fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": resuming the move from checkpoint: %s byte(s) already moved.\n", size_str);
+  }
+
+  if (((uint64_t)chunk_size) > segment_size)
+    chunk_size = (uint32_t)segment_size;
+  num_segments = (total + segment_size - 1) / segment_size;
+  next_segment = segments_done;
+
+  if (segments_done == num_segments)
+    return true;
+
+  format_disk_size(segment_size, size_str, sizeof(size_str));
+  format_disk_size(chunk_size, rate_str, sizeof(rate_str));
+  fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": copying %s in segments of %s, %u worker(s), transfer size %s.\n",
+    downwards ? "downwards (destination above source)" : "upwards (destination below source)", size_str, num_workers, rate_str);
+
+  h = disk_open_device_batched(dp->device_file);
+  if (INVALID_DISK_HANDLE == h)
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": Unable to access the device/image file for writing.\n");
+    return false;
+  }
+
+  // ring of two segment buffers: the next segment is read into one while the other one is written
+
+  buffers[0] = move_alloc(segment_size, &mem[0]);
+  buffers[1] = move_alloc(segment_size, &mem[1]);
+  if (NULL == buffers[0] || NULL == buffers[1])
+    goto NoMemory;
+
+  wp = workpool_create(num_workers << 1, 0);
+  if (NULL == wp)
+  {
+NoMemory:
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": Insufficient memory available.\n");
+    goto Exit;
+  }
+
+  memset(&run, 0, sizeof(run));
+  run.h = h;
+  run.src = src_lba << SECTOR_SHIFT;
+  run.dst = dst_lba << SECTOR_SHIFT;
+  run.chunk_size = chunk_size;
+
+  remaining = total - (segments_done * segment_size); // bytes of all outstanding segments
+
+  memset(streams, 0, sizeof(streams));
+
+  fprintf(stdout, "%s", message);
+  fflush(stdout);
+
+  t0 = get_time_usec();
+
+  // pipeline: segment k is written while segment k+1 is read; reading ahead of the write is safe
+  // because the copy direction keeps the write position behind the read position
+
+  while ((next_segment < num_segments) || prev_valid)
+  {
+    if (next_segment < num_segments)
+    {
+      memset(&streams[cur], 0, sizeof(move_stream));
+      streams[cur].run = &run;
+      streams[cur].buffer = buffers[cur];
+      move_segment(total, segment_size, downwards, next_segment, &streams[cur].start, &streams[cur].end);
+
+      for (i = 0; i < num_workers; i++)
+      {
+        readers[i].stream = &streams[cur];
+        (void)workpool_submit(wp, WORKPOOL_NO_KEY, move_task, &readers[i]);
+      }
+    }
+
+    if (prev_valid)
+    {
+      streams[cur ^ 1].write = true;
+      streams[cur ^ 1].next_chunk = 0;
+      streams[cur ^ 1].bytes = 0;
+
+      for (i = 0; i < num_workers; i++)
+      {
+        writers[i].stream = &streams[cur ^ 1];
+        (void)workpool_submit(wp, WORKPOOL_NO_KEY, move_task, &writers[i]);
+      }
+    }
+
+    while (!workpool_wait(wp, MOVE_PROGRESS_INTERVAL_MS))
+    {
+      fprintf(stdout, "\r%s" CTRL_GREEN "%3.2f%%" CTRL_RESET, message,
+        (((double)(done + (prev_valid ? atomic_load64(&streams[cur ^ 1].bytes) : 0))) * 100.0) / ((double)remaining));
+      fflush(stdout);
+    }
+
+    if (0 != atomic_load64(&run.errors))
+    {
+      fprintf(stdout, "\r%s" CTRL_RED "ERROR" CTRL_RESET "     \n", message);
+
+      io_error = false;
+      for (i = 0; i < num_workers; i++)
+        io_error |= readers[i].io_error | writers[i].io_error;
+
+      if (io_error)
+        fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": Unable to perform write or read operation.\n");
+      goto Exit;
+    }
+
+    // the written segment is durable before the checkpoint refers to it, and the checkpoint is
+    // stored before the next segment is written
+
+    if (prev_valid)
+    {
+      done += streams[cur ^ 1].end - streams[cur ^ 1].start;
+      segments_done++;
+
+      if (checkpoints)
+      {
+        if (!disk_flush_device(h) || !move_save_checkpoint(checkpoint_file, dp, src_lba, dst_lba, num_lbas, segment_size, segments_done))
+        {
+          fprintf(stdout, "\r%s" CTRL_RED "ERROR" CTRL_RESET "     \n", message);
+          fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": Unable to flush the device or to write the checkpoint file %s.\n", checkpoint_file);
+          goto Exit;
+        }
+      }
+    }
+
+    prev_valid = next_segment < num_segments;
+    if (prev_valid)
+      next_segment++;
+    cur ^= 1;
+  }
+
+  if (!disk_flush_device(h))
+  {
+    fprintf(stdout, "\r%s" CTRL_RED "ERROR" CTRL_RESET "     \n", message);
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": Unable to flush the device.\n");
+    goto Exit;
+  }
+
+  elapsed = get_time_usec() - t0;
+
+  fprintf(stdout, "\r%s" CTRL_GREEN "OK" CTRL_RESET "     \n", message);
+
+  format_disk_size(remaining, size_str, sizeof(size_str));
+  format_disk_size(0 == elapsed ? 0 : (uint64_t)((((double)remaining) * 1000000.0) / ((double)elapsed)), rate_str, sizeof(rate_str));
+  fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": moved %s in %.2f s = %s/s\n", size_str, ((double)elapsed) / 1000000.0, rate_str);
+
+  ok = true;
+
+Exit:
+  if (NULL != wp)
+    workpool_destroy(wp);
+
+  if (NULL != mem[0])
+    free(mem[0]);
+  if (NULL != mem[1])
+    free(mem[1]);
+
+  disk_close_device(h);
+
+  return ok;
+}
+
+static bool move_patch_boot_sector(DISK_HANDLE h, write_plan_ptr wpp, uint64_t old_start, uint64_t new_start, uint64_t rel_lba, uint8_t* p, const char* description)
+{
+  // the hidden sectors field (BPB offset 0x1C) holds the partition start if it was set at all
+
+  if (!disk_read_at(h, (old_start + rel_lba) << SECTOR_SHIFT, p, SECTOR_SIZE) || 0x55 != p[0x1FE] || 0xAA != p[0x1FF] ||
+      READ_LITTLE_ENDIAN32(p, 0x1C) != old_start)
+    return true;
+
+  WRITE_LITTLE_ENDIAN32(p, 0x1C, new_start);
+
+  return write_plan_add(wpp, new_start + rel_lba, 1, p, description);
+}
+
+static bool move_patch_hidden_sectors(disk_ptr dp, write_plan_ptr wpp, uint64_t old_start, uint64_t new_start, uint64_t num_lbas)
+{
+  DISK_HANDLE         h;
+  fs_sig_result       res;
+  void               *mem = NULL;
+  uint8_t            *p;
+  uint64_t            backup_lba = 0;
+  uint32_t            fs_type;
+  bool                ok = false;
+
+  p = move_alloc(SECTOR_SIZE, &mem);
+  if (NULL == p)
+    return false;
+
+  h = disk_open_device(dp->device_file, false/*read-only*/);
+  if (INVALID_DISK_HANDLE == h || !disk_read_at(h, old_start << SECTOR_SHIFT, p, SECTOR_SIZE))
+  {
+    ok = true; // nothing to be patched if the boot sector cannot be read (the move fails anyway)
+    goto Exit;
+  }
+
+  // FAT and NTFS boot sectors (and their backups) store the partition start in a 32bit field
+
+  fs_type = fs_sig_identify(p, SECTOR_SIZE, &res);
+  switch (fs_type)
+  {
+    case FSYS_WIN_FAT12:
+    case FSYS_WIN_FAT16:
+      break;
+    case FSYS_WIN_FAT32:
+      backup_lba = ((uint64_t)p[0x32]) | (((uint64_t)p[0x33]) << 8);
+      if (0xFFFF == backup_lba || backup_lba >= (((uint64_t)p[0x0E]) | (((uint64_t)p[0x0F]) << 8)))
+        backup_lba = 0;
+      break;
+    case FSYS_WIN_NTFS:
+      backup_lba = READ_LITTLE_ENDIAN64(p, 0x28);
+      if (backup_lba >= num_lbas)
+        backup_lba = 0;
+      break;
+    default:
+      ok = true;
+      goto Exit;
+  }
+
+  if (READ_LITTLE_ENDIAN32(p, 0x1C) != old_start)
+  {
+    ok = true;
+    goto Exit;
+  }
+
+  if (new_start > 0xFFFFFFFF)
+  {
+    fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": the hidden sectors of the %s boot sector cannot store LBA %" FMT64 "u, they are left as they are.\n",
+      fs_sig_name(fs_type), new_start);
+    ok = true;
+    goto Exit;
+  }
+
+  fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": the hidden sectors of the %s boot sector%s are updated.\n", fs_sig_name(fs_type), 0 != backup_lba ? " and its backup" : "");
+
+  ok = move_patch_boot_sector(h, wpp, old_start, new_start, 0, p, "boot sector (hidden sectors)");
+  if (ok && 0 != backup_lba)
+    ok = move_patch_boot_sector(h, wpp, old_start, new_start, backup_lba, p, "backup boot sector (hidden sectors)");
+
+Exit:
+  disk_close_device(h);
+  free(mem);
+
+  return ok;
+}
+
+int move_partition(cmdline_args_ptr cap)
+{
+  disk_ptr            dp = cap->work_disk;
+  write_plan_ptr      wpp = NULL;
+  gpt_ptr             g = NULL;
+  gpt_entry_ptr       gep = NULL;
+  mbr_entry_ptr       mep = NULL;
+  uint64_t            old_start, num_lbas, new_start, new_lbas, new_end, first_usable, last_usable, start, end, lba;
+  uint32_t            i, idx, entry_sectors;
+  void               *buffer_mem = NULL;
+  uint8_t            *p;
+  char                error[256], size_str[32], size_str2[32];
+  int                 exitcode = 1;
+
+  if (NULL == dp)
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": No working disk available.\n");
+    return 1;
+  }
+
+  if (SECTOR_SIZE != dp->logical_sector_size)
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": logical sector size %u is not supported.\n", dp->logical_sector_size);
+    return 1;
+  }
+
+  if (0 == cap->part_no)
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": please specify the partition to be moved (--part-no).\n");
+    return 1;
+  }
+  idx = cap->part_no - 1;
+
+  // the partition and the area it may occupy
+
+  if (dp->primary_gpt_exists || dp->backup_gpt_exists)
+  {
+    if (!dp->primary_gpt_exists || dp->primary_gpt_corrupt || !dp->backup_gpt_exists || dp->backup_gpt_corrupt || dp->gpts_mismatch)
+    {
+      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": the GPTs are not healthy, please run the repairgpt command first.\n");
+      return 1;
+    }
+
+    gep = gpt_find_entry(dp->gpt1, idx);
+    if (NULL == gep)
+    {
+      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": there is no partition %u in the GPT.\n", cap->part_no);
+      return 1;
+    }
+
+    old_start = gep->part_start_lba;
+    num_lbas = gep->part_end_lba - gep->part_start_lba + 1;
+    first_usable = dp->gpt1->header.first_usable_lba;
+    last_usable = dp->gpt1->header.last_usable_lba;
+  }
+  else
+  if (NULL != dp->mbr && NULL != dp->mbr->sp && !(DISK_FLAG_MBR_IS_PROTECTIVE & dp->flags))
+  {
+    if (idx > 3)
+    {
+      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": only the primary partitions 1..4 of an MBR can be moved.\n");
+      return 1;
+    }
+
+    mep = &dp->mbr->part_table[idx];
+    if (0 == mep->part_type || 0 == mep->num_sectors)
+    {
+      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": there is no partition %u in the MBR.\n", cap->part_no);
+      return 1;
+    }
+
+    if (MBR_IS_EXTENDED_PARTITION(mep->part_type))
+    {
+      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": an extended partition cannot be moved (the logical drives refer to it).\n");
+      return 1;
+    }
+
+    old_start = mep->start_sector;
+    num_lbas = mep->num_sectors;
+    first_usable = 1;
+    last_usable = (dp->device_sectors > 0x100000000 ? 0x100000000 : dp->device_sectors) - 1;
+  }
+  else
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": the disk neither contains a GPT nor an MBR with partitions.\n");
+    return 1;
+  }
+
+  // new location and size; REMAINING grows the partition up to the next one (or the end of the usable area)
+
+  new_start = 0 != cap->to_lba ? cap->to_lba : old_start;
+
+  if (((uint64_t)-1) == cap->part_size)
+  {
+    new_end = last_usable;
+    for (i = 0; i < (NULL != gep ? dp->gpt1->num_entries : 4); i++)
+    {
+      if (NULL != gep)
+      {
+        if (dp->gpt1->entries[i].slot == idx)
+          continue;
+        start = dp->gpt1->entries[i].part_start_lba;
+      }
+      else
+      {
+        if (i == idx || 0 == dp->mbr->part_table[i].num_sectors)
+          continue;
+        start = dp->mbr->part_table[i].start_sector;
+      }
+      if (start > new_start && start <= new_end)
+        new_end = start - 1;
+    }
+    new_lbas = new_end >= new_start ? new_end - new_start + 1 : 0;
+  }
+  else
+    new_lbas = 0 != cap->part_size ? cap->part_size >> SECTOR_SHIFT : num_lbas;
+
+  if (new_lbas < num_lbas)
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": a partition cannot be shrunk (its file system would be truncated).\n");
+    return 1;
+  }
+
+  new_end = new_start + new_lbas - 1;
+  if (new_start < first_usable || new_end > last_usable || new_end < new_start)
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": LBAs %" FMT64 "u..%" FMT64 "u are outside of the usable area %" FMT64 "u..%" FMT64 "u.\n",
+      new_start, new_end, first_usable, last_usable);
+    return 1;
+  }
+
+  // the new location may overlap the old one but no other partition
+
+  for (i = 0; i < (NULL != gep ? dp->gpt1->num_entries : 4); i++)
+  {
+    if (NULL != gep)
+    {
+      if (dp->gpt1->entries[i].slot == idx)
+        continue;
+      start = dp->gpt1->entries[i].part_start_lba;
+      end = dp->gpt1->entries[i].part_end_lba;
+    }
+    else
+    {
+      if (i == idx || 0 == dp->mbr->part_table[i].num_sectors)
+        continue;
+      start = dp->mbr->part_table[i].start_sector;
+      end = start + dp->mbr->part_table[i].num_sectors - 1;
+    }
+
+    if (!((end < new_start) || (start > new_end)))
+    {
+      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": LBAs %" FMT64 "u..%" FMT64 "u overlap partition %u (LBAs %" FMT64 "u..%" FMT64 "u).\n",
+        new_start, new_end, (NULL != gep ? dp->gpt1->entries[i].slot : i) + 1, start, end);
+      return 1;
+    }
+  }
+
+  if (new_start == old_start && new_lbas == num_lbas)
+  {
+    fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": partition %u already starts at LBA %" FMT64 "u with this size, nothing to be done.\n", cap->part_no, old_start);
+    return 0;
+  }
+
+  // the new partition table: the backup GPT is durable before the primary GPT refers to the new
+  // location (the same order as the GPT repair)
+
+  wpp = write_plan_create();
+  if (NULL == wpp)
+    goto NoMemory;
+
+  if (NULL != gep)
+  {
+    entry_sectors = GPT_ENTRY_ARRAY_SECTORS(dp->gpt1->header);
+
+    g = partition_clone_gpt(dp->gpt1);
+    p = move_alloc(((uint64_t)(1 + entry_sectors)) << SECTOR_SHIFT, &buffer_mem);
+    if (NULL == g || NULL == p)
+      goto NoMemory;
+
+    gep = gpt_find_entry(g, idx);
+    gep->part_start_lba = new_start;
+    gep->part_end_lba = new_end;
+
+    lba = gpt_repair_table(p, g, true /*primary is the template of the backup*/) >> SECTOR_SHIFT;
+    if (!write_plan_add(wpp, lba, 1 + entry_sectors, p, "backup GPT"))
+      goto NoMemory;
+    write_plan_barrier(wpp);
+
+    gpt_create_table(p, g, true /*primary*/);
+    if (!write_plan_add(wpp, g->header.current_lba, 1 + entry_sectors, p, "primary GPT"))
+      goto NoMemory;
+  }
+  else
+  {
+    p = move_alloc(SECTOR_SIZE, &buffer_mem);
+    if (NULL == p)
+      goto NoMemory;
+
+    memcpy(p, dp->mbr->sp->data, SECTOR_SIZE);
+    mbr_create_entry(&p[0x01BE + (idx << 4)], mep->boot_flag, mep->part_type, new_start, new_lbas);
+    if (!write_plan_add(wpp, 0, 1, p, "MBR"))
+      goto NoMemory;
+  }
+
+  // the BPB of a FAT or NTFS file system refers to the start of the partition
+
+  if (new_start != old_start && !move_patch_hidden_sectors(dp, wpp, old_start, new_start, num_lbas))
+    goto NoMemory;
+
+  format_disk_size(num_lbas << SECTOR_SHIFT, size_str, sizeof(size_str));
+  fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": partition %u: LBAs %" FMT64 "u..%" FMT64 "u -> %" FMT64 "u..%" FMT64 "u (%s of data).\n",
+    cap->part_no, old_start, old_start + num_lbas - 1, new_start, new_end, size_str);
+  if (new_lbas != num_lbas)
+  {
+    format_disk_size(new_lbas << SECTOR_SHIFT, size_str2, sizeof(size_str2));
+    fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": the partition grows from %s to %s; the file system has to be grown separately.\n", size_str, size_str2);
+  }
+
+  if (cap->dryrun)
+  {
+    fprintf(stdout, CTRL_MAGENTA "DRYRUN" CTRL_RESET ": Explaining what would be done.\n");
+    if (new_start != old_start)
+    {
+      fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": The data would be copied %s, the ranges %s.\n",
+        new_start > old_start ? "downwards" : "upwards", (new_start < (old_start + num_lbas) && old_start < (new_start + num_lbas)) ? "overlap" : "do not overlap");
+      if (0 != cap->checkpoint_file[0])
+        fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": Progress would be stored in the checkpoint file %s.\n", cap->checkpoint_file);
+    }
+    write_plan_dump(wpp);
+    exitcode = 0;
+    goto Exit;
+  }
+
+  if (new_start != old_start)
+  {
+    if (0 == cap->checkpoint_file[0])
+      fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": no checkpoint file (--checkpoint), an interrupted move cannot be resumed.\n");
+
+    if (!move_lba_range(dp, old_start, new_start, num_lbas, cap->num_threads, cap->checkpoint_file,
+                        CTRL_CYAN "WORKING" CTRL_RESET " : Moving the partition data ................................: "))
+      goto Exit;
+  }
+
+  fprintf(stdout, CTRL_CYAN "WORKING" CTRL_RESET " : Writing the new partition table ..........................: ");
+  if (!write_plan_execute(wpp, dp->device_file, error, sizeof(error)))
+  {
+    fprintf(stdout, CTRL_RED "ERROR" CTRL_RESET "\n          %s.\n", error);
+    goto Exit;
+  }
+  fprintf(stdout, CTRL_GREEN "OK" CTRL_RESET "\n");
+
+  if (0 != cap->checkpoint_file[0])
+    (void)remove(cap->checkpoint_file);
+
+  exitcode = 0;
+  goto Exit;
+
+NoMemory:
+  fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": Insufficient memory available.\n");
+
+Exit:
+  if (NULL != g)
+    partition_free_gpt(g);
+  if (NULL != wpp)
+    write_plan_free(wpp);
+  if (NULL != buffer_mem)
+    free(buffer_mem);
+
+  return exitcode;
+}
@@ -222,20 +222,62 @@ static int onInfo(cmdline_args_ptr cap)
   return 0;
 }
 
+#define FILL_DEFAULT_CHUNK_SIZE   (8 << 20)   ///< write size if there is no device profile
+#define FILL_DEFAULT_WORKERS      4           ///< number of writes in flight if there is no device profile
+#define FILL_PROGRESS_INTERVAL_MS 500
+
+typedef struct _fill_job        fill_job, *fill_job_ptr;
+
+struct _fill_job
+{
+  DISK_HANDLE                   h;
+  const uint8_t                *buffer;                         ///< zeros (chunk_size bytes, aligned)
+  uint32_t                      chunk_size;
+  uint64_t                      fill_size;
+  volatile uint64_t             next_chunk;                     ///< next chunk to be written (shared by all workers)
+  volatile uint64_t             errors;
+};
+
+static void fill_task(void* arg)
+{
+  fill_job_ptr  fjp = (fill_job_ptr)arg;
+  uint64_t      fp, this_size;
+
+  while (0 == atomic_load64(&fjp->errors))
+  {
+    fp = (atomic_add64(&fjp->next_chunk, 1) - 1) * fjp->chunk_size;
+    if (fp >= fjp->fill_size)
+      break;
+
+    this_size = fjp->fill_size - fp;
+    if (this_size > fjp->chunk_size)
+      this_size = fjp->chunk_size;
+
+    if (!disk_write_at(fjp->h, fp, fjp->buffer, (uint32_t)this_size))
+      atomic_add64(&fjp->errors, 1);
+  }
+}
+
 static int onFill(cmdline_args_ptr cap)
 {
-  uint64_t      fill_size, current = 0, this_size;
-  char          str[32];
+  uint64_t      fill_size, zero_size, current;
+  uint32_t      method = DISK_ZERO_NONE;
+  char          str[32], message[256];
   uint8_t      *zero_buffer;
-#ifdef _WINDOWS
-  DWORD         dwWritten;
-#endif
+  fill_job      fj;
+  workpool_ptr  wp;
+  uint32_t      i, num_workers;
+
+  memset(&fj, 0, sizeof(fj));
 
   if (0 == cap->file_size)
     fill_size = cap->work_disk->device_size;
   else
     fill_size = cap->file_size;
 
+  if (((uint64_t)-1) == fill_size)
+    fill_size = cap->work_disk->device_size;
+
   if (cap->dryrun)
   {
     fprintf(stdout, CTRL_MAGENTA "DRYRUN" CTRL_RESET ": Explaining what would be done.\n");
@@ -264,11 +306,14 @@ static int onFill(cmdline_args_ptr cap)
           format_64bit(fill_size, str, sizeof(str));
           fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": Image file size will be adjusted to %s byte(s).\n", str);
         }
+        fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": Image file will be %s.\n", cap->preallocate ? "preallocated" : "sparse (no data written)");
       }
     }
   }
   else // no dry-run!
   {
+    disk_pool_release(cap->device_name); // idle pooled handles of the device are not needed anymore
+
 #ifdef _WINDOWS
 
     HANDLE h = CreateFile(cap->device_name, GENERIC_WRITE, FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_WRITE_THROUGH | FILE_FLAG_NO_BUFFERING, NULL);
@@ -292,7 +337,7 @@ static int onFill(cmdline_args_ptr cap)
     if (-1 == h)
     {
       if (!cap->device_is_real_device)
-        h = open(cap->device_name, O_WRONLY | O_SYNC | O_DIRECT | O_CREAT);
+        h = open(cap->device_name, O_WRONLY | O_SYNC | O_DIRECT | O_CREAT, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
 
       if (-1 == h)
       {
@@ -303,47 +348,110 @@ static int onFill(cmdline_args_ptr cap)
 
 #endif
 
-    zero_buffer = (uint8_t*)malloc(1024 * 1024);
-    if (unlikely(NULL == zero_buffer))
+    // image files: the range beyond the current end of the file is a hole created by disk_resize_image() below
+
+    zero_size = fill_size;
+    if ((!cap->device_is_real_device) && (zero_size > cap->work_disk->device_size))
+      zero_size = cap->work_disk->device_size;
+
+    // sparse image files: nothing to be zeroed if the range does not contain any data at all
+
+    if ((0 != zero_size) && (DISK_FLAG_SPARSE_FILE & cap->work_disk->flags) && !disk_range_has_data(h, 0, zero_size))
     {
-      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": Insufficient memory available.\n");
-ErrorExit:
-#ifdef _WINDOWS
-      CloseHandle(h);
-#else
-      close(h);
-#endif
-      return 1;
+      zero_size = 0;
+      fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": image file does not contain any data (sparse), nothing to be zeroed.\n");
     }
 
-    memset(zero_buffer, 0, 1024 * 1024);
+    snprintf(message, sizeof(message), CTRL_CYAN "WORKING" CTRL_RESET " : Filling with zeros ......................................: ");
+    fprintf(stdout, "%s", message);
+    fflush(stdout);
 
-    while (current != fill_size)
+    // fast path: let the device (or the file system) zero the range without transferring any data
+
+    if ((0 == zero_size) || disk_zero_range(cap->work_disk, h, 0, zero_size, message, &method))
+    {
+      fprintf(stdout, "\r%s" CTRL_GREEN "OK" CTRL_RESET "     \n", message);
+      if (0 != zero_size)
+        fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": zeroing method: %s\n", disk_zero_method_name(method));
+    }
+    else
     {
-      this_size = 1024 * 1024;
-      if (this_size > (fill_size - current))
-        this_size = fill_size - current;
+      // slow path: large zero writes, several of them in flight (see device profile); all workers share one zero buffer
+
+      fj.chunk_size = disk_io_size(cap->work_disk, cap->work_disk->io_write_size, FILL_DEFAULT_CHUNK_SIZE);
+      num_workers = 0 != cap->work_disk->io_write_depth ? cap->work_disk->io_write_depth : FILL_DEFAULT_WORKERS;
 
+      zero_buffer = (uint8_t*)malloc(fj.chunk_size + SECTOR_MEM_ALIGN);
+      if (unlikely(NULL == zero_buffer))
+      {
+        fprintf(stdout, CTRL_RED "ERROR" CTRL_RESET "\n");
+        fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": Insufficient memory available.\n");
+ErrorExit:
 #ifdef _WINDOWS
-      if ((!WriteFile(h,zero_buffer,(DWORD)this_size,&dwWritten,NULL)) || (dwWritten != ((DWORD)this_size)))
+        CloseHandle(h);
 #else
-      if (((uint32_t)this_size) != write(h, zero_buffer, (uint32_t)this_size))
+        close(h);
 #endif
+        return 1;
+      }
+
+      fj.h = h;
+      fj.buffer = (uint8_t*)((((uint64_t)zero_buffer) + (SECTOR_MEM_ALIGN - 1)) & (~((uint64_t)(SECTOR_MEM_ALIGN - 1))));
+      fj.fill_size = zero_size;
+
+      memset((uint8_t*)fj.buffer, 0, fj.chunk_size);
+
+      wp = workpool_create(num_workers, 0);
+      if (NULL != wp)
+      {
+        for (i = 0; i < num_workers; i++)
+          (void)workpool_submit(wp, WORKPOOL_NO_KEY, fill_task, &fj);
+
+        while (!workpool_wait(wp, FILL_PROGRESS_INTERVAL_MS))
+        {
+          current = atomic_load64(&fj.next_chunk) * fj.chunk_size;
+          if (current > zero_size)
+            current = zero_size;
+          fprintf(stdout, "\r%s" CTRL_GREEN "%3.2f%%" CTRL_RESET, message, (((double)current) * 100.0) / ((double)zero_size));
+          fflush(stdout);
+        }
+
+        workpool_destroy(wp);
+      }
+      else
+        fill_task(&fj);
+
+      free(zero_buffer);
+
+      if (0 != fj.errors)
       {
+        fprintf(stdout, "\r%s" CTRL_RED "ERROR" CTRL_RESET "     \n", message);
         fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": Unable to perform write operation.\n");
         goto ErrorExit;
       }
 
-      current += this_size;
+      fprintf(stdout, "\r%s" CTRL_GREEN "OK" CTRL_RESET "     \n", message);
+      fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": zeroing method: %s\n", disk_zero_method_name(DISK_ZERO_NONE));
     }
+
 #ifdef _WINDOWS
     CloseHandle(h);
 #else
     close(h);
 #endif
 
-    if ((!cap->device_is_real_device) && (fill_size != cap->work_disk->device_sectors))
-      truncate(cap->device_name, fill_size);
+    // image files: truncate/extend without writing data; --preallocate re-allocates the punched holes, too
+
+    if ((!cap->device_is_real_device) && ((fill_size != cap->work_disk->device_size) || cap->preallocate))
+    {
+      if (!disk_resize_image(cap->device_name, fill_size, cap->preallocate))
+      {
+        fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": unable to truncate/extend %s to the specified file size\n", cap->device_name);
+        return 1;
+      }
+      cap->work_disk->device_size = fill_size;
+      cap->work_disk->device_sectors = fill_size >> SECTOR_SHIFT;
+    }
   }
 
   return 0;
@@ -495,8 +603,11 @@ static int onHexdump(cmdline_args_ptr cap)
 
 static int onRestore (cmdline_args_ptr cap)
 {
-  char          message[256];
+  char          message[256], error[256];
   DISK_HANDLE   h = INVALID_DISK_HANDLE;
+  FILE_HANDLE   f;
+  uint64_t      backup_size;
+  write_plan_ptr wpp;
 
   if (NULL == cap->work_disk)
   {
@@ -510,12 +621,6 @@ static int onRestore (cmdline_args_ptr cap)
     return 1;
   }
 
-  if (cap->dryrun)
-  {
-    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": Please specify '--yes-do-it' because there is NO dry-run available (restore).\n");
-    return 1;
-  }
-
   // Check that backup file is available
 
   fprintf(stdout, CTRL_CYAN "CHECKING" CTRL_RESET ": Have backup file ........................................: ");
@@ -533,7 +638,61 @@ static int onRestore (cmdline_args_ptr cap)
     return 1;
   }
 
-  // Restore it to the device
+  f = file_open(cap->backup_file, true/*read-only*/);
+  backup_size = (INVALID_FILE_HANDLE != f) ? file_get_size(f) : 0;
+  if (INVALID_FILE_HANDLE != f)
+    file_close(f, false);
+
+  // A backup that fits into a write plan is verified completely before anything is written
+
+  if (backup_size <= WRITE_PLAN_MAX_BYTES)
+  {
+    snprintf(message, sizeof(message), CTRL_CYAN "CHECKING" CTRL_RESET ": Reading and verifying the backup file ...................: ");
+    fprintf(stdout, "%s", message);
+    fflush(stdout);
+
+    wpp = write_plan_create();
+    if (NULL == wpp || !restore_backup_plan(cap->work_disk, cap->backup_file, wpp, message))
+    {
+      fprintf(stdout, CTRL_RED "ERROR" CTRL_RESET "\n          The backup file is invalid or does not match the disk.\n");
+      write_plan_free(wpp);
+      return 1;
+    }
+
+    fprintf(stdout, CTRL_GREEN "OK" CTRL_RESET "\n");
+
+    if (cap->dryrun)
+    {
+      fprintf(stdout, CTRL_MAGENTA "DRYRUN" CTRL_RESET ": Explaining what would be done.\n");
+      write_plan_dump(wpp);
+      write_plan_free(wpp);
+      return 0;
+    }
+
+    fprintf(stdout, CTRL_CYAN "WORKING" CTRL_RESET " : Restoring backup to the disk device .....................: ");
+    fflush(stdout);
+
+    if (!write_plan_execute(wpp, cap->work_disk->device_file, error, sizeof(error)))
+    {
+      fprintf(stdout, CTRL_RED "ERROR" CTRL_RESET "\n          %s.\n", error);
+      write_plan_free(wpp);
+      return 1;
+    }
+
+    write_plan_free(wpp);
+
+    fprintf(stdout, CTRL_GREEN "OK" CTRL_RESET "\n");
+
+    return 0;
+  }
+
+  if (cap->dryrun)
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": Please specify '--yes-do-it' because there is NO dry-run available (restore of a backup larger than %u MiB).\n", WRITE_PLAN_MAX_BYTES >> 20);
+    return 1;
+  }
+
+  // Restore it to the device (streamed)
 
   fprintf(stdout, CTRL_CYAN "WORKING" CTRL_RESET " : Restoring backup to the disk device .....................: ");
   fflush(stdout);
@@ -561,18 +720,157 @@ static int onRestore (cmdline_args_ptr cap)
   return 0;
 }
 
+static int onBackup(cmdline_args_ptr cap)
+{
+  char                message[256], size_str[32];
+  DISK_HANDLE         h = INVALID_DISK_HANDLE;
+  backup_header_ptr   bhp;
+  backup_record_ptr   brp;
+
+  if (0 != cap->fleet_file[0])
+    return fleet_backup(cap);
+
+  if (NULL == cap->work_disk)
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": No working disk available.\n");
+    return 1;
+  }
+
+  if (0 == cap->backup_file[0])
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": Please specify a backup file.\n");
+    return 1;
+  }
+
+  bhp = bootstrap_backup(cap->work_disk->device_sectors);
+  if ((NULL == bhp) || (!backup_add_partition_tables(cap->work_disk, bhp)))
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": Unable to prepare the backup records.\n");
+    free_backup_structure(bhp);
+    return 1;
+  }
+
+  if (0 != cap->lba_range_end)
+  {
+    if (!add_backup_record(bhp, cap->lba_range_start, cap->lba_range_end - cap->lba_range_start + 1))
+    {
+      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": specified LBA range is outside of the physical disk size.\n");
+      free_backup_structure(bhp);
+      return 1;
+    }
+  }
+
+  if (cap->dryrun)
+  {
+    fprintf(stdout, CTRL_MAGENTA "DRYRUN" CTRL_RESET ": Explaining what would be done.\n");
+
+    brp = bhp->head;
+    while (NULL != brp)
+    {
+      fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": backing up LBAs %"FMT64"u..%"FMT64"u (%"FMT64"u sector(s))\n", brp->start_lba, brp->start_lba + brp->num_lbas - 1, brp->num_lbas);
+      brp = brp->next;
+    }
+
+    format_disk_size(backup_get_data_size(bhp), size_str, sizeof(size_str));
+    fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": backup file %s would contain %s of disk data.\n", cap->backup_file, size_str);
+
+    free_backup_structure(bhp);
+    return 0;
+  }
+
+  fprintf(stdout, CTRL_CYAN "WORKING" CTRL_RESET " : Creating backup of the partition table(s) ...............: ");
+  fflush(stdout);
+
+  h = disk_open_device(cap->work_disk->device_file, false/*read-only*/);
+  if (INVALID_DISK_HANDLE == h)
+  {
+    fprintf(stdout, CTRL_RED "ERROR" CTRL_RESET "\n          Unable to open the device %s for reading.\n", cap->work_disk->device_file);
+    free_backup_structure(bhp);
+    return 1;
+  }
+
+  snprintf(message, sizeof(message), CTRL_CYAN "WORKING" CTRL_RESET " : Creating backup of the partition table(s) ...............: ");
+
+  if (!create_backup_file(cap->work_disk, bhp, h, cap->backup_file, message))
+  {
+    fprintf(stdout, CTRL_RED "ERROR" CTRL_RESET "\n          Unable to create backup file %s\n", cap->backup_file);
+ErrorExit:
+    disk_close_device(h);
+    free_backup_structure(bhp);
+    return 1;
+  }
+
+  fprintf(stdout, CTRL_GREEN "OK" CTRL_RESET "\n");
+
+  fprintf(stdout, CTRL_CYAN "WORKING" CTRL_RESET " : Verifying just created backup ...........................: ");
+  fflush(stdout);
+
+  snprintf(message, sizeof(message), CTRL_CYAN "WORKING" CTRL_RESET " : Verifying just created backup ...........................: ");
+
+  if (!check_backup_file(cap->work_disk, h, cap->backup_file, message))
+  {
+    fprintf(stdout, CTRL_RED "ERROR" CTRL_RESET "\n          Unable to verify backup file.\n");
+    goto ErrorExit;
+  }
+
+  fprintf(stdout, CTRL_GREEN "OK" CTRL_RESET "\n");
+
+  disk_close_device(h);
+  free_backup_structure(bhp);
+
+  return 0;
+}
+
 extern int onPrepareWindows10(cmdline_args_ptr cap);
 
 extern uint8_t efi_load_option_additional_data_windows[0x88];
 
+static bool commandNeedsPartitionTables(uint32_t command)
+{
+  return COMMAND_FILL != command && COMMAND_HEXDUMP != command && COMMAND_WIPE != command && COMMAND_ENUMDISKS != command;
+}
+
+static bool commandWritesToDisk(const cmdline_args* cap)
+{
+  return COMMAND_RESTORE == cap->command || COMMAND_CREATE == cap->command || COMMAND_CONVERT == cap->command ||
+         COMMAND_CONVERTWIN10 == cap->command || COMMAND_PREPAREWIN10 == cap->command || COMMAND_REPAIRGPT == cap->command ||
+         COMMAND_WRITEPMBR == cap->command || COMMAND_FILL == cap->command || COMMAND_WIPE == cap->command ||
+         COMMAND_MOVE == cap->command || COMMAND_CLONE == cap->command || (COMMAND_PROBE == cap->command && 0 != cap->scratch_range_end);
+}
+
+static void attachScanCache(cmdline_args_ptr cap)
+{
+  disk_ptr            dp;
+
+  for (dp = cap->pd_head; NULL != dp; dp = dp->next)
+    dp->scan_cache = cap->scan_cache;
+}
+
+static bool isNewImageFile(const char* device_name)
+{
+  if (0 == device_name[0] || disk_file_exists(device_name))
+    return false;
+
+#ifdef _WINDOWS
+  if (device_name[0] >= '0' && device_name[0] <= '9') // physical drive number
+    return false;
+#else
+  if (!memcmp(device_name, "/dev/", sizeof("/dev/") - 1)) // never create device nodes
+    return false;
+#endif
+
+  return true;
+}
+
 int main(int argc, char* argv[])
 {
   int           exitcode = 1, i = -1;
   char         *p, *endp;
   uint32_t      part_type, l;
   uint64_t      part_size;
-  char          part_label[40];
+  char          part_label[40], size_str[32];
   disk_ptr      dp;
+  disk_pool_stats pool_stats;
 
 #if defined(_DEBUG) && defined(_WINDOWS)
   memset(&cms, 0, sizeof(cms));
@@ -631,6 +929,9 @@ int main(int argc, char* argv[])
 
   memset(&ca, 0, sizeof(ca));
   ca.win_sys_drive = 'C'; // C: is the default Windows system drive letter
+  ca.per_device_limit = 1; // one job per physical device (fleet operations)
+  ca.probe_timeout_ms = DISK_PROBE_DEFAULT_TIMEOUT_MS; // an unresponsive device does not block the enumeration
+  probe_default_profile_file(ca.profile_file, sizeof(ca.profile_file));
   strncpy(ca.locale, "en-US", sizeof(ca.locale) - 1); // en-US is the default locale, de-DE is used by author, though...
 
 #ifdef _WINDOWS
@@ -682,6 +983,18 @@ int main(int argc, char* argv[])
   if (!stricmp(argv[1], "enumdisks"))
     ca.command = COMMAND_ENUMDISKS;
   else
+  if (!stricmp(argv[1], "probe"))
+    ca.command = COMMAND_PROBE;
+  else
+  if (!stricmp(argv[1], "wipe"))
+    ca.command = COMMAND_WIPE;
+  else
+  if (!stricmp(argv[1], "move"))
+    ca.command = COMMAND_MOVE;
+  else
+  if (!stricmp(argv[1], "clone"))
+    ca.command = COMMAND_CLONE;
+  else
   {
 ShowHelp:
     fprintf(stdout, PROGRAM_INFO "\n");
@@ -704,7 +1017,9 @@ ShowHelp:
     fprintf(stdout, "      " CTRL_YELLOW "restore" CTRL_RESET "      restores a partition table/convertwin10 backup\n");
     fprintf(stdout, "      " CTRL_YELLOW "create" CTRL_RESET "       creates a full disk partioning in one step, optionally\n");
     fprintf(stdout, "                   formatting the partitions (Linux-only)\n");
-    fprintf(stdout, "      " CTRL_YELLOW "convert" CTRL_RESET "      converts MBR to GPT\n");
+    fprintf(stdout, "      " CTRL_YELLOW "convert" CTRL_RESET "      converts MBR to GPT in place (devices and image files);\n");
+    fprintf(stdout, "                   all partition table sectors are saved to --backup-file\n");
+    fprintf(stdout, "                   (default for image files: <image file>" CONVERT_BACKUP_SUFFIX ")\n");
     fprintf(stdout, "      " CTRL_YELLOW "preparewin10" CTRL_RESET " (Windows-only) performs checks if a conversion from\n");
     fprintf(stdout, "                   Windows 10 MBR-disk to Windows 10 GPT-disk is possible\n");
     fprintf(stdout, "                   Also creates Boot Configuration Data (BCD) using bcdedit.exe\n");
@@ -723,6 +1038,13 @@ ShowHelp:
     fprintf(stdout, "      " CTRL_YELLOW "fill" CTRL_RESET "         fills a device/file with zeros (" CTRL_RED "DANGEROUS!" CTRL_RESET ")\n");
     fprintf(stdout, "      " CTRL_YELLOW "hexdump" CTRL_RESET "      dumps one or more LBAs\n");
     fprintf(stdout, "      " CTRL_YELLOW "enumdisks" CTRL_RESET "    enumerates all found physical disks\n");
+    fprintf(stdout, "      " CTRL_YELLOW "probe" CTRL_RESET "        measures throughput and latency of a device/file and stores\n");
+    fprintf(stdout, "                   a device profile used by backup, restore and fill\n");
+    fprintf(stdout, "      " CTRL_YELLOW "wipe" CTRL_RESET "         overwrites a device/file with pattern and random passes\n");
+    fprintf(stdout, "                   verifying each pass (" CTRL_RED "DANGEROUS!" CTRL_RESET ")\n");
+    fprintf(stdout, "      " CTRL_YELLOW "move" CTRL_RESET "         moves and/or grows a partition (data and partition table)\n");
+    fprintf(stdout, "      " CTRL_YELLOW "clone" CTRL_RESET "        clones the disk onto --target (device or image file) and\n");
+    fprintf(stdout, "                   verifies the clone (" CTRL_RED "DANGEROUS!" CTRL_RESET " for the target)\n");
     fprintf(stdout, "\n");
 
     fprintf(stdout, CTRL_GREEN "  2.) common options:" CTRL_RESET "\n");
@@ -761,8 +1083,51 @@ ShowHelp:
     fprintf(stdout, "      " CTRL_MAGENTA "--file-size=<size>" CTRL_RESET " for 'createimg' command; <size> is specified\n");
     fprintf(stdout, "                         as for --partition, see above.\n");
     fprintf(stdout, "                         Can also be used to limit the size of a device.\n");
+    fprintf(stdout, "                         New image files are created sparse, i.e. instantly.\n");
+    fprintf(stdout, "      " CTRL_MAGENTA "--preallocate" CTRL_RESET " allocate all blocks of created or extended image\n");
+    fprintf(stdout, "                    files instead of creating sparse files.\n");
     fprintf(stdout, "      " CTRL_MAGENTA "--locale=<locale>" CTRL_RESET " locale to be used in the Boot Configuration\n");
     fprintf(stdout, "                         Data (BCD); defaults to 'en-US'.\n");
+    fprintf(stdout, "      " CTRL_MAGENTA "--fleet=<file>" CTRL_RESET " backup command: backs up all disks listed in <file>\n");
+    fprintf(stdout, "                     (one '<disk> <backup file>' per line) in one run.\n");
+    fprintf(stdout, "                     repairgpt command: repairs all disks listed in <file>\n");
+    fprintf(stdout, "                     (one '<disk>' per line) in parallel.\n");
+    fprintf(stdout, "                     convert command: converts all disks listed in <file>\n");
+    fprintf(stdout, "                     (one '<disk> <backup file>' per line) in parallel.\n");
+    fprintf(stdout, "      " CTRL_MAGENTA "--threads=<n>" CTRL_RESET " number of worker threads, defaults to number of CPUs\n");
+    fprintf(stdout, "      " CTRL_MAGENTA "--per-device=<n>" CTRL_RESET " max. number of concurrent jobs per physical\n");
+    fprintf(stdout, "                       device, defaults to 1.\n");
+    fprintf(stdout, "      " CTRL_MAGENTA "--max-bandwidth=<size>" CTRL_RESET " global I/O bandwidth limit per second of\n");
+    fprintf(stdout, "                             all workers; <size> as for --partition.\n");
+    fprintf(stdout, "      " CTRL_MAGENTA "--scratch-range=X,Y" CTRL_RESET " probe command: the 512-byte sector range X..Y\n");
+    fprintf(stdout, "                          may be overwritten by the write tests (" CTRL_RED "DATA LOST!" CTRL_RESET ").\n");
+    fprintf(stdout, "                          Without it, image files are probed in a region\n");
+    fprintf(stdout, "                          appended to the image, which is truncated away.\n");
+    fprintf(stdout, "      " CTRL_MAGENTA "--profile-file=<file>" CTRL_RESET " file containing the device profiles,\n");
+    fprintf(stdout, "                            defaults to " PROFILE_FILE_NAME " in the home directory.\n");
+    fprintf(stdout, "      " CTRL_MAGENTA "--scan-cache[=<file>]" CTRL_RESET " cache the partition table scans in <file>,\n");
+    fprintf(stdout, "                            defaults to " SCAN_CACHE_FILE_NAME " in the home directory;\n");
+    fprintf(stdout, "                            a cached scan is validated by reading LBAs 0 and 1.\n");
+    fprintf(stdout, "      " CTRL_MAGENTA "--probe-timeout=<ms>" CTRL_RESET " deadline for probing a device, defaults to %u ms;\n", DISK_PROBE_DEFAULT_TIMEOUT_MS);
+    fprintf(stdout, "                           a device missing it is reported as not accessible (0 = none).\n");
+    fprintf(stdout, "      " CTRL_MAGENTA "--passes=<list>" CTRL_RESET " wipe command: comma-separated list of passes,\n");
+    fprintf(stdout, "                      each is zero, one, random or a byte, e.g. 0x55;\n");
+    fprintf(stdout, "                      defaults to " WIPE_DEFAULT_PASSES ". Use --lba-range to wipe a range.\n");
+    fprintf(stdout, "      " CTRL_MAGENTA "--no-verify" CTRL_RESET " wipe and clone commands: do not read back the data.\n");
+    fprintf(stdout, "      " CTRL_MAGENTA "--checkpoint=<file>" CTRL_RESET " wipe and move commands: store the progress in\n");
+    fprintf(stdout, "                          <file>; an interrupted wipe or move is resumed from it.\n");
+    fprintf(stdout, "      " CTRL_MAGENTA "--part-no=<n>" CTRL_RESET " move command: the partition (1-based GPT slot or\n");
+    fprintf(stdout, "                    MBR primary partition 1..4).\n");
+    fprintf(stdout, "      " CTRL_MAGENTA "--to-lba=<lba>" CTRL_RESET " move command: new start LBA of the partition.\n");
+    fprintf(stdout, "      " CTRL_MAGENTA "--part-size=<size>" CTRL_RESET " move command: new (larger) size of the partition;\n");
+    fprintf(stdout, "                         <size> as for --partition, REMAINING grows it up to\n");
+    fprintf(stdout, "                         the next partition.\n");
+    fprintf(stdout, "      " CTRL_MAGENTA "--target=<disk>" CTRL_RESET " clone command: target device or image file; a\n");
+    fprintf(stdout, "                      missing image file is created (sparse). The backup GPT is\n");
+    fprintf(stdout, "                      moved to the end of a larger target.\n");
+    fprintf(stdout, "      " CTRL_MAGENTA "--used-only" CTRL_RESET " clone command: copy only the used blocks of EXT2/3/4,\n");
+    fprintf(stdout, "                  NTFS and FAT file systems (plus their metadata and everything\n");
+    fprintf(stdout, "                  outside of them); unused blocks of a target device are discarded.\n");
     fprintf(stdout, "\n");
     if ((-1 != i) && (i < argc))
       fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": unable to parse command line argument: %s\n", argv[i]);
@@ -785,6 +1150,50 @@ ShowHelp:
     if (!strcmp(argv[i],"--verbose"))
       ca.verbose = true;
     else
+    if (!strcmp(argv[i],"--preallocate"))
+      ca.preallocate = true;
+    else
+    if (!strcmp(argv[i],"--no-verify"))
+      ca.no_verify = true;
+    else
+    if (!strcmp(argv[i],"--used-only"))
+      ca.used_only = true;
+    else
+    if ((l > (sizeof("--passes=") - 1)) && (!memcmp(argv[i], "--passes=", sizeof("--passes=") - 1)))
+    {
+      strncpy(ca.wipe_passes, argv[i] + sizeof("--passes=") - 1, sizeof(ca.wipe_passes) - 1);
+      if (!wipe_parse_passes(ca.wipe_passes, NULL, &l))
+        goto ShowHelp;
+    }
+    else
+    if ((l > (sizeof("--checkpoint=") - 1)) && (!memcmp(argv[i], "--checkpoint=", sizeof("--checkpoint=") - 1)))
+      strncpy(ca.checkpoint_file, argv[i] + sizeof("--checkpoint=") - 1, sizeof(ca.checkpoint_file) - 1);
+    else
+    if ((l > (sizeof("--target=") - 1)) && (!memcmp(argv[i], "--target=", sizeof("--target=") - 1)))
+      strncpy(ca.target_name, argv[i] + sizeof("--target=") - 1, sizeof(ca.target_name) - 1);
+    else
+    if ((l > (sizeof("--part-no=") - 1)) && (!memcmp(argv[i], "--part-no=", sizeof("--part-no=") - 1)))
+    {
+      ca.part_no = (uint32_t)strtoul(argv[i] + sizeof("--part-no=") - 1, &endp, 10);
+      if (0 != *endp || 0 == ca.part_no)
+        goto ShowHelp;
+    }
+    else
+    if ((l > (sizeof("--to-lba=") - 1)) && (!memcmp(argv[i], "--to-lba=", sizeof("--to-lba=") - 1)))
+    {
+      ca.to_lba = (uint64_t)strtoull(argv[i] + sizeof("--to-lba=") - 1, &endp, 10);
+      if (0 != *endp || 0 == ca.to_lba)
+        goto ShowHelp;
+    }
+    else
+    if ((l > (sizeof("--part-size=") - 1)) && (!memcmp(argv[i], "--part-size=", sizeof("--part-size=") - 1)))
+    {
+      p = argv[i] + sizeof("--part-size=") - 1;
+
+      if (!scan_size(p, &endp, &ca.part_size) || 0 != *endp || 0 == ca.part_size)
+        goto ShowHelp;
+    }
+    else
     if ((l > (sizeof("--backup-file=") - 1)) && (!memcmp(argv[i], "--backup-file=", sizeof("--backup-file=") - 1)))
       strncpy(ca.backup_file, argv[i] + sizeof("--backup-file=") - 1, sizeof(ca.backup_file) - 1);
     else
@@ -798,6 +1207,34 @@ ShowHelp:
         goto ShowHelp;
     }
     else
+    if ((l > (sizeof("--scratch-range=") - 1)) && (!memcmp(argv[i], "--scratch-range=", sizeof("--scratch-range=") - 1)))
+    {
+      p = argv[i] + sizeof("--scratch-range=") - 1;
+      ca.scratch_range_start = (uint64_t)strtoull(p, &endp, 10);
+      if (endp == p || ',' != *endp)
+        goto ShowHelp;
+      p = endp + 1;
+      ca.scratch_range_end = (uint64_t)strtoull(p, &endp, 10);
+      if (endp == p || 0 != *endp || ca.scratch_range_end <= ca.scratch_range_start)
+        goto ShowHelp;
+    }
+    else
+    if ((l > (sizeof("--profile-file=") - 1)) && (!memcmp(argv[i], "--profile-file=", sizeof("--profile-file=") - 1)))
+      strncpy(ca.profile_file, argv[i] + sizeof("--profile-file=") - 1, sizeof(ca.profile_file) - 1);
+    else
+    if (!strcmp(argv[i], "--scan-cache"))
+      scan_cache_default_file(ca.scan_cache_file, sizeof(ca.scan_cache_file));
+    else
+    if ((l > (sizeof("--scan-cache=") - 1)) && (!memcmp(argv[i], "--scan-cache=", sizeof("--scan-cache=") - 1)))
+      strncpy(ca.scan_cache_file, argv[i] + sizeof("--scan-cache=") - 1, sizeof(ca.scan_cache_file) - 1);
+    else
+    if ((l > (sizeof("--probe-timeout=") - 1)) && (!memcmp(argv[i], "--probe-timeout=", sizeof("--probe-timeout=") - 1)))
+    {
+      ca.probe_timeout_ms = (uint32_t)strtoul(argv[i] + sizeof("--probe-timeout=") - 1, &endp, 10);
+      if (0 != *endp)
+        goto ShowHelp;
+    }
+    else
     if (!strcmp(argv[i],"--no-format"))
       ca.no_format = true;
     else
@@ -997,6 +1434,31 @@ ShowHelp:
     {
       strncpy(ca.locale, argv[i] + sizeof("--locale=") - 1, sizeof(ca.locale)-1);
     }
+    else
+    if ((l > (sizeof("--fleet=") - 1)) && (!memcmp(argv[i], "--fleet=", sizeof("--fleet=") - 1)))
+      strncpy(ca.fleet_file, argv[i] + sizeof("--fleet=") - 1, sizeof(ca.fleet_file) - 1);
+    else
+    if ((l > (sizeof("--threads=") - 1)) && (!memcmp(argv[i], "--threads=", sizeof("--threads=") - 1)))
+    {
+      ca.num_threads = (uint32_t)strtoul(argv[i] + sizeof("--threads=") - 1, &endp, 10);
+      if (0 != *endp || 0 == ca.num_threads || ca.num_threads > WORKPOOL_MAX_THREADS)
+        goto ShowHelp;
+    }
+    else
+    if ((l > (sizeof("--per-device=") - 1)) && (!memcmp(argv[i], "--per-device=", sizeof("--per-device=") - 1)))
+    {
+      ca.per_device_limit = (uint32_t)strtoul(argv[i] + sizeof("--per-device=") - 1, &endp, 10);
+      if (0 != *endp || 0 == ca.per_device_limit)
+        goto ShowHelp;
+    }
+    else
+    if ((l > (sizeof("--max-bandwidth=") - 1)) && (!memcmp(argv[i], "--max-bandwidth=", sizeof("--max-bandwidth=") - 1)))
+    {
+      p = argv[i] + sizeof("--max-bandwidth=") - 1;
+
+      if (!scan_size(p, &endp, &ca.max_bandwidth) || ((uint64_t)-1) == ca.max_bandwidth || 0 == ca.max_bandwidth)
+        goto ShowHelp;
+    }
     else
       goto ShowHelp;
   } // for all command line arguments
@@ -1008,9 +1470,7 @@ ShowHelp:
 
   if (!ca.yes_do_it)
   {
-    if (COMMAND_RESTORE == ca.command || COMMAND_CREATE == ca.command ||
-      COMMAND_CONVERT == ca.command || COMMAND_CONVERTWIN10 == ca.command || COMMAND_PREPAREWIN10 == ca.command ||
-      COMMAND_REPAIRGPT == ca.command || COMMAND_FILL == ca.command)
+    if (commandWritesToDisk(&ca))
     {
       if (!ca.dryrun)
       {
@@ -1032,15 +1492,80 @@ ShowHelp:
   
   if (COMMAND_VERSION != ca.command && COMMAND_HELP != ca.command)
   {
-    ca.num_physical_disks = disk_explore_all(&ca.pd_head, &ca.pd_tail);
+    // commands writing to disks never replay cached scans (the validator only covers LBAs 0 and 1),
+    // but they drop the entries of the written disks from an existing cache, --scan-cache or not
+
+    if (0 == ca.scan_cache_file[0] && commandWritesToDisk(&ca))
+    {
+      scan_cache_default_file(ca.scan_cache_file, sizeof(ca.scan_cache_file));
+      if (!disk_file_exists(ca.scan_cache_file))
+        ca.scan_cache_file[0] = 0;
+    }
+
+    if (0 != ca.scan_cache_file[0])
+    {
+      ca.scan_cache = scan_cache_load(ca.scan_cache_file);
+      if (NULL != ca.scan_cache)
+        ca.scan_cache->invalidate_only = commandWritesToDisk(&ca);
+    }
+
+    // discovery is lazy: only the specified device is opened and scanned (see below)
 
 #ifdef _WINDOWS
-    ca.wvp = disk_enumerate_windows_volumes();
-    ca.dvp = disk_enumerate_diskpart_volumes(&ca);
+    ca.num_physical_disks = disk_explore_all(&ca.pd_head, &ca.pd_tail); // maps drive numbers to devices
+    attachScanCache(&ca);
+
+    if (COMMAND_ENUMDISKS == ca.command || COMMAND_PREPAREWIN10 == ca.command || COMMAND_CONVERTWIN10 == ca.command)
+    {
+      disk_probe_all(ca.pd_head, true, ca.probe_timeout_ms); // the diskpart volumes are matched with the partition tables of all disks
+      ca.wvp = disk_enumerate_windows_volumes();
+      ca.dvp = disk_enumerate_diskpart_volumes(&ca);
+    }
+#else
+    if (COMMAND_ENUMDISKS == ca.command)
+    {
+      ca.num_physical_disks = disk_explore_all(&ca.pd_head, &ca.pd_tail); // sysfs only, no device is opened
+      attachScanCache(&ca);
+    }
 #endif
 
-    if (COMMAND_ENUMDISKS != ca.command)
+    if (COMMAND_ENUMDISKS != ca.command && !((COMMAND_BACKUP == ca.command || COMMAND_REPAIRGPT == ca.command || COMMAND_CONVERT == ca.command) && 0 != ca.fleet_file[0]))
     {
+      // fill and create may target a new image file, which is created as an empty (sparse) file
+
+      if ((COMMAND_FILL == ca.command || COMMAND_CREATE == ca.command) && isNewImageFile(ca.device_name))
+      {
+        if (ca.dryrun)
+        {
+          format_64bit(((uint64_t)-1) == ca.file_size ? 0 : ca.file_size, size_str, sizeof(size_str));
+          fprintf(stdout, CTRL_MAGENTA "DRYRUN" CTRL_RESET ": new image file %s would be created (%s, %s byte(s)).\n",
+            ca.device_name, ca.preallocate ? "preallocated" : "sparse", size_str);
+          exitcode = 0;
+          goto GlobalCleanUp;
+        }
+
+        // the size is checked before the file is created, so that no empty file is left behind
+
+        if (0 == ca.file_size)
+        {
+          fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": please specify --file-size for the file: %s\n", ca.device_name);
+          goto GlobalCleanUp;
+        }
+
+        if ((((uint64_t)-1) != ca.file_size) && (511 & ca.file_size))
+        {
+          fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": --file-size must be divisible by 512\n");
+          goto GlobalCleanUp;
+        }
+
+        if (!disk_resize_image(ca.device_name, 0, false))
+        {
+          fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": unable to create the image file %s\n", ca.device_name);
+          goto GlobalCleanUp;
+        }
+        ca.new_image_file = true;
+      }
+
       ca.work_disk = disk_setup_device(&ca, ca.device_name);
 
       if (NULL == ca.work_disk)
@@ -1051,6 +1576,9 @@ ShowHelp:
 
       ca.device_is_real_device = ca.work_disk->flags & DISK_FLAG_NOT_DEVICE_BUT_FILE ? false : true;
 
+      if (commandNeedsPartitionTables(ca.command))
+        (void)disk_ensure_scanned(ca.work_disk);
+
       if (ca.device_is_real_device)
       {
         if (0 == ca.work_disk->device_sectors)
@@ -1084,13 +1612,11 @@ ShowHelp:
         }
         else
         {
-          if (511 & ca.work_disk->device_sectors)
+          if (511 & ca.work_disk->device_size)
           {
             fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": image file size is not divisible by 512: %s\n", ca.device_name);
             goto GlobalCleanUp;
           }
-
-          ca.work_disk->device_sectors >>= 9;
         }
       }
 
@@ -1122,18 +1648,23 @@ ShowHelp:
       }
     }
 
-    // truncate the file (if it is not a device)
+    // truncate the file (if it is not a device and --file-size is specified)
 
     if (COMMAND_FILL != ca.command && COMMAND_ENUMDISKS != ca.command && COMMAND_INFO != ca.command && COMMAND_HEXDUMP != ca.command &&
-      !ca.device_is_real_device && !ca.dryrun && ca.file_size != (ca.work_disk->device_sectors << 9))
+      COMMAND_BACKUP != ca.command && COMMAND_PROBE != ca.command && COMMAND_WIPE != ca.command && NULL != ca.work_disk &&
+      !ca.device_is_real_device && !ca.dryrun && 0 != ca.file_size && ca.file_size != (ca.work_disk->device_sectors << 9))
     {
-      if (0 != truncate(ca.device_name, ca.file_size))
+      if (!disk_resize_image(ca.device_name, ca.file_size, ca.preallocate))
       {
         fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": unable to truncate/extend %s to the specified file size\n", ca.device_name);
         goto GlobalCleanUp;
       }
+      ca.work_disk->device_size = ca.file_size;
       ca.work_disk->device_sectors = ca.file_size >> 9;
     }
+
+    if (NULL != ca.work_disk && COMMAND_PROBE != ca.command)
+      probe_apply_profile(&ca, ca.work_disk);
   }
 
   switch (ca.command)
@@ -1150,6 +1681,10 @@ ShowHelp:
       exitcode = onInfo(&ca);
       break;
 
+    case COMMAND_BACKUP:
+      exitcode = onBackup(&ca);
+      break;
+
     case COMMAND_RESTORE:
       exitcode = onRestore(&ca);
       break;
@@ -1178,16 +1713,40 @@ ShowHelp:
       exitcode = onHexdump(&ca);
       break;
 
+    case COMMAND_PROBE:
+      exitcode = probe_device(&ca);
+      break;
+
+    case COMMAND_WIPE:
+      exitcode = wipe_device(&ca);
+      break;
+
+    case COMMAND_MOVE:
+      exitcode = move_partition(&ca);
+      break;
+
+    case COMMAND_CLONE:
+      exitcode = clone_disk(&ca);
+      break;
+
     case COMMAND_ENUMDISKS:
       exitcode = onEnumDisks(&ca);
       break;
 
+    case COMMAND_CREATE:
+      exitcode = create_partition_table(&ca);
+      break;
+
     case COMMAND_REPAIRGPT:
+      exitcode = repair_gpt(&ca);
+      break;
+
     case COMMAND_WRITEPMBR:
-    case COMMAND_BACKUP:
-    case COMMAND_CREATE:
+      exitcode = convert_write_pmbr(&ca);
+      break;
+
     case COMMAND_CONVERT:
-      fprintf(stdout, CTRL_MAGENTA "SORRY" CTRL_GREEN ": Please check the next version of this tool. Currently not implemented!" CTRL_RESET "\n");
+      exitcode = convert_mbr_to_gpt(&ca);
       break;
 
     default:
@@ -1196,6 +1755,21 @@ ShowHelp:
 
 GlobalCleanUp:
 
+  // store the scans of this invocation; whatever part-y has written is rescanned next time
+
+  if (NULL != ca.scan_cache)
+  {
+    if (commandWritesToDisk(&ca) && !ca.dryrun)
+      scan_cache_invalidate(ca.work_disk);
+
+    if (!scan_cache_save(ca.scan_cache, ca.pd_head, ca.work_disk))
+      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": unable to write the scan cache file %s\n", ca.scan_cache_file);
+    else
+    if (ca.verbose)
+      fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": scan cache: %" FMT64 "u hit(s), %" FMT64 "u miss(es).\n",
+        atomic_load64(&ca.scan_cache->hits), atomic_load64(&ca.scan_cache->misses));
+  }
+
   // cleanup
 
   if (NULL != ca.work_disk)
@@ -1214,6 +1788,21 @@ GlobalCleanUp:
   }
 
   disk_free_list(ca.pd_head);
+  scan_cache_free(ca.scan_cache);
+
+  if (ca.verbose && COMMAND_VERSION != ca.command && COMMAND_HELP != ca.command)
+  {
+    disk_pool_get_stats(&pool_stats);
+    fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": device handles: %" FMT64 "u opened, %" FMT64 "u open(s) avoided, %" FMT64 "u flushed, %" FMT64 "u sync(s) avoided.\n",
+      pool_stats.opens, pool_stats.opens_avoided, pool_stats.syncs, pool_stats.syncs_avoided);
+  }
+
+  disk_pool_release(NULL);
+
+  // an image file created by a failed command is not left behind (all handles are closed now)
+
+  if (ca.new_image_file && 0 != exitcode)
+    (void)remove(ca.device_name);
 
 #ifdef _WINDOWS
 
@@ -39,7 +39,15 @@ static const char fsTypeStrings[][32] =
   "NTFS",
   "EXT2",
   "EXT3",
-  "EXT4"
+  "EXT4",
+  "XFS",
+  "Btrfs",
+  "LUKS",
+  "LVM2 PV",
+  "swap",
+  "BitLocker",
+  "ReFS",
+  "ZFS"
 };
 
 static const uint8_t zeros_16[16] = { 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0 };
@@ -182,159 +190,140 @@ static const struct
   { 0xff, "Bad Block Table (BBT) / Xenix" }
 };
 
-static const struct
-{
-  char          guid_str[40];
-  uint8_t       mbr_type;
-  char          mbr_description[64];
-  char          gpt_description[64];
-} part_type_table_gpt[] =
+// sorted by the on-disk (mixed endian) bytes of the type GUID (memcmp order), see gpt_lookup_type
+static const gpt_type_info part_type_table_gpt[] =
 {
-  { "00000000-0000-0000-0000-000000000000", 0x00, "empty", "unused entry" },
-  { "EBD0A0A2-B9E5-4433-87C0-68B6B72699C7", 0x01, "FAT12", "Microsoft basic data"},
-  { "EBD0A0A2-B9E5-4433-87C0-68B6B72699C7", 0x04, "FAT16 < 32MB", "Microsoft basic data" },
-  { "EBD0A0A2-B9E5-4433-87C0-68B6B72699C7", 0x06, "FAT16", "Microsoft basic data" },
-  { "EBD0A0A2-B9E5-4433-87C0-68B6B72699C7", 0x07, "HPFS/NTFS/exFAT", "Microsoft basic data" },
-  { "EBD0A0A2-B9E5-4433-87C0-68B6B72699C7", 0x0B, "FAT32", "Microsoft basic data" },
-  { "EBD0A0A2-B9E5-4433-87C0-68B6B72699C7", 0x0C, "FAT32 (LBA)", "Microsoft basic data" },
-  { "EBD0A0A2-B9E5-4433-87C0-68B6B72699C7", 0x0E, "FAT16 (LBA)", "Microsoft basic data" },
-  { "EBD0A0A2-B9E5-4433-87C0-68B6B72699C7", 0x11, "FAT12 (hidden)", "Microsoft basic data" },
-  { "EBD0A0A2-B9E5-4433-87C0-68B6B72699C7", 0x14, "FAT16 < 32MB (hidden)", "Microsoft basic data" },
-  { "EBD0A0A2-B9E5-4433-87C0-68B6B72699C7", 0x16, "FAT16 (hidden)", "Microsoft basic data" },
-  { "EBD0A0A2-B9E5-4433-87C0-68B6B72699C7", 0x17, "HPFS/NTFS/exFAT (hidden)", "Microsoft basic data" },
-  { "EBD0A0A2-B9E5-4433-87C0-68B6B72699C7", 0x1B, "FAT32 (hidden)", "Microsoft basic data" },
-  { "EBD0A0A2-B9E5-4433-87C0-68B6B72699C7", 0x1C, "FAT32 (LBA, hidden)", "Microsoft basic data" },
-  { "EBD0A0A2-B9E5-4433-87C0-68B6B72699C7", 0x1E, "FAT16 (LBA, hidden)", "Microsoft basic data" },
-  { "E3C9E316-0B5C-4DB8-817D-F92DF00215AE", 0x0C, "Hybrid-MBR", "Microsoft reserved"}, // equals FAT32, see above
-  { "DE94BBA4-06D1-4D40-A16A-BFD50179D6AC", 0x27, "Windows RE", "Windows RE" },
-  { "7412F7D5-A156-4B13-81DC-867174929325", 0x30, "ONIE (Open Network Install Environment)", "ONIE boot" },
-  { "D4E6E2CD-4469-46F3-B5CB-1BFF57AFC149", 0xE1, "ONIE (Open Network Install Environment)", "ONIE config" },
-  { "C91818F9-8025-47AF-89D2-F030D7000C2C", 0x39, "Plan 9", "Plan 9" },
-  { "9E1A2D38-C612-4316-AA26-8B49521E5A8B", 0x41, "PReP", "PowerPC PReP boot" },
-  { "AF9B60A0-1431-4F62-BC68-3311714A69AD", 0x42, "Windows", "Windows LDM data" },
-  { "5808C8AA-7E8F-42E0-85D2-E1E90434CFB3", 0x42, "Windows", "Windows LDM metadata" },
-  { "E75CAF8F-F680-4CEE-AFA3-B001E56EFC2D", 0x42, "Windows", "Windows Storage Spaces" },
-  { "37AFFC90-EF7D-4E96-91C3-2D7AE055B174", 0x75, "IBM GPFS", "IBM GPFS" },
-  { "FE3A2A5D-4F32-41A7-B725-ACCC3285A309", 0x7F, "Chromebook", "ChromeOS kernel" },
-  { "3CB8E202-3B7E-47DD-8A3C-7FF2A13CFCEC", 0x7F, "Chromebook", "ChromeOS root" },
-  { "2E0A753D-9E48-43B0-8337-B15192CB1B5E", 0x7F, "Chromebook", "ChromeOS reserved" },
-  { "0657FD6D-A4AB-43C4-84E5-0933C84B4F4F", 0x82, "Linux swap", "Linux swap" },
-  { "0FC63DAF-8483-4772-8E79-3D69D8477DE4", 0x83, "Linux native", "Linux filesystem" },
-  { "8DA63339-0007-60C0-C436-083AC8230908", 0x83, "Linux native", "Linux reserved" },
-  { "933AC7E1-2EB4-4F13-B844-0E14E2AEF915", 0x83, "freedesktop.org (Linux)", "Linux /home" },
-  { "3B8F8425-20E0-4F3B-907F-1A25A76F98E8", 0x83, "freedesktop.org (Linux)", "Linux /srv" },
-  { "7FFEC5C9-2D00-49B7-8941-3EA10A5586B7", 0x83, "freedesktop.org (Linux)", "Linux dm-crypt" },
-  { "CA7D7CCB-63ED-4C53-861C-1742536059CC", 0x83, "freedesktop.org (Linux)", "Linux LUKS" },
-  { "44479540-F297-41B2-9AF7-D131D5F0458A", 0x83, "freedesktop.org (Linux)", "root partition / Linux x86 (x86/32bit platform)" },
-  { "4F68BCE3-E8CD-4DB1-96E7-FBCAF984B709", 0x83, "freedesktop.org (Linux)", "root partition / Linux x86-64 (AMD64 platform)" },
-  { "69DAD710-2CE4-4E3C-B16C-21A1D49ABED3", 0x83, "freedesktop.org (Linux)", "root partition / Linux ARM32 platform" },
-  { "B921B045-1DF0-41C3-AF44-4C6F280D3FAE", 0x83, "freedesktop.org (Linux)", "root partition / Linux ARM64 platform" },
-  { "993d8d3d-f80e-4225-855a-9daf8ed7ea97", 0x00, "freedesktop.org (Linux)", "root partition / Linux IA64 platform" }, // MBR-Type 0x00 means: there is NO MBR type
-  { "D3BFE2DE-3DAF-11DF-BA40-E3A556D89593", 0x84, "Intel-PC", "Intel Rapid Start" },
-  { "E6D6D379-F507-44C2-A23C-238F2A3DF928", 0x8E, "Linux LVM", "Linux LVM" },
-  { "734E5AFE-F61A-11E6-BC64-92361F002671", 0xA2, "Atari TOS", "TOS basic data" },
-  { "516E7CB4-6ECF-11D6-8FF8-00022D09712B", 0xA5, "FreeBSD", "FreeBSD Disklabel" },
-  { "83BD6B9D-7F41-11DC-BE0B-001560B84F0F", 0xA5, "FreeBSD", "FreeBSD boot" },
-  { "516E7CB5-6ECF-11D6-8FF8-00022D09712B", 0xA5, "FreeBSD", "FreeBSD swap" },
-  { "516E7CB6-6ECF-11D6-8FF8-00022D09712B", 0xA5, "FreeBSD", "FreeBSD UFS" },
-  { "516E7CBA-6ECF-11D6-8FF8-00022D09712B", 0xA5, "FreeBSD", "FreeBSD ZFS" },
-  { "516E7CB8-6ECF-11D6-8FF8-00022D09712B", 0xA5, "FreeBSD", "FreeBSD Vinum/RAID" },
-  { "85D5E45A-237C-11E1-B4B3-E89A8F7FC3A7", 0xA5, "MidnightBSD", "MidnightBSD data" },
-  { "85D5E45E-237C-11E1-B4B3-E89A8F7FC3A7", 0xA5, "MidnightBSD", "MidnightBSD boot" },
-  { "85D5E45B-237C-11E1-B4B3-E89A8F7FC3A7", 0xA5, "MidnightBSD", "MidnightBSD swap" },
-  { "0394EF8B-237E-11E1-B4B3-E89A8F7FC3A7", 0xA5, "MidnightBSD", "MidnightBSD UFS" },
-  { "85D5E45D-237C-11E1-B4B3-E89A8F7FC3A7", 0xA5, "MidnightBSD", "MidnightBSD ZFS" },
-  { "85D5E45C-237C-11E1-B4B3-E89A8F7FC3A7", 0xA5, "MidnightBSD", "MidnightBSD Vinum" },
-  { "824CC7A0-36A8-11E3-890A-952519AD3F61", 0xA6, "OpenBSD", "OpenBSD data" },
-  { "55465300-0000-11AA-AA11-00306543ECAC", 0xA8, "Mac OS X", "Apple UFS" },
-  { "516E7CB4-6ECF-11D6-8FF8-00022D09712B", 0xA9, "FreeBSD", "FreeBSD Disklabel" },
-  { "49F48D32-B10E-11DC-B99B-0019D1879648", 0xA9, "NetBSD", "NetBSD swap" },
-  { "49F48D5A-B10E-11DC-B99B-0019D1879648", 0xA9, "NetBSD", "NetBSD FFS" },
-  { "49F48D82-B10E-11DC-B99B-0019D1879648", 0xA9, "NetBSD", "NetBSD LFS" },
-  { "2DB519C4-B10F-11DC-B99B-0019D1879648", 0xA9, "NetBSD", "NetBSD concatenated" },
-  { "2DB519EC-B10F-11DC-B99B-0019D1879648", 0xA9, "NetBSD", "NetBSD encrypted" },
-  { "49F48DAA-B10E-11DC-B99B-0019D1879648", 0xA9, "NetBSD", "NetBSD RAID" },
-  { "426F6F74-0000-11AA-AA11-00306543ECAC", 0xAB, "macOS", "Apple boot" },
-  { "48465300-0000-11AA-AA11-00306543ECAC", 0xAF, "macOS", "Apple HFS/HFS+" },
-  { "52414944-0000-11AA-AA11-00306543ECAC", 0xAF, "macOS", "Apple RAID" },
-  { "52414944-5F4F-11AA-AA11-00306543ECAC", 0xAF, "macOS", "Apple RAID offline" },
-  { "4C616265-6C00-11AA-AA11-00306543ECAC", 0xAF, "macOS", "Apple Label" },
-  { "5265636F-7665-11AA-AA11-00306543ECAC", 0xAF, "macOS", "AppleTV Recovery" },
-  { "53746F72-6167-11AA-AA11-00306543ECAC", 0xAF, "macOS", "Apple Core Storage" },
-  { "B6FA30DA-92D2-4A9A-96F1-871EC6486200", 0xAF, "macOS", "Apple SoftRAID Status" },
-  { "2E313465-19B9-463F-8126-8A7993773801", 0xAF, "macOS", "Apple SoftRAID Scratch" },
-  { "FA709C7E-65B1-4593-BFD5-E71D61DE9B02", 0xAF, "macOS", "Apple SoftRAID Volume" },
-  { "BBBA6DF5-F46F-4A89-8F59-8765B2727503", 0xAF, "macOS", "Apple SoftRAID Cache" },
-  { "7C3457EF-0000-11AA-AA11-00306543ECAC", 0xAF, "macOS", "Apple APFS" },
-  { "CEF5A9AD-73BC-4601-89F3-CDEEEEE321A1", 0xB3, "QNX", "QNX6 Power-Safe" },
-  { "0311FC50-01CA-4725-AD77-9ADBB20ACE98", 0xBC, "Acronis", "Acronis Secure Zone" },
-  { "6A82CB45-1DD2-11B2-99A6-080020736631", 0xBE, "Solaris", "Solaris boot" },
-  { "6A85CF4D-1DD2-11B2-99A6-080020736631", 0xBF, "Solaris", "Solaris root" },
-  { "6A898CC3-1DD2-11B2-99A6-080020736631", 0xBF, "Solaris", "Solaris /usr" },
-  { "6A87C46F-1DD2-11B2-99A6-080020736631", 0xBF, "Solaris", "Solaris swap" },
-  { "6A8B642B-1DD2-11B2-99A6-080020736631", 0xBF, "Solaris", "Solaris backup" },
-  { "6A8EF2E9-1DD2-11B2-99A6-080020736631", 0xBF, "Solaris", "Solaris /var" },
-  { "6A90BA39-1DD2-11B2-99A6-080020736631", 0xBF, "Solaris", "Solaris /home" },
-  { "6A9283A5-1DD2-11B2-99A6-080020736631", 0xBF, "Solaris", "Solaris alternate sector" },
-  { "6A945A3B-1DD2-11B2-99A6-080020736631", 0xBF, "Solaris", "Solaris Reserved" },
-  { "6A9630D1-1DD2-11B2-99A6-080020736631", 0xBF, "Solaris", "Solaris Reserved" },
-  { "6A980767-1DD2-11B2-99A6-080020736631", 0xBF, "Solaris", "Solaris Reserved" },
-  { "6A96237F-1DD2-11B2-99A6-080020736631", 0xBF, "Solaris", "Solaris Reserved" },
-  { "6A8D2AC7-1DD2-11B2-99A6-080020736631", 0xBF, "Solaris", "Solaris Reserved" },
-  { "75894C1E-3AEB-11D3-B7C1-7B03A0000000", 0xC0, "HP-UX", "HP-UX data" },
-  { "E2A1E728-32E3-11D6-A682-7B03A0000000", 0xC0, "HP-UX", "HP-UX service" },
-  { "BC13C2FF-59E6-4262-A352-B275FD6F7172", 0xEA, "freedesktop.org", "Freedesktop $BOOT" },
-  { "42465331-3BA3-10F1-802A-4861696B7521", 0xEB, "Haiku", "Haiku BFS" },
-  { "BFBFAFE7-A34F-448A-9A5B-6213EB736C22", 0xED, "ESP (OEM-specific)", "Lenovo system partition" },
-  { "F4019732-066E-4E12-8273-346C5641494F", 0xED, "ESP (OEM-specific)", "Sony system partition" },
-  { "C12A7328-F81F-11D2-BA4B-00A0C93EC93B", 0xEF, "EFI", "EFI System Partition (ESP)" },
-  { "024DEE41-33E7-11D3-9D69-0008C781F39F", 0xEF, "EFI", "MBR partition scheme" }, // we can use this type to encapsulate an MBR in it
-  { "21686148-6449-6E6F-744E-656564454649", 0xEF, "EFI", "BIOS boot partition" }, // because no MBR-gap on GPT-disks, this is the UUID for the e.g. GRUB2 boot loader
-  { "4FBD7E29-9D25-41B8-AFD0-062C0CEFF05D", 0xF8, "Ceph", "Ceph OSD" },
-  { "4FBD7E29-9D25-41B8-AFD0-5EC00CEFF05D", 0xF8, "Ceph", "Ceph dm-crypt OSD" },
-  { "45B0969E-9B03-4F30-B4C6-B4B80CEFF106", 0xF8, "Ceph", "Ceph journal" },
-  { "45B0969E-9B03-4F30-B4C6-5EC00CEFF106", 0xF8, "Ceph", "Ceph dm-crypt journal" },
-  { "89C57F98-2FE5-4DC0-89C1-F3AD0CEFF2BE", 0xF8, "Ceph", "Ceph disk in creation" },
-  { "89C57F98-2FE5-4DC0-89C1-5EC00CEFF2BE", 0xF8, "Ceph", "Ceph dm-crypt disk in creation" },
-  { "AA31E02A-400F-11DB-9590-000C2911D1B8", 0xFB, "VMWare ESX", "VMware VMFS" },
-  { "9198EFFC-31C0-11DB-8F78-000C2911D1B8", 0xFB, "VMWare ESX", "VMware reserved" },
-  { "9D275380-40AD-11DB-BF97-000C2911D1B8", 0xFC, "VMWare ESX", "VMware kcore crash protection" },
-  { "A19D880F-05FC-4D3B-A006-743F0F84911E", 0xFD, "Linux", "Linux RAID" }
+  { GPT_TYPE_GUID(0x00000000, 0x0000, 0x0000, 0x0000, 0x000000000000), 0x00, 0,                "empty", "unused entry" },
+  { GPT_TYPE_GUID(0x48465300, 0x0000, 0x11AA, 0xAA11, 0x00306543ECAC), 0xAF, 0,                "macOS", "Apple HFS/HFS+" },
+  { GPT_TYPE_GUID(0x55465300, 0x0000, 0x11AA, 0xAA11, 0x00306543ECAC), 0xA8, 0,                "Mac OS X", "Apple UFS" },
+  { GPT_TYPE_GUID(0x3CB8E202, 0x3B7E, 0x47DD, 0x8A3C, 0x7FF2A13CFCEC), 0x7F, 0,                "Chromebook", "ChromeOS root" },
+  { GPT_TYPE_GUID(0xA19D880F, 0x05FC, 0x4D3B, 0xA006, 0x743F0F84911E), 0xFD, 0,                "Linux", "Linux RAID" },
+  { GPT_TYPE_GUID(0x69DAD710, 0x2CE4, 0x4E3C, 0xB16C, 0x21A1D49ABED3), 0x83, 0,                "freedesktop.org (Linux)", "root partition / Linux ARM32 platform" },
+  { GPT_TYPE_GUID(0xE3C9E316, 0x0B5C, 0x4DB8, 0x817D, 0xF92DF00215AE), 0x0C, GPT_TYPE_PEEK_FS, "Hybrid-MBR", "Microsoft reserved" }, // equals FAT32, see above
+  { GPT_TYPE_GUID(0x75894C1E, 0x3AEB, 0x11D3, 0xB7C1, 0x7B03A0000000), 0xC0, 0,                "HP-UX", "HP-UX data" },
+  { GPT_TYPE_GUID(0x3B8F8425, 0x20E0, 0x4F3B, 0x907F, 0x1A25A76F98E8), 0x83, 0,                "freedesktop.org (Linux)", "Linux /srv" },
+  { GPT_TYPE_GUID(0xC12A7328, 0xF81F, 0x11D2, 0xBA4B, 0x00A0C93EC93B), 0xEF, GPT_TYPE_PEEK_FS, "EFI", "EFI System Partition (ESP)" },
+  { GPT_TYPE_GUID(0xE2A1E728, 0x32E3, 0x11D6, 0xA682, 0x7B03A0000000), 0xC0, 0,                "HP-UX", "HP-UX service" },
+  { GPT_TYPE_GUID(0x4FBD7E29, 0x9D25, 0x41B8, 0xAFD0, 0x062C0CEFF05D), 0xF8, 0,                "Ceph", "Ceph OSD" },
+  { GPT_TYPE_GUID(0x4FBD7E29, 0x9D25, 0x41B8, 0xAFD0, 0x5EC00CEFF05D), 0xF8, 0,                "Ceph", "Ceph dm-crypt OSD" },
+  { GPT_TYPE_GUID(0xAA31E02A, 0x400F, 0x11DB, 0x9590, 0x000C2911D1B8), 0xFB, 0,                "VMWare ESX", "VMware VMFS" },
+  { GPT_TYPE_GUID(0x6A8B642B, 0x1DD2, 0x11B2, 0x99A6, 0x080020736631), 0xBF, 0,                "Solaris", "Solaris backup" },
+  { GPT_TYPE_GUID(0x42465331, 0x3BA3, 0x10F1, 0x802A, 0x4861696B7521), 0xEB, 0,                "Haiku", "Haiku BFS" },
+  { GPT_TYPE_GUID(0x49F48D32, 0xB10E, 0x11DC, 0xB99B, 0x0019D1879648), 0xA9, 0,                "NetBSD", "NetBSD swap" },
+  { GPT_TYPE_GUID(0xF4019732, 0x066E, 0x4E12, 0x8273, 0x346C5641494F), 0xED, 0,                "ESP (OEM-specific)", "Sony system partition" },
+  { GPT_TYPE_GUID(0x9E1A2D38, 0xC612, 0x4316, 0xAA26, 0x8B49521E5A8B), 0x41, 0,                "PReP", "PowerPC PReP boot" },
+  { GPT_TYPE_GUID(0x8DA63339, 0x0007, 0x60C0, 0xC436, 0x083AC8230908), 0x83, GPT_TYPE_PEEK_FS, "Linux native", "Linux reserved" },
+  { GPT_TYPE_GUID(0x6A90BA39, 0x1DD2, 0x11B2, 0x99A6, 0x080020736631), 0xBF, 0,                "Solaris", "Solaris /home" },
+  { GPT_TYPE_GUID(0x6A945A3B, 0x1DD2, 0x11B2, 0x99A6, 0x080020736631), 0xBF, 0,                "Solaris", "Solaris Reserved" },
+  { GPT_TYPE_GUID(0x2E0A753D, 0x9E48, 0x43B0, 0x8337, 0xB15192CB1B5E), 0x7F, 0,                "Chromebook", "ChromeOS reserved" },
+  { GPT_TYPE_GUID(0x993D8D3D, 0xF80E, 0x4225, 0x855A, 0x9DAF8ED7EA97), 0x00, 0,                "freedesktop.org (Linux)", "root partition / Linux IA64 platform" }, // MBR-Type 0x00 means: there is NO MBR type
+  { GPT_TYPE_GUID(0x44479540, 0xF297, 0x41B2, 0x9AF7, 0xD131D5F0458A), 0x83, 0,                "freedesktop.org (Linux)", "root partition / Linux x86 (x86/32bit platform)" },
+  { GPT_TYPE_GUID(0x024DEE41, 0x33E7, 0x11D3, 0x9D69, 0x0008C781F39F), 0xEF, GPT_TYPE_PEEK_FS, "EFI", "MBR partition scheme" }, // we can use this type to encapsulate an MBR in it
+  { GPT_TYPE_GUID(0x52414944, 0x0000, 0x11AA, 0xAA11, 0x00306543ECAC), 0xAF, 0,                "macOS", "Apple RAID" },
+  { GPT_TYPE_GUID(0x52414944, 0x5F4F, 0x11AA, 0xAA11, 0x00306543ECAC), 0xAF, 0,                "macOS", "Apple RAID offline" },
+  { GPT_TYPE_GUID(0xB921B045, 0x1DF0, 0x41C3, 0xAF44, 0x4C6F280D3FAE), 0x83, 0,                "freedesktop.org (Linux)", "root partition / Linux ARM64 platform" },
+  { GPT_TYPE_GUID(0x6A82CB45, 0x1DD2, 0x11B2, 0x99A6, 0x080020736631), 0xBE, 0,                "Solaris", "Solaris boot" },
+  { GPT_TYPE_GUID(0x21686148, 0x6449, 0x6E6F, 0x744E, 0x656564454649), 0xEF, GPT_TYPE_PEEK_FS, "EFI", "BIOS boot partition" }, // because no MBR-gap on GPT-disks, this is the UUID for the e.g. GRUB2 boot loader
+  { GPT_TYPE_GUID(0x6A85CF4D, 0x1DD2, 0x11B2, 0x99A6, 0x080020736631), 0xBF, 0,                "Solaris", "Solaris root" },
+  { GPT_TYPE_GUID(0x0311FC50, 0x01CA, 0x4725, 0xAD77, 0x9ADBB20ACE98), 0xBC, 0,                "Acronis", "Acronis Secure Zone" },
+  { GPT_TYPE_GUID(0x49F48D5A, 0xB10E, 0x11DC, 0xB99B, 0x0019D1879648), 0xA9, 0,                "NetBSD", "NetBSD FFS" },
+  { GPT_TYPE_GUID(0x85D5E45A, 0x237C, 0x11E1, 0xB4B3, 0xE89A8F7FC3A7), 0xA5, 0,                "MidnightBSD", "MidnightBSD data" },
+  { GPT_TYPE_GUID(0x85D5E45B, 0x237C, 0x11E1, 0xB4B3, 0xE89A8F7FC3A7), 0xA5, 0,                "MidnightBSD", "MidnightBSD swap" },
+  { GPT_TYPE_GUID(0x85D5E45C, 0x237C, 0x11E1, 0xB4B3, 0xE89A8F7FC3A7), 0xA5, 0,                "MidnightBSD", "MidnightBSD Vinum" },
+  { GPT_TYPE_GUID(0xFE3A2A5D, 0x4F32, 0x41A7, 0xB725, 0xACCC3285A309), 0x7F, 0,                "Chromebook", "ChromeOS kernel" },
+  { GPT_TYPE_GUID(0x85D5E45D, 0x237C, 0x11E1, 0xB4B3, 0xE89A8F7FC3A7), 0xA5, 0,                "MidnightBSD", "MidnightBSD ZFS" },
+  { GPT_TYPE_GUID(0x85D5E45E, 0x237C, 0x11E1, 0xB4B3, 0xE89A8F7FC3A7), 0xA5, 0,                "MidnightBSD", "MidnightBSD boot" },
+  { GPT_TYPE_GUID(0x2E313465, 0x19B9, 0x463F, 0x8126, 0x8A7993773801), 0xAF, 0,                "macOS", "Apple SoftRAID Scratch" },
+  { GPT_TYPE_GUID(0x4C616265, 0x6C00, 0x11AA, 0xAA11, 0x00306543ECAC), 0xAF, 0,                "macOS", "Apple Label" },
+  { GPT_TYPE_GUID(0x6A980767, 0x1DD2, 0x11B2, 0x99A6, 0x080020736631), 0xBF, 0,                "Solaris", "Solaris Reserved" },
+  { GPT_TYPE_GUID(0x0657FD6D, 0xA4AB, 0x43C4, 0x84E5, 0x0933C84B4F4F), 0x82, GPT_TYPE_PEEK_FS, "Linux swap", "Linux swap" },
+  { GPT_TYPE_GUID(0x5265636F, 0x7665, 0x11AA, 0xAA11, 0x00306543ECAC), 0xAF, 0,                "macOS", "AppleTV Recovery" },
+  { GPT_TYPE_GUID(0x6A87C46F, 0x1DD2, 0x11B2, 0x99A6, 0x080020736631), 0xBF, 0,                "Solaris", "Solaris swap" },
+  { GPT_TYPE_GUID(0x53746F72, 0x6167, 0x11AA, 0xAA11, 0x00306543ECAC), 0xAF, 0,                "macOS", "Apple Core Storage" },
+  { GPT_TYPE_GUID(0x426F6F74, 0x0000, 0x11AA, 0xAA11, 0x00306543ECAC), 0xAB, 0,                "macOS", "Apple boot" },
+  { GPT_TYPE_GUID(0xE6D6D379, 0xF507, 0x44C2, 0xA23C, 0x238F2A3DF928), 0x8E, GPT_TYPE_PEEK_FS, "Linux LVM", "Linux LVM" },
+  { GPT_TYPE_GUID(0xFA709C7E, 0x65B1, 0x4593, 0xBFD5, 0xE71D61DE9B02), 0xAF, 0,                "macOS", "Apple SoftRAID Volume" },
+  { GPT_TYPE_GUID(0x6A96237F, 0x1DD2, 0x11B2, 0x99A6, 0x080020736631), 0xBF, 0,                "Solaris", "Solaris Reserved" },
+  { GPT_TYPE_GUID(0x9D275380, 0x40AD, 0x11DB, 0xBF97, 0x000C2911D1B8), 0xFC, 0,                "VMWare ESX", "VMware kcore crash protection" },
+  { GPT_TYPE_GUID(0x49F48D82, 0xB10E, 0x11DC, 0xB99B, 0x0019D1879648), 0xA9, 0,                "NetBSD", "NetBSD LFS" },
+  { GPT_TYPE_GUID(0x0394EF8B, 0x237E, 0x11E1, 0xB4B3, 0xE89A8F7FC3A7), 0xA5, 0,                "MidnightBSD", "MidnightBSD UFS" },
+  { GPT_TYPE_GUID(0xE75CAF8F, 0xF680, 0x4CEE, 0xAFA3, 0xB001E56EFC2D), 0x42, 0,                "Windows", "Windows Storage Spaces" },
+  { GPT_TYPE_GUID(0x37AFFC90, 0xEF7D, 0x4E96, 0x91C3, 0x2D7AE055B174), 0x75, 0,                "IBM GPFS", "IBM GPFS" },
+  { GPT_TYPE_GUID(0x89C57F98, 0x2FE5, 0x4DC0, 0x89C1, 0x5EC00CEFF2BE), 0xF8, 0,                "Ceph", "Ceph dm-crypt disk in creation" },
+  { GPT_TYPE_GUID(0x89C57F98, 0x2FE5, 0x4DC0, 0x89C1, 0xF3AD0CEFF2BE), 0xF8, 0,                "Ceph", "Ceph disk in creation" },
+  { GPT_TYPE_GUID(0x83BD6B9D, 0x7F41, 0x11DC, 0xBE0B, 0x001560B84F0F), 0xA5, 0,                "FreeBSD", "FreeBSD boot" },
+  { GPT_TYPE_GUID(0x45B0969E, 0x9B03, 0x4F30, 0xB4C6, 0x5EC00CEFF106), 0xF8, 0,                "Ceph", "Ceph dm-crypt journal" },
+  { GPT_TYPE_GUID(0x45B0969E, 0x9B03, 0x4F30, 0xB4C6, 0xB4B80CEFF106), 0xF8, 0,                "Ceph", "Ceph journal" },
+  { GPT_TYPE_GUID(0xAF9B60A0, 0x1431, 0x4F62, 0xBC68, 0x3311714A69AD), 0x42, 0,                "Windows", "Windows LDM data" },
+  { GPT_TYPE_GUID(0x824CC7A0, 0x36A8, 0x11E3, 0x890A, 0x952519AD3F61), 0xA6, 0,                "OpenBSD", "OpenBSD data" },
+  { GPT_TYPE_GUID(0xEBD0A0A2, 0xB9E5, 0x4433, 0x87C0, 0x68B6B72699C7), 0x07, GPT_TYPE_PEEK_FS, "HPFS/NTFS/exFAT", "Microsoft basic data" },
+  { GPT_TYPE_GUID(0xDE94BBA4, 0x06D1, 0x4D40, 0xA16A, 0xBFD50179D6AC), 0x27, GPT_TYPE_PEEK_FS, "Windows RE", "Windows RE" },
+  { GPT_TYPE_GUID(0x6A9283A5, 0x1DD2, 0x11B2, 0x99A6, 0x080020736631), 0xBF, 0,                "Solaris", "Solaris alternate sector" },
+  { GPT_TYPE_GUID(0x49F48DAA, 0xB10E, 0x11DC, 0xB99B, 0x0019D1879648), 0xA9, 0,                "NetBSD", "NetBSD RAID" },
+  { GPT_TYPE_GUID(0x5808C8AA, 0x7E8F, 0x42E0, 0x85D2, 0xE1E90434CFB3), 0x42, 0,                "Windows", "Windows LDM metadata" },
+  { GPT_TYPE_GUID(0xCEF5A9AD, 0x73BC, 0x4601, 0x89F3, 0xCDEEEEE321A1), 0xB3, 0,                "QNX", "QNX6 Power-Safe" },
+  { GPT_TYPE_GUID(0x0FC63DAF, 0x8483, 0x4772, 0x8E79, 0x3D69D8477DE4), 0x83, GPT_TYPE_PEEK_FS, "Linux native", "Linux filesystem" },
+  { GPT_TYPE_GUID(0x516E7CB4, 0x6ECF, 0x11D6, 0x8FF8, 0x00022D09712B), 0xA5, 0,                "FreeBSD", "FreeBSD Disklabel" },
+  { GPT_TYPE_GUID(0x516E7CB5, 0x6ECF, 0x11D6, 0x8FF8, 0x00022D09712B), 0xA5, 0,                "FreeBSD", "FreeBSD swap" },
+  { GPT_TYPE_GUID(0x516E7CB6, 0x6ECF, 0x11D6, 0x8FF8, 0x00022D09712B), 0xA5, 0,                "FreeBSD", "FreeBSD UFS" },
+  { GPT_TYPE_GUID(0x516E7CB8, 0x6ECF, 0x11D6, 0x8FF8, 0x00022D09712B), 0xA5, 0,                "FreeBSD", "FreeBSD Vinum/RAID" },
+  { GPT_TYPE_GUID(0x516E7CBA, 0x6ECF, 0x11D6, 0x8FF8, 0x00022D09712B), 0xA5, 0,                "FreeBSD", "FreeBSD ZFS" },
+  { GPT_TYPE_GUID(0x6A898CC3, 0x1DD2, 0x11B2, 0x99A6, 0x080020736631), 0xBF, GPT_TYPE_PEEK_FS, "Solaris", "Solaris /usr" },
+  { GPT_TYPE_GUID(0x2DB519C4, 0xB10F, 0x11DC, 0xB99B, 0x0019D1879648), 0xA9, 0,                "NetBSD", "NetBSD concatenated" },
+  { GPT_TYPE_GUID(0x6A8D2AC7, 0x1DD2, 0x11B2, 0x99A6, 0x080020736631), 0xBF, 0,                "Solaris", "Solaris Reserved" },
+  { GPT_TYPE_GUID(0x7FFEC5C9, 0x2D00, 0x49B7, 0x8941, 0x3EA10A5586B7), 0x83, GPT_TYPE_PEEK_FS, "freedesktop.org (Linux)", "Linux dm-crypt" },
+  { GPT_TYPE_GUID(0xCA7D7CCB, 0x63ED, 0x4C53, 0x861C, 0x1742536059CC), 0x83, GPT_TYPE_PEEK_FS, "freedesktop.org (Linux)", "Linux LUKS" },
+  { GPT_TYPE_GUID(0xD4E6E2CD, 0x4469, 0x46F3, 0xB5CB, 0x1BFF57AFC149), 0xE1, 0,                "ONIE (Open Network Install Environment)", "ONIE config" },
+  { GPT_TYPE_GUID(0x6A9630D1, 0x1DD2, 0x11B2, 0x99A6, 0x080020736631), 0xBF, 0,                "Solaris", "Solaris Reserved" },
+  { GPT_TYPE_GUID(0x7412F7D5, 0xA156, 0x4B13, 0x81DC, 0x867174929325), 0x30, 0,                "ONIE (Open Network Install Environment)", "ONIE boot" },
+  { GPT_TYPE_GUID(0xB6FA30DA, 0x92D2, 0x4A9A, 0x96F1, 0x871EC6486200), 0xAF, 0,                "macOS", "Apple SoftRAID Status" },
+  { GPT_TYPE_GUID(0xD3BFE2DE, 0x3DAF, 0x11DF, 0xBA40, 0xE3A556D89593), 0x84, 0,                "Intel-PC", "Intel Rapid Start" },
+  { GPT_TYPE_GUID(0x933AC7E1, 0x2EB4, 0x4F13, 0xB844, 0x0E14E2AEF915), 0x83, GPT_TYPE_PEEK_FS, "freedesktop.org (Linux)", "Linux /home" },
+  { GPT_TYPE_GUID(0x4F68BCE3, 0xE8CD, 0x4DB1, 0x96E7, 0xFBCAF984B709), 0x83, GPT_TYPE_PEEK_FS, "freedesktop.org (Linux)", "root partition / Linux x86-64 (AMD64 platform)" },
+  { GPT_TYPE_GUID(0xBFBFAFE7, 0xA34F, 0x448A, 0x9A5B, 0x6213EB736C22), 0xED, 0,                "ESP (OEM-specific)", "Lenovo system partition" },
+  { GPT_TYPE_GUID(0x6A8EF2E9, 0x1DD2, 0x11B2, 0x99A6, 0x080020736631), 0xBF, 0,                "Solaris", "Solaris /var" },
+  { GPT_TYPE_GUID(0x2DB519EC, 0xB10F, 0x11DC, 0xB99B, 0x0019D1879648), 0xA9, 0,                "NetBSD", "NetBSD encrypted" },
+  { GPT_TYPE_GUID(0x7C3457EF, 0x0000, 0x11AA, 0xAA11, 0x00306543ECAC), 0xAF, 0,                "macOS", "Apple APFS" },
+  { GPT_TYPE_GUID(0xBBBA6DF5, 0xF46F, 0x4A89, 0x8F59, 0x8765B2727503), 0xAF, 0,                "macOS", "Apple SoftRAID Cache" },
+  { GPT_TYPE_GUID(0xC91818F9, 0x8025, 0x47AF, 0x89D2, 0xF030D7000C2C), 0x39, 0,                "Plan 9", "Plan 9" },
+  { GPT_TYPE_GUID(0x9198EFFC, 0x31C0, 0x11DB, 0x8F78, 0x000C2911D1B8), 0xFB, 0,                "VMWare ESX", "VMware reserved" },
+  { GPT_TYPE_GUID(0x734E5AFE, 0xF61A, 0x11E6, 0xBC64, 0x92361F002671), 0xA2, 0,                "Atari TOS", "TOS basic data" },
+  { GPT_TYPE_GUID(0xBC13C2FF, 0x59E6, 0x4262, 0xA352, 0xB275FD6F7172), 0xEA, 0,                "freedesktop.org", "Freedesktop $BOOT" }
 };
 
 static struct
 {
   uint64_t      attributes;
-  char          guid_str[40];
+  uint8_t       guid[16];
   uint8_t       mbr_type;
   char          mbr_description[64];
   char          gpt_description[64];
 } part_convert_table_gpt[] =
 {
-  { 0, "00000000-0000-0000-0000-000000000000", 0x00, "empty", "unused entry" },
-  { 0, "EBD0A0A2-B9E5-4433-87C0-68B6B72699C7", 0x01, "FAT12", "Microsoft basic data"},
-  { 0, "EBD0A0A2-B9E5-4433-87C0-68B6B72699C7", 0x04, "FAT16 < 32MB", "Microsoft basic data" },
-  { 0, "EBD0A0A2-B9E5-4433-87C0-68B6B72699C7", 0x06, "FAT16", "Microsoft basic data" },
-  { 0, "EBD0A0A2-B9E5-4433-87C0-68B6B72699C7", 0x07, "HPFS/NTFS/exFAT", "Microsoft basic data" },
-  { 0, "EBD0A0A2-B9E5-4433-87C0-68B6B72699C7", 0x0B, "FAT32", "Microsoft basic data" },
-  { 0, "EBD0A0A2-B9E5-4433-87C0-68B6B72699C7", 0x0C, "FAT32 (LBA)", "Microsoft basic data" },
-  { 0, "EBD0A0A2-B9E5-4433-87C0-68B6B72699C7", 0x0E, "FAT16 (LBA)", "Microsoft basic data" },
-  { GPT_ATTR_HIDDEN, "EBD0A0A2-B9E5-4433-87C0-68B6B72699C7", 0x11, "FAT12 (hidden)", "Microsoft basic data" },
-  { GPT_ATTR_HIDDEN, "EBD0A0A2-B9E5-4433-87C0-68B6B72699C7", 0x14, "FAT16 < 32MB (hidden)", "Microsoft basic data" },
-  { GPT_ATTR_HIDDEN, "EBD0A0A2-B9E5-4433-87C0-68B6B72699C7", 0x16, "FAT16 (hidden)", "Microsoft basic data" },
-  { GPT_ATTR_HIDDEN, "EBD0A0A2-B9E5-4433-87C0-68B6B72699C7", 0x17, "HPFS/NTFS/exFAT (hidden)", "Microsoft basic data" },
-  { GPT_ATTR_HIDDEN, "EBD0A0A2-B9E5-4433-87C0-68B6B72699C7", 0x1B, "FAT32 (hidden)", "Microsoft basic data" },
-  { GPT_ATTR_HIDDEN, "EBD0A0A2-B9E5-4433-87C0-68B6B72699C7", 0x1C, "FAT32 (LBA, hidden)", "Microsoft basic data" },
-  { GPT_ATTR_HIDDEN, "EBD0A0A2-B9E5-4433-87C0-68B6B72699C7", 0x1E, "FAT16 (LBA, hidden)", "Microsoft basic data" },
-  { GPT_ATTR_DO_NOT_MOUNT, "DE94BBA4-06D1-4D40-A16A-BFD50179D6AC", 0x27, "Windows RE", "Windows RE" },
-  { 0, "0657FD6D-A4AB-43C4-84E5-0933C84B4F4F", 0x82, "Linux swap", "Linux swap" },
-  { 0, "0FC63DAF-8483-4772-8E79-3D69D8477DE4", 0x83, "Linux native", "Linux filesystem" },
-  { 0, "E6D6D379-F507-44C2-A23C-238F2A3DF928", 0x8E, "Linux LVM", "Linux LVM" },
-  { 0, "55465300-0000-11AA-AA11-00306543ECAC", 0xA8, "Mac OS X", "Apple UFS" },
-  { 0, "426F6F74-0000-11AA-AA11-00306543ECAC", 0xAB, "macOS", "Apple boot" },
-  { 0, "48465300-0000-11AA-AA11-00306543ECAC", 0xAF, "macOS", "Apple HFS/HFS+" },
-  { GPT_ATTR_DO_NOT_MOUNT, "C12A7328-F81F-11D2-BA4B-00A0C93EC93B", 0xEF, "EFI", "EFI System Partition (ESP)" },
-  { 0, "A19D880F-05FC-4D3B-A006-743F0F84911E", 0xFD, "Linux", "Linux RAID" }
+  { 0, GPT_TYPE_GUID(0x00000000, 0x0000, 0x0000, 0x0000, 0x000000000000), 0x00, "empty", "unused entry" },
+  { 0, GPT_TYPE_GUID(0xEBD0A0A2, 0xB9E5, 0x4433, 0x87C0, 0x68B6B72699C7), 0x01, "FAT12", "Microsoft basic data"},
+  { 0, GPT_TYPE_GUID(0xEBD0A0A2, 0xB9E5, 0x4433, 0x87C0, 0x68B6B72699C7), 0x04, "FAT16 < 32MB", "Microsoft basic data" },
+  { 0, GPT_TYPE_GUID(0xEBD0A0A2, 0xB9E5, 0x4433, 0x87C0, 0x68B6B72699C7), 0x06, "FAT16", "Microsoft basic data" },
+  { 0, GPT_TYPE_GUID(0xEBD0A0A2, 0xB9E5, 0x4433, 0x87C0, 0x68B6B72699C7), 0x07, "HPFS/NTFS/exFAT", "Microsoft basic data" },
+  { 0, GPT_TYPE_GUID(0xEBD0A0A2, 0xB9E5, 0x4433, 0x87C0, 0x68B6B72699C7), 0x0B, "FAT32", "Microsoft basic data" },
+  { 0, GPT_TYPE_GUID(0xEBD0A0A2, 0xB9E5, 0x4433, 0x87C0, 0x68B6B72699C7), 0x0C, "FAT32 (LBA)", "Microsoft basic data" },
+  { 0, GPT_TYPE_GUID(0xEBD0A0A2, 0xB9E5, 0x4433, 0x87C0, 0x68B6B72699C7), 0x0E, "FAT16 (LBA)", "Microsoft basic data" },
+  { GPT_ATTR_HIDDEN, GPT_TYPE_GUID(0xEBD0A0A2, 0xB9E5, 0x4433, 0x87C0, 0x68B6B72699C7), 0x11, "FAT12 (hidden)", "Microsoft basic data" },
+  { GPT_ATTR_HIDDEN, GPT_TYPE_GUID(0xEBD0A0A2, 0xB9E5, 0x4433, 0x87C0, 0x68B6B72699C7), 0x14, "FAT16 < 32MB (hidden)", "Microsoft basic data" },
+  { GPT_ATTR_HIDDEN, GPT_TYPE_GUID(0xEBD0A0A2, 0xB9E5, 0x4433, 0x87C0, 0x68B6B72699C7), 0x16, "FAT16 (hidden)", "Microsoft basic data" },
+  { GPT_ATTR_HIDDEN, GPT_TYPE_GUID(0xEBD0A0A2, 0xB9E5, 0x4433, 0x87C0, 0x68B6B72699C7), 0x17, "HPFS/NTFS/exFAT (hidden)", "Microsoft basic data" },
+  { GPT_ATTR_HIDDEN, GPT_TYPE_GUID(0xEBD0A0A2, 0xB9E5, 0x4433, 0x87C0, 0x68B6B72699C7), 0x1B, "FAT32 (hidden)", "Microsoft basic data" },
+  { GPT_ATTR_HIDDEN, GPT_TYPE_GUID(0xEBD0A0A2, 0xB9E5, 0x4433, 0x87C0, 0x68B6B72699C7), 0x1C, "FAT32 (LBA, hidden)", "Microsoft basic data" },
+  { GPT_ATTR_HIDDEN, GPT_TYPE_GUID(0xEBD0A0A2, 0xB9E5, 0x4433, 0x87C0, 0x68B6B72699C7), 0x1E, "FAT16 (LBA, hidden)", "Microsoft basic data" },
+  { GPT_ATTR_DO_NOT_MOUNT, GPT_TYPE_GUID(0xDE94BBA4, 0x06D1, 0x4D40, 0xA16A, 0xBFD50179D6AC), 0x27, "Windows RE", "Windows RE" },
+  { 0, GPT_TYPE_GUID(0x0657FD6D, 0xA4AB, 0x43C4, 0x84E5, 0x0933C84B4F4F), 0x82, "Linux swap", "Linux swap" },
+  { 0, GPT_TYPE_GUID(0x0FC63DAF, 0x8483, 0x4772, 0x8E79, 0x3D69D8477DE4), 0x83, "Linux native", "Linux filesystem" },
+  { 0, GPT_TYPE_GUID(0xE6D6D379, 0xF507, 0x44C2, 0xA23C, 0x238F2A3DF928), 0x8E, "Linux LVM", "Linux LVM" },
+  { 0, GPT_TYPE_GUID(0x55465300, 0x0000, 0x11AA, 0xAA11, 0x00306543ECAC), 0xA8, "Mac OS X", "Apple UFS" },
+  { 0, GPT_TYPE_GUID(0x426F6F74, 0x0000, 0x11AA, 0xAA11, 0x00306543ECAC), 0xAB, "macOS", "Apple boot" },
+  { 0, GPT_TYPE_GUID(0x48465300, 0x0000, 0x11AA, 0xAA11, 0x00306543ECAC), 0xAF, "macOS", "Apple HFS/HFS+" },
+  { GPT_ATTR_DO_NOT_MOUNT, GPT_TYPE_GUID(0xC12A7328, 0xF81F, 0x11D2, 0xBA4B, 0x00A0C93EC93B), 0xEF, "EFI", "EFI System Partition (ESP)" },
+  { 0, GPT_TYPE_GUID(0xA19D880F, 0x05FC, 0x4D3B, 0xA006, 0x743F0F84911E), 0xFD, "Linux", "Linux RAID" }
 };
 
 bool gpt_get_guid_for_mbr_type(uint8_t part_type, uint8_t* guid, uint64_t *attributes)
@@ -345,7 +334,7 @@ bool gpt_get_guid_for_mbr_type(uint8_t part_type, uint8_t* guid, uint64_t *attri
   {
     if (part_type == part_convert_table_gpt[i].mbr_type)
     {
-      parse_guid(guid, part_convert_table_gpt[i].guid_str, false /* parse it with mixed endianess */);
+      memcpy(guid, part_convert_table_gpt[i].guid, 16);
       *attributes = part_convert_table_gpt[i].attributes;
       return true;
     }
@@ -354,9 +343,29 @@ bool gpt_get_guid_for_mbr_type(uint8_t part_type, uint8_t* guid, uint64_t *attri
   return false;
 }
 
+const gpt_type_info* gpt_lookup_type(const uint8_t* type_guid)
+{
+  uint32_t            lo = 0, hi = sizeof(part_type_table_gpt) / sizeof(part_type_table_gpt[0]), mid;
+  int                 cmp;
+
+  while (lo < hi)
+  {
+    mid = (lo + hi) >> 1;
+    cmp = memcmp(type_guid, part_type_table_gpt[mid].guid, 16);
+    if (0 == cmp)
+      return &part_type_table_gpt[mid];
+    if (cmp < 0)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+
+  return NULL;
+}
+
 // additional lba offset is required for extended partition tables because everything is specified relative to the LBA of the extended
 // partition table itself
-static bool mbr_parse_part_entry(disk_ptr dp, DISK_HANDLE h, const uint8_t* data, mbr_entry_ptr mep, uint64_t additional_lba_offset )
+static bool mbr_parse_part_entry(const uint8_t* data, mbr_entry_ptr mep, uint64_t additional_lba_offset )
 {
   size_t          i;
 
@@ -381,7 +390,7 @@ static bool mbr_parse_part_entry(disk_ptr dp, DISK_HANDLE h, const uint8_t* data
   {
     if (part_type_table_mbr[i].type_byte == mep->part_type)
     {
-      strncpy(mep->type_desc, part_type_table_mbr[i].description, sizeof(mep->type_desc) - 1);
+      mep->type_desc = part_type_table_mbr[i].description;
 
       // check if we should 'peek' into the file system
 
@@ -408,9 +417,11 @@ static bool mbr_parse_part_entry(disk_ptr dp, DISK_HANDLE h, const uint8_t* data
         case 0x07:
         case 0x17:
         case 0x27:
+        case 0x82:
         case 0x83:
-        case 0xC2: // peek file system and try to find out what is in there
-          mep->fs_type = partition_peek_filesystem(dp, h, mep->start_sector + additional_lba_offset, mep->uuid);
+        case 0x8E:
+        case 0xC2: // peek file system and try to find out what is in there (partition_peek_fs_for_mbr)
+          mep->fs_peek_lba = mep->start_sector + additional_lba_offset;
           break;
       }
 
@@ -419,12 +430,12 @@ static bool mbr_parse_part_entry(disk_ptr dp, DISK_HANDLE h, const uint8_t* data
   }
 
   if (i == sizeof(part_type_table_mbr) / sizeof(part_type_table_mbr[0]))
-    strncpy(mep->type_desc, "*UNKNOWN*", sizeof(mep->type_desc) - 1);
+    mep->type_desc = "*UNKNOWN*";
 
   return true;
 }
 
-static mbr_part_sector_ptr mbr_parse_boot_sector(disk_ptr dp, DISK_HANDLE h, sector_ptr sp)
+static mbr_part_sector_ptr mbr_parse_boot_sector(sector_ptr sp)
 {
   mbr_part_sector_ptr       mbsp = (mbr_part_sector_ptr)malloc(sizeof(mbr_part_sector));
 
@@ -441,17 +452,17 @@ static mbr_part_sector_ptr mbr_parse_boot_sector(disk_ptr dp, DISK_HANDLE h, sec
   mbsp->boot_sector_signature2 = sp->data[0x01FF]; // 0xAA
   mbsp->ext_part_no = 0xFF; // no extended partition
 
-  if (!mbr_parse_part_entry(dp, h, &sp->data[0x01BE], &mbsp->part_table[0], sp->lba))
+  if (!mbr_parse_part_entry(&sp->data[0x01BE], &mbsp->part_table[0], sp->lba))
   {
 ErrorExit:
     free(mbsp);
     return NULL;
   }
-  if (!mbr_parse_part_entry(dp, h, &sp->data[0x01CE], &mbsp->part_table[1], sp->lba))
+  if (!mbr_parse_part_entry(&sp->data[0x01CE], &mbsp->part_table[1], sp->lba))
     goto ErrorExit;
-  if (!mbr_parse_part_entry(dp, h, &sp->data[0x01DE], &mbsp->part_table[2], sp->lba))
+  if (!mbr_parse_part_entry(&sp->data[0x01DE], &mbsp->part_table[2], sp->lba))
     goto ErrorExit;
-  if (!mbr_parse_part_entry(dp, h, &sp->data[0x01EE], &mbsp->part_table[3], sp->lba))
+  if (!mbr_parse_part_entry(&sp->data[0x01EE], &mbsp->part_table[3], sp->lba))
     goto ErrorExit;
 
   if (MBR_IS_EXTENDED_PARTITION(mbsp->part_table[0].part_type))
@@ -484,7 +495,7 @@ ErrorExit:
   goto ErrorExit;
 }
 
-static mbr_part_sector_ptr mbr_parse_ext_part_sector(disk_ptr dp, DISK_HANDLE h, sector_ptr sp)
+static mbr_part_sector_ptr mbr_parse_ext_part_sector(sector_ptr sp)
 {
   mbr_part_sector_ptr       mbsp = (mbr_part_sector_ptr)malloc(sizeof(mbr_part_sector));
 
@@ -499,13 +510,13 @@ static mbr_part_sector_ptr mbr_parse_ext_part_sector(disk_ptr dp, DISK_HANDLE h,
   mbsp->boot_sector_signature2 = sp->data[0x01FF]; // 0xAA
   mbsp->ext_part_no = 0xFF; // no extended partition
   
-  if (!mbr_parse_part_entry(dp, h, &sp->data[0x01BE], &mbsp->part_table[0],sp->lba))
+  if (!mbr_parse_part_entry(&sp->data[0x01BE], &mbsp->part_table[0],sp->lba))
   {
 ErrorExit:
     free(mbsp);
     return NULL;
   }
-  if (!mbr_parse_part_entry(dp, h, &sp->data[0x01CE], &mbsp->part_table[1],sp->lba))
+  if (!mbr_parse_part_entry(&sp->data[0x01CE], &mbsp->part_table[1],sp->lba))
     goto ErrorExit;
   if (0 != memcmp(&sp->data[0x01DE], zeros_16, 16))
     goto ErrorExit;
@@ -550,7 +561,7 @@ mbr_part_sector_ptr partition_scan_mbr(disk_ptr dp, DISK_HANDLE h)
   if (NULL == sp)
     return NULL;
 
-  item = mbr_parse_boot_sector(dp, h, sp);
+  item = mbr_parse_boot_sector(sp);
   if (NULL == item)
   {
     disk_free_sector(sp);
@@ -578,7 +589,7 @@ mbr_part_sector_ptr partition_scan_mbr(disk_ptr dp, DISK_HANDLE h)
       return NULL;
     }
 
-    item = mbr_parse_ext_part_sector(dp, h, sp);
+    item = mbr_parse_ext_part_sector(sp);
     if (NULL == item)
     {
       disk_free_sector(sp); // because here, sp was not yet linked to the last item pointer!
@@ -610,9 +621,10 @@ void partition_free_mbr_part_sector_list(mbr_part_sector_ptr item)
   }
 }
 
-static uint32_t calc_crc32(const uint8_t* buf, uint32_t len, uint32_t init /* typically 0xFFFFFFFF */)
+// running CRC32 (not inverted), so that it can be computed over several buffers
+static uint32_t update_crc32(const uint8_t* buf, uint32_t len, uint32_t crc)
 {
-  uint32_t i, crc = init, j;
+  uint32_t i, j;
 
   for (i = 0; i < len; i++)
   {
@@ -629,41 +641,201 @@ static uint32_t calc_crc32(const uint8_t* buf, uint32_t len, uint32_t init /* ty
     }
   }
 
-  return ~crc;
+  return crc;
+}
+
+static uint32_t calc_crc32(const uint8_t* buf, uint32_t len, uint32_t init /* typically 0xFFFFFFFF */)
+{
+  return ~update_crc32(buf, len, init);
+}
+
+gpt_ptr partition_new_gpt(uint32_t max_entries)
+{
+  gpt_ptr               gptp = (gpt_ptr)malloc(sizeof(gpt));
+
+  if (unlikely(NULL == gptp))
+    return NULL;
+
+  memset(gptp, 0, sizeof(gpt));
+
+  if (0 != max_entries)
+  {
+    gptp->entries = (gpt_entry_ptr)malloc(max_entries * sizeof(gpt_entry));
+    if (unlikely(NULL == gptp->entries))
+    {
+      free(gptp);
+      return NULL;
+    }
+    gptp->max_entries = max_entries;
+  }
+
+  return gptp;
+}
+
+gpt_ptr partition_clone_gpt(gpt_ptr gptp)
+{
+  gpt_ptr               clone;
+
+  if (unlikely(NULL == gptp))
+    return NULL;
+
+  clone = partition_new_gpt(gptp->num_entries);
+  if (unlikely(NULL == clone))
+    return NULL;
+
+  memcpy(&clone->header, &gptp->header, sizeof(gpt_header));
+  clone->header.sp = NULL; // the sector belongs to the original
+
+  if (0 != gptp->num_entries)
+    memcpy(clone->entries, gptp->entries, gptp->num_entries * sizeof(gpt_entry));
+  clone->num_entries = gptp->num_entries;
+
+  if (NULL != gptp->ext_data)
+  {
+    clone->ext_data = (uint8_t*)malloc(((size_t)gptp->header.number_of_part_entries) * (gptp->header.size_of_part_entry - GPT_ENTRY_SIZE));
+    if (unlikely(NULL == clone->ext_data))
+    {
+      partition_free_gpt(clone);
+      return NULL;
+    }
+    memcpy(clone->ext_data, gptp->ext_data, ((size_t)gptp->header.number_of_part_entries) * (gptp->header.size_of_part_entry - GPT_ENTRY_SIZE));
+  }
+
+  return clone;
+}
+
+// returns the index of the first entry whose slot is >= the specified slot
+static uint32_t gpt_entry_index(gpt_ptr g, uint32_t slot)
+{
+  uint32_t              lo = 0, hi = g->num_entries, mid;
+
+  if (0 != hi && g->entries[hi - 1].slot < slot) // appending
+    return hi;
+
+  while (lo < hi)
+  {
+    mid = (lo + hi) >> 1;
+    if (g->entries[mid].slot < slot)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+gpt_entry_ptr gpt_find_entry(gpt_ptr g, uint32_t slot)
+{
+  uint32_t              idx;
+
+  if (unlikely(NULL == g))
+    return NULL;
+
+  idx = gpt_entry_index(g, slot);
+
+  return (idx < g->num_entries && g->entries[idx].slot == slot) ? &g->entries[idx] : NULL;
+}
+
+gpt_entry_ptr gpt_add_entry(gpt_ptr g, uint32_t slot)
+{
+  uint32_t              idx, new_max;
+  gpt_entry_ptr         new_entries;
+
+  if (unlikely(NULL == g))
+    return NULL;
+
+  idx = gpt_entry_index(g, slot);
+  if (idx < g->num_entries && g->entries[idx].slot == slot)
+    return NULL; // already in use
+
+  if (g->num_entries == g->max_entries)
+  {
+    new_max = (0 == g->max_entries) ? 16 : (g->max_entries << 1);
+    new_entries = (gpt_entry_ptr)realloc(g->entries, new_max * sizeof(gpt_entry));
+    if (unlikely(NULL == new_entries))
+      return NULL;
+    g->entries = new_entries;
+    g->max_entries = new_max;
+  }
+
+  if (idx < g->num_entries)
+    memmove(&g->entries[idx + 1], &g->entries[idx], (g->num_entries - idx) * sizeof(gpt_entry));
+  g->num_entries++;
+
+  memset(&g->entries[idx], 0, sizeof(gpt_entry));
+  g->entries[idx].slot = slot;
+
+  return &g->entries[idx];
 }
 
+// the entry array is streamed in chunks: only the used entries are kept, the CRC32 is computed on the fly
 static bool gpt_read_and_parse_entries(disk_ptr dp, DISK_HANDLE h, gpt_ptr gptp)
 {
-  uint32_t        entry_sectors = ((gptp->header.number_of_part_entries * gptp->header.size_of_part_entry) + SECTOR_SIZE_MASK) >> SECTOR_SHIFT;
-  sector_ptr      sp = disk_read_sectors(dp, h, NULL, NULL, gptp->header.starting_lba_part_entries, entry_sectors);
-  uint32_t        i, crc32;
+  uint64_t        lba = gptp->header.starting_lba_part_entries;
+  uint32_t        entry_size = gptp->header.size_of_part_entry;
+  uint32_t        entries_per_chunk = (GPT_ENTRY_READ_CHUNK_SECTORS << SECTOR_SHIFT) / entry_size;
+  uint32_t        slot = 0, num, i, crc32 = 0xFFFFFFFF;
+  sector_ptr      sp;
   uint8_t        *raw_gpt_entry;
+  gpt_entry_ptr   gep;
 
-  if (NULL == sp)
-    return false;
+  // vendor specific bytes of larger entries are kept, so that rewriting the table preserves them
 
-  gptp->sp = sp;
+  if (entry_size > GPT_ENTRY_SIZE)
+  {
+    gptp->ext_data = (uint8_t*)malloc(((size_t)gptp->header.number_of_part_entries) * (entry_size - GPT_ENTRY_SIZE));
+    if (unlikely(NULL == gptp->ext_data))
+      return false;
+  }
 
-  for (i = 0; i < gptp->header.number_of_part_entries; i++)
+  while (slot < gptp->header.number_of_part_entries)
   {
-    raw_gpt_entry = sp->data + i * gptp->header.size_of_part_entry;
+    num = gptp->header.number_of_part_entries - slot;
+    if (num > entries_per_chunk)
+      num = entries_per_chunk;
 
-    memcpy(gptp->entries[i].type_guid, raw_gpt_entry + 0x0000, 16);
-    memcpy(gptp->entries[i].partition_guid, raw_gpt_entry + 0x0010, 16);
+    sp = disk_read_sectors(dp, h, NULL, NULL, lba, ((num * entry_size) + SECTOR_SIZE_MASK) >> SECTOR_SHIFT);
+    if (NULL == sp)
+      return false;
 
-    gptp->entries[i].part_start_lba = READ_LITTLE_ENDIAN64(raw_gpt_entry, 0x0020);
-    gptp->entries[i].part_end_lba = READ_LITTLE_ENDIAN64(raw_gpt_entry, 0x0028);
+    crc32 = update_crc32(sp->data, num * entry_size, crc32);
 
-    gptp->entries[i].attributes = READ_LITTLE_ENDIAN64(raw_gpt_entry, 0x0030);
+    for (i = 0; i < num; i++, slot++)
+    {
+      raw_gpt_entry = sp->data + i * entry_size;
 
-    memcpy(gptp->entries[i].part_name, raw_gpt_entry + 0x0038, 72);
+      if (NULL != gptp->ext_data)
+        memcpy(gptp->ext_data + ((size_t)slot) * (entry_size - GPT_ENTRY_SIZE), raw_gpt_entry + GPT_ENTRY_SIZE, entry_size - GPT_ENTRY_SIZE);
 
-    (void)convertUTF162UTF8(gptp->entries[i].part_name, (uint8_t*)gptp->entries[i].part_name_utf8_oem, sizeof(gptp->entries[i].part_name_utf8_oem), true);
-  }
+      // unused entries are not stored at all
+
+      if (!memcmp(raw_gpt_entry, zeros_16, 16) && !memcmp(raw_gpt_entry + 0x0010, zeros_16, 16))
+        continue;
 
-  crc32 = calc_crc32(sp->data, gptp->header.number_of_part_entries * gptp->header.size_of_part_entry, 0xFFFFFFFF);
+      gep = gpt_add_entry(gptp, slot);
+      if (unlikely(NULL == gep))
+      {
+        disk_free_sector(sp);
+        return false;
+      }
 
-  if (crc32 != gptp->header.part_entries_crc32)
+      memcpy(gep->type_guid, raw_gpt_entry + 0x0000, 16);
+      memcpy(gep->partition_guid, raw_gpt_entry + 0x0010, 16);
+
+      gep->part_start_lba = READ_LITTLE_ENDIAN64(raw_gpt_entry, 0x0020);
+      gep->part_end_lba = READ_LITTLE_ENDIAN64(raw_gpt_entry, 0x0028);
+
+      gep->attributes = READ_LITTLE_ENDIAN64(raw_gpt_entry, 0x0030);
+
+      memcpy(gep->part_name, raw_gpt_entry + 0x0038, 72); // decoded on demand, see gpt_entry_name
+    }
+
+    disk_free_sector(sp);
+
+    lba += (num * entry_size) >> SECTOR_SHIFT;
+  }
+
+  if ((~crc32) != gptp->header.part_entries_crc32)
     gptp->header.entries_corrupt = true;
 
   return true;
@@ -705,7 +877,10 @@ bool partition_compare_gpts(gpt_ptr g1, gpt_ptr g2)
   if (g1->header.part_entries_crc32 != g2->header.part_entries_crc32)
     return false;
 
-  for (i = 0; i < g1->header.number_of_part_entries; i++)
+  if (g1->num_entries != g2->num_entries)
+    return false;
+
+  for (i = 0; i < g1->num_entries; i++)
     if (memcmp(&g1->entries[i], &g2->entries[i], sizeof(gpt_entry)))
       return false;
 
@@ -717,18 +892,16 @@ static gpt_ptr gpt_parse_header(sector_ptr sp)
   uint32_t              i, crc32, orig_crc32;
   gpt_ptr               gptp;
 
-  gptp = (gpt_ptr)malloc(sizeof(gpt));
+  gptp = partition_new_gpt(0);
   if (unlikely(NULL == gptp))
     return NULL;
 
-  memset(gptp, 0, sizeof(gpt));
-
   gptp->header.sp = sp;
 
   if (memcmp(&sp->data[0x0000], "EFI PART", 8))
   {
 ErrorExit:
-    free(gptp);
+    free(gptp); // no entries allocated yet; the caller frees the sector
     return NULL;
   }
 
@@ -760,11 +933,17 @@ ErrorExit:
     goto ErrorExit;
 
   gptp->header.number_of_part_entries = READ_LITTLE_ENDIAN32(sp->data, 0x0050);
-  if (gptp->header.number_of_part_entries > 0x80) // not supported
+  if (0 == gptp->header.number_of_part_entries)
     goto ErrorExit;
 
+  // the entry size is 128 * 2^n (UEFI spec.)
+
   gptp->header.size_of_part_entry = READ_LITTLE_ENDIAN32(sp->data, 0x0054);
-  if (0x80 != gptp->header.size_of_part_entry)
+  if (gptp->header.size_of_part_entry < 0x80 || gptp->header.size_of_part_entry > GPT_MAX_ENTRY_SIZE ||
+      0 != (gptp->header.size_of_part_entry & (gptp->header.size_of_part_entry - 1)))
+    goto ErrorExit;
+
+  if (((uint64_t)gptp->header.number_of_part_entries) * gptp->header.size_of_part_entry > GPT_MAX_ENTRY_ARRAY_SIZE)
     goto ErrorExit;
 
   gptp->header.part_entries_crc32 = READ_LITTLE_ENDIAN32(sp->data, 0x0058);
@@ -798,8 +977,10 @@ void partition_free_gpt(gpt_ptr gptp)
 {
   if (NULL != gptp)
   {
-    if (NULL != gptp->sp)
-      disk_free_sector(gptp->sp);
+    if (NULL != gptp->entries)
+      free(gptp->entries);
+    if (NULL != gptp->ext_data)
+      free(gptp->ext_data);
     if (NULL != gptp->header.sp)
       disk_free_sector(gptp->header.sp);
     free(gptp);
@@ -836,8 +1017,10 @@ gpt_ptr partition_scan_gpt(disk_ptr dp, DISK_HANDLE h, uint64_t lba)
 bool partition_peek_fs_for_gpt(disk_ptr dp, DISK_HANDLE h)
 {
   gpt_ptr             g;
-  uint32_t            i;
-  char                current_guid[48];
+  uint32_t            i, num_peeks = 0;
+  const gpt_type_info* gti;
+  fs_peek_ptr         peeks;
+  bool                res;
 
   if (unlikely(NULL == dp))
     return false;
@@ -849,25 +1032,79 @@ bool partition_peek_fs_for_gpt(disk_ptr dp, DISK_HANDLE h)
   if (NULL == g)
     return false;
 
-  for (i = 0; i < g->header.number_of_part_entries; i++)
+  peeks = (fs_peek_ptr)malloc(g->num_entries * sizeof(fs_peek) + 1);
+  if (unlikely(NULL == peeks))
+    return false;
+
+  // collect the partitions first, so that all of them are read in one batch
+
+  for (i = 0; i < g->num_entries; i++)
   {
-    format_guid(current_guid, g->entries[i].type_guid, false/*use mixed endian*/);
-
-    if ((!memcmp(current_guid, "EBD0A0A2-B9E5-4433-87C0-68B6B72699C7", 36)) || // Microsoft basic data
-      (!memcmp(current_guid, "E3C9E316-0B5C-4DB8-817D-F92DF00215AE", 36)) || // Hybrid-MBR | Microsoft reserved
-      (!memcmp(current_guid, "DE94BBA4-06D1-4D40-A16A-BFD50179D6AC", 36)) || // Windows Recovery Environment (RE)
-      (!memcmp(current_guid, "0FC63DAF-8483-4772-8E79-3D69D8477DE4", 36)) || // Linux native
-      (!memcmp(current_guid, "8DA63339-0007-60C0-C436-083AC8230908", 36)) || // Linux reserved
-      (!memcmp(current_guid, "C12A7328-F81F-11D2-BA4B-00A0C93EC93B", 36)) || // EFI System Partition (ESP)
-      (!memcmp(current_guid, "024DEE41-33E7-11D3-9D69-0008C781F39F", 36)) || // EFI MBR partition scheme
-      (!memcmp(current_guid, "21686148-6449-6E6F-744E-656564454649", 36))  // EFI BIOS boot partition
-      )
+    gti = gpt_lookup_type(g->entries[i].type_guid);
+
+    if (NULL != gti && 0 != (gti->flags & GPT_TYPE_PEEK_FS))
     {
-      g->entries[i].fs_type = partition_peek_filesystem(dp, h, g->entries[i].part_start_lba, g->entries[i].fs_uuid);
+      peeks[num_peeks].lba = g->entries[i].part_start_lba;
+      peeks[num_peeks].num_sectors = g->entries[i].part_end_lba - g->entries[i].part_start_lba + 1;
+      peeks[num_peeks].fs_type = &g->entries[i].fs_type;
+      peeks[num_peeks].uuid = g->entries[i].fs_uuid;
+      peeks[num_peeks].label = g->entries[i].fs_label;
+      peeks[num_peeks].fs_size = &g->entries[i].fs_size;
+      num_peeks++;
     }
   }
 
-  return true;
+  res = partition_peek_fs_batch(dp, h, peeks, num_peeks);
+
+  free(peeks);
+
+  return res;
+}
+
+bool partition_peek_fs_for_mbr(disk_ptr dp, DISK_HANDLE h)
+{
+  mbr_part_sector_ptr mpsp;
+  fs_peek_ptr         peeks;
+  uint32_t            i, num_peeks = 0;
+  bool                res;
+
+  if (unlikely(NULL == dp))
+    return false;
+
+  for (mpsp = dp->mbr; NULL != mpsp; mpsp = mpsp->next)
+    num_peeks += 4;
+
+  if (0 == num_peeks)
+    return false;
+
+  peeks = (fs_peek_ptr)malloc(num_peeks * sizeof(fs_peek));
+  if (unlikely(NULL == peeks))
+    return false;
+
+  num_peeks = 0;
+
+  for (mpsp = dp->mbr; NULL != mpsp; mpsp = mpsp->next)
+  {
+    for (i = 0; i < 4; i++)
+    {
+      if (0 == mpsp->part_table[i].fs_peek_lba)
+        continue;
+
+      peeks[num_peeks].lba = mpsp->part_table[i].fs_peek_lba;
+      peeks[num_peeks].num_sectors = mpsp->part_table[i].num_sectors;
+      peeks[num_peeks].fs_type = &mpsp->part_table[i].fs_type;
+      peeks[num_peeks].uuid = mpsp->part_table[i].uuid;
+      peeks[num_peeks].label = mpsp->part_table[i].fs_label;
+      peeks[num_peeks].fs_size = &mpsp->part_table[i].fs_size;
+      num_peeks++;
+    }
+  }
+
+  res = partition_peek_fs_batch(dp, h, peeks, num_peeks);
+
+  free(peeks);
+
+  return res;
 }
 
 disk_map_ptr partition_create_disk_map_mbr(disk_ptr dp)
@@ -942,8 +1179,8 @@ disk_map_ptr partition_create_disk_map_gpt(gpt_ptr g, gpt_ptr g2)
 {
   disk_map_ptr          head = NULL, tail = NULL;
   disk_map_ptr          dmp;
-  uint32_t              i, j;
-  char                  str[40];
+  uint32_t              i;
+  const gpt_type_info*  gti;
 
   // add the MBR = Master Boot Record itself
 
@@ -981,7 +1218,7 @@ disk_map_ptr partition_create_disk_map_gpt(gpt_ptr g, gpt_ptr g2)
   memset(dmp, 0, sizeof(disk_map));
   strcpy(dmp->description, "GPT entries (primary)");
   dmp->start_lba = g->header.starting_lba_part_entries;
-  dmp->end_lba = dmp->start_lba + (g->header.number_of_part_entries >> 2) - 1;
+  dmp->end_lba = dmp->start_lba + GPT_ENTRY_ARRAY_SECTORS(g->header) - 1;
   tail->next = dmp;
   dmp->prev = tail;
   tail = dmp;
@@ -1007,20 +1244,15 @@ disk_map_ptr partition_create_disk_map_gpt(gpt_ptr g, gpt_ptr g2)
   memset(dmp, 0, sizeof(disk_map));
   strcpy(dmp->description, "GPT entries (secondary)");
   dmp->start_lba = g2->header.starting_lba_part_entries;
-  dmp->end_lba = dmp->start_lba + (g2->header.number_of_part_entries >> 2) - 1;
+  dmp->end_lba = dmp->start_lba + GPT_ENTRY_ARRAY_SECTORS(g2->header) - 1;
   tail->next = dmp;
   dmp->prev = tail;
   tail = dmp;
 
-  // work on 128 entries in GPT
+  // work on the used entries in GPT
 
-  for (i = 0; i < 128; i++)
+  for (i = 0; i < g->num_entries; i++)
   {
-    if (is_zero_guid(g->entries[i].partition_guid) && is_zero_guid(g->entries[i].type_guid))
-      continue;
-
-    format_guid(str, g->entries[i].type_guid, false);
-
     dmp = (disk_map_ptr)malloc(sizeof(disk_map));
     if (unlikely(NULL == dmp))
       goto ErrorExit;
@@ -1029,14 +1261,12 @@ disk_map_ptr partition_create_disk_map_gpt(gpt_ptr g, gpt_ptr g2)
     dmp->start_lba = g->entries[i].part_start_lba;
     dmp->end_lba = g->entries[i].part_end_lba;
 
-    for (j = 0; j < sizeof(part_type_table_gpt) / sizeof(part_type_table_gpt[0]); j++)
-      if (!memcmp(part_type_table_gpt[j].guid_str, str, 36))
-        break;
+    gti = gpt_lookup_type(g->entries[i].type_guid);
 
-    if (j == (sizeof(part_type_table_gpt) / sizeof(part_type_table_gpt[0]))) // unknown
+    if (NULL == gti) // unknown
       strncpy(dmp->description, "GPT partition (unknown)", sizeof(dmp->description) - 1);
     else
-      strncpy(dmp->description, part_type_table_gpt[j].gpt_description, sizeof(dmp->description) - 1);
+      strncpy(dmp->description, gti->gpt_description, sizeof(dmp->description) - 1);
 
     tail->next = dmp;
     dmp->prev = tail;
@@ -1046,81 +1276,173 @@ disk_map_ptr partition_create_disk_map_gpt(gpt_ptr g, gpt_ptr g2)
   return head;
 }
 
-uint32_t partition_peek_filesystem(disk_ptr dp, DISK_HANDLE h, uint64_t lba_start, uint8_t* uuid)
+static void peekStoreResult(fs_peek_ptr fpp, const fs_sig_result* res)
 {
-  sector_ptr              sp = disk_read_sectors(dp, h, NULL, NULL, lba_start, 3); // mostly LBA 0 within partition is sufficient but not for EXT2/3/4 where sector #2 has to be inspected (LBA 2 within partition)
-  uint32_t                fs_type = FSYS_UNKNOWN;
+  *fpp->fs_type = res->fs_type;
+  if (FSYS_UNKNOWN == res->fs_type)
+    return;
+
+  if (NULL != fpp->uuid)
+    memcpy(fpp->uuid, res->uuid, sizeof(res->uuid));
+  if (NULL != fpp->label)
+    memcpy(fpp->label, res->label, FS_SIG_LABEL_SIZE);
+  if (NULL != fpp->fs_size)
+    *fpp->fs_size = res->fs_size;
+}
 
-  if (NULL == sp)
-    return FSYS_UNKNOWN;
+static bool peekFarWindows(disk_ptr dp, DISK_HANDLE h, fs_peek_ptr fpp, fs_sig_result_ptr res)
+{
+  uint32_t                offsets[FS_SIG_MAX_FAR_WINDOWS], sizes[FS_SIG_MAX_FAR_WINDOWS];
+  uint32_t                i, num_windows;
+  sector_ptr              sp;
 
-  if (!memcmp(&sp->data[0x36], "FAT12   ", 8))
-  {
-    fs_type = FSYS_WIN_FAT12;
-    goto do_exit;
-  }
-  if (!memcmp(&sp->data[0x36], "FAT16   ", 8))
-  {
-    fs_type = FSYS_WIN_FAT16;
-    goto do_exit;
-  }
-  if (!memcmp(&sp->data[0x52], "FAT16   ", 8))
-  {
-    fs_type = FSYS_WIN_FAT16;
-    goto do_exit;
-  }
-  if (!memcmp(&sp->data[0x36], "FAT32   ", 8))
-  {
-    fs_type = FSYS_WIN_FAT32;
-    goto do_exit;
-  }
-  if (!memcmp(&sp->data[0x52], "FAT32   ", 8))
-  {
-    fs_type = FSYS_WIN_FAT32;
-    goto do_exit;
-  }
-  if (!memcmp(&sp->data[0x03], "EXFAT   ", 8))
-  {
-    fs_type = FSYS_WIN_EXFAT;
-    goto do_exit;
-  }
-  if (!memcmp(&sp->data[0x03], "NTFS    ", 8))
+  // only read if none of the near probes matched (e.g. BTRFS at 64 KiB, ZFS at 128 KiB)
+
+  num_windows = fs_sig_far_windows(fpp->num_sectors << SECTOR_SHIFT, offsets, sizes, FS_SIG_MAX_FAR_WINDOWS);
+
+  for (i = 0; i < num_windows; i++)
   {
-    fs_type = FSYS_WIN_NTFS;
-    goto do_exit;
+    if ((DISK_FLAG_SPARSE_FILE & dp->flags) && !disk_range_has_data(h, (fpp->lba << SECTOR_SHIFT) + offsets[i], sizes[i]))
+      continue;
+
+    sp = disk_read_sectors(dp, h, NULL, NULL, fpp->lba + (offsets[i] >> SECTOR_SHIFT), sizes[i] >> SECTOR_SHIFT);
+    if (NULL == sp)
+      return false;
+
+    (void)fs_sig_identify_at(sp->data, offsets[i], sizes[i], res);
+    disk_free_sector(sp);
+
+    if (FSYS_UNKNOWN != res->fs_type)
+      break;
   }
 
-  // check LBA 2 for specific Linux EXT filesystems (2, 3, and 4)
+  return true;
+}
 
-  if (0x53 != sp->data[0x438] || 0xEF != sp->data[0x439])
-    goto do_exit;
+uint32_t partition_peek_filesystem(disk_ptr dp, DISK_HANDLE h, uint64_t lba_start, uint8_t* uuid)
+{
+  fs_peek                 fp;
+  uint32_t                fs_type = FSYS_UNKNOWN;
 
-  if (NULL != uuid)
-    memcpy(uuid, &sp->data[0x468], 16); // this is full BIG ENDIAN UUID (not mixed endian as in GPT)
+  memset(&fp, 0, sizeof(fp));
+  fp.lba = lba_start;
+  fp.num_sectors = dp->device_sectors - lba_start;
+  fp.fs_type = &fs_type;
+  fp.uuid = uuid;
 
-  // 32bit Little Endian at 0x5C means: just check that byte!
+  (void)partition_peek_fs_batch(dp, h, &fp, 1);
 
-  if (0 == (0x04 & sp->data[0x45C])) // no journal
-  {
-    fs_type = FSYS_LINUX_EXT2;
-    goto do_exit;
-  }
+  return fs_type;
+}
+
+bool partition_peek_fs_batch(disk_ptr dp, DISK_HANDLE h, fs_peek_ptr peeks, uint32_t num_peeks)
+{
+  uint64_t                lbas[FS_PEEK_BATCH];
+  uint32_t                index[FS_PEEK_BATCH];
+  bool                    ok[FS_PEEK_BATCH], known[FS_PEEK_BATCH], recording;
+  fs_sig_result           results[FS_PEEK_BATCH];
+  uint8_t                *buffer, *buffer_mem;
+  uint32_t                i, k, first, num_reads, window_size, this_size;
+  sector_ptr              sp;
+
+  if (0 == num_peeks)
+    return true;
+
+  for (i = 0; i < num_peeks; i++)
+    *peeks[i].fs_type = FSYS_UNKNOWN;
 
-  // EXT3 or EXT4
+  // one read per partition covers the near windows of all signature probes
 
-  if (READ_LITTLE_ENDIAN32(sp->data, 0x464) < 0x00000008)
+  window_size = fs_sig_window_size((uint64_t)-1);
+
+  buffer_mem = (uint8_t*)malloc(((size_t)FS_PEEK_BATCH) * window_size + SECTOR_MEM_ALIGN);
+  if (unlikely(NULL == buffer_mem))
+    return false;
+  buffer = (uint8_t*)((((uint64_t)buffer_mem) + (SECTOR_MEM_ALIGN - 1)) & (~(SECTOR_MEM_ALIGN - 1)));
+
+  // the scan cache stores the results of the peeks, not the windows read
+
+  recording = dp->scan_recording;
+  dp->scan_recording = false;
+
+  for (first = 0; first < num_peeks; first += FS_PEEK_BATCH)
   {
-    fs_type = FSYS_LINUX_EXT3;
-    goto do_exit;
+    num_reads = 0;
+
+    for (i = first; i < num_peeks && i < (first + FS_PEEK_BATCH); i++)
+    {
+      k = i - first;
+      memset(&results[k], 0, sizeof(fs_sig_result));
+      known[k] = false;
+
+      if (NULL != dp->scan_replay && scan_cache_replay_peek(dp, peeks[i].lba, peeks[i].num_sectors, &results[k]))
+      {
+        peekStoreResult(&peeks[i], &results[k]);
+        continue;
+      }
+
+      known[k] = true;
+
+      // sparse image files: a hole at the start of the partition cannot contain a near signature
+
+      if ((DISK_FLAG_SPARSE_FILE & dp->flags) && !disk_range_has_data(h, peeks[i].lba << SECTOR_SHIFT, window_size))
+        continue;
+
+      this_size = fs_sig_window_size(peeks[i].num_sectors << SECTOR_SHIFT);
+      if (0 == this_size)
+        continue;
+
+      if (this_size == window_size && (peeks[i].lba + (window_size >> SECTOR_SHIFT)) <= dp->device_sectors)
+      {
+        lbas[num_reads] = peeks[i].lba;
+        index[num_reads] = i;
+        num_reads++;
+        continue;
+      }
+
+      // small partitions (or at the very end of the device) are read on their own
+
+      sp = disk_read_sectors(dp, h, NULL, NULL, peeks[i].lba, this_size >> SECTOR_SHIFT);
+      if (NULL != sp)
+      {
+        (void)fs_sig_identify_at(sp->data, 0, this_size, &results[k]);
+        disk_free_sector(sp);
+      }
+      else
+        known[k] = false;
+    }
+
+    (void)disk_read_batch(dp, h, lbas, num_reads, window_size >> SECTOR_SHIFT, buffer, ok);
+
+    for (i = 0; i < num_reads; i++)
+    {
+      if (ok[i])
+        (void)fs_sig_identify_at(buffer + ((size_t)i) * window_size, 0, window_size, &results[index[i] - first]);
+      else
+        known[index[i] - first] = false;
+    }
+
+    for (i = first; i < num_peeks && i < (first + FS_PEEK_BATCH); i++)
+    {
+      k = i - first;
+      if (!known[k])
+        continue;
+
+      if (FSYS_UNKNOWN == results[k].fs_type && !peekFarWindows(dp, h, &peeks[i], &results[k]))
+        continue;
+
+      peekStoreResult(&peeks[i], &results[k]);
+
+      if (recording)
+        scan_cache_record_peek(dp, peeks[i].lba, peeks[i].num_sectors, &results[k]);
+    }
   }
 
-  fs_type = FSYS_LINUX_EXT4;
+  dp->scan_recording = recording && NULL != dp->scan_record;
 
-do_exit:
+  free(buffer_mem);
 
-  disk_free_sector(sp);
-  
-  return fs_type;
+  return true;
 }
 
 bool partition_dump_mbr(disk_ptr dp)
@@ -1174,13 +1496,38 @@ bool partition_dump_mbr(disk_ptr dp)
   return true;
 }
 
+static void dumpFileSystem(uint32_t fs_type, const uint8_t* uuid, const char* label, uint64_t fs_size)
+{
+  char                uuid_str[40], size_str[16];
+
+  if (FSYS_UNKNOWN == fs_type)
+    return;
+
+  fprintf(stdout, "  File system in partition : '" CTRL_MAGENTA "%s" CTRL_RESET "'", fs_sig_name(fs_type));
+  if (memcmp(uuid, zeros_16, sizeof(zeros_16)))
+  {
+    format_guid(uuid_str, uuid, true); // file system UUIDs are big endian
+    fprintf(stdout, " (UUID %s)", uuid_str);
+  }
+  fprintf(stdout, "\n");
+
+  if (0 != label[0])
+    fprintf(stdout, "  File system label .......: '%s'\n", label);
+
+  if (0 != fs_size)
+  {
+    format_disk_size(fs_size, size_str, sizeof(size_str));
+    fprintf(stdout, "  File system size ........: %s\n", size_str);
+  }
+}
+
 bool partition_dump_gpt(disk_ptr dp)
 {
-  uint32_t            i, j;
-  char                size_str[16], str[40];
+  uint32_t            i;
+  char                size_str[16], str[40], name[128];
   uint64_t            attr;
   bool                first;
-  char                fs_uuid_str[40];
+  const gpt_type_info* gti;
   gpt_ptr             g;
   uint64_t            primary_lba, backup_lba;
 
@@ -1219,26 +1566,21 @@ bool partition_dump_gpt(disk_ptr dp)
   fprintf(stdout, "  " CTRL_CYAN "  => number of usable sectors ...: " CTRL_MAGENTA "%"FMT64"u is approx. " CTRL_GREEN "%s" CTRL_RESET "\n", g->header.last_usable_lba - g->header.first_usable_lba + 1, str);
   fprintf(stdout, "  " CTRL_CYAN "part. entries CRC32 .............: " CTRL_MAGENTA "0x%08X" CTRL_RESET "\n\n", g->header.part_entries_crc32);
 
-  for (i = 0; i < 128; i++)
+  for (i = 0; i < g->num_entries; i++)
   {
-    if ((is_zero_guid(g->entries[i].partition_guid)) && (is_zero_guid(g->entries[i].type_guid)))
-      continue;
-
-    fprintf(stdout, "GPT partition entry %u of 128:\n", i + 1);
+    fprintf(stdout, "GPT partition entry %u of %u:\n", g->entries[i].slot + 1, g->header.number_of_part_entries);
 
     format_guid(str, g->entries[i].partition_guid, false);
     fprintf(stdout, "  Partition GUID ..........: " CTRL_GREEN "%s" CTRL_RESET "\n", str);
     format_guid(str, g->entries[i].type_guid, false);
     fprintf(stdout, "  Type GUID ...............: " CTRL_YELLOW "%s" CTRL_RESET " => " CTRL_MAGENTA, str);
 
-    for (j = 0; j < sizeof(part_type_table_gpt) / sizeof(part_type_table_gpt[0]); j++)
-      if (!memcmp(part_type_table_gpt[j].guid_str, str, 36))
-        break;
+    gti = gpt_lookup_type(g->entries[i].type_guid);
 
-    if (j == (sizeof(part_type_table_gpt) / sizeof(part_type_table_gpt[0]))) // unknown
+    if (NULL == gti) // unknown
       fprintf(stdout, "*** UNKNOWN ***\n");
     else
-      fprintf(stdout, "%s\n", part_type_table_gpt[j].gpt_description);
+      fprintf(stdout, "%s\n", gti->gpt_description);
 
     format_disk_size((g->entries[i].part_end_lba - g->entries[i].part_start_lba + 1) << 9, size_str, sizeof(size_str));
     fprintf(stdout, CTRL_RESET "  Start and end LBA .......: " CTRL_GREEN "%"FMT64"u" CTRL_RESET " to " CTRL_GREEN "%"FMT64"u" CTRL_RESET " (size approx. " CTRL_MAGENTA "%s" CTRL_RESET ")\n", g->entries[i].part_start_lba, g->entries[i].part_end_lba, size_str);
@@ -1292,39 +1634,9 @@ bool partition_dump_gpt(disk_ptr dp)
       }
       fprintf(stdout, CTRL_RESET "\n");
     }
-    fprintf(stdout, "  Partition name ..........: '" CTRL_RED "%s" CTRL_RESET "'\n", g->entries[i].part_name_utf8_oem);
-
-    format_guid(fs_uuid_str, g->entries[i].fs_uuid, true); // only meaningful for EXT2, EXT3, and EXT4
+    fprintf(stdout, "  Partition name ..........: '" CTRL_RED "%s" CTRL_RESET "'\n", gpt_entry_name(&g->entries[i], name, sizeof(name)));
 
-    switch (g->entries[i].fs_type)
-    {
-      case FSYS_WIN_FAT12:
-        fprintf(stdout, "  File system in partition : '" CTRL_MAGENTA "Windows FAT12" CTRL_RESET "'\n");
-        break;
-      case FSYS_WIN_FAT16:
-        fprintf(stdout, "  File system in partition : '" CTRL_MAGENTA "Windows FAT16" CTRL_RESET "'\n");
-        break;
-      case FSYS_WIN_FAT32:
-        fprintf(stdout, "  File system in partition : '" CTRL_MAGENTA "Windows FAT32" CTRL_RESET "'\n");
-        break;
-      case FSYS_WIN_EXFAT:
-        fprintf(stdout, "  File system in partition : '" CTRL_MAGENTA "Windows exFAT" CTRL_RESET "'\n");
-        break;
-      case FSYS_WIN_NTFS:
-        fprintf(stdout, "  File system in partition : '" CTRL_MAGENTA "Windows NTFS" CTRL_RESET "'\n");
-        break;
-      case FSYS_LINUX_EXT2:
-        fprintf(stdout, "  File system in partition : '" CTRL_MAGENTA "Linux EXT2" CTRL_RESET "' (UUID %s)\n", fs_uuid_str);
-        break;
-      case FSYS_LINUX_EXT3:
-        fprintf(stdout, "  File system in partition : '" CTRL_MAGENTA "Linux EXT3" CTRL_RESET "' (UUID %s)\n", fs_uuid_str);
-        break;
-      case FSYS_LINUX_EXT4:
-        fprintf(stdout, "  File system in partition : '" CTRL_MAGENTA "Linux EXT4" CTRL_RESET "' (UUID %s)\n", fs_uuid_str);
-        break;
-      default:
-        break;
-    }
+    dumpFileSystem(g->entries[i].fs_type, g->entries[i].fs_uuid, g->entries[i].fs_label, g->entries[i].fs_size);
     fprintf(stdout, "\n");
   }
 
@@ -1333,11 +1645,11 @@ bool partition_dump_gpt(disk_ptr dp)
 
 bool partition_dump_temporary_gpt(gpt_ptr g)
 {
-  uint32_t            i, j;
-  char                size_str[16], str[40];
+  uint32_t            i;
+  char                size_str[16], str[40], name[128];
   uint64_t            attr;
   bool                first;
-  char                fs_uuid_str[40];
+  const gpt_type_info* gti;
 
   format_guid(str, g->header.disk_guid, false);
   fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": disk GUID is " CTRL_GREEN "%s" CTRL_RESET "\n\n", str);
@@ -1353,26 +1665,21 @@ bool partition_dump_temporary_gpt(gpt_ptr g)
 
   fprintf(stdout, "\n");
 
-  for (i = 0; i < 128; i++)
+  for (i = 0; i < g->num_entries; i++)
   {
-    if ((is_zero_guid(g->entries[i].partition_guid)) && (is_zero_guid(g->entries[i].type_guid)))
-      continue;
-
-    fprintf(stdout, "GPT partition entry %u of 128:\n", i + 1);
+    fprintf(stdout, "GPT partition entry %u of %u:\n", g->entries[i].slot + 1, g->header.number_of_part_entries);
 
     format_guid(str, g->entries[i].partition_guid, false);
     fprintf(stdout, "  Partition GUID ..........: " CTRL_GREEN "%s" CTRL_RESET "\n", str);
     format_guid(str, g->entries[i].type_guid, false);
     fprintf(stdout, "  Type GUID ...............: " CTRL_YELLOW "%s" CTRL_RESET " => " CTRL_MAGENTA, str);
 
-    for (j = 0; j < sizeof(part_type_table_gpt) / sizeof(part_type_table_gpt[0]); j++)
-      if (!memcmp(part_type_table_gpt[j].guid_str, str, 36))
-        break;
+    gti = gpt_lookup_type(g->entries[i].type_guid);
 
-    if (j == (sizeof(part_type_table_gpt) / sizeof(part_type_table_gpt[0]))) // unknown
+    if (NULL == gti) // unknown
       fprintf(stdout, "*** UNKNOWN ***\n");
     else
-      fprintf(stdout, "%s\n", part_type_table_gpt[j].gpt_description);
+      fprintf(stdout, "%s\n", gti->gpt_description);
 
     format_disk_size((g->entries[i].part_end_lba - g->entries[i].part_start_lba + 1) << 9, size_str, sizeof(size_str));
     fprintf(stdout, CTRL_RESET "  Start and end LBA .......: " CTRL_GREEN "%"FMT64"u" CTRL_RESET " to " CTRL_GREEN "%"FMT64"u" CTRL_RESET " (size approx. " CTRL_MAGENTA "%s" CTRL_RESET ")\n", g->entries[i].part_start_lba, g->entries[i].part_end_lba, size_str);
@@ -1426,61 +1733,43 @@ bool partition_dump_temporary_gpt(gpt_ptr g)
       }
       fprintf(stdout, CTRL_RESET "\n");
     }
-    fprintf(stdout, "  Partition name ..........: '" CTRL_RED "%s" CTRL_RESET "'\n", g->entries[i].part_name_utf8_oem);
-
-    format_guid(fs_uuid_str, g->entries[i].fs_uuid, true); // only meaningful for EXT2, EXT3, and EXT4
+    fprintf(stdout, "  Partition name ..........: '" CTRL_RED "%s" CTRL_RESET "'\n", gpt_entry_name(&g->entries[i], name, sizeof(name)));
 
-    switch (g->entries[i].fs_type)
-    {
-    case FSYS_WIN_FAT12:
-      fprintf(stdout, "  File system in partition : '" CTRL_MAGENTA "Windows FAT12" CTRL_RESET "'\n");
-      break;
-    case FSYS_WIN_FAT16:
-      fprintf(stdout, "  File system in partition : '" CTRL_MAGENTA "Windows FAT16" CTRL_RESET "'\n");
-      break;
-    case FSYS_WIN_FAT32:
-      fprintf(stdout, "  File system in partition : '" CTRL_MAGENTA "Windows FAT32" CTRL_RESET "'\n");
-      break;
-    case FSYS_WIN_EXFAT:
-      fprintf(stdout, "  File system in partition : '" CTRL_MAGENTA "Windows exFAT" CTRL_RESET "'\n");
-      break;
-    case FSYS_WIN_NTFS:
-      fprintf(stdout, "  File system in partition : '" CTRL_MAGENTA "Windows NTFS" CTRL_RESET "'\n");
-      break;
-    case FSYS_LINUX_EXT2:
-      fprintf(stdout, "  File system in partition : '" CTRL_MAGENTA "Linux EXT2" CTRL_RESET "' (UUID %s)\n", fs_uuid_str);
-      break;
-    case FSYS_LINUX_EXT3:
-      fprintf(stdout, "  File system in partition : '" CTRL_MAGENTA "Linux EXT3" CTRL_RESET "' (UUID %s)\n", fs_uuid_str);
-      break;
-    case FSYS_LINUX_EXT4:
-      fprintf(stdout, "  File system in partition : '" CTRL_MAGENTA "Linux EXT4" CTRL_RESET "' (UUID %s)\n", fs_uuid_str);
-      break;
-    default:
-      break;
-    }
+    dumpFileSystem(g->entries[i].fs_type, g->entries[i].fs_uuid, g->entries[i].fs_label, g->entries[i].fs_size);
     fprintf(stdout, "\n");
   }
 
   return true;
 }
 
-void setGPTPartitionName(uint16_t* p, char *p2, const char* name)
+void setGPTPartitionName(uint16_t* p, const char* name)
 {
   uint32_t i, l = (uint32_t)strlen(name);
 
   if (l > 35)
     l = 35;
 
-  memcpy(p2, name, l);
-  p2[l] = 0;
-
   for (i = 0; i < l; i++)
     *((uint8_t*)(p+i)) = name[i]; // UTF-16, Little Endian!
     
   p[l] = 0;
 }
 
+const char* gpt_entry_name(const gpt_entry* gep, char* buffer, uint32_t buffer_size)
+{
+  uint16_t            name[38];
+
+  // the on-disk name has 36 characters and need not be zero-terminated
+
+  memcpy(name, gep->part_name, 36 * sizeof(uint16_t));
+  name[36] = 0;
+
+  if (!convertUTF162UTF8(name, (uint8_t*)buffer, buffer_size, true))
+    buffer[0] = 0;
+
+  return buffer;
+}
+
 void create_protective_mbr(uint64_t device_sectors, uint8_t *target)
 {
   uint32_t            num_sectors, write_sectors, start_cyl, start_head, start_sector, end_cyl, end_head, end_sector;
@@ -1524,24 +1813,57 @@ void create_protective_mbr(uint64_t device_sectors, uint8_t *target)
   WRITE_LITTLE_ENDIAN32(target, 0x01BE + 0x0C, write_sectors);
 }
 
+void mbr_create_entry(uint8_t* entry, uint8_t boot_flag, uint8_t part_type, uint64_t start_lba, uint64_t num_sectors)
+{
+  uint32_t            start_cyl, start_head, start_sector, end_cyl, end_head, end_sector;
+
+  lba2chs(start_lba, &start_cyl, &start_head, &start_sector);
+  lba2chs(start_lba + num_sectors - 1, &end_cyl, &end_head, &end_sector);
+
+  entry[0x00] = boot_flag;
+  entry[0x01] = (uint8_t)start_head;
+  entry[0x02] = (uint8_t)(start_sector | ((start_cyl >> 8) << 6));
+  entry[0x03] = (uint8_t)start_cyl;
+  entry[0x04] = part_type;
+  entry[0x05] = (uint8_t)end_head;
+  entry[0x06] = (uint8_t)(end_sector | ((end_cyl >> 8) << 6));
+  entry[0x07] = (uint8_t)end_cyl;
+
+  WRITE_LITTLE_ENDIAN32(entry, 0x08, (uint32_t)start_lba);
+  WRITE_LITTLE_ENDIAN32(entry, 0x0C, (uint32_t)num_sectors);
+}
+
 extern const uint8_t guid_empty_partition[16];
 
+// writes the bytes beyond GPT_ENTRY_SIZE of all slots back (entries larger than 128 bytes only)
+static void gpt_write_ext_data(uint8_t* entries, gpt_ptr g)
+{
+  uint32_t          slot, ext_size = g->header.size_of_part_entry - GPT_ENTRY_SIZE;
+
+  if (NULL == g->ext_data || g->header.size_of_part_entry <= GPT_ENTRY_SIZE)
+    return;
+
+  for (slot = 0; slot < g->header.number_of_part_entries; slot++)
+    memcpy(entries + ((size_t)slot) * g->header.size_of_part_entry + GPT_ENTRY_SIZE, g->ext_data + ((size_t)slot) * ext_size, ext_size);
+}
+
 void gpt_create_table(uint8_t* sector, gpt_ptr g, bool is_primary)
 {
-  uint32_t          i, header_ofs, orig_entry_ofs, entry_ofs, crc32;
+  uint32_t          i, header_ofs, entry_ofs, entry_sectors = GPT_ENTRY_ARRAY_SECTORS(g->header), crc32;
+  uint8_t          *p;
 
   if (is_primary)
   {
     header_ofs = 0;
-    orig_entry_ofs = entry_ofs = SECTOR_SIZE;
+    entry_ofs = SECTOR_SIZE;
   }
   else
   {
-    header_ofs = 32 * SECTOR_SIZE;
-    orig_entry_ofs = entry_ofs = 0;
+    header_ofs = entry_sectors * SECTOR_SIZE;
+    entry_ofs = 0;
   }
 
-  memset(sector, 0x00, 33 * SECTOR_SIZE); // header plus entries (primary) or entries plus header (secondary)
+  memset(sector, 0x00, (1 + entry_sectors) * SECTOR_SIZE); // header plus entries (primary) or entries plus header (secondary)
 
   // create header
 
@@ -1557,31 +1879,32 @@ void gpt_create_table(uint8_t* sector, gpt_ptr g, bool is_primary)
   WRITE_LITTLE_ENDIAN64(sector, header_ofs + 0x0030, g->header.last_usable_lba);
   memcpy(&sector[header_ofs + 0x0038], g->header.disk_guid, 16);
   WRITE_LITTLE_ENDIAN64(sector, header_ofs + 0x0048, g->header.starting_lba_part_entries);
-  sector[header_ofs + 0x0050] = 0x80; // length 4, number of entries = 128
-  sector[header_ofs + 0x0054] = 0x80; // length 4, size of one entry = 128
+  WRITE_LITTLE_ENDIAN32(sector, header_ofs + 0x0050, g->header.number_of_part_entries);
+  WRITE_LITTLE_ENDIAN32(sector, header_ofs + 0x0054, g->header.size_of_part_entry);
 
   // 0x0058: CRC32 of entries
 
   // add all entries
 
-  for (i = 0; i < 128; i++)
+  for (i = 0; i < g->num_entries; i++)
   {
-    if (memcmp(guid_empty_partition, g->entries[i].type_guid, 16))
+    if (g->entries[i].slot < g->header.number_of_part_entries && memcmp(guid_empty_partition, g->entries[i].type_guid, 16))
     {
-      memcpy(&sector[entry_ofs + 0x0000], g->entries[i].type_guid, 16);
-      memcpy(&sector[entry_ofs + 0x0010], g->entries[i].partition_guid, 16);
-      WRITE_LITTLE_ENDIAN64(sector, entry_ofs + 0x0020, g->entries[i].part_start_lba);
-      WRITE_LITTLE_ENDIAN64(sector, entry_ofs + 0x0028, g->entries[i].part_end_lba);
-      WRITE_LITTLE_ENDIAN64(sector, entry_ofs + 0x0030, g->entries[i].attributes);
-      memcpy(&sector[entry_ofs + 0x0038], g->entries[i].part_name, 36 * sizeof(uint16_t));
+      p = &sector[entry_ofs + g->entries[i].slot * g->header.size_of_part_entry];
+      memcpy(p + 0x0000, g->entries[i].type_guid, 16);
+      memcpy(p + 0x0010, g->entries[i].partition_guid, 16);
+      WRITE_LITTLE_ENDIAN64(p, 0x0020, g->entries[i].part_start_lba);
+      WRITE_LITTLE_ENDIAN64(p, 0x0028, g->entries[i].part_end_lba);
+      WRITE_LITTLE_ENDIAN64(p, 0x0030, g->entries[i].attributes);
+      memcpy(p + 0x0038, g->entries[i].part_name, 36 * sizeof(uint16_t));
     }
-
-    entry_ofs += 0x0080;
   }
 
+  gpt_write_ext_data(&sector[entry_ofs], g);
+
   // compute CRC32 of header (please note that CRC32 itself is currently zero) and entries
 
-  crc32 = calc_crc32(&sector[orig_entry_ofs], 128 * 128, 0xFFFFFFFF);
+  crc32 = calc_crc32(&sector[entry_ofs], g->header.number_of_part_entries * g->header.size_of_part_entry, 0xFFFFFFFF);
   WRITE_LITTLE_ENDIAN32(sector, header_ofs + 0x0058, crc32);
 
   crc32 = calc_crc32(&sector[header_ofs], 0x5C, 0xFFFFFFFF);
@@ -1590,20 +1913,21 @@ void gpt_create_table(uint8_t* sector, gpt_ptr g, bool is_primary)
 
 uint64_t gpt_repair_table(uint8_t* sector, gpt_ptr g, bool is_primary )
 {
-  uint32_t          i, header_ofs, orig_entry_ofs, entry_ofs, crc32;
+  uint32_t          i, header_ofs, entry_ofs, entry_sectors = GPT_ENTRY_ARRAY_SECTORS(g->header), crc32;
+  uint8_t          *p;
 
   if (is_primary) // if/else part exchanged from function gpt_create_table because either one repairs the other one
   {
-    header_ofs = 32 * SECTOR_SIZE;
-    orig_entry_ofs = entry_ofs = 0;
+    header_ofs = entry_sectors * SECTOR_SIZE;
+    entry_ofs = 0;
   }
   else
   {
     header_ofs = 0;
-    orig_entry_ofs = entry_ofs = SECTOR_SIZE;
+    entry_ofs = SECTOR_SIZE;
   }
 
-  memset(sector, 0x00, 33 * SECTOR_SIZE); // header plus entries (primary) or entries plus header (secondary)
+  memset(sector, 0x00, (1 + entry_sectors) * SECTOR_SIZE); // header plus entries (primary) or entries plus header (secondary)
 
   // create header
 
@@ -1622,39 +1946,42 @@ uint64_t gpt_repair_table(uint8_t* sector, gpt_ptr g, bool is_primary )
   // write location of GPT partition entries
 
   if (is_primary) // use primary to re-create backup GPT
-    WRITE_LITTLE_ENDIAN64(sector, header_ofs + 0x0048, g->header.backup_lba - 32);
+    WRITE_LITTLE_ENDIAN64(sector, header_ofs + 0x0048, g->header.backup_lba - entry_sectors);
   else
     WRITE_LITTLE_ENDIAN64(sector, header_ofs + 0x0048, ((uint64_t)2)); // primary GPT partition entries always start at 2
   
-  sector[header_ofs + 0x0050] = 0x80; // length 4, number of entries = 128
-  sector[header_ofs + 0x0054] = 0x80; // length 4, size of one entry = 128
+  WRITE_LITTLE_ENDIAN32(sector, header_ofs + 0x0050, g->header.number_of_part_entries);
+  WRITE_LITTLE_ENDIAN32(sector, header_ofs + 0x0054, g->header.size_of_part_entry);
 
   // 0x0058: CRC32 of entries
 
   // add all entries
 
-  for (i = 0; i < 128; i++)
+  for (i = 0; i < g->num_entries; i++)
   {
-    if (memcmp(guid_empty_partition, g->entries[i].type_guid, 16))
+    if (g->entries[i].slot < g->header.number_of_part_entries && memcmp(guid_empty_partition, g->entries[i].type_guid, 16))
     {
-      memcpy(&sector[entry_ofs + 0x0000], g->entries[i].type_guid, 16);
-      memcpy(&sector[entry_ofs + 0x0010], g->entries[i].partition_guid, 16);
-      WRITE_LITTLE_ENDIAN64(sector, entry_ofs + 0x0020, g->entries[i].part_start_lba);
-      WRITE_LITTLE_ENDIAN64(sector, entry_ofs + 0x0028, g->entries[i].part_end_lba);
-      WRITE_LITTLE_ENDIAN64(sector, entry_ofs + 0x0030, g->entries[i].attributes);
-      memcpy(&sector[entry_ofs + 0x0038], g->entries[i].part_name, 36 * sizeof(uint16_t));
+      p = &sector[entry_ofs + g->entries[i].slot * g->header.size_of_part_entry];
+      memcpy(p + 0x0000, g->entries[i].type_guid, 16);
+      memcpy(p + 0x0010, g->entries[i].partition_guid, 16);
+      WRITE_LITTLE_ENDIAN64(p, 0x0020, g->entries[i].part_start_lba);
+      WRITE_LITTLE_ENDIAN64(p, 0x0028, g->entries[i].part_end_lba);
+      WRITE_LITTLE_ENDIAN64(p, 0x0030, g->entries[i].attributes);
+      memcpy(p + 0x0038, g->entries[i].part_name, 36 * sizeof(uint16_t));
     }
-
-    entry_ofs += 0x0080;
   }
 
+  gpt_write_ext_data(&sector[entry_ofs], g);
+
   // compute CRC32 of header (please note that CRC32 itself is currently zero) and entries
 
-  crc32 = calc_crc32(&sector[orig_entry_ofs], 128 * 128, 0xFFFFFFFF);
+  crc32 = calc_crc32(&sector[entry_ofs], g->header.number_of_part_entries * g->header.size_of_part_entry, 0xFFFFFFFF);
   WRITE_LITTLE_ENDIAN32(sector, header_ofs + 0x0058, crc32);
 
   crc32 = calc_crc32(&sector[header_ofs], 0x5C, 0xFFFFFFFF);
   WRITE_LITTLE_ENDIAN32(sector, header_ofs + 0x0010, crc32);
 
-  return g->header.backup_lba << SECTOR_SHIFT;
+  // the backup GPT starts with its entries, the primary one with its header
+
+  return (is_primary ? (g->header.backup_lba - entry_sectors) : g->header.backup_lba) << SECTOR_SHIFT;
 }
@@ -0,0 +1,739 @@
+/**
+ * @file   probe.c
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @brief  implementation of the device throughput probe and of the per-device
+ *         profiles.
+ *
+ * [MIT license]
+ *
+ * Copyright (c) 2021 Ingo A. Kubbilun
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <part-y.h>
+
+#define PROBE_NUM_BLOCK_SIZES     5           ///< 64K, 256K, 1M, 4M, 16M
+#define PROBE_NUM_QUEUE_DEPTHS    5           ///< 1, 2, 4, 8, 16
+#define PROBE_SCRATCH_IMAGE_SIZE  (256 << 20) ///< size of the region appended to image files for the write tests
+
+static const uint32_t probe_block_sizes[PROBE_NUM_BLOCK_SIZES] = { 64 << 10, 256 << 10, 1 << 20, 4 << 20, 16 << 20 };
+static const uint32_t probe_queue_depths[PROBE_NUM_QUEUE_DEPTHS] = { 1, 2, 4, 8, 16 };
+
+typedef struct _probe_run               probe_run, * probe_run_ptr;
+
+struct _probe_run
+{
+  DISK_HANDLE                           h;                          ///< shared handle (positional I/O only)
+  bool                                  write;                      ///< true: write test, false: read test
+  bool                                  random;                     ///< true: random offsets, false: sequential stream
+  uint32_t                              block_size;                 ///< transfer size of one operation
+  uint64_t                              region_start;               ///< start of the test region in bytes
+  uint64_t                              region_blocks;              ///< size of the test region in units of block_size
+  uint64_t                              max_bytes;                  ///< sequential tests stop after this number of bytes
+  uint64_t                              deadline_usec;              ///< all tests stop at this point in time
+  const uint8_t                        *pattern;                    ///< write data (block_size bytes, aligned)
+
+  volatile uint64_t                     next_block;                 ///< next block of the sequential stream
+  volatile uint64_t                     seed;                       ///< seeds of the random generators of the workers
+  volatile uint64_t                     bytes;                      ///< transferred bytes
+  volatile uint64_t                     ops;                        ///< number of operations
+  volatile uint64_t                     latency_usec;               ///< sum of the latencies of all operations
+  volatile uint64_t                     errors;                     ///< number of failed operations
+};
+
+typedef struct _probe_result            probe_result, * probe_result_ptr;
+
+struct _probe_result
+{
+  uint64_t                              bps;                        ///< bytes per second
+  uint32_t                              iops;                       ///< operations per second
+  uint32_t                              latency_usec;               ///< average latency of one operation
+};
+
+void probe_default_profile_file(char* buf, size_t buf_size)
+{
+#ifdef _WINDOWS
+  const char         *home = getenv("APPDATA");
+#else
+  const char         *home = getenv("HOME");
+#endif
+
+  if (NULL == home || 0 == home[0])
+    snprintf(buf, buf_size, "%s", PROFILE_FILE_NAME);
+  else
+#ifdef _WINDOWS
+    snprintf(buf, buf_size, "%s\\%s", home, PROFILE_FILE_NAME);
+#else
+    snprintf(buf, buf_size, "%s/%s", home, PROFILE_FILE_NAME);
+#endif
+}
+
+// 0 means 'not measured' (e.g. no write tests), the consumers use their defaults then
+static bool probe_profile_values_valid(uint32_t block_size, uint32_t queue_depth)
+{
+  if (0 != (block_size & SECTOR_SIZE_MASK) || block_size > PROBE_MAX_BLOCK_SIZE)
+    return false;
+
+  return queue_depth <= PROBE_MAX_QUEUE_DEPTH;
+}
+
+static bool probe_parse_profile_line(char* line, device_profile_ptr prof)
+{
+  int                 n = 0;
+  size_t              l;
+
+  l = strlen(line);
+  while (l > 0 && ('\n' == line[l - 1] || '\r' == line[l - 1]))
+    line[--l] = 0;
+
+  if (0 == line[0] || '#' == line[0])
+    return false;
+
+  memset(prof, 0, sizeof(device_profile));
+
+  if (11 != sscanf(line, "%" FMT64 "u %u %u %u %u %" FMT64 "u %" FMT64 "u %u %u %u %u %n",
+                   &prof->device_size, &prof->read_block_size, &prof->read_queue_depth, &prof->write_block_size, &prof->write_queue_depth,
+                   &prof->read_bps, &prof->write_bps, &prof->random_read_iops, &prof->random_read_latency_usec,
+                   &prof->random_write_iops, &prof->random_write_latency_usec, &n))
+    return false;
+
+  if (0 == n || 0 == line[n])
+    return false;
+
+  // a profile edited by hand must not result in unaligned or absurd I/O sizes and depths
+
+  if (!probe_profile_values_valid(prof->read_block_size, prof->read_queue_depth) ||
+      !probe_profile_values_valid(prof->write_block_size, prof->write_queue_depth))
+    return false;
+
+  strncpy(prof->device_file, line + n, sizeof(prof->device_file) - 1);
+
+  return true;
+}
+
+bool probe_load_profile(const char* profile_file, const char* device_file, uint64_t device_size, device_profile_ptr prof)
+{
+  FILE               *f;
+  char                line[512];
+  bool                found = false;
+
+  f = fopen(profile_file, "rt");
+  if (NULL == f)
+    return false;
+
+  while (NULL != fgets(line, sizeof(line), f))
+  {
+    if (!probe_parse_profile_line(line, prof))
+      continue;
+
+    if (!strcmp(prof->device_file, device_file) && prof->device_size == device_size)
+    {
+      found = true;
+      break;
+    }
+  }
+
+  fclose(f);
+
+  return found;
+}
+
+bool probe_save_profile(const char* profile_file, const device_profile* prof)
+{
+  FILE               *f;
+  char                line[512], line_copy[512];
+  char               *content = NULL, *p;
+  size_t              content_size = 0, content_len = 0, l;
+  device_profile      other;
+
+  // read all other profiles (they are preserved)
+
+  f = fopen(profile_file, "rt");
+  if (NULL != f)
+  {
+    while (NULL != fgets(line, sizeof(line), f))
+    {
+      memcpy(line_copy, line, sizeof(line));
+      if (probe_parse_profile_line(line_copy, &other) && !strcmp(other.device_file, prof->device_file))
+        continue;
+      if ('#' == line[0])
+        continue;
+
+      l = strlen(line);
+      if (content_len + l + 1 > content_size)
+      {
+        content_size = (content_size + l + 1) << 1;
+        p = (char*)realloc(content, content_size);
+        if (unlikely(NULL == p))
+        {
+          fclose(f);
+          free(content);
+          return false;
+        }
+        content = p;
+      }
+      memcpy(content + content_len, line, l + 1);
+      content_len += l;
+    }
+    fclose(f);
+  }
+
+  f = fopen(profile_file, "wt");
+  if (NULL == f)
+  {
+    if (NULL != content)
+      free(content);
+    return false;
+  }
+
+  fprintf(f, "# part-y device profiles (written by the probe command, do not edit)\n");
+  fprintf(f, "# size rd_block rd_qd wr_block wr_qd rd_bps wr_bps rd_iops rd_lat_us wr_iops wr_lat_us device\n");
+
+  if (NULL != content)
+  {
+    fputs(content, f);
+    free(content);
+  }
+
+  fprintf(f, "%" FMT64 "u %u %u %u %u %" FMT64 "u %" FMT64 "u %u %u %u %u %s\n",
+          prof->device_size, prof->read_block_size, prof->read_queue_depth, prof->write_block_size, prof->write_queue_depth,
+          prof->read_bps, prof->write_bps, prof->random_read_iops, prof->random_read_latency_usec,
+          prof->random_write_iops, prof->random_write_latency_usec, prof->device_file);
+
+  return (0 == fclose(f)) ? true : false;
+}
+
+void probe_apply_profile(cmdline_args_ptr cap, disk_ptr dp)
+{
+  device_profile      prof;
+
+  if (NULL == dp || 0 == cap->profile_file[0])
+    return;
+
+  if (!probe_load_profile(cap->profile_file, dp->device_file, dp->device_sectors << SECTOR_SHIFT, &prof))
+    return;
+
+  dp->io_read_size = prof.read_block_size;
+  dp->io_read_depth = prof.read_queue_depth;
+  dp->io_write_size = prof.write_block_size;
+  dp->io_write_depth = prof.write_queue_depth;
+
+  if (cap->verbose)
+    fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": using device profile of %s (read: %u bytes x %u, write: %u bytes x %u).\n",
+            dp->device_file, dp->io_read_size, dp->io_read_depth, dp->io_write_size, dp->io_write_depth);
+}
+
+static DISK_HANDLE probe_open(const char* file_name, bool write, bool* buffered)
+{
+#ifdef _WINDOWS
+  DISK_HANDLE         h;
+
+  *buffered = false;
+
+  disk_pool_release(file_name); // an idle pooled read-only handle denies write sharing
+
+  h = CreateFileA(file_name, write ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING | (write ? FILE_FLAG_WRITE_THROUGH : 0), NULL);
+
+  return h;
+#else
+  int                 flags = write ? O_RDWR : O_RDONLY;
+  int                 h;
+
+  *buffered = false;
+
+  // bypass the page cache, otherwise the cache (and not the device) is measured
+
+  h = open(file_name, flags | O_DIRECT, S_IRUSR | S_IWUSR);
+  if (-1 == h && EINVAL == errno) // e.g. tmpfs does not support O_DIRECT
+  {
+    *buffered = true;
+    h = open(file_name, flags, S_IRUSR | S_IWUSR);
+  }
+
+  return h;
+#endif
+}
+
+static void probe_close(DISK_HANDLE h)
+{
+#ifdef _WINDOWS
+  CloseHandle(h);
+#else
+  close(h);
+#endif
+}
+
+static uint8_t* probe_alloc(uint32_t size, void** mem)
+{
+  *mem = malloc(size + SECTOR_MEM_ALIGN);
+  if (unlikely(NULL == *mem))
+    return NULL;
+
+  return (uint8_t*)((((uint64_t)*mem) + (SECTOR_MEM_ALIGN - 1)) & (~((uint64_t)(SECTOR_MEM_ALIGN - 1))));
+}
+
+static void probe_task(void* arg)
+{
+  probe_run_ptr       run = (probe_run_ptr)arg;
+  void               *mem = NULL;
+  uint8_t            *buffer;
+  uint64_t            idx, rnd, t0, t1;
+  bool                ok;
+
+  if (run->write)
+    buffer = (uint8_t*)run->pattern;
+  else
+  {
+    buffer = probe_alloc(run->block_size, &mem);
+    if (NULL == buffer)
+    {
+      atomic_add64(&run->errors, 1);
+      return;
+    }
+  }
+
+  rnd = atomic_add64(&run->seed, 0x9E3779B97F4A7C15);
+
+  for (;;)
+  {
+    t0 = get_time_usec();
+    if (t0 >= run->deadline_usec)
+      break;
+
+    if (run->random)
+    {
+      rnd ^= rnd << 13; // xorshift64
+      rnd ^= rnd >> 7;
+      rnd ^= rnd << 17;
+      idx = rnd % run->region_blocks;
+    }
+    else
+    {
+      idx = atomic_add64(&run->next_block, 1) - 1;
+      if ((idx * run->block_size) >= run->max_bytes)
+        break;
+      idx %= run->region_blocks;
+    }
+
+    if (run->write)
+      ok = disk_write_at(run->h, run->region_start + idx * run->block_size, buffer, run->block_size);
+    else
+      ok = disk_read_at(run->h, run->region_start + idx * run->block_size, buffer, run->block_size);
+
+    t1 = get_time_usec();
+
+    if (!ok)
+    {
+      atomic_add64(&run->errors, 1);
+      break;
+    }
+
+    atomic_add64(&run->bytes, run->block_size);
+    atomic_add64(&run->ops, 1);
+    atomic_add64(&run->latency_usec, t1 - t0);
+  }
+
+  if (NULL != mem)
+    free(mem);
+}
+
+static bool probe_measure(workpool_ptr wp, probe_run_ptr run, uint32_t queue_depth, probe_result_ptr res)
+{
+  uint64_t            start, elapsed;
+  uint32_t            i;
+
+  memset(res, 0, sizeof(probe_result));
+
+  run->next_block = 0;
+  run->bytes = 0;
+  run->ops = 0;
+  run->latency_usec = 0;
+  run->errors = 0;
+
+  start = get_time_usec();
+  run->deadline_usec = start + PROBE_POINT_DURATION_MS * 1000;
+
+  for (i = 0; i < queue_depth; i++)
+  {
+    if (!workpool_submit(wp, WORKPOOL_NO_KEY, probe_task, run))
+    {
+      atomic_add64(&run->errors, 1);
+      break;
+    }
+  }
+
+  workpool_wait(wp, 0);
+
+  elapsed = get_time_usec() - start;
+  if (0 == elapsed)
+    elapsed = 1;
+
+  if (0 != run->errors)
+    return false;
+
+  res->bps = (uint64_t)((((double)run->bytes) * 1000000.0) / ((double)elapsed));
+  res->iops = (uint32_t)((((double)run->ops) * 1000000.0) / ((double)elapsed));
+  res->latency_usec = 0 == run->ops ? 0 : (uint32_t)(run->latency_usec / run->ops);
+
+  return true;
+}
+
+static bool probe_sequential(workpool_ptr wp, probe_run_ptr run, uint64_t region_size, const char* title,
+                             uint32_t* best_block_size, uint32_t* best_queue_depth, uint64_t* best_bps)
+{
+  uint64_t            rates[PROBE_NUM_BLOCK_SIZES][PROBE_NUM_QUEUE_DEPTHS];
+  uint64_t            max_rate = 0, cost, best_cost = (uint64_t)-1;
+  uint32_t            b, q;
+  probe_result        res;
+  char                str[32];
+
+  memset(rates, 0, sizeof(rates));
+
+  fprintf(stdout, "\n" CTRL_CYAN "%s" CTRL_RESET "\n  block size ", title);
+  for (q = 0; q < PROBE_NUM_QUEUE_DEPTHS; q++)
+    fprintf(stdout, "        QD %2u", probe_queue_depths[q]);
+  fprintf(stdout, "\n");
+
+  run->random = false;
+  run->max_bytes = PROBE_POINT_MAX_BYTES;
+
+  for (b = 0; b < PROBE_NUM_BLOCK_SIZES; b++)
+  {
+    run->block_size = probe_block_sizes[b];
+    run->region_blocks = region_size / run->block_size;
+    if (0 == run->region_blocks)
+      break;
+
+    format_disk_size(run->block_size, str, sizeof(str));
+    fprintf(stdout, "  %10s ", str);
+    fflush(stdout);
+
+    for (q = 0; q < PROBE_NUM_QUEUE_DEPTHS; q++)
+    {
+      if (!probe_measure(wp, run, probe_queue_depths[q], &res))
+      {
+        fprintf(stdout, CTRL_RED " I/O ERROR" CTRL_RESET "\n");
+        return false;
+      }
+
+      rates[b][q] = res.bps;
+      if (res.bps > max_rate)
+        max_rate = res.bps;
+
+      format_disk_size(res.bps, str, sizeof(str));
+      fprintf(stdout, " %10s/s", str);
+      fflush(stdout);
+    }
+    fprintf(stdout, "\n");
+  }
+
+  if (0 == max_rate)
+    return false;
+
+  // pick the cheapest setting (memory in flight) which is almost as good as the best one
+
+  for (b = 0; b < PROBE_NUM_BLOCK_SIZES; b++)
+  {
+    for (q = 0; q < PROBE_NUM_QUEUE_DEPTHS; q++)
+    {
+      if (rates[b][q] * 100 < max_rate * PROBE_GOOD_ENOUGH_PERCENT)
+        continue;
+
+      cost = ((uint64_t)probe_block_sizes[b]) * probe_queue_depths[q];
+      if (cost < best_cost)
+      {
+        best_cost = cost;
+        *best_block_size = probe_block_sizes[b];
+        *best_queue_depth = probe_queue_depths[q];
+        *best_bps = rates[b][q];
+      }
+    }
+  }
+
+  format_disk_size(*best_block_size, str, sizeof(str));
+  fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": preferred setting: block size %s, queue depth %u", str, *best_queue_depth);
+  format_disk_size(*best_bps, str, sizeof(str));
+  fprintf(stdout, " (%s/s)\n", str);
+
+  return true;
+}
+
+static bool probe_random(workpool_ptr wp, probe_run_ptr run, uint64_t region_size, const char* title, uint32_t* iops, uint32_t* latency_usec)
+{
+  uint32_t            q;
+  probe_result        res;
+
+  fprintf(stdout, "\n" CTRL_CYAN "%s" CTRL_RESET "\n", title);
+
+  run->random = true;
+  run->block_size = PROBE_RANDOM_BLOCK_SIZE;
+  run->region_blocks = region_size / PROBE_RANDOM_BLOCK_SIZE;
+  run->max_bytes = (uint64_t)-1;
+
+  if (0 == run->region_blocks)
+    return false;
+
+  for (q = 0; q < PROBE_NUM_QUEUE_DEPTHS; q++)
+  {
+    if (!probe_measure(wp, run, probe_queue_depths[q], &res))
+    {
+      fprintf(stdout, CTRL_RED "  I/O ERROR" CTRL_RESET "\n");
+      return false;
+    }
+
+    fprintf(stdout, "  QD %2u: %8u IOPS, avg. latency %8u us\n", probe_queue_depths[q], res.iops, res.latency_usec);
+
+    if (0 == q)
+    {
+      *iops = res.iops;
+      *latency_usec = res.latency_usec;
+    }
+  }
+
+  return true;
+}
+
+// the LBAs outside of the partition tables: the usable LBAs of all (readable) GPT headers, which
+// may have larger entry arrays, and at least the areas of a default GPT (MBR-partitioned disks)
+static bool probe_usable_range(disk_ptr dp, uint64_t* first_usable, uint64_t* last_usable)
+{
+  gpt_ptr             g[2] = { dp->gpt1, dp->gpt2 };
+  uint32_t            i;
+
+  if (dp->device_sectors < (DISK_GPT_HEAD_SECTORS << 1))
+    return false;
+
+  *first_usable = DISK_GPT_HEAD_SECTORS;
+  *last_usable = dp->device_sectors - DISK_GPT_HEAD_SECTORS;
+
+  for (i = 0; i < 2; i++)
+  {
+    if (NULL == g[i] || g[i]->header.header_corrupt)
+      continue;
+
+    if (g[i]->header.first_usable_lba > *first_usable)
+      *first_usable = g[i]->header.first_usable_lba;
+    if (g[i]->header.last_usable_lba < *last_usable)
+      *last_usable = g[i]->header.last_usable_lba;
+  }
+
+  return *first_usable <= *last_usable;
+}
+
+int probe_device(cmdline_args_ptr cap)
+{
+  disk_ptr            dp = cap->work_disk;
+  device_profile      prof;
+  probe_run           run;
+  workpool_ptr        wp = NULL;
+  DISK_HANDLE         h = INVALID_DISK_HANDLE;
+  bool                buffered, write_tests = false, append_region = false, ok = false;
+  char                str[32];
+  uint64_t            region_start = 0, region_size = 0, num_lbas, first_usable, last_usable, image_size = 0, i;
+  void               *mem = NULL;
+  uint8_t            *pattern;
+
+  if (NULL == dp)
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": No working disk available.\n");
+    return 1;
+  }
+
+  if (SECTOR_SIZE != dp->logical_sector_size)
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": logical sector size %u is not supported.\n", dp->logical_sector_size);
+    return 1;
+  }
+
+  memset(&prof, 0, sizeof(prof));
+  strncpy(prof.device_file, dp->device_file, sizeof(prof.device_file) - 1);
+  prof.device_size = dp->device_sectors << SECTOR_SHIFT;
+
+  // where may we write?
+
+  if (0 != cap->scratch_range_end)
+  {
+    num_lbas = cap->scratch_range_end - cap->scratch_range_start + 1;
+
+    if (!probe_usable_range(dp, &first_usable, &last_usable) ||
+        (cap->scratch_range_start < first_usable) || (cap->scratch_range_end > last_usable))
+    {
+      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": the scratch range must not overlap the partition tables.\n");
+      return 1;
+    }
+
+    if ((NULL != dp->gpt_dmp && !check_lba_range_is_free(dp->gpt_dmp, cap->scratch_range_start, num_lbas)) ||
+        (NULL != dp->mbr_dmp && !check_lba_range_is_free(dp->mbr_dmp, cap->scratch_range_start, num_lbas)))
+    {
+      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": the scratch range overlaps a partition.\n");
+      return 1;
+    }
+
+    region_start = cap->scratch_range_start << SECTOR_SHIFT;
+    region_size = num_lbas << SECTOR_SHIFT;
+
+    if (region_size < PROBE_MIN_SCRATCH_SIZE)
+    {
+      format_disk_size(PROBE_MIN_SCRATCH_SIZE, str, sizeof(str));
+      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": the scratch range must be at least %s.\n", str);
+      return 1;
+    }
+
+    if (cap->dryrun)
+      fprintf(stdout, CTRL_MAGENTA "DRYRUN" CTRL_RESET ": write tests in LBAs %" FMT64 "u..%" FMT64 "u are skipped.\n", cap->scratch_range_start, cap->scratch_range_end);
+    else
+      write_tests = true;
+  }
+  else
+  if (!cap->device_is_real_device)
+  {
+    // image files: the write tests use a region appended to the image, which is truncated away
+    // afterwards, i.e. the writes go to the image file itself but its data is not touched
+
+    region_size = PROBE_SCRATCH_IMAGE_SIZE;
+    append_region = true;
+
+    if (cap->dryrun)
+      fprintf(stdout, CTRL_MAGENTA "DRYRUN" CTRL_RESET ": write tests in a region appended to the image file are skipped.\n");
+    else
+      write_tests = true;
+  }
+  else
+    fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": no --scratch-range specified, write tests are skipped.\n");
+
+  wp = workpool_create(PROBE_MAX_QUEUE_DEPTH, 0);
+  if (NULL == wp)
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": Unable to create the worker threads.\n");
+    return 1;
+  }
+
+  memset(&run, 0, sizeof(run));
+  run.seed = get_time_usec();
+
+  // read tests (whole device)
+
+  h = probe_open(dp->device_file, false, &buffered);
+  if (INVALID_DISK_HANDLE == h)
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": Unable to open %s for reading.\n", dp->device_file);
+    goto Exit;
+  }
+
+  if (buffered)
+    fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": unbuffered I/O not supported for %s, results include caching effects.\n", dp->device_file);
+
+  fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": probing %s, %u ms per test point.\n", dp->device_file, PROBE_POINT_DURATION_MS);
+
+  run.h = h;
+  run.write = false;
+  run.region_start = 0;
+
+  if (!probe_sequential(wp, &run, dp->device_sectors << SECTOR_SHIFT, "sequential read:", &prof.read_block_size, &prof.read_queue_depth, &prof.read_bps))
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": sequential read test failed.\n");
+    goto Exit;
+  }
+
+  if (!probe_random(wp, &run, dp->device_sectors << SECTOR_SHIFT, "random 4K read:", &prof.random_read_iops, &prof.random_read_latency_usec))
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": random read test failed.\n");
+    goto Exit;
+  }
+
+  probe_close(h);
+  h = INVALID_DISK_HANDLE;
+
+  // write tests (scratch range or region appended to the image file)
+
+  if (write_tests)
+  {
+    h = probe_open(dp->device_file, true, &buffered);
+    if (INVALID_DISK_HANDLE == h)
+    {
+      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": Unable to open %s for writing.\n", dp->device_file);
+      goto Exit;
+    }
+
+    if (append_region)
+    {
+      image_size = disk_getFileSize(h);
+      if ((0 == image_size) || (((uint64_t)-1) == image_size))
+      {
+        fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": Unable to get the size of %s.\n", dp->device_file);
+        goto Exit;
+      }
+      region_start = (image_size + (PROBE_MAX_BLOCK_SIZE - 1)) & ~((uint64_t)(PROBE_MAX_BLOCK_SIZE - 1));
+    }
+
+    pattern = probe_alloc(PROBE_MAX_BLOCK_SIZE, &mem);
+    if (NULL == pattern)
+    {
+      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": Insufficient memory available.\n");
+      goto Exit;
+    }
+
+    // incompressible data, some devices compress or deduplicate zeros
+
+    for (i = 0; i < PROBE_MAX_BLOCK_SIZE; i++)
+      pattern[i] = (uint8_t)((i * 0x9E3779B1) >> 13);
+
+    run.h = h;
+    run.write = true;
+    run.region_start = region_start;
+    run.pattern = pattern;
+
+    if (!probe_sequential(wp, &run, region_size, "sequential write:", &prof.write_block_size, &prof.write_queue_depth, &prof.write_bps))
+    {
+      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": sequential write test failed.\n");
+      goto Exit;
+    }
+
+    if (!probe_random(wp, &run, region_size, "random 4K write:", &prof.random_write_iops, &prof.random_write_latency_usec))
+    {
+      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": random write test failed.\n");
+      goto Exit;
+    }
+  }
+
+  fprintf(stdout, "\n");
+
+  if (!probe_save_profile(cap->profile_file, &prof))
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": Unable to store the device profile in %s\n", cap->profile_file);
+    goto Exit;
+  }
+
+  fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": device profile stored in %s\n", cap->profile_file);
+
+  ok = true;
+
+Exit:
+  if (INVALID_DISK_HANDLE != h)
+    probe_close(h);
+  if ((0 != image_size) && (((uint64_t)-1) != image_size) && !disk_resize_image(dp->device_file, image_size, false))
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": Unable to truncate %s to its original size.\n", dp->device_file);
+  if (NULL != mem)
+    free(mem);
+  workpool_destroy(wp);
+
+  return ok ? 0 : 1;
+}
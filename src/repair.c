@@ -0,0 +1,293 @@
+/**
+ * @file   repair.c
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @brief  implementation of the repairgpt command (minimal-write reconstruction
+ *         of a broken or misplaced GPT copy).
+ *
+ * [MIT license]
+ *
+ * Copyright (c) 2021 Ingo A. Kubbilun
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <part-y.h>
+
+static const char* repair_gpt_actions[] =
+{
+  "no repair needed",
+  "backup GPT from primary GPT",
+  "primary GPT from backup GPT",
+  "backup GPT moved to disk end"
+};
+
+static uint8_t* repair_gpt_alloc(void** buffer_mem, uint32_t num_sectors)
+{
+  *buffer_mem = malloc((((size_t)num_sectors) << SECTOR_SHIFT) + SECTOR_MEM_ALIGN);
+  if (NULL == *buffer_mem)
+    return NULL;
+
+  return (uint8_t*)((((uint64_t)*buffer_mem) + (SECTOR_MEM_ALIGN - 1)) & (~((uint64_t)(SECTOR_MEM_ALIGN - 1))));
+}
+
+bool repair_gpt_plan(disk_ptr dp, repair_plan_ptr rpp, char* error, size_t error_size)
+{
+  bool                primary_ok, backup_ok;
+  gpt_ptr             g = NULL;
+  uint64_t            last_lba = dp->device_sectors - 1, lba;
+  uint32_t            i, entry_sectors;
+  uint8_t            *p;
+  void               *buffer_mem = NULL;
+
+  memset(rpp, 0, sizeof(repair_plan));
+
+  rpp->wpp = write_plan_create();
+  if (NULL == rpp->wpp)
+    goto NoMemory;
+
+  primary_ok = dp->primary_gpt_exists && !dp->primary_gpt_corrupt;
+  backup_ok = dp->backup_gpt_exists && !dp->backup_gpt_corrupt;
+
+  if (!primary_ok && !backup_ok)
+  {
+    snprintf(error, error_size, "neither the primary nor the backup GPT is valid");
+    return false;
+  }
+
+  // the primary GPT is authoritative if it is valid (as with UEFI firmware), i.e. it also wins if
+  // both copies are valid but mismatch
+
+  if (primary_ok)
+  {
+    entry_sectors = GPT_ENTRY_ARRAY_SECTORS(dp->gpt1->header);
+
+    if (dp->gpt1->header.backup_lba == last_lba)
+    {
+      if (backup_ok && !dp->gpts_mismatch)
+        return true; // REPAIR_GPT_NONE
+
+      if ((dp->gpt1->header.last_usable_lba + entry_sectors) >= last_lba)
+      {
+        snprintf(error, error_size, "the backup GPT would overlap the usable area");
+        repair_gpt_free(rpp);
+        return false;
+      }
+
+      p = repair_gpt_alloc(&buffer_mem, 1 + entry_sectors);
+      if (NULL == p)
+        goto NoMemory;
+
+      rpp->action = REPAIR_GPT_BACKUP;
+      lba = gpt_repair_table(p, dp->gpt1, true /*primary is the template of the backup*/) >> SECTOR_SHIFT;
+      if (!write_plan_add(rpp->wpp, lba, 1 + entry_sectors, p, "backup GPT"))
+        goto NoMemory;
+
+      free(buffer_mem);
+      return true;
+    }
+
+    // resized disk: the backup GPT goes to the (new) last LBA, the usable area ends right before
+    // its entries; the primary GPT has to refer to the new location, too, and a protective MBR
+    // has to cover the new size (it precedes the primary GPT, so this is coalesced into one write)
+
+    if (last_lba <= (dp->gpt1->header.first_usable_lba + entry_sectors))
+    {
+      snprintf(error, error_size, "the disk is too small for the GPT");
+      repair_gpt_free(rpp);
+      return false;
+    }
+
+    g = partition_clone_gpt(dp->gpt1);
+    if (NULL == g)
+      goto NoMemory;
+
+    g->header.backup_lba = last_lba;
+    g->header.last_usable_lba = last_lba - entry_sectors - 1;
+
+    for (i = 0; i < g->num_entries; i++)
+    {
+      if (g->entries[i].part_end_lba > g->header.last_usable_lba)
+      {
+        snprintf(error, error_size, "partition in slot %u exceeds the end of the (shrunk) disk", g->entries[i].slot + 1);
+        partition_free_gpt(g);
+        repair_gpt_free(rpp);
+        return false;
+      }
+    }
+
+    p = repair_gpt_alloc(&buffer_mem, 1 + entry_sectors);
+    if (NULL == p)
+    {
+      partition_free_gpt(g);
+      goto NoMemory;
+    }
+
+    // the new backup GPT is durable before the primary GPT is replaced: until then, the old
+    // primary GPT still refers to the old (intact) backup GPT
+
+    rpp->action = REPAIR_GPT_RELOCATE;
+    lba = gpt_repair_table(p, g, true /*primary is the template of the backup*/) >> SECTOR_SHIFT;
+    if (!write_plan_add(rpp->wpp, lba, 1 + entry_sectors, p, "backup GPT"))
+    {
+      partition_free_gpt(g);
+      goto NoMemory;
+    }
+    write_plan_barrier(rpp->wpp);
+
+    if ((DISK_FLAG_MBR_IS_PROTECTIVE & dp->flags) && NULL != dp->mbr && NULL != dp->mbr->sp)
+    {
+      create_protective_mbr(dp->device_sectors, p);
+      memcpy(p, dp->mbr->sp->data, 0x01BE); // keep boot code and disk signature
+      if (!write_plan_add(rpp->wpp, 0, 1, p, "protective MBR"))
+      {
+        partition_free_gpt(g);
+        goto NoMemory;
+      }
+    }
+
+    gpt_create_table(p, g, true /*primary*/);
+    if (!write_plan_add(rpp->wpp, g->header.current_lba, 1 + entry_sectors, p, "primary GPT"))
+    {
+      partition_free_gpt(g);
+      goto NoMemory;
+    }
+
+    partition_free_gpt(g);
+    free(buffer_mem);
+    return true;
+  }
+
+  // only the backup GPT is valid: rebuild the primary header at LBA 1 and its entries at LBA 2
+
+  entry_sectors = GPT_ENTRY_ARRAY_SECTORS(dp->gpt2->header);
+
+  if (1 != dp->gpt2->header.backup_lba)
+  {
+    snprintf(error, error_size, "the backup GPT does not refer to the primary GPT at LBA 1");
+    repair_gpt_free(rpp);
+    return false;
+  }
+
+  if ((2 + entry_sectors) > dp->gpt2->header.first_usable_lba)
+  {
+    snprintf(error, error_size, "the primary GPT would overlap the usable area");
+    repair_gpt_free(rpp);
+    return false;
+  }
+
+  p = repair_gpt_alloc(&buffer_mem, 1 + entry_sectors);
+  if (NULL == p)
+    goto NoMemory;
+
+  rpp->action = REPAIR_GPT_PRIMARY;
+  lba = gpt_repair_table(p, dp->gpt2, false /*backup is the template of the primary*/) >> SECTOR_SHIFT;
+  if (!write_plan_add(rpp->wpp, lba, 1 + entry_sectors, p, "primary GPT"))
+    goto NoMemory;
+
+  free(buffer_mem);
+  return true;
+
+NoMemory:
+  if (NULL != buffer_mem)
+    free(buffer_mem);
+  repair_gpt_free(rpp);
+  snprintf(error, error_size, "insufficient memory available");
+  return false;
+}
+
+bool repair_gpt_commit(disk_ptr dp, repair_plan_ptr rpp, char* error, size_t error_size)
+{
+  return write_plan_execute(rpp->wpp, dp->device_file, error, error_size);
+}
+
+void repair_gpt_free(repair_plan_ptr rpp)
+{
+  if (NULL != rpp->wpp)
+    write_plan_free(rpp->wpp);
+  memset(rpp, 0, sizeof(repair_plan));
+}
+
+const char* repair_gpt_action_name(uint32_t action)
+{
+  return action < (sizeof(repair_gpt_actions) / sizeof(repair_gpt_actions[0])) ? repair_gpt_actions[action] : "(unknown)";
+}
+
+int repair_gpt(cmdline_args_ptr cap)
+{
+  disk_ptr            dp = cap->work_disk;
+  repair_plan         rp;
+  char                error[256];
+
+  if (0 != cap->fleet_file[0])
+    return fleet_repair_gpt(cap);
+
+  if (NULL == dp)
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": No working disk available.\n");
+    return 1;
+  }
+
+  if (SECTOR_SIZE != dp->logical_sector_size)
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": logical sector size %u is not supported.\n", dp->logical_sector_size);
+    return 1;
+  }
+
+  if (!repair_gpt_plan(dp, &rp, error, sizeof(error)))
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": %s: %s.\n", dp->device_file, error);
+    return 1;
+  }
+
+  if (REPAIR_GPT_NONE == rp.action)
+  {
+    fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": both GPTs of %s are consistent and HEALTHY, nothing to repair.\n", dp->device_file);
+    repair_gpt_free(&rp);
+    return 0;
+  }
+
+  fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": %s: %s.\n", dp->device_file, repair_gpt_action_name(rp.action));
+
+  if (cap->dryrun)
+    fprintf(stdout, CTRL_MAGENTA "DRYRUN" CTRL_RESET ": Explaining what would be done.\n");
+
+  write_plan_dump(rp.wpp);
+
+  if (cap->dryrun)
+  {
+    repair_gpt_free(&rp);
+    return 0;
+  }
+
+  fprintf(stdout, CTRL_CYAN "WORKING" CTRL_RESET " : Repairing the GPT ........................................: ");
+  fflush(stdout);
+
+  if (!repair_gpt_commit(dp, &rp, error, sizeof(error)))
+  {
+    fprintf(stdout, CTRL_RED "ERROR" CTRL_RESET "\n          %s.\n", error);
+    repair_gpt_free(&rp);
+    return 1;
+  }
+
+  fprintf(stdout, CTRL_GREEN "OK" CTRL_RESET "\n");
+
+  repair_gpt_free(&rp);
+
+  return 0;
+}
@@ -0,0 +1,810 @@
+/**
+ * @file   scancache.c
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @brief  implementation of the scan cache, which stores the sectors read
+ *         while scanning the partition tables of a device, so that repeated
+ *         invocations only have to read (and validate) LBAs 0 and 1.
+ *
+ * [MIT license]
+ *
+ * Copyright (c) 2021 Ingo A. Kubbilun
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <part-y.h>
+
+#define SCAN_CACHE_ENTRY_SIZE     (256 + 64 + SCAN_CACHE_HASH_SIZE + 5 * 8 + 4 * 4) ///< serialized entry (without the sector runs and peeks)
+#define SCAN_CACHE_RUN_SIZE       (8 + 4)     ///< serialized run header (LBA, number of sectors)
+#define SCAN_CACHE_PEEK_SIZE      (8 + 8 + 4 + 8 + 16 + FS_SIG_LABEL_SIZE) ///< serialized peek (LBA, sectors, type, size, UUID, label)
+
+void scan_cache_default_file(char* buf, size_t buf_size)
+{
+#ifdef _WINDOWS
+  const char         *home = getenv("APPDATA");
+#else
+  const char         *home = getenv("HOME");
+#endif
+
+  if (NULL == home || 0 == home[0])
+    snprintf(buf, buf_size, "%s", SCAN_CACHE_FILE_NAME);
+  else
+#ifdef _WINDOWS
+    snprintf(buf, buf_size, "%s\\%s", home, SCAN_CACHE_FILE_NAME);
+#else
+    snprintf(buf, buf_size, "%s/%s", home, SCAN_CACHE_FILE_NAME);
+#endif
+}
+
+void scan_cache_free_entry(scan_cache_entry_ptr ep)
+{
+  uint32_t            i;
+
+  if (NULL == ep)
+    return;
+
+  if (NULL != ep->runs)
+  {
+    for (i = 0; i < ep->num_runs; i++)
+      free(ep->runs[i].data);
+    free(ep->runs);
+  }
+
+  if (NULL != ep->peeks)
+    free(ep->peeks);
+
+  free(ep);
+}
+
+void scan_cache_free(scan_cache_ptr sc)
+{
+  scan_cache_entry_ptr  next;
+
+  if (NULL == sc)
+    return;
+
+  while (NULL != sc->head)
+  {
+    next = sc->head->next;
+    scan_cache_free_entry(sc->head);
+    sc->head = next;
+  }
+
+  free(sc);
+}
+
+static bool scanCacheAddRun(scan_cache_entry_ptr ep, uint64_t lba, uint32_t num_sectors, const uint8_t* data)
+{
+  scan_cache_run_ptr  runs;
+  uint32_t            max_runs;
+
+  if (ep->num_runs >= SCAN_CACHE_MAX_RUNS || 0 == num_sectors || num_sectors > SCAN_CACHE_MAX_RUN_SECTORS)
+    return false;
+
+  if (ep->num_runs == ep->max_runs)
+  {
+    max_runs = 0 == ep->max_runs ? 16 : ep->max_runs << 1;
+    runs = (scan_cache_run_ptr)realloc(ep->runs, max_runs * sizeof(scan_cache_run));
+    if (unlikely(NULL == runs))
+      return false;
+    ep->runs = runs;
+    ep->max_runs = max_runs;
+  }
+
+  ep->runs[ep->num_runs].data = (uint8_t*)malloc(((size_t)num_sectors) << SECTOR_SHIFT);
+  if (unlikely(NULL == ep->runs[ep->num_runs].data))
+    return false;
+
+  if (NULL != data)
+    memcpy(ep->runs[ep->num_runs].data, data, ((size_t)num_sectors) << SECTOR_SHIFT);
+  ep->runs[ep->num_runs].lba = lba;
+  ep->runs[ep->num_runs].num_sectors = num_sectors;
+  ep->num_runs++;
+
+  return true;
+}
+
+static bool scanCacheAddPeek(scan_cache_entry_ptr ep, uint64_t lba, uint64_t num_sectors, const fs_sig_result* res)
+{
+  scan_cache_peek_ptr peeks;
+  uint32_t            max_peeks;
+
+  if (ep->num_peeks >= SCAN_CACHE_MAX_PEEKS)
+    return false;
+
+  if (ep->num_peeks == ep->max_peeks)
+  {
+    max_peeks = 0 == ep->max_peeks ? 16 : ep->max_peeks << 1;
+    peeks = (scan_cache_peek_ptr)realloc(ep->peeks, max_peeks * sizeof(scan_cache_peek));
+    if (unlikely(NULL == peeks))
+      return false;
+    ep->peeks = peeks;
+    ep->max_peeks = max_peeks;
+  }
+
+  memset(&ep->peeks[ep->num_peeks], 0, sizeof(scan_cache_peek));
+  ep->peeks[ep->num_peeks].lba = lba;
+  ep->peeks[ep->num_peeks].num_sectors = num_sectors;
+  if (NULL != res)
+    memcpy(&ep->peeks[ep->num_peeks].result, res, sizeof(fs_sig_result));
+  ep->num_peeks++;
+
+  return true;
+}
+
+static void scanCacheCopySerial(char* serial, size_t serial_size, const char* src, size_t src_len)
+{
+  size_t              l = 0;
+
+  // trim leading and trailing white space (sysfs attributes end with a newline, ATA serial numbers are padded)
+
+  while (src_len > 0 && (' ' == *src || '\t' == *src))
+  {
+    src++;
+    src_len--;
+  }
+
+  while (src_len > 0 && (' ' == src[src_len - 1] || '\t' == src[src_len - 1] || '\n' == src[src_len - 1] || '\r' == src[src_len - 1] || 0 == src[src_len - 1]))
+    src_len--;
+
+  while (l < src_len && l < serial_size - 1)
+  {
+    serial[l] = src[l];
+    l++;
+  }
+
+  serial[l] = 0;
+}
+
+#ifdef _WINDOWS
+
+static bool scanCacheGetIdentity(disk_ptr dp, DISK_HANDLE h, scan_cache_entry_ptr ep)
+{
+  BY_HANDLE_FILE_INFORMATION  bhfi;
+  STORAGE_PROPERTY_QUERY      query;
+  uint8_t                     desc_buf[1024];
+  PSTORAGE_DEVICE_DESCRIPTOR  pdesc = (PSTORAGE_DEVICE_DESCRIPTOR)desc_buf;
+  DWORD                       returned = 0;
+
+  if (DISK_FLAG_NOT_DEVICE_BUT_FILE & dp->flags)
+  {
+    if (!GetFileInformationByHandle(h, &bhfi))
+      return false;
+
+    ep->device_id = (uint64_t)bhfi.dwVolumeSerialNumber;
+    ep->file_id = (((uint64_t)bhfi.nFileIndexHigh) << 32) | ((uint64_t)bhfi.nFileIndexLow);
+    ep->mtime_usec = ((((uint64_t)bhfi.ftLastWriteTime.dwHighDateTime) << 32) | ((uint64_t)bhfi.ftLastWriteTime.dwLowDateTime)) / 10;
+  }
+  else
+  {
+    ep->device_id = (uint64_t)dp->device_no;
+
+    memset(&query, 0, sizeof(query));
+    query.PropertyId = StorageDeviceProperty;
+    query.QueryType = PropertyStandardQuery;
+
+    if (DeviceIoControl(h, IOCTL_STORAGE_QUERY_PROPERTY, &query, sizeof(query), desc_buf, sizeof(desc_buf), &returned, NULL) &&
+        0 != pdesc->SerialNumberOffset && pdesc->SerialNumberOffset < returned)
+      scanCacheCopySerial(ep->serial, sizeof(ep->serial), (const char*)(desc_buf + pdesc->SerialNumberOffset),
+                          strnlen((const char*)(desc_buf + pdesc->SerialNumberOffset), returned - pdesc->SerialNumberOffset));
+  }
+
+  return true;
+}
+
+#else // _LINUX
+
+static void scanCacheReadSerial(unsigned int maj, unsigned int min, char* serial, size_t serial_size)
+{
+  static const char* const  attributes[] = { "wwid", "device/wwid", "device/serial", "serial" };
+  char                      sys_file[256];
+  FILE                     *f;
+  size_t                    i, l;
+
+  for (i = 0; i < sizeof(attributes) / sizeof(attributes[0]); i++)
+  {
+    snprintf(sys_file, sizeof(sys_file), "/sys/dev/block/%u:%u/%s", maj, min, attributes[i]);
+    f = fopen(sys_file, "rt");
+    if (NULL == f)
+      continue;
+
+    memset(sys_file, 0, sizeof(sys_file));
+    l = fread(sys_file, 1, sizeof(sys_file) - 1, f);
+    fclose(f);
+
+    scanCacheCopySerial(serial, serial_size, sys_file, l);
+    if (0 != serial[0])
+      return;
+  }
+}
+
+static bool scanCacheGetIdentity(disk_ptr dp, DISK_HANDLE h, scan_cache_entry_ptr ep)
+{
+  struct stat         st;
+
+  (void)dp;
+
+  if (0 != fstat(h, &st))
+    return false;
+
+  if (S_ISBLK(st.st_mode))
+  {
+    ep->device_id = (uint64_t)st.st_rdev;
+    scanCacheReadSerial(major(st.st_rdev), minor(st.st_rdev), ep->serial, sizeof(ep->serial));
+  }
+  else
+  {
+    ep->device_id = (uint64_t)st.st_dev;
+    ep->file_id = (uint64_t)st.st_ino;
+    ep->mtime_usec = (((uint64_t)st.st_mtim.tv_sec) * 1000000) + (((uint64_t)st.st_mtim.tv_nsec) / 1000);
+  }
+
+  return true;
+}
+
+#endif // _LINUX
+
+static bool scanCacheSameIdentity(const scan_cache_entry* a, const scan_cache_entry* b)
+{
+  return !strcmp(a->device_file, b->device_file) && a->device_id == b->device_id && a->file_id == b->file_id &&
+         a->mtime_usec == b->mtime_usec && a->device_size == b->device_size &&
+         a->logical_sector_size == b->logical_sector_size && a->physical_sector_size == b->physical_sector_size &&
+         !strcmp(a->serial, b->serial);
+}
+
+bool scan_cache_begin(disk_ptr dp, DISK_HANDLE h)
+{
+  scan_cache_ptr        sc = dp->scan_cache;
+  scan_cache_entry_ptr  ep, run;
+  uint8_t              *buffer_malloc = NULL, *buffer;
+  uint64_t              now = (uint64_t)time(NULL);
+
+  dp->scan_replay = NULL;
+  dp->scan_recording = false;
+
+  if (NULL == sc || sc->invalidate_only || dp->device_sectors < 2)
+    return false;
+
+  if (NULL != dp->scan_record) // rescan
+  {
+    scan_cache_free_entry(dp->scan_record);
+    dp->scan_record = NULL;
+  }
+
+  ep = (scan_cache_entry_ptr)malloc(sizeof(scan_cache_entry));
+  if (unlikely(NULL == ep))
+    return false;
+
+  memset(ep, 0, sizeof(scan_cache_entry));
+
+  strncpy(ep->device_file, dp->device_file, sizeof(ep->device_file) - 1);
+  ep->device_size = dp->device_sectors << SECTOR_SHIFT;
+  ep->logical_sector_size = dp->logical_sector_size;
+  ep->physical_sector_size = dp->physical_sector_size;
+  ep->timestamp = now;
+
+  if (!scanCacheGetIdentity(dp, h, ep))
+    goto NoCache;
+
+  // the validator: MBR and primary GPT header (which contains the CRCs of itself and of the GPT entries)
+
+  buffer_malloc = (uint8_t*)malloc((SECTOR_SIZE << 1) + SECTOR_MEM_ALIGN);
+  if (unlikely(NULL == buffer_malloc))
+    goto NoCache;
+
+  buffer = (uint8_t*)((((uint64_t)buffer_malloc) + (SECTOR_MEM_ALIGN - 1)) & (~(SECTOR_MEM_ALIGN - 1)));
+
+  if (!disk_read(dp, h, 0, buffer, SECTOR_SIZE << 1))
+    goto NoCache;
+
+  if (SHA3_RETURN_OK != sha3_HashBuffer(256, SHA3_FLAGS_NONE, buffer, SECTOR_SIZE << 1, ep->validator, SCAN_CACHE_HASH_SIZE))
+    goto NoCache;
+
+  free(buffer_malloc);
+
+  for (run = sc->head; NULL != run; run = run->next)
+  {
+    if (scanCacheSameIdentity(run, ep) && !memcmp(run->validator, ep->validator, SCAN_CACHE_HASH_SIZE) &&
+        now >= run->timestamp && (now - run->timestamp) < SCAN_CACHE_MAX_AGE_SEC)
+    {
+      scan_cache_free_entry(ep);
+      dp->scan_replay = run;
+      (void)atomic_add64(&sc->hits, 1);
+      return true;
+    }
+  }
+
+  // miss: record all sectors of this scan
+
+  dp->scan_record = ep;
+  dp->scan_recording = true;
+  (void)atomic_add64(&sc->misses, 1);
+
+  return false;
+
+NoCache:
+
+  if (NULL != buffer_malloc)
+    free(buffer_malloc);
+  scan_cache_free_entry(ep);
+
+  return false;
+}
+
+bool scan_cache_replay(disk_ptr dp, uint64_t lba, uint32_t num_sectors, uint8_t* buffer)
+{
+  scan_cache_entry_ptr  ep = dp->scan_replay;
+  uint32_t              i;
+
+  for (i = 0; i < ep->num_runs; i++)
+  {
+    if (lba >= ep->runs[i].lba && (lba + num_sectors) <= (ep->runs[i].lba + ep->runs[i].num_sectors))
+    {
+      memcpy(buffer, ep->runs[i].data + ((lba - ep->runs[i].lba) << SECTOR_SHIFT), ((size_t)num_sectors) << SECTOR_SHIFT);
+      return true;
+    }
+  }
+
+  // the scan deviates from the recorded one: read from the device and rescan next time
+
+  dp->scan_cache_invalid = true;
+  dp->scan_replay = NULL;
+
+  return false;
+}
+
+void scan_cache_record(disk_ptr dp, uint64_t lba, uint32_t num_sectors, const uint8_t* data)
+{
+  if (!dp->scan_recording || NULL == dp->scan_record)
+    return;
+
+  if (!scanCacheAddRun(dp->scan_record, lba, num_sectors, data))
+  {
+    // incomplete recordings cannot be replayed
+
+    scan_cache_free_entry(dp->scan_record);
+    dp->scan_record = NULL;
+    dp->scan_recording = false;
+  }
+}
+
+bool scan_cache_replay_peek(disk_ptr dp, uint64_t lba, uint64_t num_sectors, fs_sig_result_ptr res)
+{
+  scan_cache_entry_ptr  ep = dp->scan_replay;
+  uint32_t              i;
+
+  for (i = 0; i < ep->num_peeks; i++)
+  {
+    if (lba == ep->peeks[i].lba && num_sectors == ep->peeks[i].num_sectors)
+    {
+      memcpy(res, &ep->peeks[i].result, sizeof(fs_sig_result));
+      return true;
+    }
+  }
+
+  dp->scan_cache_invalid = true;
+  dp->scan_replay = NULL;
+
+  return false;
+}
+
+void scan_cache_record_peek(disk_ptr dp, uint64_t lba, uint64_t num_sectors, const fs_sig_result* res)
+{
+  if (NULL == dp->scan_record)
+    return;
+
+  if (!scanCacheAddPeek(dp->scan_record, lba, num_sectors, res))
+  {
+    scan_cache_free_entry(dp->scan_record);
+    dp->scan_record = NULL;
+    dp->scan_recording = false;
+  }
+}
+
+void scan_cache_end(disk_ptr dp)
+{
+  dp->scan_replay = NULL;
+  dp->scan_recording = false;
+}
+
+void scan_cache_invalidate(disk_ptr dp)
+{
+  if (NULL != dp)
+    dp->scan_cache_invalid = true;
+}
+
+void scan_cache_invalidate_file(scan_cache_ptr sc, const char* device_file)
+{
+  scan_cache_entry_ptr  ep, prev = NULL, next;
+
+  if (NULL == sc)
+    return;
+
+  for (ep = sc->head; NULL != ep; ep = next)
+  {
+    next = ep->next;
+
+    if (!strcmp(ep->device_file, device_file))
+    {
+      if (NULL == prev)
+        sc->head = next;
+      else
+        prev->next = next;
+      scan_cache_free_entry(ep);
+      sc->dropped = true;
+    }
+    else
+      prev = ep;
+  }
+}
+
+static void scanCachePutBytes(uint8_t** p, const void* src, size_t size)
+{
+  memcpy(*p, src, size);
+  *p += size;
+}
+
+static void scanCachePut32(uint8_t** p, uint32_t value)
+{
+  WRITE_LITTLE_ENDIAN32((*p), 0, value);
+  *p += 4;
+}
+
+static void scanCachePut64(uint8_t** p, uint64_t value)
+{
+  WRITE_LITTLE_ENDIAN64((*p), 0, value);
+  *p += 8;
+}
+
+static void scanCacheGetBytes(const uint8_t** p, void* dst, size_t size)
+{
+  memcpy(dst, *p, size);
+  *p += size;
+}
+
+static uint32_t scanCacheGet32(const uint8_t** p)
+{
+  uint32_t            value = READ_LITTLE_ENDIAN32((*p), 0);
+
+  *p += 4;
+  return value;
+}
+
+static uint64_t scanCacheGet64(const uint8_t** p)
+{
+  uint64_t            value = READ_LITTLE_ENDIAN64((*p), 0);
+
+  *p += 8;
+  return value;
+}
+
+static scan_cache_entry_ptr scanCacheReadEntry(FILE* f)
+{
+  uint8_t               buffer[SCAN_CACHE_ENTRY_SIZE];
+  const uint8_t        *p = buffer;
+  scan_cache_entry_ptr  ep;
+  uint32_t              i, num_runs, num_peeks, num_sectors;
+  uint64_t              lba;
+  scan_cache_peek_ptr   pp;
+
+  if (1 != fread(buffer, sizeof(buffer), 1, f))
+    return NULL;
+
+  ep = (scan_cache_entry_ptr)malloc(sizeof(scan_cache_entry));
+  if (unlikely(NULL == ep))
+    return NULL;
+
+  memset(ep, 0, sizeof(scan_cache_entry));
+
+  scanCacheGetBytes(&p, ep->device_file, sizeof(ep->device_file));
+  ep->device_file[sizeof(ep->device_file) - 1] = 0;
+  scanCacheGetBytes(&p, ep->serial, sizeof(ep->serial));
+  ep->serial[sizeof(ep->serial) - 1] = 0;
+  scanCacheGetBytes(&p, ep->validator, SCAN_CACHE_HASH_SIZE);
+  ep->device_id = scanCacheGet64(&p);
+  ep->file_id = scanCacheGet64(&p);
+  ep->mtime_usec = scanCacheGet64(&p);
+  ep->device_size = scanCacheGet64(&p);
+  ep->timestamp = scanCacheGet64(&p);
+  ep->logical_sector_size = scanCacheGet32(&p);
+  ep->physical_sector_size = scanCacheGet32(&p);
+  num_runs = scanCacheGet32(&p);
+  num_peeks = scanCacheGet32(&p);
+
+  if (num_runs > SCAN_CACHE_MAX_RUNS || num_peeks > SCAN_CACHE_MAX_PEEKS)
+    goto ErrorExit;
+
+  for (i = 0; i < num_runs; i++)
+  {
+    p = buffer;
+    if (1 != fread(buffer, SCAN_CACHE_RUN_SIZE, 1, f))
+      goto ErrorExit;
+    lba = scanCacheGet64(&p);
+    num_sectors = scanCacheGet32(&p);
+
+    if (!scanCacheAddRun(ep, lba, num_sectors, NULL))
+      goto ErrorExit;
+
+    if (1 != fread(ep->runs[i].data, ((size_t)num_sectors) << SECTOR_SHIFT, 1, f))
+      goto ErrorExit;
+  }
+
+  for (i = 0; i < num_peeks; i++)
+  {
+    p = buffer;
+    if (1 != fread(buffer, SCAN_CACHE_PEEK_SIZE, 1, f))
+      goto ErrorExit;
+
+    if (!scanCacheAddPeek(ep, 0, 0, NULL))
+      goto ErrorExit;
+
+    pp = &ep->peeks[i];
+    pp->lba = scanCacheGet64(&p);
+    pp->num_sectors = scanCacheGet64(&p);
+    pp->result.fs_type = scanCacheGet32(&p);
+    pp->result.fs_size = scanCacheGet64(&p);
+    scanCacheGetBytes(&p, pp->result.uuid, sizeof(pp->result.uuid));
+    scanCacheGetBytes(&p, pp->result.label, FS_SIG_LABEL_SIZE);
+    pp->result.label[FS_SIG_LABEL_SIZE - 1] = 0;
+  }
+
+  return ep;
+
+ErrorExit:
+
+  scan_cache_free_entry(ep);
+
+  return NULL;
+}
+
+scan_cache_ptr scan_cache_load(const char* cache_file)
+{
+  scan_cache_ptr        sc;
+  scan_cache_entry_ptr  ep, tail = NULL;
+  FILE                 *f;
+  uint8_t               header[sizeof(SCAN_CACHE_MAGIC) - 1 + 4];
+  const uint8_t        *p = header + sizeof(SCAN_CACHE_MAGIC) - 1;
+  uint32_t              i, num_entries;
+
+  sc = (scan_cache_ptr)malloc(sizeof(scan_cache));
+  if (unlikely(NULL == sc))
+    return NULL;
+
+  memset(sc, 0, sizeof(scan_cache));
+  strncpy(sc->cache_file, cache_file, sizeof(sc->cache_file) - 1);
+
+  f = fopen(cache_file, "rb");
+  if (NULL == f)
+    return sc; // no cache file (yet)
+
+  if (1 != fread(header, sizeof(header), 1, f) || memcmp(header, SCAN_CACHE_MAGIC, sizeof(SCAN_CACHE_MAGIC) - 1))
+    goto Discard;
+
+  num_entries = scanCacheGet32(&p);
+  if (num_entries > SCAN_CACHE_MAX_ENTRIES)
+    goto Discard;
+
+  for (i = 0; i < num_entries; i++)
+  {
+    ep = scanCacheReadEntry(f);
+    if (NULL == ep)
+      goto Discard;
+
+    if (NULL == tail)
+      sc->head = ep;
+    else
+      tail->next = ep;
+    tail = ep;
+  }
+
+  fclose(f);
+
+  return sc;
+
+Discard:
+
+  // foreign or damaged cache file: start with an empty cache, the file is rewritten
+
+  fclose(f);
+
+  while (NULL != sc->head)
+  {
+    ep = sc->head->next;
+    scan_cache_free_entry(sc->head);
+    sc->head = ep;
+  }
+
+  return sc;
+}
+
+static bool scanCacheWriteEntry(FILE* f, const scan_cache_entry* ep)
+{
+  uint8_t             buffer[SCAN_CACHE_ENTRY_SIZE];
+  uint8_t            *p = buffer;
+  uint32_t            i;
+
+  scanCachePutBytes(&p, ep->device_file, sizeof(ep->device_file));
+  scanCachePutBytes(&p, ep->serial, sizeof(ep->serial));
+  scanCachePutBytes(&p, ep->validator, SCAN_CACHE_HASH_SIZE);
+  scanCachePut64(&p, ep->device_id);
+  scanCachePut64(&p, ep->file_id);
+  scanCachePut64(&p, ep->mtime_usec);
+  scanCachePut64(&p, ep->device_size);
+  scanCachePut64(&p, ep->timestamp);
+  scanCachePut32(&p, ep->logical_sector_size);
+  scanCachePut32(&p, ep->physical_sector_size);
+  scanCachePut32(&p, ep->num_runs);
+  scanCachePut32(&p, ep->num_peeks);
+
+  if (1 != fwrite(buffer, sizeof(buffer), 1, f))
+    return false;
+
+  for (i = 0; i < ep->num_runs; i++)
+  {
+    p = buffer;
+    scanCachePut64(&p, ep->runs[i].lba);
+    scanCachePut32(&p, ep->runs[i].num_sectors);
+
+    if (1 != fwrite(buffer, SCAN_CACHE_RUN_SIZE, 1, f) ||
+        1 != fwrite(ep->runs[i].data, ((size_t)ep->runs[i].num_sectors) << SECTOR_SHIFT, 1, f))
+      return false;
+  }
+
+  for (i = 0; i < ep->num_peeks; i++)
+  {
+    p = buffer;
+    scanCachePut64(&p, ep->peeks[i].lba);
+    scanCachePut64(&p, ep->peeks[i].num_sectors);
+    scanCachePut32(&p, ep->peeks[i].result.fs_type);
+    scanCachePut64(&p, ep->peeks[i].result.fs_size);
+    scanCachePutBytes(&p, ep->peeks[i].result.uuid, sizeof(ep->peeks[i].result.uuid));
+    scanCachePutBytes(&p, ep->peeks[i].result.label, FS_SIG_LABEL_SIZE);
+
+    if (1 != fwrite(buffer, SCAN_CACHE_PEEK_SIZE, 1, f))
+      return false;
+  }
+
+  return true;
+}
+
+static bool scanCacheMerge(scan_cache_ptr sc, disk_ptr dp)
+{
+  scan_cache_entry_ptr  ep, prev = NULL, next;
+  bool                  changed = false;
+
+  if (!dp->scan_cache_invalid && NULL == dp->scan_record)
+    return false;
+
+  // drop the old entry of this device: it is either invalid or replaced by the new recording
+
+  for (ep = sc->head; NULL != ep; ep = next)
+  {
+    next = ep->next;
+
+    if (!strcmp(ep->device_file, dp->device_file))
+    {
+      if (NULL == prev)
+        sc->head = next;
+      else
+        prev->next = next;
+      scan_cache_free_entry(ep);
+      changed = true;
+    }
+    else
+      prev = ep;
+  }
+
+  if (NULL != dp->scan_record)
+  {
+    if (dp->scan_cache_invalid)
+      scan_cache_free_entry(dp->scan_record);
+    else
+    {
+      dp->scan_record->next = sc->head;
+      sc->head = dp->scan_record;
+      changed = true;
+    }
+    dp->scan_record = NULL;
+  }
+
+  dp->scan_recording = false;
+
+  return changed;
+}
+
+bool scan_cache_save(scan_cache_ptr sc, disk_ptr head, disk_ptr work_disk)
+{
+  scan_cache_entry_ptr  ep, prev = NULL, next;
+  disk_ptr              dp;
+  bool                  changed = sc->dropped, work_disk_in_list = false, ok;
+  uint64_t              now = (uint64_t)time(NULL);
+  uint32_t              num_entries = 0;
+  char                  tmp_file[sizeof(sc->cache_file) + 8];
+  uint8_t               header[sizeof(SCAN_CACHE_MAGIC) - 1 + 4];
+  uint8_t              *p = header;
+  FILE                 *f;
+
+  for (dp = head; NULL != dp; dp = dp->next)
+  {
+    if (dp == work_disk)
+      work_disk_in_list = true;
+    if (scanCacheMerge(sc, dp))
+      changed = true;
+  }
+
+  if (NULL != work_disk && !work_disk_in_list && scanCacheMerge(sc, work_disk))
+    changed = true;
+
+  // drop expired entries and limit the size of the cache (new entries are at the head)
+
+  for (ep = sc->head; NULL != ep; ep = next)
+  {
+    next = ep->next;
+
+    if (now < ep->timestamp || (now - ep->timestamp) >= SCAN_CACHE_MAX_AGE_SEC || num_entries >= SCAN_CACHE_MAX_ENTRIES)
+    {
+      if (NULL == prev)
+        sc->head = next;
+      else
+        prev->next = next;
+      scan_cache_free_entry(ep);
+      changed = true;
+    }
+    else
+    {
+      num_entries++;
+      prev = ep;
+    }
+  }
+
+  if (!changed)
+    return true;
+
+  // write a temporary file, which replaces the cache file (a concurrent reader never sees a partial file)
+
+  snprintf(tmp_file, sizeof(tmp_file), "%s.tmp", sc->cache_file);
+
+  f = fopen(tmp_file, "wb");
+  if (NULL == f)
+    return false;
+
+  scanCachePutBytes(&p, SCAN_CACHE_MAGIC, sizeof(SCAN_CACHE_MAGIC) - 1);
+  scanCachePut32(&p, num_entries);
+
+  ok = (1 == fwrite(header, sizeof(header), 1, f));
+
+  for (ep = sc->head; ok && NULL != ep; ep = ep->next)
+    ok = scanCacheWriteEntry(f, ep);
+
+  if (0 != fclose(f))
+    ok = false;
+
+#ifdef _WINDOWS
+  if (ok)
+    ok = MoveFileExA(tmp_file, sc->cache_file, MOVEFILE_REPLACE_EXISTING) ? true : false;
+#else
+  if (ok)
+    ok = (0 == rename(tmp_file, sc->cache_file));
+#endif
+
+  if (!ok)
+    (void)remove(tmp_file);
+
+  return ok;
+}
@@ -422,25 +422,40 @@ bool is_zero_guid(const uint8_t* guid)
   return (memcmp(guid, zero_guid, 16) ? false : true);
 }
 
-bool check_lba_range_is_free(disk_map_ptr dmp, uint64_t lba_start, uint64_t num_lbas)
+bool generate_guid(uint8_t* guid)
 {
-  while (NULL != dmp)
-  {
-    if (dmp->is_free)
-    {
-      if (lba_start >= dmp->start_lba && (lba_start + num_lbas - 1) <= dmp->end_lba)
-        return true;
-    }
+#ifdef _WINDOWS
+  if (S_OK != CoCreateGuid((GUID*)guid))
+    return false;
+#else
+  int                 fd = open("/dev/urandom", O_RDONLY);
+  bool                ok;
 
-    dmp = dmp->next;
-  }
+  if (-1 == fd)
+    return false;
+  ok = (16 == read(fd, guid, 16)) ? true : false;
+  close(fd);
+  if (!ok)
+    return false;
 
-  return false;
+  // random GUID (version 4, variant 1); the version is in the high nibble of Data3 (mixed endian)
+
+  guid[7] = (guid[7] & 0x0F) | 0x40;
+  guid[8] = (guid[8] & 0x3F) | 0x80;
+#endif
+
+  return true;
+}
+
+bool check_lba_range_is_free(disk_map_ptr dmp, uint64_t lba_start, uint64_t num_lbas)
+{
+  dmp = disk_map_find(dmp, lba_start);
+
+  return (NULL != dmp && dmp->is_free && (lba_start + num_lbas - 1) <= dmp->end_lba) ? true : false;
 }
 
 bool find_last_partition(disk_ptr dp, disk_map_ptr dmp, uint64_t* lba_start, uint64_t* num_lbas, bool *is_ntfs, uint64_t *lba_free_start, uint64_t *num_lba_free)
 {
-  uint64_t            max_lba_start = 0, max_lba_end = 0;
   mbr_part_sector_ptr mpsp = dp->mbr;
   uint32_t            i;
 
@@ -448,33 +463,33 @@ bool find_last_partition(disk_ptr dp, disk_map_ptr dmp, uint64_t* lba_start, uin
   *lba_free_start = (uint64_t)-1;
   *num_lba_free = (uint64_t)-1;
 
-  while (NULL != dmp)
+  if (NULL == dmp)
+    return false;
+
+  // the map is sorted: the last partition precedes the (optional) trailing free space
+
+  if (0 != dmp->num_items)
+    dmp = &dmp[dmp->num_items - 1];
+  else
   {
-    if (!dmp->is_free)
-    {
-      if (dmp->start_lba > max_lba_start)
-      {
-        max_lba_start = dmp->start_lba;
-        max_lba_end = dmp->end_lba;
-      }
-    }
-    else // free space
-    {
-      if (NULL == dmp->next) // check for trailing free space only
-      {
-        *lba_free_start = dmp->start_lba;
-        *num_lba_free = dmp->end_lba - dmp->start_lba + 1;
-      }
-    }
+    while (NULL != dmp->next)
+      dmp = dmp->next;
+  }
 
-    dmp = dmp->next;
+  if (dmp->is_free) // check for trailing free space only
+  {
+    *lba_free_start = dmp->start_lba;
+    *num_lba_free = dmp->end_lba - dmp->start_lba + 1;
   }
 
-  if (0 == max_lba_start)
+  while (NULL != dmp && dmp->is_free)
+    dmp = dmp->prev;
+
+  if (NULL == dmp || 0 == dmp->start_lba)
     return false;
 
-  *lba_start = max_lba_start;
-  *num_lbas = max_lba_end - max_lba_start + 1;
+  *lba_start = dmp->start_lba;
+  *num_lbas = dmp->end_lba - dmp->start_lba + 1;
   
   while (NULL != mpsp)
   {
@@ -529,6 +544,8 @@ int execute_external_program(uint8_t stdout_buffer[MAX_STDOUT_CAPTURE], bool wai
   int                       pipe_desc[2] = { -1, -1 };
   FILE                     *f;
 
+  disk_pool_release(NULL); // idle device handles must not block the external program
+
   if (NULL != stdout_buffer)
   {
     if (pipe(pipe_desc) < 0)
@@ -693,6 +710,8 @@ int execute_external_program(uint8_t stdout_buffer[MAX_STDOUT_CAPTURE], bool wai
   bool                      bProcessTerminated = false, bIoFailed = false;
   uint8_t                   read_buffer[512];
 
+  disk_pool_release(NULL); // idle device handles must not block the external program
+
   memset(&saAttr, 0, sizeof(saAttr));
   memset(&piProcInfo, 0, sizeof(piProcInfo));
   memset(&siStartInfo, 0, sizeof(siStartInfo));
@@ -933,6 +952,8 @@ int execute_external_program_with_input(const char *stdin_input, uint8_t stdout_
   bool                      bProcessTerminated = false, bIoFailed = false;
   uint8_t                   read_buffer[512];
 
+  disk_pool_release(NULL); // idle device handles must not block the external program
+
   memset(&saAttr, 0, sizeof(saAttr));
   memset(&piProcInfo, 0, sizeof(piProcInfo));
   memset(&siStartInfo, 0, sizeof(siStartInfo));
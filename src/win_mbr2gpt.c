@@ -594,6 +594,7 @@ int win_mbr2gpt(cmdline_args_ptr cap)
   uint64_t              device_size;
   uint32_t              i, logical_sector_size;
   DISK_HANDLE           d;
+  write_plan_ptr        wpp;
   char                  device_file[256], exec_cmd_line[256];
   FILE                 *fi;
   char                  buffer[256];
@@ -973,33 +974,39 @@ int win_mbr2gpt(cmdline_args_ptr cap)
 
     fprintf(stdout, CTRL_CYAN "WORKING " CTRL_RESET ": Write the (protective) MBR plus GPTs to the disk ........: ");
     fflush(stdout);
-    d = disk_open_device(cap->device_name, true/*read/write access*/);
-    if (INVALID_DISK_HANDLE == d)
+
+    // the backup GPT is durable before the (protective) MBR and the primary GPT are written
+
+    wpp = write_plan_create();
+    if (NULL == wpp ||
+        !write_plan_add(wpp, (device_size >> SECTOR_SHIFT) - 33, 33, &conversion_data[35 * SECTOR_SIZE], "backup GPT"))
     {
-      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET "\n          Unable to open the disk device %s for reading and writing.\n",cap->device_name);
+      write_plan_free(wpp);
+      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET "\n          Insufficient memory available.\n");
       free(conversion_memory_pool);
       return 1;
     }
-
-    if (!disk_write(dp, d, 0, &conversion_data[SECTOR_SIZE], 34 * SECTOR_SIZE))
+    write_plan_barrier(wpp);
+    if (!write_plan_add(wpp, 0, 34, &conversion_data[SECTOR_SIZE], "MBR and primary GPT"))
     {
-      disk_close_device(d);
-      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET "\n          Unable to write the MBR plus the primary GPT to the disk %s.\n",cap->device_name);
+      write_plan_free(wpp);
+      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET "\n          Insufficient memory available.\n");
       free(conversion_memory_pool);
       return 1;
     }
 
-    if (!disk_write(dp, d, device_size - 33 * SECTOR_SIZE, &conversion_data[35 * SECTOR_SIZE], 33 * SECTOR_SIZE))
+    if (!write_plan_execute(wpp, cap->device_name, buffer, sizeof(buffer)))
     {
-      disk_close_device(d);
-      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET "\n          Unable to write the backup GPT to the disk %s.\n",cap->device_name);
+      write_plan_free(wpp);
+      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET "\n          Unable to write the partition tables to the disk %s: %s.\n",cap->device_name, buffer);
       free(conversion_memory_pool);
       return 1;
     }
 
+    write_plan_free(wpp);
+
     fprintf(stdout, CTRL_GREEN "OK" CTRL_RESET "\n");
 
-    disk_close_device(d);
     dp = NULL;
 
     // run partx to re-scan the modified partition table(s)
@@ -1408,11 +1415,12 @@ int onPrepareWindows10(cmdline_args_ptr cap)
 #else
   char                  buffer[256], buffer2[256], str1[64], str2[64], convert_file[256], bcd_file[256], message[128], linux_stick[256], szPartYFilePath[256];
   dir_entry_ptr         dep = NULL;
-  uint64_t              bootEfiSize, efi_partition_lba = 0, msr_partition_lba = 0;
+  uint64_t              bootEfiSize, efi_partition_lba = 0, msr_partition_lba = 0, msr_max_lba, align_lbas, align_offset;
   uint32_t              i, j, shrink_vol_no = 1 << 30, idx = 0;
   bool                  need_diskpart_run = false, last_part_is_ntfs = false;
   win_volume_ptr        wvp = NULL, shrink_volume = NULL;
   gpt_ptr               new_g = NULL, new_g2 = NULL;
+  gpt_entry_ptr         gep;
   uint32_t              winboot_part_idx, winboot_numlbas, winre_numlbas;
   uint64_t              winboot_startlba, free_lba_start = (uint64_t)-1, free_lba_num = (uint64_t)-1, winre_startlba = 0, winboot_size = 0;
   GUID                  guid_current, guid_disk, guid_efi_partition, guid_winsys_partition, guid_winre_partition, guid_msr_partition;
@@ -1445,9 +1453,9 @@ int onPrepareWindows10(cmdline_args_ptr cap)
     fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": no working drive available. STOP.\n");
 ErrorExit:
     if (NULL != new_g)
-      free(new_g);
+      partition_free_gpt(new_g);
     if (NULL != new_g2)
-      free(new_g2);
+      partition_free_gpt(new_g2);
     if (NULL != dmp)
       free_disk_map(dmp);
     if (NULL != bhp)
@@ -1678,16 +1686,13 @@ ErrorExit:
 
   // 13.) Create new GUID Partition Table in memory
 
-  new_g = (gpt_ptr)malloc(sizeof(gpt));
-  new_g2 = (gpt_ptr)malloc(sizeof(gpt));
-  if (NULL == new_g || NULL == new_g2)
+  new_g = partition_new_gpt(GPT_DEFAULT_ENTRIES);
+  if (NULL == new_g)
   {
     fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET "\n          Insufficient memory available (internal error).\n");
     goto ErrorExit;
   }
 
-  memset(new_g, 0, sizeof(gpt));
-
   new_g->header.revision = 0x00010000;
   new_g->header.header_size = 0x5C;
   new_g->header.current_lba = 1;
@@ -1713,10 +1718,29 @@ ErrorExit:
   // first partition on disk is EFI System Partition (ESP)
   
   efi_partition_lba = winboot_startlba;
-  msr_partition_lba = winboot_startlba + winboot_numlbas - (MS_RESERVED_PART_SIZE >> SECTOR_SHIFT);
-  msr_partition_lba &= ~2047; // align to 1MB boundary
+  msr_max_lba = winboot_startlba + winboot_numlbas - (MS_RESERVED_PART_SIZE >> SECTOR_SHIFT);
+  disk_partition_alignment(cap->work_disk, &align_lbas, &align_offset);
+  msr_partition_lba = disk_align_lba(msr_max_lba, align_lbas, align_offset, false); // align to 1MB (or optimal I/O size) boundary
 
-  memcpy(new_g->entries[new_g->header.number_of_part_entries].type_guid, guid_efi_system_partition, 16);
+  // rounding down to a large optimal I/O size (up to 16MB) shrinks the ESP: fall back to 1MB if it becomes too small
+
+  if ((msr_partition_lba << SECTOR_SHIFT) < (efi_partition_lba << SECTOR_SHIFT) + bootEfiSize)
+    msr_partition_lba = disk_align_lba(msr_max_lba, DISK_PARTITION_ALIGNMENT >> SECTOR_SHIFT, 0, false);
+
+  if ((msr_partition_lba << SECTOR_SHIFT) < (efi_partition_lba << SECTOR_SHIFT) + bootEfiSize)
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET "\n          The aligned EFI partition is smaller than its estimated content.\n");
+    goto ErrorExit;
+  }
+
+  gep = gpt_add_entry(new_g, new_g->num_entries); // entries are appended slot by slot
+  if (NULL == gep)
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET "\n          Insufficient memory available (internal error).\n");
+    goto ErrorExit;
+  }
+
+  memcpy(gep->type_guid, guid_efi_system_partition, 16);
 
   this_volume = findWindowsVolumeByPartitionStartLBA(cap->wvp, cap->win_device_no, winboot_startlba);
   if (NULL == this_volume)
@@ -1739,23 +1763,28 @@ ErrorExit:
 
   memcpy(&guid_efi_partition, &guid_current, sizeof(GUID));
   guid_current.Data1++;
-  memcpy(new_g->entries[new_g->header.number_of_part_entries].partition_guid, &guid_efi_partition, 16);
-
-  new_g->entries[new_g->header.number_of_part_entries].part_start_lba = efi_partition_lba;
-  new_g->entries[new_g->header.number_of_part_entries].part_end_lba = msr_partition_lba - 1;
-  new_g->entries[new_g->header.number_of_part_entries].attributes = GPT_ATTR_DO_NOT_MOUNT | GPT_ATTR_LEGACY_BIOS_BOOT;
-  new_g->entries[new_g->header.number_of_part_entries].fs_type = FSYS_WIN_FAT32;
-  setGPTPartitionName(new_g->entries[new_g->header.number_of_part_entries].part_name, new_g->entries[new_g->header.number_of_part_entries].part_name_utf8_oem, "EFI System Partition (ESP)");
+  memcpy(gep->partition_guid, &guid_efi_partition, 16);
 
-  new_g->header.number_of_part_entries++;
+  gep->part_start_lba = efi_partition_lba;
+  gep->part_end_lba = msr_partition_lba - 1;
+  gep->attributes = GPT_ATTR_DO_NOT_MOUNT | GPT_ATTR_LEGACY_BIOS_BOOT;
+  gep->fs_type = FSYS_WIN_FAT32;
+  setGPTPartitionName(gep->part_name, "EFI System Partition (ESP)");
 
   // second partition on disk is Microsoft Reserved Partition (16 MB)
   
-  memcpy(new_g->entries[new_g->header.number_of_part_entries].type_guid, guid_microsoft_reserved, 16);
+  gep = gpt_add_entry(new_g, new_g->num_entries); // entries are appended slot by slot
+  if (NULL == gep)
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET "\n          Insufficient memory available (internal error).\n");
+    goto ErrorExit;
+  }
+
+  memcpy(gep->type_guid, guid_microsoft_reserved, 16);
 
   memcpy(&guid_msr_partition, &guid_current, sizeof(GUID));
   guid_current.Data1++;
-  memcpy(new_g->entries[new_g->header.number_of_part_entries].partition_guid, &guid_msr_partition, 16); // always new GUID for Microsoft Reserved
+  memcpy(gep->partition_guid, &guid_msr_partition, 16); // always new GUID for Microsoft Reserved
 
 #if 0
   if (S_OK != CoCreateGuid(&winguid))
@@ -1763,15 +1792,13 @@ ErrorExit:
     fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET "\n          Unable to generate new GUID (using COM-API).\n");
     goto ErrorExit;
   }
-  memcpy(new_g->entries[new_g->header.number_of_part_entries].partition_guid, &winguid, 16); // always new GUID for Microsoft Reserved
+  memcpy(gep->partition_guid, &winguid, 16); // always new GUID for Microsoft Reserved
 #endif
-  new_g->entries[new_g->header.number_of_part_entries].part_start_lba = msr_partition_lba;
-  new_g->entries[new_g->header.number_of_part_entries].part_end_lba = msr_partition_lba + (MS_RESERVED_PART_SIZE >> SECTOR_SHIFT) - 1;
-  new_g->entries[new_g->header.number_of_part_entries].attributes = 0; // GPT_ATTR_DO_NOT_MOUNT;
-  new_g->entries[new_g->header.number_of_part_entries].fs_type = FSYS_UNKNOWN;
-  setGPTPartitionName(new_g->entries[new_g->header.number_of_part_entries].part_name, new_g->entries[new_g->header.number_of_part_entries].part_name_utf8_oem, "Microsoft Reserved Partition (MSR)");
-
-  new_g->header.number_of_part_entries++;
+  gep->part_start_lba = msr_partition_lba;
+  gep->part_end_lba = msr_partition_lba + (MS_RESERVED_PART_SIZE >> SECTOR_SHIFT) - 1;
+  gep->attributes = 0; // GPT_ATTR_DO_NOT_MOUNT;
+  gep->fs_type = FSYS_UNKNOWN;
+  setGPTPartitionName(gep->part_name, "Microsoft Reserved Partition (MSR)");
 
 #if 0
   // very important: During the testing, it turned out that MS Windows also counts the previously added Microsoft Reserved Partition
@@ -1787,12 +1814,12 @@ ErrorExit:
 
   memset(new_volume_msr, 0, sizeof(win_volume));
 
-  format_guid(msr_guid, new_g->entries[new_g->header.number_of_part_entries - 1].partition_guid, false/*mixed endianess*/);
+  format_guid(msr_guid, gep->partition_guid, false/*mixed endianess*/);
   snprintf(new_volume_msr->volume_name, sizeof(new_volume_msr->volume_name), "\\\\?\\Volume{%s}\\", msr_guid);
   // device_name "\Device\HarddiskVolumeX" -> see below
   snprintf(new_volume_msr->volume_guid, sizeof(new_volume_msr->volume_guid), "{%s}", msr_guid);
-  new_volume_msr->start_lba = new_g->entries[new_g->header.number_of_part_entries - 1].part_start_lba;
-  new_volume_msr->num_lbas = new_g->entries[new_g->header.number_of_part_entries - 1].part_end_lba - new_g->entries[new_g->header.number_of_part_entries - 1].part_start_lba + 1;
+  new_volume_msr->start_lba = gep->part_start_lba;
+  new_volume_msr->num_lbas = gep->part_end_lba - gep->part_start_lba + 1;
   new_volume_msr->disk_number = cap->win_device_no;
   // volume_no -> see below
   new_volume_msr->num_extents = 1;
@@ -1877,49 +1904,61 @@ ErrorExit:
 
         if (NULL == this_volume) // any other partition (e.g. Linux)
         {
-          memcpy(new_g->entries[new_g->header.number_of_part_entries].type_guid, part_guid, 16);
+          gep = gpt_add_entry(new_g, new_g->num_entries); // entries are appended slot by slot
+          if (NULL == gep)
+          {
+            fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET "\n          Insufficient memory available (internal error).\n");
+            goto ErrorExit;
+          }
+
+          memcpy(gep->type_guid, part_guid, 16);
 
           if (mpsp->part_table[i].fs_type >= FSYS_LINUX_EXT2 && mpsp->part_table[i].fs_type <= FSYS_LINUX_EXT4) // re-use the EXT2, 3, 4 partition UUID as the GPT partition GUID
           {
-            new_g->entries[new_g->header.number_of_part_entries].partition_guid[0] = mpsp->part_table[i].uuid[3];
-            new_g->entries[new_g->header.number_of_part_entries].partition_guid[1] = mpsp->part_table[i].uuid[2];
-            new_g->entries[new_g->header.number_of_part_entries].partition_guid[2] = mpsp->part_table[i].uuid[1];
-            new_g->entries[new_g->header.number_of_part_entries].partition_guid[3] = mpsp->part_table[i].uuid[0];
+            gep->partition_guid[0] = mpsp->part_table[i].uuid[3];
+            gep->partition_guid[1] = mpsp->part_table[i].uuid[2];
+            gep->partition_guid[2] = mpsp->part_table[i].uuid[1];
+            gep->partition_guid[3] = mpsp->part_table[i].uuid[0];
 
-            new_g->entries[new_g->header.number_of_part_entries].partition_guid[4] = mpsp->part_table[i].uuid[5];
-            new_g->entries[new_g->header.number_of_part_entries].partition_guid[5] = mpsp->part_table[i].uuid[4];
+            gep->partition_guid[4] = mpsp->part_table[i].uuid[5];
+            gep->partition_guid[5] = mpsp->part_table[i].uuid[4];
 
-            new_g->entries[new_g->header.number_of_part_entries].partition_guid[6] = mpsp->part_table[i].uuid[7];
-            new_g->entries[new_g->header.number_of_part_entries].partition_guid[7] = mpsp->part_table[i].uuid[6];
+            gep->partition_guid[6] = mpsp->part_table[i].uuid[7];
+            gep->partition_guid[7] = mpsp->part_table[i].uuid[6];
 
-            memcpy(&new_g->entries[new_g->header.number_of_part_entries].partition_guid[8], &mpsp->part_table[i].uuid[8], 8);
+            memcpy(&gep->partition_guid[8], &mpsp->part_table[i].uuid[8], 8);
           }
           else
           {
-            memcpy(new_g->entries[new_g->header.number_of_part_entries].partition_guid, &guid_current, 16);
+            memcpy(gep->partition_guid, &guid_current, 16);
             guid_current.Data1++;
           }
 
-          new_g->entries[new_g->header.number_of_part_entries].part_start_lba = mpsp->part_table[i].start_sector;
-          new_g->entries[new_g->header.number_of_part_entries].part_end_lba = new_g->entries[new_g->header.number_of_part_entries].part_start_lba + ((uint64_t)mpsp->part_table[i].num_sectors) - 1;
-          new_g->entries[new_g->header.number_of_part_entries].attributes = part_attributes;
-          new_g->entries[new_g->header.number_of_part_entries].fs_type = mpsp->part_table[i].fs_type;
-
-          new_g->header.number_of_part_entries++;
+          gep->part_start_lba = mpsp->part_table[i].start_sector;
+          gep->part_end_lba = gep->part_start_lba + ((uint64_t)mpsp->part_table[i].num_sectors) - 1;
+          gep->attributes = part_attributes;
+          gep->fs_type = mpsp->part_table[i].fs_type;
         }
         else // this is a Windows volume on the MBR-disk -> convert it
         {
-          memcpy(new_g->entries[new_g->header.number_of_part_entries].type_guid, part_guid, 16);
+          gep = gpt_add_entry(new_g, new_g->num_entries); // entries are appended slot by slot
+          if (NULL == gep)
+          {
+            fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET "\n          Insufficient memory available (internal error).\n");
+            goto ErrorExit;
+          }
+
+          memcpy(gep->type_guid, part_guid, 16);
 
-          memcpy(new_g->entries[new_g->header.number_of_part_entries].partition_guid, &guid_current, 16);
+          memcpy(gep->partition_guid, &guid_current, 16);
           guid_current.Data1++;
 
           //parse_guid(part_guid, &this_volume->volume_guid[1], false/*mixed endian*/);
-          //memcpy(new_g->entries[new_g->header.number_of_part_entries].partition_guid, part_guid, 16); // re-use Windows volume partition GUID
+          //memcpy(gep->partition_guid, part_guid, 16); // re-use Windows volume partition GUID
 
           if (cap->win_sys_drive == this_volume->drive_letter)
           {
-            memcpy(&guid_winsys_partition, new_g->entries[new_g->header.number_of_part_entries].partition_guid, 16);
+            memcpy(&guid_winsys_partition, gep->partition_guid, 16);
             have_winsys_guid = true;
             //parse_guid((uint8_t*)&guid_mbr_winsys, &this_volume->volume_guid[1], false/*mixed endian*/);
             if (!disk_mbr_get_partition_guid(cap->work_disk, this_volume->start_lba, this_volume->num_lbas, &guid_mbr_winsys))
@@ -1932,7 +1971,7 @@ ErrorExit:
 
           if (mpsp->part_table[i].start_sector == winre_startlba)
           {
-            memcpy(&guid_winre_partition, new_g->entries[new_g->header.number_of_part_entries].partition_guid, 16);
+            memcpy(&guid_winre_partition, gep->partition_guid, 16);
             have_winre_guid = true;
             //parse_guid((uint8_t*)&guid_mbr_winre, &this_volume->volume_guid[1], false/*mixed endian*/);
             if (!disk_mbr_get_partition_guid(cap->work_disk, winre_startlba, winre_numlbas, &guid_mbr_winre))
@@ -1943,18 +1982,16 @@ ErrorExit:
             vol_winre_index = this_volume->volume_no;
           }
 
-          new_g->entries[new_g->header.number_of_part_entries].part_start_lba = mpsp->part_table[i].start_sector;
-          new_g->entries[new_g->header.number_of_part_entries].part_end_lba = new_g->entries[new_g->header.number_of_part_entries].part_start_lba + ((uint64_t)mpsp->part_table[i].num_sectors) - 1;
-          new_g->entries[new_g->header.number_of_part_entries].attributes = ((0x00==this_volume->drive_letter) ? GPT_ATTR_DO_NOT_MOUNT : 0) | part_attributes;
-          new_g->entries[new_g->header.number_of_part_entries].fs_type = mpsp->part_table[i].fs_type;
+          gep->part_start_lba = mpsp->part_table[i].start_sector;
+          gep->part_end_lba = gep->part_start_lba + ((uint64_t)mpsp->part_table[i].num_sectors) - 1;
+          gep->attributes = ((0x00==this_volume->drive_letter) ? GPT_ATTR_DO_NOT_MOUNT : 0) | part_attributes;
+          gep->fs_type = mpsp->part_table[i].fs_type;
           if (0x00 == this_volume->drive_letter)
             snprintf(this_part_name, sizeof(this_part_name), "Windows partition");
           else
             snprintf(this_part_name, sizeof(this_part_name), "Windows drive %c:", this_volume->drive_letter);
 
-          setGPTPartitionName(new_g->entries[new_g->header.number_of_part_entries].part_name, new_g->entries[new_g->header.number_of_part_entries].part_name_utf8_oem, this_part_name);
-
-          new_g->header.number_of_part_entries++;
+          setGPTPartitionName(gep->part_name, this_part_name);
         }
       }
 
@@ -1966,7 +2003,7 @@ ErrorExit:
 
   // 14.) perform sanity checks regarding partition GUIDs
   
-  for (i = 0; i < new_g->header.number_of_part_entries; i++)
+  for (i = 0; i < new_g->num_entries; i++)
   {
     // partition GUID MUST NOT match disk GUID
     
@@ -1978,7 +2015,7 @@ ErrorExit:
 
     // the partition GUIDs must be unique among each other
     
-    for (j = 0; j < new_g->header.number_of_part_entries; j++)
+    for (j = 0; j < new_g->num_entries; j++)
     {
       if (i != j)
       {
@@ -1993,12 +2030,17 @@ ErrorExit:
 
   // 15.) create a disk map and ensure that all areas fit in the disk...
   
-  memcpy(new_g2, new_g, sizeof(gpt));
+  new_g2 = partition_clone_gpt(new_g);
+  if (NULL == new_g2)
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET "\n          Insufficient memory available (internal error).\n");
+    goto ErrorExit;
+  }
   new_g2->header.current_lba = new_g->header.backup_lba;
   new_g2->header.backup_lba = new_g->header.current_lba;
 
-  new_g->header.number_of_part_entries = 128;
-  new_g2->header.number_of_part_entries = 128;
+  new_g->header.number_of_part_entries = GPT_DEFAULT_ENTRIES;
+  new_g2->header.number_of_part_entries = GPT_DEFAULT_ENTRIES;
 
   new_g2->header.starting_lba_part_entries = cap->work_disk->device_sectors - 33;
 
@@ -0,0 +1,596 @@
+/**
+ * @file   wipe.c
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @brief  implementation of the wipe engine (pattern and pseudo random passes,
+ *         pipelined verification, checkpoints).
+ *
+ * [MIT license]
+ *
+ * Copyright (c) 2021 Ingo A. Kubbilun
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <part-y.h>
+
+#define WIPE_TITLE_WIDTH          56          ///< width of the progress title (padded with dots)
+
+typedef struct _wipe_run                wipe_run, * wipe_run_ptr;
+typedef struct _wipe_stream             wipe_stream, * wipe_stream_ptr;
+typedef struct _wipe_worker             wipe_worker, * wipe_worker_ptr;
+
+struct _wipe_run
+{
+  DISK_HANDLE                           h;                          ///< shared handle (positional I/O only)
+  const wipe_pass                      *pass;                       ///< the current pass
+  uint64_t                              seed;                       ///< seed of the random passes (stored in the checkpoint)
+  uint32_t                              chunk_size;                 ///< transfer size of one operation
+  const uint8_t                        *pattern;                    ///< chunk_size bytes of the byte pattern (pattern passes)
+  volatile uint64_t                     errors;                     ///< number of failed operations (I/O errors or mismatches)
+};
+
+struct _wipe_stream
+{
+  wipe_run_ptr                          run;                        ///< back pointer to the run
+  bool                                  verify;                     ///< true: read back and compare, false: write
+  uint64_t                              start;                      ///< first byte of the segment
+  uint64_t                              end;                        ///< first byte after the segment
+  volatile uint64_t                     next_chunk;                 ///< next chunk of the segment to be processed
+  volatile uint64_t                     bytes;                      ///< number of bytes written (verified) so far
+};
+
+struct _wipe_worker
+{
+  wipe_stream_ptr                       stream;                     ///< segment the worker currently processes
+  void                                 *mem;                        ///< allocated memory of buffer
+  void                                 *mem2;                       ///< allocated memory of expected
+  uint8_t                              *buffer;                     ///< write data (random passes) or read buffer (verification)
+  uint8_t                              *expected;                   ///< expected data of random passes (verification only)
+  uint64_t                              mismatch_fp;                ///< first mismatching byte position ((uint64_t)-1 if none)
+  bool                                  io_error;                   ///< true if a read or write failed
+};
+
+bool wipe_parse_passes(const char* spec, wipe_pass_ptr passes, uint32_t* num_passes)
+{
+  wipe_pass           wp;
+  const char         *p = spec, *q;
+  char               *endp;
+  size_t              l;
+  unsigned long       value;
+
+  *num_passes = 0;
+
+  while (0 != *p)
+  {
+    q = strchr(p, ',');
+    l = NULL == q ? strlen(p) : (size_t)(q - p);
+
+    if ((0 == l) || (l >= sizeof(wp.name)) || (WIPE_MAX_PASSES == *num_passes))
+      return false;
+
+    memset(&wp, 0, sizeof(wp));
+    memcpy(wp.name, p, l);
+
+    if (!stricmp(wp.name, "random"))
+      wp.type = WIPE_PASS_RANDOM;
+    else
+    if (!stricmp(wp.name, "zero"))
+      wp.pattern = 0x00;
+    else
+    if (!stricmp(wp.name, "one"))
+      wp.pattern = 0xFF;
+    else
+    if ((l > 2) && ('0' == wp.name[0]) && ('x' == wp.name[1] || 'X' == wp.name[1]))
+    {
+      value = strtoul(wp.name + 2, &endp, 16);
+      if ((0 != *endp) || (value > 0xFF))
+        return false;
+      wp.pattern = (uint8_t)value;
+    }
+    else
+      return false;
+
+    if (NULL != passes)
+      memcpy(&passes[*num_passes], &wp, sizeof(wp));
+    (*num_passes)++;
+
+    p += l;
+    if (',' == *p)
+    {
+      p++;
+      if (0 == *p)
+        return false;
+    }
+  }
+
+  return 0 != *num_passes;
+}
+
+static uint64_t wipe_splitmix64(uint64_t* x)
+{
+  uint64_t            z = (*x += 0x9E3779B97F4A7C15);
+
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+
+  return z ^ (z >> 31);
+}
+
+static void wipe_random_fill(uint64_t seed, uint64_t fp, uint8_t* buffer, uint32_t size)
+{
+  uint64_t            s0[WIPE_PRNG_LANES], s1[WIPE_PRNG_LANES], x, y, sm = seed ^ fp;
+  uint64_t           *out = (uint64_t*)buffer;
+  uint32_t            i, l, n = size >> 3;
+
+  // the data only depends on the seed and the position, so the verification can regenerate it
+
+  for (l = 0; l < WIPE_PRNG_LANES; l++)
+  {
+    s0[l] = wipe_splitmix64(&sm);
+    s1[l] = wipe_splitmix64(&sm);
+  }
+
+  // xorshift128+ running in independent lanes; the compiler vectorizes the inner loop (SSE2, AVX2, NEON)
+
+  for (i = 0; i < n; i += WIPE_PRNG_LANES)
+  {
+    for (l = 0; l < WIPE_PRNG_LANES; l++)
+    {
+      x = s0[l];
+      y = s1[l];
+      s0[l] = y;
+      x ^= x << 23;
+      s1[l] = x ^ y ^ (x >> 17) ^ (y >> 26);
+      out[i + l] = s1[l] + y;
+    }
+  }
+}
+
+static void wipe_task(void* arg)
+{
+  wipe_worker_ptr     wwp = (wipe_worker_ptr)arg;
+  wipe_stream_ptr     ws = wwp->stream;
+  wipe_run_ptr        run = ws->run;
+  uint64_t            fp;
+  uint32_t            this_size, i;
+  const uint8_t      *data;
+
+  while (0 == atomic_load64(&run->errors))
+  {
+    fp = ws->start + (atomic_add64(&ws->next_chunk, 1) - 1) * run->chunk_size;
+    if (fp >= ws->end)
+      break;
+
+    this_size = (ws->end - fp) > run->chunk_size ? run->chunk_size : (uint32_t)(ws->end - fp);
+
+    if (WIPE_PASS_RANDOM == run->pass->type)
+    {
+      data = ws->verify ? wwp->expected : wwp->buffer;
+      wipe_random_fill(run->seed, fp, (uint8_t*)data, this_size);
+    }
+    else
+      data = run->pattern;
+
+    if (!ws->verify)
+    {
+      if (!disk_write_at(run->h, fp, data, this_size))
+      {
+        wwp->io_error = true;
+        atomic_add64(&run->errors, 1);
+        break;
+      }
+    }
+    else
+    {
+      if (!disk_read_at(run->h, fp, wwp->buffer, this_size))
+      {
+        wwp->io_error = true;
+        atomic_add64(&run->errors, 1);
+        break;
+      }
+
+      if (memcmp(wwp->buffer, data, this_size))
+      {
+        for (i = 0; i < this_size; i++)
+        {
+          if (wwp->buffer[i] != data[i])
+            break;
+        }
+        if ((fp + i) < wwp->mismatch_fp)
+          wwp->mismatch_fp = fp + i;
+        atomic_add64(&run->errors, 1);
+        break;
+      }
+    }
+
+    atomic_add64(&ws->bytes, this_size);
+  }
+}
+
+static uint8_t* wipe_alloc(uint32_t size, void** mem)
+{
+  *mem = malloc(size + SECTOR_MEM_ALIGN);
+  if (unlikely(NULL == *mem))
+    return NULL;
+
+  return (uint8_t*)((((uint64_t)*mem) + (SECTOR_MEM_ALIGN - 1)) & (~((uint64_t)(SECTOR_MEM_ALIGN - 1))));
+}
+
+static bool wipe_load_checkpoint(const char* checkpoint_file, disk_ptr dp, uint64_t range_start, uint64_t range_end, const char* spec,
+                                 uint32_t num_passes, uint32_t* pass_idx, uint64_t* offset, uint64_t* seed)
+{
+  FILE               *f = fopen(checkpoint_file, "rt");
+  char                line[1024], passes[128];
+  uint64_t            device_size, start, end, ofs, sd;
+  uint32_t            idx;
+  int                 n = 0;
+  size_t              l;
+  bool                found = false;
+
+  if (NULL == f)
+    return false;
+
+  while (NULL != fgets(line, sizeof(line), f))
+  {
+    if ('#' == line[0])
+      continue;
+
+    if (7 != sscanf(line, "%" FMT64 "u %" FMT64 "u %" FMT64 "u %u %" FMT64 "u %" FMT64 "u %127s %n",
+                    &device_size, &start, &end, &idx, &ofs, &sd, passes, &n) || 0 == n)
+      continue;
+
+    l = strlen(line + n);
+    while ((0 != l) && ('\r' == line[n + l - 1] || '\n' == line[n + l - 1]))
+      line[n + --l] = 0;
+
+    if (strcmp(line + n, dp->device_file) || (device_size != dp->device_size) || (start != range_start) || (end != range_end) || strcmp(passes, spec))
+      continue;
+
+    // the values are only taken over if the line matches completely
+
+    if (idx < num_passes && ofs < (range_end - range_start))
+    {
+      *pass_idx = idx;
+      *offset = ofs;
+      *seed = sd;
+      found = true;
+    }
+    break;
+  }
+
+  fclose(f);
+
+  return found;
+}
+
+static bool wipe_save_checkpoint(const char* checkpoint_file, disk_ptr dp, uint64_t range_start, uint64_t range_end, const char* spec,
+                                 uint32_t pass_idx, uint64_t offset, uint64_t seed)
+{
+  char                text[1024];
+  int                 n;
+
+  n = snprintf(text, sizeof(text),
+               "# part-y wipe checkpoint (written by the wipe command, do not edit)\n"
+               "# size range_start range_end pass offset seed passes device\n"
+               "%" FMT64 "u %" FMT64 "u %" FMT64 "u %u %" FMT64 "u %" FMT64 "u %s %s\n",
+               dp->device_size, range_start, range_end, pass_idx, offset, seed, spec, dp->device_file);
+  if (n < 0 || n >= (int)sizeof(text))
+    return false;
+
+  return file_replace(checkpoint_file, text, (uint32_t)n); // a crash never loses or truncates the resume point
+}
+
+static void wipe_make_message(char* message, size_t message_size, uint32_t pass_idx, uint32_t num_passes, const wipe_pass* pass)
+{
+  char                title[WIPE_TITLE_WIDTH + 1];
+  int                 n;
+
+  n = snprintf(title, sizeof(title), "Wipe pass %u/%u (%s) ", pass_idx + 1, num_passes, pass->name);
+  if (n < 0)
+    n = 0;
+  while (n < WIPE_TITLE_WIDTH)
+    title[n++] = '.';
+  title[WIPE_TITLE_WIDTH] = 0;
+
+  snprintf(message, message_size, CTRL_CYAN "WORKING" CTRL_RESET " : %s: ", title);
+}
+
+int wipe_device(cmdline_args_ptr cap)
+{
+  disk_ptr            dp = cap->work_disk;
+  wipe_pass           passes[WIPE_MAX_PASSES];
+  const char         *spec = 0 != cap->wipe_passes[0] ? cap->wipe_passes : WIPE_DEFAULT_PASSES;
+  wipe_worker         writers[WORKPOOL_MAX_THREADS / 2], verifiers[WORKPOOL_MAX_THREADS / 2];
+  wipe_stream         streams[2];
+  wipe_run            run;
+  workpool_ptr        wp = NULL;
+  DISK_HANDLE         h = INVALID_DISK_HANDLE;
+  uint32_t            num_passes, num_workers, chunk_size, first_pass = 0, p, i, cur;
+  uint64_t            range_start, range_end, range_size, offset = 0, seed, segment_size, pos, pass_start, t0, elapsed, checkpoint;
+  uint64_t            done, total, mismatch_fp;
+  bool                verify = !cap->no_verify, prev_valid, wrote, io_error, ok = false;
+  char                message[256], size_str[32], rate_str[32];
+  void               *pattern_mem = NULL;
+  uint8_t            *pattern = NULL;
+
+  memset(writers, 0, sizeof(writers));
+  memset(verifiers, 0, sizeof(verifiers));
+
+  if (NULL == dp)
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": No working disk available.\n");
+    return 1;
+  }
+
+  if (SECTOR_SIZE != dp->logical_sector_size)
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": logical sector size %u is not supported.\n", dp->logical_sector_size);
+    return 1;
+  }
+
+  if (!wipe_parse_passes(spec, passes, &num_passes))
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": unable to parse the list of passes: %s\n", spec);
+    return 1;
+  }
+
+  // the range to be wiped
+
+  if (0 != cap->lba_range_end)
+  {
+    if (cap->lba_range_end >= dp->device_sectors)
+    {
+      fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": LBA range %" FMT64 "u..%" FMT64 "u exceeds the device.\n", cap->lba_range_start, cap->lba_range_end);
+      return 1;
+    }
+    range_start = cap->lba_range_start << SECTOR_SHIFT;
+    range_end = (cap->lba_range_end + 1) << SECTOR_SHIFT;
+  }
+  else
+  {
+    range_start = 0;
+    range_end = dp->device_sectors << SECTOR_SHIFT;
+  }
+
+  range_size = range_end - range_start;
+  if (0 == range_size)
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": nothing to be wiped (size is zero).\n");
+    return 1;
+  }
+
+  // transfer size and concurrency: command line, device profile, built-in defaults
+
+  chunk_size = disk_io_size(dp, dp->io_write_size, WIPE_DEFAULT_CHUNK_SIZE);
+  num_workers = 0 != cap->num_threads ? cap->num_threads : (0 != dp->io_write_depth ? dp->io_write_depth : WIPE_DEFAULT_WORKERS);
+  if (num_workers > (WORKPOOL_MAX_THREADS / 2))
+    num_workers = WORKPOOL_MAX_THREADS / 2;
+  segment_size = ((uint64_t)chunk_size) * WIPE_SEGMENT_CHUNKS;
+
+  seed = get_time_usec() ^ (((uint64_t)(size_t)&seed) << 16);
+
+  if (0 != cap->checkpoint_file[0] && wipe_load_checkpoint(cap->checkpoint_file, dp, range_start, range_end, spec, num_passes, &first_pass, &offset, &seed))
+  {
+    format_64bit(offset, size_str, sizeof(size_str));
+    fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": resuming from checkpoint: pass %u/%u at byte offset %s.\n", first_pass + 1, num_passes, size_str);
+  }
+
+  format_disk_size(range_size, size_str, sizeof(size_str));
+  fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": wiping LBAs %" FMT64 "u..%" FMT64 "u (%s) with %u pass(es): %s\n",
+    range_start >> SECTOR_SHIFT, (range_end >> SECTOR_SHIFT) - 1, size_str, num_passes, spec);
+  format_disk_size(chunk_size, size_str, sizeof(size_str));
+  fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": %u worker(s), transfer size %s, verification %s.\n", num_workers, size_str, verify ? "enabled" : "disabled");
+
+  if (cap->dryrun)
+  {
+    fprintf(stdout, CTRL_MAGENTA "DRYRUN" CTRL_RESET ": Explaining what would be done.\n");
+    if (cap->device_is_real_device)
+      fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": Overwriting drive (" CTRL_RED "DANGEROUS" CTRL_RESET ") with the passes listed above.\n");
+    else
+      fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": Overwriting image file with the passes listed above.\n");
+    if (0 != cap->checkpoint_file[0])
+      fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": Progress would be stored in the checkpoint file %s.\n", cap->checkpoint_file);
+    return 0;
+  }
+
+  h = disk_open_device(dp->device_file, true/*write access*/);
+  if (INVALID_DISK_HANDLE == h)
+  {
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": Unable to access the device/image file for writing.\n");
+    return 1;
+  }
+
+  // one buffer per writer, two per verifier (read data and expected data); pattern passes share one buffer
+
+  pattern = wipe_alloc(chunk_size, &pattern_mem);
+  if (NULL == pattern)
+    goto NoMemory;
+
+  for (i = 0; i < num_workers; i++)
+  {
+    writers[i].buffer = wipe_alloc(chunk_size, &writers[i].mem);
+    if (NULL == writers[i].buffer)
+      goto NoMemory;
+
+    verifiers[i].mismatch_fp = (uint64_t)-1; // no mismatch unless a verifier finds one (write errors, --no-verify)
+
+    if (verify)
+    {
+      verifiers[i].buffer = wipe_alloc(chunk_size, &verifiers[i].mem);
+      verifiers[i].expected = wipe_alloc(chunk_size, &verifiers[i].mem2);
+      if (NULL == verifiers[i].buffer || NULL == verifiers[i].expected)
+        goto NoMemory;
+    }
+  }
+
+  wp = workpool_create(verify ? (num_workers << 1) : num_workers, 0);
+  if (NULL == wp)
+  {
+NoMemory:
+    fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": Insufficient memory available.\n");
+    goto Exit;
+  }
+
+  memset(&run, 0, sizeof(run));
+  run.h = h;
+  run.seed = seed;
+  run.chunk_size = chunk_size;
+  run.pattern = pattern;
+
+  for (p = first_pass; p < num_passes; p++)
+  {
+    run.pass = &passes[p];
+    if (WIPE_PASS_PATTERN == passes[p].type)
+      memset(pattern, passes[p].pattern, chunk_size);
+
+    pass_start = (p == first_pass) ? range_start + offset : range_start;
+    pos = pass_start;
+    total = range_end - pass_start;
+    done = 0;
+    cur = 0;
+    prev_valid = false;
+
+    wipe_make_message(message, sizeof(message), p, num_passes, &passes[p]);
+    fprintf(stdout, "%s", message);
+    fflush(stdout);
+
+    t0 = get_time_usec();
+
+    // pipeline: the chunks of segment k are written while the chunks of segment k-1 are verified
+
+    while ((pos < range_end) || (verify && prev_valid))
+    {
+      memset(&streams[cur], 0, sizeof(wipe_stream));
+
+      if (pos < range_end)
+      {
+        streams[cur].run = &run;
+        streams[cur].start = pos;
+        streams[cur].end = (range_end - pos) > segment_size ? pos + segment_size : range_end;
+
+        for (i = 0; i < num_workers; i++)
+        {
+          writers[i].stream = &streams[cur];
+          (void)workpool_submit(wp, WORKPOOL_NO_KEY, wipe_task, &writers[i]);
+        }
+      }
+
+      if (verify && prev_valid)
+      {
+        streams[cur ^ 1].verify = true;
+        streams[cur ^ 1].next_chunk = 0;
+        streams[cur ^ 1].bytes = 0;
+
+        for (i = 0; i < num_workers; i++)
+        {
+          verifiers[i].stream = &streams[cur ^ 1];
+          verifiers[i].mismatch_fp = (uint64_t)-1;
+          (void)workpool_submit(wp, WORKPOOL_NO_KEY, wipe_task, &verifiers[i]);
+        }
+      }
+
+      while (!workpool_wait(wp, WIPE_PROGRESS_INTERVAL_MS))
+      {
+        fprintf(stdout, "\r%s" CTRL_GREEN "%3.2f%%" CTRL_RESET, message,
+          (((double)(done + atomic_load64(&streams[0].bytes) + atomic_load64(&streams[1].bytes))) * 100.0) / ((double)(verify ? (total << 1) : total)));
+        fflush(stdout);
+      }
+
+      if (0 != atomic_load64(&run.errors))
+      {
+        fprintf(stdout, "\r%s" CTRL_RED "ERROR" CTRL_RESET "     \n", message);
+
+        io_error = false;
+        mismatch_fp = (uint64_t)-1;
+        for (i = 0; i < num_workers; i++)
+        {
+          io_error |= writers[i].io_error | verifiers[i].io_error;
+          if (verifiers[i].mismatch_fp < mismatch_fp)
+            mismatch_fp = verifiers[i].mismatch_fp;
+        }
+
+        if (io_error)
+          fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": Unable to perform write or read operation.\n");
+        if (((uint64_t)-1) != mismatch_fp)
+          fprintf(stderr, CTRL_RED "ERROR" CTRL_RESET ": verification failed at byte offset %" FMT64 "u (LBA %" FMT64 "u).\n", mismatch_fp, mismatch_fp >> SECTOR_SHIFT);
+        goto Exit;
+      }
+
+      // everything in front of the checkpoint is written and (if requested) verified
+
+      wrote = (pos < range_end) ? true : false;
+      if (wrote)
+      {
+        done += streams[cur].end - streams[cur].start;
+        pos = streams[cur].end;
+      }
+      if (verify && prev_valid)
+        done += streams[cur ^ 1].end - streams[cur ^ 1].start;
+
+      // a completed pass is recorded as the start of the next one
+
+      if (0 != cap->checkpoint_file[0] && (!verify || prev_valid))
+      {
+        checkpoint = (verify ? streams[cur ^ 1].end : streams[cur].end) - range_start;
+        if (checkpoint < range_size)
+          (void)wipe_save_checkpoint(cap->checkpoint_file, dp, range_start, range_end, spec, p, checkpoint, seed);
+        else
+          (void)wipe_save_checkpoint(cap->checkpoint_file, dp, range_start, range_end, spec, p + 1, 0, seed);
+      }
+
+      prev_valid = verify && wrote;
+      cur ^= 1;
+    }
+
+    elapsed = get_time_usec() - t0;
+
+    fprintf(stdout, "\r%s" CTRL_GREEN "OK" CTRL_RESET "     \n", message);
+
+    format_disk_size(total, size_str, sizeof(size_str));
+    format_disk_size(0 == elapsed ? 0 : (uint64_t)((((double)total) * 1000000.0) / ((double)elapsed)), rate_str, sizeof(rate_str));
+    fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": pass %u/%u (%s): %s in %.2f s = %s/s%s\n", p + 1, num_passes, passes[p].name,
+      size_str, ((double)elapsed) / 1000000.0, rate_str, verify ? " (written and verified)" : "");
+  }
+
+  if (0 != cap->checkpoint_file[0])
+    (void)remove(cap->checkpoint_file);
+
+  ok = true;
+
+Exit:
+  if (NULL != wp)
+    workpool_destroy(wp);
+
+  for (i = 0; i < num_workers; i++)
+  {
+    if (NULL != writers[i].mem)
+      free(writers[i].mem);
+    if (NULL != verifiers[i].mem)
+      free(verifiers[i].mem);
+    if (NULL != verifiers[i].mem2)
+      free(verifiers[i].mem2);
+  }
+
+  if (NULL != pattern_mem)
+    free(pattern_mem);
+
+  disk_close_device(h);
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,557 @@
+/**
+ * @file   workpool.c
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @brief  implementation of a small, portable worker thread pool (with optional
+ *         per-key concurrency limits) and of a global I/O bandwidth budget
+ *         shared by all workers.
+ *
+ * [MIT license]
+ *
+ * Copyright (c) 2021 Ingo A. Kubbilun
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <part-y.h>
+
+#ifdef _WINDOWS
+
+typedef CRITICAL_SECTION                wp_mutex;
+typedef CONDITION_VARIABLE              wp_cond;
+typedef HANDLE                          wp_thread;
+
+#define wp_mutex_init(_m)               InitializeCriticalSection(_m)
+#define wp_mutex_destroy(_m)            DeleteCriticalSection(_m)
+#define wp_mutex_lock(_m)               EnterCriticalSection(_m)
+#define wp_mutex_unlock(_m)             LeaveCriticalSection(_m)
+#define wp_cond_init(_c)                InitializeConditionVariable(_c)
+#define wp_cond_destroy(_c)             do { } while (0)
+#define wp_cond_wait(_c,_m)             SleepConditionVariableCS(_c, _m, INFINITE)
+#define wp_cond_signal(_c)              WakeConditionVariable(_c)
+#define wp_cond_broadcast(_c)           WakeAllConditionVariable(_c)
+
+#else // _LINUX
+
+typedef pthread_mutex_t                 wp_mutex;
+typedef pthread_cond_t                  wp_cond;
+typedef pthread_t                       wp_thread;
+
+#define wp_mutex_init(_m)               pthread_mutex_init(_m, NULL)
+#define wp_mutex_destroy(_m)            pthread_mutex_destroy(_m)
+#define wp_mutex_lock(_m)               pthread_mutex_lock(_m)
+#define wp_mutex_unlock(_m)             pthread_mutex_unlock(_m)
+#define wp_cond_init(_c)                pthread_cond_init(_c, NULL)
+#define wp_cond_destroy(_c)             pthread_cond_destroy(_c)
+#define wp_cond_wait(_c,_m)             pthread_cond_wait(_c, _m)
+#define wp_cond_signal(_c)              pthread_cond_signal(_c)
+#define wp_cond_broadcast(_c)           pthread_cond_broadcast(_c)
+
+#endif
+
+typedef struct _workpool_task           workpool_task, * workpool_task_ptr;
+typedef struct _workpool_key            workpool_key, * workpool_key_ptr;
+
+struct _workpool_task
+{
+  workpool_task_ptr                     next;                       ///< next task in FIFO (NULL if this is tail)
+  uint64_t                              key;                        ///< concurrency key or WORKPOOL_NO_KEY
+  workpool_func                         func;                       ///< task function
+  void                                 *arg;                        ///< argument of task function
+};
+
+struct _workpool_key
+{
+  uint64_t                              key;                        ///< concurrency key
+  uint32_t                              running;                    ///< number of currently running tasks with this key
+};
+
+struct _workpool
+{
+  wp_mutex                              lock;                       ///< protects all members below
+  wp_cond                               task_available;             ///< signalled if a task was added or a key slot was released
+  wp_cond                               task_done;                  ///< signalled if a task was completed
+
+  workpool_task_ptr                     head;                       ///< head of pending tasks (FIFO)
+  workpool_task_ptr                     tail;                       ///< tail of pending tasks (FIFO)
+
+  workpool_key_ptr                      keys;                       ///< running counters per key (only used if max_per_key != 0)
+  uint32_t                              num_keys;
+  uint32_t                              max_keys;
+  uint32_t                              max_per_key;                ///< 0 = unlimited
+
+  uint32_t                              num_pending;                ///< submitted but not completed tasks (queued + running)
+  bool                                  shutdown;                   ///< true if the worker threads have to terminate
+  bool                                  abandoned;                  ///< true if the last worker thread frees the pool (workpool_abandon)
+  uint32_t                              num_alive;                  ///< number of worker threads which have not terminated yet
+
+  uint32_t                              num_threads;
+  wp_thread                             threads[WORKPOOL_MAX_THREADS];
+};
+
+struct _io_budget
+{
+  wp_mutex                              lock;
+  uint64_t                              bytes_per_second;           ///< 0 = unlimited
+  uint64_t                              next_usec;                  ///< virtual time at which the next transfer may start
+};
+
+uint32_t workpool_num_cpus(void)
+{
+#ifdef _WINDOWS
+  SYSTEM_INFO         si;
+
+  GetSystemInfo(&si);
+
+  return 0 == si.dwNumberOfProcessors ? 1 : (uint32_t)si.dwNumberOfProcessors;
+#else
+  long                n = sysconf(_SC_NPROCESSORS_ONLN);
+
+  return n <= 0 ? 1 : (uint32_t)n;
+#endif
+}
+
+uint64_t get_time_usec(void)
+{
+#ifdef _WINDOWS
+  LARGE_INTEGER       freq, cnt;
+
+  QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&cnt);
+
+  return (uint64_t)((((double)cnt.QuadPart) * 1000000.0) / ((double)freq.QuadPart));
+#else
+  struct timespec     ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (((uint64_t)ts.tv_sec) * 1000000) + (((uint64_t)ts.tv_nsec) / 1000);
+#endif
+}
+
+static void sleep_usec(uint64_t usec)
+{
+#ifdef _WINDOWS
+  Sleep((DWORD)((usec + 999) / 1000));
+#else
+  struct timespec     ts;
+
+  ts.tv_sec = (time_t)(usec / 1000000);
+  ts.tv_nsec = (long)((usec % 1000000) * 1000);
+
+  while ((0 != nanosleep(&ts, &ts)) && (EINTR == errno));
+#endif
+}
+
+uint64_t atomic_add64(volatile uint64_t* p, uint64_t value)
+{
+#ifdef _WINDOWS
+  return (uint64_t)InterlockedAdd64((volatile LONG64*)p, (LONG64)value);
+#else
+  return __atomic_add_fetch(p, value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+uint64_t atomic_load64(volatile uint64_t* p)
+{
+#ifdef _WINDOWS
+  return (uint64_t)InterlockedCompareExchange64((volatile LONG64*)p, 0, 0);
+#else
+  return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static workpool_key_ptr workpool_find_key(workpool_ptr wp, uint64_t key)
+{
+  uint32_t            i;
+
+  for (i = 0; i < wp->num_keys; i++)
+    if (key == wp->keys[i].key)
+      return &wp->keys[i];
+
+  return NULL;
+}
+
+// lock must be held: dequeues the first runnable task (submission order, skipping tasks whose key is exhausted)
+static workpool_task_ptr workpool_dequeue(workpool_ptr wp)
+{
+  workpool_task_ptr   run = wp->head, prev = NULL;
+  workpool_key_ptr    kp;
+
+  while (NULL != run)
+  {
+    if ((0 == wp->max_per_key) || (WORKPOOL_NO_KEY == run->key))
+      break;
+
+    kp = workpool_find_key(wp, run->key);
+    if ((NULL == kp) || (kp->running < wp->max_per_key))
+    {
+      if (NULL == kp) // key is not yet known; the array was sized in workpool_submit, so there is room
+      {
+        kp = &wp->keys[wp->num_keys++];
+        kp->key = run->key;
+        kp->running = 0;
+      }
+      kp->running++;
+      break;
+    }
+
+    prev = run;
+    run = run->next;
+  }
+
+  if (NULL == run)
+    return NULL;
+
+  if (NULL == prev)
+    wp->head = run->next;
+  else
+    prev->next = run->next;
+
+  if (wp->tail == run)
+    wp->tail = prev;
+
+  return run;
+}
+
+static void workpool_free(workpool_ptr wp)
+{
+  while (NULL != wp->head) // only if there were no threads at all
+  {
+    wp->tail = wp->head->next;
+    free(wp->head);
+    wp->head = wp->tail;
+  }
+
+  if (NULL != wp->keys)
+    free(wp->keys);
+
+  wp_cond_destroy(&wp->task_done);
+  wp_cond_destroy(&wp->task_available);
+  wp_mutex_destroy(&wp->lock);
+
+  free(wp);
+}
+
+#ifdef _WINDOWS
+static DWORD WINAPI workpool_thread(LPVOID param)
+#else
+static void* workpool_thread(void* param)
+#endif
+{
+  workpool_ptr        wp = (workpool_ptr)param;
+  workpool_task_ptr   tp;
+  workpool_key_ptr    kp;
+  bool                last;
+
+  wp_mutex_lock(&wp->lock);
+
+  for (;;)
+  {
+    tp = workpool_dequeue(wp);
+
+    if (NULL == tp)
+    {
+      if (wp->shutdown && NULL == wp->head)
+        break;
+
+      wp_cond_wait(&wp->task_available, &wp->lock);
+      continue;
+    }
+
+    wp_mutex_unlock(&wp->lock);
+
+    tp->func(tp->arg);
+
+    wp_mutex_lock(&wp->lock);
+
+    if ((0 != wp->max_per_key) && (WORKPOOL_NO_KEY != tp->key))
+    {
+      kp = workpool_find_key(wp, tp->key);
+      if (NULL != kp && 0 != kp->running)
+        kp->running--;
+      wp_cond_broadcast(&wp->task_available); // a key slot is available again
+    }
+
+    free(tp);
+
+    wp->num_pending--;
+    if (0 == wp->num_pending)
+      wp_cond_broadcast(&wp->task_done);
+  }
+
+  wp->num_alive--;
+  last = wp->abandoned && 0 == wp->num_alive;
+
+  wp_mutex_unlock(&wp->lock);
+
+  if (last) // nobody waits for this pool anymore
+    workpool_free(wp);
+
+#ifdef _WINDOWS
+  return 0;
+#else
+  return NULL;
+#endif
+}
+
+workpool_ptr workpool_create(uint32_t num_threads, uint32_t max_per_key)
+{
+  workpool_ptr        wp;
+  uint32_t            i;
+
+  if (0 == num_threads)
+    num_threads = workpool_num_cpus();
+
+  if (num_threads > WORKPOOL_MAX_THREADS)
+    num_threads = WORKPOOL_MAX_THREADS;
+
+  wp = (workpool_ptr)malloc(sizeof(workpool));
+  if (unlikely(NULL == wp))
+    return NULL;
+
+  memset(wp, 0, sizeof(workpool));
+
+  wp_mutex_init(&wp->lock);
+  wp_cond_init(&wp->task_available);
+  wp_cond_init(&wp->task_done);
+
+  wp->max_per_key = max_per_key;
+
+  for (i = 0; i < num_threads; i++)
+  {
+#ifdef _WINDOWS
+    wp->threads[i] = CreateThread(NULL, 0, workpool_thread, wp, 0, NULL);
+    if (NULL == wp->threads[i])
+      break;
+#else
+    if (0 != pthread_create(&wp->threads[i], NULL, workpool_thread, wp))
+      break;
+#endif
+    wp->num_threads++;
+    wp->num_alive++;
+  }
+
+  if (0 == wp->num_threads)
+  {
+    workpool_destroy(wp);
+    return NULL;
+  }
+
+  return wp;
+}
+
+bool workpool_submit(workpool_ptr wp, uint64_t key, workpool_func func, void* arg)
+{
+  workpool_task_ptr   tp;
+  workpool_key_ptr    keys;
+
+  if (unlikely(NULL == wp || NULL == func))
+    return false;
+
+  tp = (workpool_task_ptr)malloc(sizeof(workpool_task));
+  if (unlikely(NULL == tp))
+    return false;
+
+  memset(tp, 0, sizeof(workpool_task));
+  tp->key = key;
+  tp->func = func;
+  tp->arg = arg;
+
+  wp_mutex_lock(&wp->lock);
+
+  // every task may introduce one new key, so make sure there is room for it before it is queued
+
+  if ((0 != wp->max_per_key) && (WORKPOOL_NO_KEY != key) && (wp->num_keys + wp->num_pending >= wp->max_keys))
+  {
+    keys = (workpool_key_ptr)realloc(wp->keys, (wp->max_keys + 16 + wp->num_pending) * sizeof(workpool_key));
+    if (unlikely(NULL == keys))
+    {
+      wp_mutex_unlock(&wp->lock);
+      free(tp);
+      return false;
+    }
+    wp->keys = keys;
+    wp->max_keys += 16 + wp->num_pending;
+  }
+
+  if (NULL == wp->tail)
+    wp->head = tp;
+  else
+    wp->tail->next = tp;
+  wp->tail = tp;
+
+  wp->num_pending++;
+
+  wp_cond_signal(&wp->task_available);
+
+  wp_mutex_unlock(&wp->lock);
+
+  return true;
+}
+
+bool workpool_wait(workpool_ptr wp, uint32_t timeout_ms)
+{
+  bool                idle;
+#ifndef _WINDOWS
+  struct timespec     ts;
+#endif
+
+  if (NULL == wp)
+    return true;
+
+  wp_mutex_lock(&wp->lock);
+
+  if (0 == timeout_ms)
+  {
+    while (0 != wp->num_pending)
+      wp_cond_wait(&wp->task_done, &wp->lock);
+  }
+  else
+  if (0 != wp->num_pending)
+  {
+#ifdef _WINDOWS
+    SleepConditionVariableCS(&wp->task_done, &wp->lock, timeout_ms);
+#else
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += timeout_ms / 1000;
+    ts.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000)
+    {
+      ts.tv_sec++;
+      ts.tv_nsec -= 1000000000;
+    }
+    (void)pthread_cond_timedwait(&wp->task_done, &wp->lock, &ts);
+#endif
+  }
+
+  idle = (0 == wp->num_pending) ? true : false;
+
+  wp_mutex_unlock(&wp->lock);
+
+  return idle;
+}
+
+void workpool_destroy(workpool_ptr wp)
+{
+  uint32_t            i;
+
+  if (NULL == wp)
+    return;
+
+  wp_mutex_lock(&wp->lock);
+  wp->shutdown = true;
+  wp_cond_broadcast(&wp->task_available);
+  wp_mutex_unlock(&wp->lock);
+
+  for (i = 0; i < wp->num_threads; i++)
+  {
+#ifdef _WINDOWS
+    WaitForSingleObject(wp->threads[i], INFINITE);
+    CloseHandle(wp->threads[i]);
+#else
+    pthread_join(wp->threads[i], NULL);
+#endif
+  }
+
+  workpool_free(wp);
+}
+
+void workpool_abandon(workpool_ptr wp)
+{
+  workpool_task_ptr   tp;
+  uint32_t            i;
+  bool                last;
+
+  if (NULL == wp)
+    return;
+
+  wp_mutex_lock(&wp->lock);
+
+  while (NULL != wp->head) // queued tasks are never started
+  {
+    tp = wp->head;
+    wp->head = tp->next;
+    free(tp);
+    wp->num_pending--;
+  }
+  wp->tail = NULL;
+
+  for (i = 0; i < wp->num_threads; i++)
+  {
+#ifdef _WINDOWS
+    CloseHandle(wp->threads[i]);
+#else
+    pthread_detach(wp->threads[i]);
+#endif
+  }
+
+  wp->shutdown = true;
+  wp->abandoned = true;
+  last = (0 == wp->num_alive);
+  wp_cond_broadcast(&wp->task_available);
+
+  wp_mutex_unlock(&wp->lock);
+
+  if (last)
+    workpool_free(wp);
+}
+
+io_budget_ptr io_budget_create(uint64_t bytes_per_second)
+{
+  io_budget_ptr       bp = (io_budget_ptr)malloc(sizeof(io_budget));
+
+  if (unlikely(NULL == bp))
+    return NULL;
+
+  memset(bp, 0, sizeof(io_budget));
+
+  wp_mutex_init(&bp->lock);
+  bp->bytes_per_second = bytes_per_second;
+
+  return bp;
+}
+
+void io_budget_consume(io_budget_ptr bp, uint64_t bytes)
+{
+  uint64_t            now, start;
+
+  if (NULL == bp || 0 == bp->bytes_per_second || 0 == bytes)
+    return;
+
+  now = get_time_usec();
+
+  // reserve a slot on the shared virtual time line, then sleep (outside of the lock) until it begins
+
+  wp_mutex_lock(&bp->lock);
+  start = bp->next_usec > now ? bp->next_usec : now;
+  bp->next_usec = start + (uint64_t)((((double)bytes) * 1000000.0) / ((double)bp->bytes_per_second));
+  wp_mutex_unlock(&bp->lock);
+
+  if (start > now)
+    sleep_usec(start - now);
+}
+
+void io_budget_free(io_budget_ptr bp)
+{
+  if (NULL != bp)
+  {
+    wp_mutex_destroy(&bp->lock);
+    free(bp);
+  }
+}
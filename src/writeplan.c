@@ -0,0 +1,328 @@
+/**
+ * @file   writeplan.c
+ * @author Ingo A. Kubbilun (www.devcorn.de)
+ * @brief  implementation of write plans (sorted, coalesced and vectored sector
+ *         writes with flush barriers).
+ *
+ * [MIT license]
+ *
+ * Copyright (c) 2021 Ingo A. Kubbilun
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <part-y.h>
+
+static int writePlanCompare(const void* a, const void* b)
+{
+  const write_plan_item* x = (const write_plan_item*)a;
+  const write_plan_item* y = (const write_plan_item*)b;
+
+  if (x->phase != y->phase)
+    return (x->phase < y->phase) ? -1 : 1;
+  if (x->lba != y->lba)
+    return (x->lba < y->lba) ? -1 : 1;
+  return (x->seq < y->seq) ? -1 : ((x->seq > y->seq) ? 1 : 0);
+}
+
+static bool writePlanSort(write_plan_ptr wpp, char* error, size_t error_size)
+{
+  uint32_t            i;
+  write_plan_item_ptr prev, item;
+
+  if (wpp->sorted)
+    return true;
+
+  if (wpp->num_items > 1)
+    qsort(wpp->items, wpp->num_items, sizeof(write_plan_item), writePlanCompare);
+
+  // two writes of the same phase must not overlap, otherwise the result depends on the order
+
+  for (i = 1; i < wpp->num_items; i++)
+  {
+    prev = &wpp->items[i - 1];
+    item = &wpp->items[i];
+    if (prev->phase == item->phase && item->lba < prev->lba + prev->num_sectors)
+    {
+      if (NULL != error)
+        snprintf(error, error_size, "the writes of LBAs %" FMT64 "u..%" FMT64 "u (%s) and %" FMT64 "u..%" FMT64 "u (%s) overlap",
+          prev->lba, prev->lba + prev->num_sectors - 1, prev->description, item->lba, item->lba + item->num_sectors - 1, item->description);
+      return false;
+    }
+  }
+
+  wpp->sorted = true;
+  return true;
+}
+
+static uint32_t writePlanRun(write_plan_ptr wpp, uint32_t first, uint64_t* num_sectors)
+{
+  uint32_t            n = 1;
+  uint64_t            sectors = wpp->items[first].num_sectors;
+  write_plan_item_ptr item;
+
+  // a run of adjacent writes of the same phase is issued as one vectored write
+
+  while (first + n < wpp->num_items && n < DISK_MAX_IO_VECTORS)
+  {
+    item = &wpp->items[first + n];
+    if (item->phase != wpp->items[first].phase || item->lba != wpp->items[first].lba + sectors ||
+        ((sectors + item->num_sectors) << SECTOR_SHIFT) > WRITE_PLAN_MAX_WRITE)
+      break;
+    sectors += item->num_sectors;
+    n++;
+  }
+
+  *num_sectors = sectors;
+  return n;
+}
+
+static uint32_t writePlanNumPhases(write_plan_ptr wpp)
+{
+  // a trailing barrier does not open a (used) phase
+
+  return (0 == wpp->num_items) ? 0 : wpp->items[wpp->num_items - 1].phase + 1;
+}
+
+write_plan_ptr write_plan_create(void)
+{
+  write_plan_ptr      wpp = (write_plan_ptr)malloc(sizeof(write_plan));
+
+  if (NULL == wpp)
+    return NULL;
+
+  memset(wpp, 0, sizeof(write_plan));
+  wpp->num_phases = 1;
+  wpp->sorted = true;
+
+  return wpp;
+}
+
+void write_plan_free(write_plan_ptr wpp)
+{
+  uint32_t            i;
+
+  if (NULL == wpp)
+    return;
+
+  for (i = 0; i < wpp->num_items; i++)
+    free(wpp->items[i].data_malloc_ptr);
+  if (NULL != wpp->items)
+    free(wpp->items);
+  free(wpp);
+}
+
+bool write_plan_add(write_plan_ptr wpp, uint64_t lba, uint32_t num_sectors, const uint8_t* data, const char* description)
+{
+  write_plan_item_ptr item, items;
+  uint64_t            size = ((uint64_t)num_sectors) << SECTOR_SHIFT;
+
+  if (NULL == wpp || 0 == num_sectors || wpp->num_bytes + size > WRITE_PLAN_MAX_BYTES)
+    return false;
+
+  if (wpp->num_items == wpp->max_items)
+  {
+    items = (write_plan_item_ptr)realloc(wpp->items, (wpp->max_items + 16) * sizeof(write_plan_item));
+    if (NULL == items)
+      return false;
+    wpp->items = items;
+    wpp->max_items += 16;
+  }
+
+  item = &wpp->items[wpp->num_items];
+  memset(item, 0, sizeof(write_plan_item));
+
+  item->data_malloc_ptr = malloc(size + SECTOR_MEM_ALIGN);
+  if (NULL == item->data_malloc_ptr)
+    return false;
+  item->data = (uint8_t*)((((uint64_t)item->data_malloc_ptr) + (SECTOR_MEM_ALIGN - 1)) & (~((uint64_t)(SECTOR_MEM_ALIGN - 1))));
+  if (NULL != data)
+    memcpy(item->data, data, size);
+  else
+    memset(item->data, 0, size);
+
+  item->lba = lba;
+  item->num_sectors = num_sectors;
+  item->phase = wpp->num_phases - 1;
+  item->seq = wpp->num_items;
+  strncpy(item->description, (NULL != description) ? description : "data", sizeof(item->description) - 1);
+
+  wpp->num_items++;
+  wpp->num_bytes += size;
+  wpp->sorted = false;
+
+  return true;
+}
+
+void write_plan_barrier(write_plan_ptr wpp)
+{
+  // only a phase containing writes is ended (no empty phases, no redundant flushes); the last
+  // item always belongs to the latest phase because sorting keeps the phase order
+
+  if (NULL != wpp && 0 != wpp->num_items && wpp->items[wpp->num_items - 1].phase == wpp->num_phases - 1)
+    wpp->num_phases++;
+}
+
+bool write_plan_append(write_plan_ptr wpp, write_plan_ptr src)
+{
+  write_plan_item_ptr items;
+  uint32_t            i, base;
+
+  if (NULL == wpp || NULL == src || wpp->num_bytes + src->num_bytes > WRITE_PLAN_MAX_BYTES)
+    return false;
+
+  if (0 == src->num_items)
+    return true;
+
+  if (wpp->num_items + src->num_items > wpp->max_items)
+  {
+    items = (write_plan_item_ptr)realloc(wpp->items, (wpp->num_items + src->num_items) * sizeof(write_plan_item));
+    if (NULL == items)
+      return false;
+    wpp->items = items;
+    wpp->max_items = wpp->num_items + src->num_items;
+  }
+
+  write_plan_barrier(wpp);
+  base = wpp->num_phases - 1;
+
+  // the data copies are moved (src is empty afterwards)
+
+  for (i = 0; i < src->num_items; i++)
+  {
+    memcpy(&wpp->items[wpp->num_items], &src->items[i], sizeof(write_plan_item));
+    wpp->items[wpp->num_items].phase += base;
+    wpp->items[wpp->num_items].seq = wpp->num_items;
+    wpp->num_items++;
+  }
+
+  wpp->num_phases = base + src->num_phases;
+  wpp->num_bytes += src->num_bytes;
+  wpp->sorted = false;
+
+  src->num_items = 0;
+  src->num_phases = 1;
+  src->num_bytes = 0;
+  src->sorted = true;
+
+  return true;
+}
+
+void write_plan_dump(write_plan_ptr wpp)
+{
+  uint32_t            i, j, n, num_writes = 0, num_phases;
+  uint64_t            num_sectors;
+  char                error[256], size_str[16];
+  write_plan_item_ptr item;
+
+  if (NULL == wpp || 0 == wpp->num_items)
+  {
+    fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": nothing has to be written.\n");
+    return;
+  }
+
+  if (!writePlanSort(wpp, error, sizeof(error)))
+  {
+    fprintf(stdout, CTRL_RED "ERROR" CTRL_RESET ": invalid write plan: %s.\n", error);
+    return;
+  }
+
+  for (i = 0; i < wpp->num_items; i += n)
+  {
+    n = writePlanRun(wpp, i, &num_sectors);
+    item = &wpp->items[i];
+
+    if (0 != i && wpp->items[i - 1].phase != item->phase)
+      fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": flush (the writes above are durable before the writes below are issued)\n");
+
+    if (1 == n)
+      fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": writing LBAs %" FMT64 "u..%" FMT64 "u (%u sector(s), %s)\n",
+        item->lba, item->lba + item->num_sectors - 1, item->num_sectors, item->description);
+    else
+    {
+      fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": writing LBAs %" FMT64 "u..%" FMT64 "u (%" FMT64 "u sector(s), %u regions in one write):\n",
+        item->lba, item->lba + num_sectors - 1, num_sectors, n);
+      for (j = 0; j < n; j++)
+        fprintf(stdout, "      LBAs %" FMT64 "u..%" FMT64 "u (%u sector(s), %s)\n",
+          item[j].lba, item[j].lba + item[j].num_sectors - 1, item[j].num_sectors, item[j].description);
+    }
+
+    num_writes++;
+  }
+
+  num_phases = writePlanNumPhases(wpp);
+  format_disk_size(wpp->num_bytes, size_str, sizeof(size_str));
+
+  // without a plan, each region is one synchronous (write-through) write, i.e. a write plus a flush
+
+  fprintf(stdout, CTRL_YELLOW "INFO" CTRL_RESET ": cost: %s in %u write(s) and %u flush(es); unbatched: %u synchronous write(s).\n",
+    size_str, num_writes, num_phases, wpp->num_items);
+}
+
+bool write_plan_execute(write_plan_ptr wpp, const char* device_file, char* error, size_t error_size)
+{
+  DISK_HANDLE         h = INVALID_DISK_HANDLE;
+  disk_io_vector      iov[DISK_MAX_IO_VECTORS];
+  uint32_t            i, j, n;
+  uint64_t            num_sectors;
+  bool                ok = false;
+
+  if (NULL == wpp || 0 == wpp->num_items)
+    return true;
+
+  if (!writePlanSort(wpp, error, error_size))
+    return false;
+
+  h = disk_open_device_batched(device_file);
+  if (INVALID_DISK_HANDLE == h)
+  {
+    snprintf(error, error_size, "unable to open the device %s for reading AND writing", device_file);
+    return false;
+  }
+
+  for (i = 0; i < wpp->num_items; i += n)
+  {
+    n = writePlanRun(wpp, i, &num_sectors);
+
+    if (0 != i && wpp->items[i - 1].phase != wpp->items[i].phase && !disk_flush_device(h))
+    {
+      snprintf(error, error_size, "unable to flush the device %s", device_file);
+      goto Exit;
+    }
+
+    for (j = 0; j < n; j++)
+    {
+      iov[j].buffer = wpp->items[i + j].data;
+      iov[j].size = wpp->items[i + j].num_sectors << SECTOR_SHIFT;
+    }
+
+    if (!disk_write_vector_at(h, wpp->items[i].lba << SECTOR_SHIFT, iov, n))
+    {
+      snprintf(error, error_size, "unable to write LBAs %" FMT64 "u..%" FMT64 "u", wpp->items[i].lba, wpp->items[i].lba + num_sectors - 1);
+      goto Exit;
+    }
+  }
+
+  ok = true;
+
+Exit:
+  disk_close_device(h); // final flush
+
+  return ok;
+}